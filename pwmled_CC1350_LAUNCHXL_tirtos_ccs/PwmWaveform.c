@@ -0,0 +1,300 @@
+/*
+ * Copyright (c) 2015-2016, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/***** Includes *****/
+#include "PwmWaveform.h"
+
+#include <xdc/std.h>
+
+#include <ti/drivers/pwm/PWMTimerCC26XX.h>
+#include <ti/drivers/timer/GPTimerCC26XX.h>
+#include <ti/drivers/dma/UDMACC26XX.h>
+
+#include <ti/devices/DeviceFamily.h>
+#include DEVICE_FAMILY_PATH(inc/hw_types.h)
+#include DEVICE_FAMILY_PATH(inc/hw_memmap.h)
+#include DEVICE_FAMILY_PATH(inc/hw_gpt.h)
+#include DEVICE_FAMILY_PATH(driverlib/udma.h)
+
+/***** Defines *****/
+/* The timers run from the 48 MHz system clock */
+#define PWMWAVEFORM_PERIOD_COUNTS   (PWMWAVEFORM_PWM_PERIOD_US * 48)
+
+#if PWMWAVEFORM_PERIOD_COUNTS > 0xFFFF
+#error "PWMWAVEFORM_PWM_PERIOD_US is too long for a 16-bit match value"
+#endif
+
+/* Longest uDMA transfer, so the most PWM periods one step can last */
+#define PWMWAVEFORM_MAX_REPEAT      1024
+
+/***** Type declarations *****/
+typedef struct
+{
+    PWM_Handle pwm; //NULL if the channel is free
+    uint_least8_t pwmIndex;
+    uint32_t gptBase;
+    uint32_t matchRegister;
+    uint32_t dmaEventEnable; //GPT_DMAEV bit of the timer half
+    uint32_t dmaChannel;
+    /* One task per step, and one copying primary back to restart the list */
+    tDMAControlTable tasks[PWMWAVEFORM_STEPS + 1];
+    tDMAControlTable primary;
+} PwmWaveform_Channel;
+
+/***** Variable declarations *****/
+PwmWaveform_Channel pwmWaveformChannels[PWMWAVEFORM_MAX_CHANNELS]; /* not static so you can see it in the memory browser */
+static uint32_t levelMatch[PWMWAVEFORM_LEVELS];
+static UDMACC26XX_Handle udmaHandle;
+
+/* Control table entries of the timer uDMA channels, the alternate entries are
+ * written by the scatter-gather tasks */
+ALLOCATE_CONTROL_TABLE_ENTRY(dmaTimer0APriControlTableEntry, UDMA_CHAN_TIMER0_A);
+ALLOCATE_CONTROL_TABLE_ENTRY(dmaTimer0AAltControlTableEntry, (UDMA_CHAN_TIMER0_A | UDMA_ALT_SELECT));
+ALLOCATE_CONTROL_TABLE_ENTRY(dmaTimer0BPriControlTableEntry, UDMA_CHAN_TIMER0_B);
+ALLOCATE_CONTROL_TABLE_ENTRY(dmaTimer0BAltControlTableEntry, (UDMA_CHAN_TIMER0_B | UDMA_ALT_SELECT));
+ALLOCATE_CONTROL_TABLE_ENTRY(dmaTimer1APriControlTableEntry, UDMA_CHAN_TIMER1_A);
+ALLOCATE_CONTROL_TABLE_ENTRY(dmaTimer1AAltControlTableEntry, (UDMA_CHAN_TIMER1_A | UDMA_ALT_SELECT));
+ALLOCATE_CONTROL_TABLE_ENTRY(dmaTimer1BPriControlTableEntry, UDMA_CHAN_TIMER1_B);
+ALLOCATE_CONTROL_TABLE_ENTRY(dmaTimer1BAltControlTableEntry, (UDMA_CHAN_TIMER1_B | UDMA_ALT_SELECT));
+
+/***** Prototypes *****/
+static PwmWaveform_Channel* findChannel(uint_least8_t pwmIndex);
+static PwmWaveform_Channel* findFreeChannel(void);
+static bool setupTimerDma(PwmWaveform_Channel* channel);
+static uint8_t stepLevel(const PwmWaveform_Params* params, uint8_t step);
+
+/***** Function definitions *****/
+void PwmWaveform_Params_init(PwmWaveform_Params* params)
+{
+    params->shape = PwmWaveform_Shape_Sine;
+    params->periodMs = 2000;
+    params->phaseDeg = 0;
+    params->maxLevel = PWMWAVEFORM_LEVELS - 1;
+}
+
+void PwmWaveform_init(void)
+{
+    uint8_t i;
+
+    PWM_init();
+    udmaHandle = UDMACC26XX_open();
+
+    /* The timer counts down and the output goes low at the match, so the match
+     * value is the period minus the duty */
+    for (i = 0; i < PWMWAVEFORM_LEVELS; i++)
+    {
+        levelMatch[i] = PWMWAVEFORM_PERIOD_COUNTS -
+                        ((PWMWAVEFORM_PERIOD_COUNTS * (uint32_t)PwmWaveform_gamma[i]) / 0xFFFF);
+    }
+}
+
+bool PwmWaveform_start(uint_least8_t pwmIndex, const PwmWaveform_Params* params)
+{
+    PwmWaveform_Channel* channel;
+    PWM_Params pwmParams;
+    tDMAControlTable* controlTable = (tDMAControlTable*)uDMAControlBaseGet(UDMA0_BASE);
+    uint32_t repeat;
+    uint8_t offset;
+    uint8_t step;
+
+    PwmWaveform_stop(pwmIndex);
+
+    channel = findFreeChannel();
+    if (channel == NULL)
+    {
+        return false;
+    }
+
+    PWM_Params_init(&pwmParams);
+    pwmParams.periodUnits = PWM_PERIOD_COUNTS;
+    pwmParams.periodValue = PWMWAVEFORM_PERIOD_COUNTS;
+    pwmParams.dutyUnits = PWM_DUTY_COUNTS;
+    pwmParams.dutyValue = 0;
+    channel->pwm = PWM_open(pwmIndex, &pwmParams);
+    if (channel->pwm == NULL)
+    {
+        return false;
+    }
+    channel->pwmIndex = pwmIndex;
+
+    if (!setupTimerDma(channel))
+    {
+        PWM_close(channel->pwm);
+        channel->pwm = NULL;
+        return false;
+    }
+
+    /* Each step holds its match value for repeat PWM periods */
+    repeat = (params->periodMs * 1000) / (PWMWAVEFORM_PWM_PERIOD_US * PWMWAVEFORM_STEPS);
+    if (repeat == 0)
+    {
+        repeat = 1;
+    }
+    else if (repeat > PWMWAVEFORM_MAX_REPEAT)
+    {
+        repeat = PWMWAVEFORM_MAX_REPEAT;
+    }
+    offset = ((uint32_t)(params->phaseDeg % 360) * PWMWAVEFORM_STEPS) / 360;
+
+    for (step = 0; step < PWMWAVEFORM_STEPS; step++)
+    {
+        channel->tasks[step] = (tDMAControlTable)uDMATaskStructEntry(repeat, UDMA_SIZE_32,
+            UDMA_SRC_INC_NONE, &levelMatch[stepLevel(params, (step + offset) % PWMWAVEFORM_STEPS)],
+            UDMA_DST_INC_NONE, (void*)channel->matchRegister,
+            UDMA_ARB_1, UDMA_MODE_PER_SCATTER_GATHER);
+    }
+
+    /* Restore the primary control structure, which the list has used up by
+     * now, so the next timeout starts it over */
+    channel->tasks[PWMWAVEFORM_STEPS] = (tDMAControlTable)uDMATaskStructEntry(4, UDMA_SIZE_32,
+        UDMA_SRC_INC_32, &channel->primary,
+        UDMA_DST_INC_32, &controlTable[channel->dmaChannel],
+        UDMA_ARB_4, UDMA_MODE_PER_SCATTER_GATHER);
+
+    uDMAChannelAttributeDisable(UDMA0_BASE, channel->dmaChannel, UDMA_ATTR_ALL);
+    uDMAChannelScatterGatherSet(UDMA0_BASE, channel->dmaChannel, PWMWAVEFORM_STEPS + 1, channel->tasks, true);
+    channel->primary = controlTable[channel->dmaChannel];
+
+    PWM_start(channel->pwm);
+    UDMACC26XX_channelEnable(udmaHandle, 1 << channel->dmaChannel);
+    HWREG(channel->gptBase + GPT_O_DMAEV) |= channel->dmaEventEnable;
+
+    return true;
+}
+
+void PwmWaveform_stop(uint_least8_t pwmIndex)
+{
+    PwmWaveform_Channel* channel = findChannel(pwmIndex);
+
+    if (channel == NULL)
+    {
+        return;
+    }
+
+    HWREG(channel->gptBase + GPT_O_DMAEV) &= ~channel->dmaEventEnable;
+    UDMACC26XX_channelDisable(udmaHandle, 1 << channel->dmaChannel);
+
+    PWM_stop(channel->pwm);
+    PWM_close(channel->pwm);
+    channel->pwm = NULL;
+}
+
+static PwmWaveform_Channel* findChannel(uint_least8_t pwmIndex)
+{
+    uint8_t i;
+
+    for (i = 0; i < PWMWAVEFORM_MAX_CHANNELS; i++)
+    {
+        if ((pwmWaveformChannels[i].pwm != NULL) && (pwmWaveformChannels[i].pwmIndex == pwmIndex))
+        {
+            return &pwmWaveformChannels[i];
+        }
+    }
+
+    return NULL;
+}
+
+static PwmWaveform_Channel* findFreeChannel(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < PWMWAVEFORM_MAX_CHANNELS; i++)
+    {
+        if (pwmWaveformChannels[i].pwm == NULL)
+        {
+            return &pwmWaveformChannels[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* Finds the match register, timeout DMA event and uDMA channel of the timer
+ * half the PWM driver opened */
+static bool setupTimerDma(PwmWaveform_Channel* channel)
+{
+    GPTimerCC26XX_Handle hTimer = ((PWMTimerCC26XX_Object*)channel->pwm->object)->hTimer;
+    bool timerA = (hTimer->timerPart == GPT_A);
+
+    channel->gptBase = hTimer->hwAttrs->baseAddr;
+    channel->matchRegister = channel->gptBase + (timerA ? GPT_O_TAMATCHR : GPT_O_TBMATCHR);
+    channel->dmaEventEnable = timerA ? GPT_DMAEV_TATODMAEN : GPT_DMAEV_TBTODMAEN;
+
+    if (channel->gptBase == GPT0_BASE)
+    {
+        channel->dmaChannel = timerA ? UDMA_CHAN_TIMER0_A : UDMA_CHAN_TIMER0_B;
+    }
+    else if (channel->gptBase == GPT1_BASE)
+    {
+        channel->dmaChannel = timerA ? UDMA_CHAN_TIMER1_A : UDMA_CHAN_TIMER1_B;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+static uint8_t stepLevel(const PwmWaveform_Params* params, uint8_t step)
+{
+    uint32_t level;
+
+    switch (params->shape)
+    {
+    case PwmWaveform_Shape_Square:
+        level = (step < PWMWAVEFORM_STEPS / 2) ? 0 : PWMWAVEFORM_LEVELS - 1;
+        break;
+    case PwmWaveform_Shape_Triangle:
+        level = (step < PWMWAVEFORM_STEPS / 2) ? step : PWMWAVEFORM_STEPS - step;
+        level = (level * (PWMWAVEFORM_LEVELS - 1)) / (PWMWAVEFORM_STEPS / 2);
+        break;
+    case PwmWaveform_Shape_Sawtooth:
+        level = ((uint32_t)step * (PWMWAVEFORM_LEVELS - 1)) / (PWMWAVEFORM_STEPS - 1);
+        break;
+    case PwmWaveform_Shape_Sine:
+        level = PwmWaveform_sine[step];
+        break;
+    case PwmWaveform_Shape_Constant:
+    default:
+        level = PWMWAVEFORM_LEVELS - 1;
+        break;
+    }
+
+    /* Scale down to the top level of the waveform */
+    if (params->maxLevel < PWMWAVEFORM_LEVELS - 1)
+    {
+        level = (level * params->maxLevel) / (PWMWAVEFORM_LEVELS - 1);
+    }
+
+    return (uint8_t)level;
+}
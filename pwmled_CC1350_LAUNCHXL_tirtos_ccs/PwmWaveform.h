@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2015-2016, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PWMWAVEFORM_H_
+#define PWMWAVEFORM_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+
+#include <ti/drivers/PWM.h>
+
+/* LED waveforms played by the uDMA, without waking the CPU.
+ *
+ * Each channel runs its PWM timer at PWMWAVEFORM_PWM_PERIOD_US. At every
+ * timer timeout the timer's uDMA channel writes the next match value, taken
+ * from a peripheral scatter-gather task list that walks through the
+ * PWMWAVEFORM_STEPS steps of the waveform. The last task copies the saved
+ * primary control structure back, so the list starts over without the CPU.
+ * The CPU only builds the task list when a waveform is started.
+ *
+ * Only PWM instances on GPTimer 0 and 1 can be used, the other timers have no
+ * uDMA channel.
+ */
+
+/* The PWM period, the match value written by the uDMA has 16 bits so it must
+ * stay below 65536 / 48 MHz */
+#ifndef PWMWAVEFORM_PWM_PERIOD_US
+#define PWMWAVEFORM_PWM_PERIOD_US   1000
+#endif
+
+/* Brightness levels in the gamma table and steps in one waveform period,
+ * tools/gen_pwm_tables.py generates PwmWaveformTables.c for these */
+#define PWMWAVEFORM_LEVELS          64
+#define PWMWAVEFORM_STEPS           64
+
+/* Number of waveforms playing at the same time */
+#ifndef PWMWAVEFORM_MAX_CHANNELS
+#define PWMWAVEFORM_MAX_CHANNELS    3
+#endif
+
+typedef enum
+{
+    PwmWaveform_Shape_Constant, //stays at the top level
+    PwmWaveform_Shape_Square,
+    PwmWaveform_Shape_Triangle,
+    PwmWaveform_Shape_Sawtooth,
+    PwmWaveform_Shape_Sine,
+} PwmWaveform_Shape;
+
+typedef struct
+{
+    PwmWaveform_Shape shape;
+    uint32_t periodMs; //rounded to a multiple of PWMWAVEFORM_STEPS PWM periods
+    uint16_t phaseDeg; //0 starts at the lowest level
+    uint8_t maxLevel; //top brightness level, up to PWMWAVEFORM_LEVELS - 1
+} PwmWaveform_Params;
+
+/* Generated by tools/gen_pwm_tables.py */
+extern const uint16_t PwmWaveform_gamma[PWMWAVEFORM_LEVELS];
+extern const uint8_t PwmWaveform_sine[PWMWAVEFORM_STEPS];
+
+/* Initializes the params to a 2 second sine at full brightness */
+void PwmWaveform_Params_init(PwmWaveform_Params* params);
+
+/* Opens the uDMA, call once before the first PwmWaveform_start */
+void PwmWaveform_init(void);
+
+/* Opens PWM instance pwmIndex, e.g. Board_PWM0, and plays the waveform on it.
+ * A waveform already playing on the instance is replaced. Returns false if
+ * the instance cannot be opened, has no uDMA channel or all channels are in
+ * use. */
+bool PwmWaveform_start(uint_least8_t pwmIndex, const PwmWaveform_Params* params);
+
+/* Stops the waveform on PWM instance pwmIndex and closes it */
+void PwmWaveform_stop(uint_least8_t pwmIndex);
+
+#endif /* PWMWAVEFORM_H_ */
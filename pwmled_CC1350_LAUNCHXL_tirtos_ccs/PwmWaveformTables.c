@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2015-2016, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Generated by tools/gen_pwm_tables.py --levels 64 --steps 64, do not edit */
+
+/***** Includes *****/
+#include "PwmWaveform.h"
+
+#if (PWMWAVEFORM_LEVELS != 64) || (PWMWAVEFORM_STEPS != 64)
+#error "Regenerate PwmWaveformTables.c for PWMWAVEFORM_LEVELS and PWMWAVEFORM_STEPS"
+#endif
+
+/***** Variable declarations *****/
+/* Duty cycle of each brightness level, as a fraction of 65535 */
+const uint16_t PwmWaveform_gamma[PWMWAVEFORM_LEVELS] = {
+    0, 115, 230, 345, 461, 576, 698, 837,
+    992, 1166, 1359, 1573, 1807, 2064, 2344, 2649,
+    2979, 3334, 3718, 4129, 4570, 5041, 5543, 6078,
+    6646, 7249, 7886, 8560, 9272, 10022, 10811, 11640,
+    12511, 13425, 14381, 15383, 16429, 17522, 18663, 19851,
+    21090, 22378, 23719, 25111, 26558, 28058, 29614, 31227,
+    32897, 34626, 36414, 38263, 40173, 42146, 44182, 46283,
+    48449, 50682, 52983, 55352, 57791, 60300, 62881, 65535,
+};
+
+/* Brightness level of each step of a sine period */
+const uint8_t PwmWaveform_sine[PWMWAVEFORM_STEPS] = {
+    0, 0, 1, 1, 2, 4, 5, 7, 9, 12, 14, 17, 19, 22, 25, 28,
+    31, 35, 38, 41, 44, 46, 49, 51, 54, 56, 58, 59, 61, 62, 62, 63,
+    63, 63, 62, 62, 61, 59, 58, 56, 54, 51, 49, 46, 44, 41, 38, 35,
+    32, 28, 25, 22, 19, 17, 14, 12, 9, 7, 5, 4, 2, 1, 1, 0,
+};
@@ -33,106 +33,52 @@
 /*
  *  ======== pwmled.c ========
  */
-/* For usleep() */
-#include <unistd.h>
 #include <stddef.h>
 
-/* Driver Header files */
-#include <ti/drivers/PWM.h>
-
 /* Example/Board Header files */
 #include "Board.h"
 
+#include "PwmWaveform.h"
+
 /*
  *  ======== mainThread ========
- *  Task periodically increments the PWM duty for the on board LED.
+ *  Starts the LED waveforms. The uDMA plays them from then on, so the thread
+ *  ends and the CPU is not woken up for the LEDs.
  */
 void *mainThread(void *arg0)
 {
-    /* Period and duty in microseconds */
-    uint16_t   pwmPeriod = 3000;
-    uint16_t   duty_1 = 0;
-    uint16_t   duty_2 = 0;
-    uint16_t   duty_3 = 0;
-    uint16_t   dutyInc_1 = 100;
-    uint16_t   dutyInc_2 = 100;
-    uint16_t   dutyInc_3 = 100;
-
-    /* Sleep time in microseconds */
-    uint32_t   time = 50000;
-    PWM_Handle pwm1;
-    PWM_Handle pwm2;
-    PWM_Handle pwm3;
-    PWM_Params params;
+    PwmWaveform_Params params;
 
-    /* Call driver init functions. */
-    PWM_init();
+    PwmWaveform_init();
 
-    PWM_Params_init(&params);
-    params.dutyUnits = PWM_DUTY_US;
-    params.dutyValue = 0;
-    params.periodUnits = PWM_PERIOD_US;
-    params.periodValue = pwmPeriod;
-    pwm1 = PWM_open(Board_PWM0, &params);
-    if (pwm1 == NULL) {
+    /* Breathe on Board_PWM0 */
+    PwmWaveform_Params_init(&params);
+    params.shape = PwmWaveform_Shape_Sine;
+    params.periodMs = 3000;
+    if (!PwmWaveform_start(Board_PWM0, &params)) {
         /* Board_PWM0 did not open */
         while (1);
     }
 
-    PWM_start(pwm1);
-
+    /* The same half a period later on Board_PWM1 */
     if (Board_PWM1 != Board_PWM0) {
-        pwm2 = PWM_open(Board_PWM1, &params);
-
-        if (pwm2 == NULL) {
+        params.phaseDeg = 180;
+        if (!PwmWaveform_start(Board_PWM1, &params)) {
             /* Board_PWM1 did not open */
             while (1);
         }
-
-        PWM_start(pwm2);
     }
 
-    if (Board_PWM1 != Board_PWM0) {
-        pwm3 = PWM_open(Board_PWM2, &params);
-
-        if (pwm3 == NULL) {
+    /* A triangle at twice the rate on Board_PWM2 */
+    if (Board_PWM2 != Board_PWM0) {
+        params.shape = PwmWaveform_Shape_Triangle;
+        params.periodMs = 1500;
+        params.phaseDeg = 0;
+        if (!PwmWaveform_start(Board_PWM2, &params)) {
             /* Board_PWM2 did not open */
             while (1);
         }
-
-        PWM_start(pwm3);
     }
 
-    /* Loop forever incrementing the PWM duty */
-    while (1) {
-        PWM_setDuty(pwm1, duty_1);
-
-        if (pwm2) {
-            PWM_setDuty(pwm2, duty_2);
-        }
-
-        if (pwm3) {
-            PWM_setDuty(pwm3, duty_3);
-        }
-
-        duty_1 = (duty_1 + dutyInc_1);
-
-        if (duty_1 == pwmPeriod || (!duty_1)) {
-            dutyInc_1 = - dutyInc_1;
-        }
-
-        duty_2 = (duty_2 - dutyInc_2);
-
-        if (duty_2 == pwmPeriod || (!duty_2)) {
-            dutyInc_2 = + dutyInc_2;
-        }
-
-        duty_3 = (duty_3 + 2*dutyInc_3);
-
-        if (duty_3 == pwmPeriod || (!duty_3)) {
-            dutyInc_3 = - 2*dutyInc_3;
-        }
-
-        usleep(time);
-    }
+    return (NULL);
 }
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2015-2016, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/***** Includes *****/
+#include "Trace.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include <xdc/std.h>
+#include <xdc/runtime/Timestamp.h>
+#include <xdc/runtime/Types.h>
+
+#include <ti/sysbios/BIOS.h>
+
+/***** Defines *****/
+#define TRACE_INDEX_MASK    (TRACE_BUFFER_SIZE - 1)
+
+/***** Variable declarations *****/
+Trace_Record traceBuffer[TRACE_BUFFER_SIZE]; /* not static so you can see it in the memory browser */
+/* Number of records written since the last dump, the next record goes to
+ * traceBuffer[traceCount & TRACE_INDEX_MASK] */
+static volatile uint32_t traceCount = 0;
+static volatile bool tracePaused = false;
+
+/***** Prototypes *****/
+static uint32_t reserveSlot(void);
+static uint32_t swapCount(uint32_t newCount);
+
+/***** Function definitions *****/
+void Trace_record(Trace_Event event, uint8_t arg8, uint16_t arg16)
+{
+    Trace_Record* record;
+
+    if (tracePaused)
+    {
+        return;
+    }
+
+    /* Only the slot reservation is shared, and it is lock-free, so a writer
+     * never waits for another one and never masks interrupts. A preempting
+     * writer may get a later slot but an earlier timestamp, the converter
+     * sorts on the timestamp. */
+    record = &traceBuffer[reserveSlot() & TRACE_INDEX_MASK];
+
+    record->timestamp = Timestamp_get32();
+    record->event = (uint8_t)event | (uint8_t)(BIOS_getThreadType() << 6);
+    record->arg8 = arg8;
+    record->arg16 = arg16;
+}
+
+void Trace_dump(Trace_PrintFxn printFxn)
+{
+    Types_FreqHz freq;
+    uint32_t written;
+    uint32_t count;
+    uint32_t first;
+    uint32_t i;
+    Trace_Record* record;
+    char line[32];
+
+    tracePaused = true;
+
+    /* Take the records written so far and restart the count in one step, so
+     * a writer that got past the pause check is not lost between the two */
+    written = swapCount(0);
+    count = (written < TRACE_BUFFER_SIZE) ? written : TRACE_BUFFER_SIZE;
+    first = written - count;
+    Timestamp_getFreq(&freq);
+
+    /* Header with the timestamp frequency in Hz and the number of records */
+    sprintf(line, "TRACE %lu %lu", (unsigned long)freq.lo, (unsigned long)count);
+    printFxn(line);
+
+    for (i = 0; i < count; i++)
+    {
+        record = &traceBuffer[(first + i) & TRACE_INDEX_MASK];
+        sprintf(line, "%08lx %02x %02x %04x", (unsigned long)record->timestamp,
+                record->event, record->arg8, record->arg16);
+        printFxn(line);
+    }
+
+    printFxn("TRACE END");
+
+    tracePaused = false;
+}
+
+void Trace_taskSwitchHook(Task_Handle prev, Task_Handle next)
+{
+    Trace_record(Trace_Event_TaskSwitch, (uint8_t)Task_getPri(next), (uint16_t)((uint32_t)next));
+}
+
+/* Returns traceCount and increments it. The store only succeeds if nothing
+ * else accessed the exclusive monitor since the load, else it is retried. */
+static uint32_t reserveSlot(void)
+{
+#if defined(__TI_COMPILER_VERSION__)
+    uint32_t count;
+
+    do
+    {
+        count = __ldrex((void*)&traceCount);
+    } while (__strex(count + 1, (void*)&traceCount) != 0);
+
+    return count;
+#else
+    return __atomic_fetch_add(&traceCount, 1, __ATOMIC_RELAXED);
+#endif
+}
+
+/* Returns traceCount and replaces it with newCount, like reserveSlot */
+static uint32_t swapCount(uint32_t newCount)
+{
+#if defined(__TI_COMPILER_VERSION__)
+    uint32_t count;
+
+    do
+    {
+        count = __ldrex((void*)&traceCount);
+    } while (__strex(newCount, (void*)&traceCount) != 0);
+
+    return count;
+#else
+    return __atomic_exchange_n(&traceCount, newCount, __ATOMIC_RELAXED);
+#endif
+}
@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2015-2016, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/***** Includes *****/
+#include "BleObserver.h"
+
+#include <string.h>
+
+#include <xdc/std.h>
+#include <ti/sysbios/hal/Hwi.h>
+
+#include "seb/SEB.h"
+
+/***** Defines *****/
+#define BLEOBSERVER_ADDR_LEN            6
+#define BLEOBSERVER_FIRST_CHANNEL       37
+#define BLEOBSERVER_LAST_CHANNEL        39
+#define BLEOBSERVER_NODE_ADDRESS_DIGITS 4
+
+/***** Type declarations *****/
+struct Advertiser {
+    uint8_t advAddress[BLEOBSERVER_ADDR_LEN];
+    uint16_t address;
+    uint8_t lastSeqNumber;
+    bool hasAddress;
+    bool hasSeqNumber;
+};
+
+/***** Variable declarations *****/
+static struct Advertiser advertisers[BLEOBSERVER_MAX_ADVERTISERS];
+static uint8_t nextAdvertiser = 0;
+static struct BleObserver_Reading queue[BLEOBSERVER_QUEUE_SIZE];
+static uint8_t queueHead = 0;
+static uint8_t queueCount = 0;
+static uint8_t channel = BLEOBSERVER_FIRST_CHANNEL;
+static BleObserver_ReadingCallback readingCallback;
+
+/***** Prototypes *****/
+static void advertisementCallback(uint8_t* advAddress, uint8_t* advData, uint8_t advLen, int8_t rssi);
+static struct Advertiser* findAdvertiser(uint8_t* advAddress);
+static bool parseNodeAddress(const char* url, uint16_t* address);
+static void queueReading(struct BleObserver_Reading* reading);
+
+/***** Function definitions *****/
+void BleObserver_init(BleObserver_ReadingCallback callback)
+{
+    readingCallback = callback;
+}
+
+SimpleBeacon_Status BleObserver_startScan(uint32_t scanTime, SimpleBeacon_ScanDoneCb doneCb)
+{
+    SimpleBeacon_Status status = SimpleBeacon_startScan(channel, scanTime, advertisementCallback, doneCb);
+
+    if (status == SimpleBeacon_Status_Success)
+    {
+        channel = (channel == BLEOBSERVER_LAST_CHANNEL) ? BLEOBSERVER_FIRST_CHANNEL : channel + 1;
+    }
+
+    return status;
+}
+
+bool BleObserver_getReading(struct BleObserver_Reading* reading)
+{
+    bool found = false;
+    UInt key = Hwi_disable();
+
+    if (queueCount > 0)
+    {
+        *reading = queue[queueHead];
+        queueHead = (queueHead + 1) % BLEOBSERVER_QUEUE_SIZE;
+        queueCount--;
+        found = true;
+    }
+
+    Hwi_restore(key);
+
+    return found;
+}
+
+static void advertisementCallback(uint8_t* advAddress, uint8_t* advData, uint8_t advLen, int8_t rssi)
+{
+    SEB_ParsedFrame frame;
+    struct Advertiser* advertiser;
+    uint16_t address;
+
+    if (SEB_parseFrame(advData, advLen, &frame) != SimpleBeacon_Status_Success)
+    {
+        return;
+    }
+
+    advertiser = findAdvertiser(advAddress);
+
+    if (frame.type == SEB_FrameType_Url)
+    {
+        if (!parseNodeAddress(frame.url, &address))
+        {
+            return;
+        }
+
+        if (advertiser == NULL)
+        {
+            /* Replace the oldest advertiser */
+            advertiser = &advertisers[nextAdvertiser];
+            nextAdvertiser = (nextAdvertiser + 1) % BLEOBSERVER_MAX_ADVERTISERS;
+            memcpy(advertiser->advAddress, advAddress, BLEOBSERVER_ADDR_LEN);
+            advertiser->hasAddress = false;
+        }
+
+        if (!advertiser->hasAddress || (advertiser->address != address))
+        {
+            advertiser->address = address;
+            advertiser->hasAddress = true;
+            advertiser->hasSeqNumber = false;
+        }
+    }
+    else if ((frame.type == SEB_FrameType_Tlm) && (advertiser != NULL) && advertiser->hasAddress)
+    {
+        struct BleObserver_Reading reading;
+        uint8_t seqNumber = frame.advCnt & 0xFF;
+
+        /* The same reading is repeated through the advertising train */
+        if (advertiser->hasSeqNumber && (advertiser->lastSeqNumber == seqNumber))
+        {
+            return;
+        }
+        advertiser->lastSeqNumber = seqNumber;
+        advertiser->hasSeqNumber = true;
+
+        reading.address = advertiser->address;
+        reading.temp = frame.temp;
+        reading.battMv = frame.battMv;
+        reading.uptimeS = frame.secCnt;
+        reading.seqNumber = seqNumber;
+        reading.rssi = rssi;
+        queueReading(&reading);
+    }
+}
+
+static struct Advertiser* findAdvertiser(uint8_t* advAddress)
+{
+    uint8_t i;
+
+    for (i = 0; i < BLEOBSERVER_MAX_ADVERTISERS; i++)
+    {
+        if (advertisers[i].hasAddress &&
+            (memcmp(advertisers[i].advAddress, advAddress, BLEOBSERVER_ADDR_LEN) == 0))
+        {
+            return &advertisers[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* Takes the node address from the hex digits after the node URL prefix */
+static bool parseNodeAddress(const char* url, uint16_t* address)
+{
+    uint8_t prefixLen = strlen(BLEOBSERVER_NODE_URL_PREFIX);
+    uint16_t value = 0;
+    uint8_t i;
+
+    if (strncmp(url, BLEOBSERVER_NODE_URL_PREFIX, prefixLen) != 0)
+    {
+        return false;
+    }
+
+    for (i = 0; i < BLEOBSERVER_NODE_ADDRESS_DIGITS; i++)
+    {
+        char c = url[prefixLen + i];
+
+        if ((c >= '0') && (c <= '9'))
+        {
+            value = (value << 4) | (c - '0');
+        }
+        else if ((c >= 'a') && (c <= 'f'))
+        {
+            value = (value << 4) | (c - 'a' + 10);
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    *address = value;
+    return true;
+}
+
+static void queueReading(struct BleObserver_Reading* reading)
+{
+    UInt key = Hwi_disable();
+
+    /* Drop the oldest reading if the task has not kept up */
+    if (queueCount == BLEOBSERVER_QUEUE_SIZE)
+    {
+        queueHead = (queueHead + 1) % BLEOBSERVER_QUEUE_SIZE;
+        queueCount--;
+    }
+    queue[(queueHead + queueCount) % BLEOBSERVER_QUEUE_SIZE] = *reading;
+    queueCount++;
+
+    Hwi_restore(key);
+
+    if (readingCallback)
+    {
+        readingCallback();
+    }
+}
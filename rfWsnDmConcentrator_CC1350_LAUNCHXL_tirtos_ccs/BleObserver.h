@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2015-2016, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef BLEOBSERVER_H_
+#define BLEOBSERVER_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+#include "seb/SimpleBeacon.h"
+
+/* Observer for the Eddystone beacons of nodes in BLE mode. A node advertises
+ * a URL frame with its address and a TLM frame with its reading, from the
+ * same BLE address, so the address from the URL is kept per advertiser and
+ * the TLM frames that follow are turned into readings. The readings are told
+ * apart by the TLM advertisement count, which the nodes set to the sequence
+ * number of the reading, so the repeats of one reading in an advertising
+ * train are only reported once. */
+
+/* URL of a node beacon, followed by its address in hex */
+#define BLEOBSERVER_NODE_URL_PREFIX     "https://m4bd.se/s/"
+
+/* Number of advertisers remembered, the oldest is replaced when full */
+#ifndef BLEOBSERVER_MAX_ADVERTISERS
+#define BLEOBSERVER_MAX_ADVERTISERS     8
+#endif
+
+/* Readings queued until the radio task takes them */
+#define BLEOBSERVER_QUEUE_SIZE          4
+
+struct BleObserver_Reading {
+    uint16_t address;
+    uint16_t temp;      /* fixed 8.8 */
+    uint16_t battMv;
+    uint32_t uptimeS;   /* time since the node booted */
+    uint8_t seqNumber;
+    int8_t rssi;
+};
+
+/* Called from the RF callback when a reading is queued, so it must not
+ * block */
+typedef void (*BleObserver_ReadingCallback)(void);
+
+/* Register the callback for queued readings */
+void BleObserver_init(BleObserver_ReadingCallback callback);
+
+/* Starts a scan window of scanTime radio timer ticks, on the next of the
+ * three advertising channels in turn. doneCb is called when it is over. */
+SimpleBeacon_Status BleObserver_startScan(uint32_t scanTime, SimpleBeacon_ScanDoneCb doneCb);
+
+/* Takes the oldest queued reading, returns false if there is none */
+bool BleObserver_getReading(struct BleObserver_Reading* reading);
+
+#endif /* BLEOBSERVER_H_ */
@@ -41,17 +41,27 @@
 #include <ti/sysbios/knl/Task.h>
 #include <ti/sysbios/knl/Semaphore.h>
 #include <ti/sysbios/knl/Event.h>
+#include <ti/sysbios/knl/Clock.h>
 
 /* Drivers */
 #include <ti/drivers/rf/RF.h>
 #include <ti/drivers/PIN.h>
 #include <stdio.h>
+#include <string.h>
 
 /* Board Header files */
 #include "Board.h"
 
 #include "easylink/EasyLink.h"
 #include "RadioProtocol.h"
+#include "trace/Trace.h"
+#include "pool/PacketPool.h"
+#include "NodeRegistry.h"
+#include "NodeLiveness.h"
+#include "NodeJoin.h"
+#include "MultiNodeBeacon.h"
+#include "BleObserver.h"
+#include "crypto/PacketCrypto.h"
 
 
 /***** Defines *****/
@@ -61,32 +71,76 @@
 #define RADIO_EVENT_ALL                  0xFFFFFFFF
 #define RADIO_EVENT_VALID_PACKET_RECEIVED      (uint32_t)(1 << 0)
 #define RADIO_EVENT_INVALID_PACKET_RECEIVED (uint32_t)(1 << 1)
+#define RADIO_EVENT_SEND_TIME_SYNC        (uint32_t)(1 << 2)
+#define RADIO_EVENT_ACK_DONE              (uint32_t)(1 << 3)
+#define RADIO_EVENT_BLE_SCAN              (uint32_t)(1 << 4)
+#define RADIO_EVENT_BLE_READING           (uint32_t)(1 << 5)
 
 #define CONCENTRATORRADIO_MAX_RETRIES 2
 #define NORERADIO_ACK_TIMEOUT_TIME_MS (160)
-#define CONCENTRATOR_MAX_NODES 7
 
 #define CONCENTRATOR_SUB1_ACTIVITY_LED Board_PIN_LED0
 #define CONCENTRATOR_BLE_ACTIVITY_LED Board_PIN_LED1
 
 #define CONCENTRATOR_0M_TXPOWER    -10
 
+#define CONCENTRATOR_RAT_TICKS_PER_MS       4000
+/* The task wakes up this long before a time sync packet is due, and skips it
+ * if it is not handled at least CONCENTRATOR_TIME_SYNC_MIN_LEAD_MS before */
+#define CONCENTRATOR_TIME_SYNC_WAKEUP_MS    50
+#define CONCENTRATOR_TIME_SYNC_MIN_LEAD_MS  2
+
+/* Trace marker ids */
+#define CONCENTRATOR_TRACE_BLE_ADV          1
+#define CONCENTRATOR_TRACE_TIME_SYNC        2
+
+/* Max RX time on the default PHY before the task wakes up */
+#define CONCENTRATOR_RX_TIMEOUT_MS          1000
+
+/* Listen for the beacons of nodes in BLE mode for a window of
+ * CONCENTRATOR_BLE_SCAN_WINDOW_MS every CONCENTRATOR_BLE_SCAN_PERIOD_MS, in
+ * between the sub-1 GHz receives. 0 to not scan. Off by default, as the
+ * receiver is fully on during a scan, more than it is when sniffing. A period
+ * in the order of the node heartbeat, e.g. 60000, keeps the cost small. */
+#ifndef CONCENTRATOR_BLE_SCAN_PERIOD_MS
+#define CONCENTRATOR_BLE_SCAN_PERIOD_MS     0
+#endif
+
+/* Node beacons are not authenticated, so with security on their readings
+ * could be forged by anyone */
+#if RADIO_SECURITY_ENABLED && (CONCENTRATOR_BLE_SCAN_PERIOD_MS != 0)
+#error "CONCENTRATOR_BLE_SCAN_PERIOD_MS must be 0 with RADIO_SECURITY_ENABLED"
+#endif
+#define CONCENTRATOR_BLE_SCAN_WINDOW_MS     100
+
 /***** Variable declarations *****/
 static Task_Params concentratorRadioTaskParams;
 Task_Struct concentratorRadioTask; /* not static so you can see in ROV */
 static uint8_t concentratorRadioTaskStack[CONCENTRATORRADIO_TASK_STACK_SIZE];
 Event_Struct radioOperationEvent;  /* not static so you can see in ROV */
 static Event_Handle radioOperationEventHandle;
+Clock_Struct timeSyncClock;        /* not static so you can see in ROV */
+static Clock_Handle timeSyncClockHandle;
+Clock_Struct bleScanClock;         /* not static so you can see in ROV */
 
 static ConcentratorRadio_PacketReceivedCallback packetReceivedCallback;
 static union ConcentratorPacket latestRxPacket;
-static EasyLink_TxPacket txPacket;
+static EasyLink_RxLentPacket* lentRxPacket; /* lent by EasyLink until decoded */
+static uint32_t lentRxDoneTime; /* radio time at the end of lentRxPacket */
+static EasyLink_TxPacket* txPacket; /* from the PacketPool while sending */
+static EasyLink_Cmd ackCmd;
+static EasyLink_Cmd rxCmd;
+static bool ackPending = false; /* ackCmd submitted, RX is restarted when done */
+static bool timeSyncPending = false; /* time sync due while ackPending */
 static struct AckPacket ackPacket;
-static uint8_t concentratorAddress;
+static uint16_t concentratorAddress;
 static int8_t latestRssi;
-static struct SensorNodeRX latestActiveSensorNodeRX;
-struct SensorNodeRX knownSensorNodeRXs[CONCENTRATOR_MAX_NODES];
-static struct SensorNodeRX* lastAddedSensorNodeRX = knownSensorNodeRXs;
+static int8_t latestTxPower;
+static uint32_t nextTimeSyncMs;
+static volatile bool rxStopped = false;
+static uint8_t addrFilterTable[EASYLINK_MAX_ADDR_SIZE * EASYLINK_MAX_ADDR_FILTERS];
+static EasyLink_PhyType currentPhy = RADIO_EASYLINK_MODULATION;
+struct SensorNodeRX knownSensorNodeRXs[NODEREGISTRY_MAX_NODES]; /* indexed by NodeRegistry slot */
 
 static ConcentratorAdvertiser bleAdvertiser = {
         CONCENTRATOR_ADVERTISE_INVALID,
@@ -94,24 +148,62 @@ static ConcentratorAdvertiser bleAdvertiser = {
 };
 
 struct SensorNodeRX {
-    uint8_t address;
+    uint16_t address;
     uint32_t timeForLastRX;
+    uint16_t temp; /* fixed 8.8, of the latest DM sensor packet */
+    bool hasTemp;
+    uint8_t lastSeqNumber; /* of the latest DM sensor packet */
+    bool hasSeqNumber;
+    uint32_t lastFrameCounter; /* of the latest sealed packet */
+    bool hasFrameCounter;
 };
 
 static uint8_t bleMacAddr[6];
+static uint16_t nextBeaconSlot = 0; /* multi node beacon round robin */
+#if RADIO_SECURITY_ENABLED
+static uint32_t latestFrameCounter; /* of the packet being handled */
+#endif
 
 /***** Prototypes *****/
 static void concentratorRadioTaskFunction(UArg arg0, UArg arg1);
-static void rxDoneCallback(EasyLink_RxPacket * rxPacket, EasyLink_Status status);
+static void rxDoneCallback(EasyLink_Cmd * cmd, EasyLink_Status status, EasyLink_RxLentPacket * rxPacket);
+static void ackDoneCallback(EasyLink_Cmd * cmd, EasyLink_Status status, EasyLink_RxLentPacket * rxPacket);
+static bool isValidPacket(EasyLink_RxLentPacket * rxPacket);
+static bool isValidPayload(uint8_t* payload, uint8_t len);
+#if RADIO_SECURITY_ENABLED
+static bool openPacket(EasyLink_RxLentPacket * rxPacket);
+static void updateFrameCounter(uint16_t address);
+#endif
+static void decodePacket(EasyLink_RxLentPacket * rxPacket);
 static void notifyPacketReceived(union ConcentratorPacket* latestRxPacket);
-static void sendAck(uint8_t latestSourceAddress);
+static void sendAck(uint16_t latestSourceAddress);
+static void sendJoinResponse(uint16_t latestSourceAddress, uint16_t address);
+static void buildAck(uint16_t latestSourceAddress);
+static void submitAck(void);
+static void handleJoinRequest(void);
+static void allocTxPacket(void);
+static void transmitAndFreeTxPacket(void);
 static void sendBleAdvertisement(struct DualModeInternalTempSensorPacket sensorPacket);
+static void sendBleTrain(void);
+static uint8_t nextBeaconRecords(struct MultiNodeBeacon_Record* records);
+static void bleAdvDoneCallback(SimpleBeacon_Status status, uint32_t radioTime);
 static void sendEmptyBleAdvertisement(void);
-static void addNewNodeRX(struct SensorNodeRX* node);
-static void updateNodeRX(struct SensorNodeRX* node);
-static uint8_t isKnownNodeAddress(uint8_t address);
-static uint32_t timeForLastRXForAdress(uint8_t address);
-static uint8_t numberOfNodes(void);
+static void updateNodeRX(union ConcentratorPacket* packet);
+static uint32_t timeForLastRXForAdress(uint16_t address);
+static uint32_t getNetworkTimeMs(void);
+static uint32_t ratTimeToNetworkTime(uint32_t ratTime);
+static void scheduleTimeSync(void);
+static void sendTimeSync(void);
+static void timeSyncClockCallback(UArg arg0);
+static void bleScanClockCallback(UArg arg0);
+static void bleReadingCallback(void);
+static void bleScanDoneCallback(SimpleBeacon_Status status);
+static void startBleScan(void);
+static void handleBleReadings(void);
+static bool bleBusy(void);
+static void startRx(void);
+static void setPhy(EasyLink_PhyType phy);
+static EasyLink_PhyType selectPhy(int8_t rssi, int8_t txPower);
 
 /* Pin driver handle */
 static PIN_Handle ledPinHandle;
@@ -144,6 +236,19 @@ void ConcentratorRadioTask_init(void) {
     Event_construct(&radioOperationEvent, &eventParam);
     radioOperationEventHandle = Event_handle(&radioOperationEvent);
 
+    /* Create the one shot clock used to wake up before each time sync */
+    Clock_Params clockParams;
+    Clock_Params_init(&clockParams);
+    Clock_construct(&timeSyncClock, timeSyncClockCallback, 1, &clockParams);
+    timeSyncClockHandle = Clock_handle(&timeSyncClock);
+
+#if CONCENTRATOR_BLE_SCAN_PERIOD_MS != 0
+    /* Create the periodic clock of the BLE scan windows */
+    clockParams.period = (CONCENTRATOR_BLE_SCAN_PERIOD_MS * 1000) / Clock_tickPeriod;
+    clockParams.startFlag = TRUE;
+    Clock_construct(&bleScanClock, bleScanClockCallback, clockParams.period, &clockParams);
+#endif
+
     /* Create the concentrator radio protocol task */
     Task_Params_init(&concentratorRadioTaskParams);
     concentratorRadioTaskParams.stackSize = CONCENTRATORRADIO_TASK_STACK_SIZE;
@@ -179,7 +284,15 @@ static void concentratorRadioTaskFunction(UArg arg0, UArg arg1)
 
     /* Set concentrator address */
     concentratorAddress = RADIO_CONCENTRATOR_ADDRESS;
-    EasyLink_enableRxAddrFilter(&concentratorAddress, 1, 1);
+    addrFilterTable[0] = (concentratorAddress & 0xFF00) >> 8;
+    addrFilterTable[1] = (concentratorAddress & 0xFF);
+    EasyLink_setCtrl(EasyLink_Ctrl_AddSize, RADIO_ADDRESS_SIZE);
+    EasyLink_enableRxAddrFilter(addrFilterTable, RADIO_ADDRESS_SIZE, 1);
+
+    /* Sniff for a preamble once per interval instead of listening all the
+     * time, the nodes send a preamble longer than the interval. Only on the
+     * default PHY, see setPhy. */
+    EasyLink_setCtrl(EasyLink_Ctrl_Sniff_Interval, EasyLink_ms_To_RadioTime(RADIO_SNIFF_INTERVAL_MS));
 
     /* Set up ack packet */
     ackPacket.header.sourceAddress = concentratorAddress;
@@ -200,146 +313,212 @@ static void concentratorRadioTaskFunction(UArg arg0, UArg arg1)
 
     SimpleBeacon_getIeeeAddr(bleMacAddr);
 
+    /* Take the readings of nodes in BLE mode from their beacons */
+    BleObserver_init(bleReadingCallback);
+
+#if RADIO_SECURITY_ENABLED
+    /* Open the packets of the nodes and authenticate our own beacons */
+    PacketCrypto_init();
+#endif
+    MultiNodeBeacon_init();
+
 #ifdef __CC1350_LAUNCHXL_BOARD_H__
     /* Enable power to RF switch to 2.4G antenna */
     PIN_setOutputValue(ledPinHandle, Board_DIO30_SWPWR, 1);
 #endif //__CC1350_LAUNCHXL_BOARD_H__
 
-    /* Enter receive */
-    if (EasyLink_receiveAsync(rxDoneCallback, 0) != EasyLink_Status_Success) {
-        System_abort("EasyLink_receiveAsync failed");
-    }
+    /* Start broadcasting the network time */
+    scheduleTimeSync();
 
-    EasyLink_setCtrl(EasyLink_Ctrl_AsyncRx_TimeOut, EasyLink_ms_To_RadioTime(1000));
+    /* Enter receive */
+    startRx();
 
     while (1)
     {
-        uint32_t events = Event_pend(radioOperationEventHandle, 0, RADIO_EVENT_ALL, BIOS_WAIT_FOREVER);
+        uint32_t events = Trace_eventPend(radioOperationEventHandle, 0, RADIO_EVENT_ALL, BIOS_WAIT_FOREVER);
 
-        /* If valid packet received */
-        if (events & RADIO_EVENT_VALID_PACKET_RECEIVED)
+        /* If the ack is sent, or dropped as too late for the node */
+        if (events & RADIO_EVENT_ACK_DONE)
         {
+            PacketPool_free(txPacket);
+            txPacket = NULL;
+            ackPending = false;
 
-            /* toggle Sub1G Activity LED */
-            PIN_setOutputValue(ledPinHandle, CONCENTRATOR_SUB1_ACTIVITY_LED,
-                               !PIN_getOutputValue(CONCENTRATOR_SUB1_ACTIVITY_LED));
-
-            /* Send ack packet */
-            sendAck(latestRxPacket.header.sourceAddress);
+            /* Go back to RX */
+            startRx();
 
-            /* Call packet received callback */
-            notifyPacketReceived(&latestRxPacket);
+            /* Send a time sync which came due meanwhile */
+            if (timeSyncPending)
+            {
+                timeSyncPending = false;
+                events |= RADIO_EVENT_SEND_TIME_SYNC;
+            }
+        }
 
-            /* If we knew this node from before, update the value */
-            if (isKnownNodeAddress(latestActiveSensorNodeRX.address))
+        /* A received packet comes first, its ACK is due a fixed time after it */
+        if (events & (RADIO_EVENT_VALID_PACKET_RECEIVED | RADIO_EVENT_INVALID_PACKET_RECEIVED))
+        {
+#if RADIO_SECURITY_ENABLED
+            /* A packet which does not authenticate, or replays a recent one, is
+             * dropped without an ACK like a corrupted one */
+            if ((events & RADIO_EVENT_VALID_PACKET_RECEIVED) && !openPacket(lentRxPacket))
             {
-                updateNodeRX(&latestActiveSensorNodeRX);
+                EasyLink_releaseRx(lentRxPacket);
+                lentRxPacket = NULL;
+                events = (events & ~RADIO_EVENT_VALID_PACKET_RECEIVED) | RADIO_EVENT_INVALID_PACKET_RECEIVED;
             }
-            else
+#endif
+
+            /* If valid packet received */
+            if (events & RADIO_EVENT_VALID_PACKET_RECEIVED)
             {
-                /* Else add it */
-                addNewNodeRX(&latestActiveSensorNodeRX);
+
+                /* toggle Sub1G Activity LED */
+                PIN_setOutputValue(ledPinHandle, CONCENTRATOR_SUB1_ACTIVITY_LED,
+                                   !PIN_getOutputValue(CONCENTRATOR_SUB1_ACTIVITY_LED));
+
+                /* Decode the packet from the radio's buffer and give the buffer
+                 * back for the next RX */
+                decodePacket(lentRxPacket);
+                EasyLink_releaseRx(lentRxPacket);
+                lentRxPacket = NULL;
+
+                if (latestRxPacket.header.packetType == RADIO_PACKET_TYPE_JOIN_REQUEST_PACKET)
+                {
+                    /* Answered with the node's address in place of the ack */
+                    handleJoinRequest();
+                }
+                else
+                {
+                    /* Queue the ack packet, the radio sends it after the turnaround
+                     * while the task carries on */
+                    sendAck(latestRxPacket.header.sourceAddress);
+
+                    /* Register the node, before the callback so the concentrator task
+                     * finds it in the registry */
+                    updateNodeRX(&latestRxPacket);
+
+                    /* Call packet received callback */
+                    notifyPacketReceived(&latestRxPacket);
+#if RADIO_SECURITY_ENABLED
+                    updateFrameCounter(latestRxPacket.header.sourceAddress);
+#endif
+                }
+
+                /* toggle Sub1G Activity LED */
+                PIN_setOutputValue(ledPinHandle, CONCENTRATOR_SUB1_ACTIVITY_LED,
+                                   !PIN_getOutputValue(CONCENTRATOR_SUB1_ACTIVITY_LED));
+
             }
 
-            /* Go back to RX */
-            if (EasyLink_receiveAsync(rxDoneCallback, 0) != EasyLink_Status_Success)
+            if ( (bleAdvertiser.type != Concentrator_AdvertiserNone) &&
+                 (latestRxPacket.header.packetType == RADIO_PACKET_TYPE_DM_SENSOR_PACKET) )
             {
-                System_abort("EasyLink_receiveAsync failed");
+                //send ble advertisement
+                Trace_begin(CONCENTRATOR_TRACE_BLE_ADV, 0);
+                sendBleAdvertisement(latestRxPacket.dmSensorPacket);
+                Trace_end(CONCENTRATOR_TRACE_BLE_ADV, 0);
             }
 
-            /* toggle Sub1G Activity LED */
-            PIN_setOutputValue(ledPinHandle, CONCENTRATOR_SUB1_ACTIVITY_LED,
-                               !PIN_getOutputValue(CONCENTRATOR_SUB1_ACTIVITY_LED));
+            if (bleAdvertiser.type == Concentrator_AdvertiserNone) {
+                Trace_begin(CONCENTRATOR_TRACE_BLE_ADV, 1);
+                sendEmptyBleAdvertisement();
+                Trace_end(CONCENTRATOR_TRACE_BLE_ADV, 1);
+            }
 
+            /* If invalid packet received */
+            if (events & RADIO_EVENT_INVALID_PACKET_RECEIVED)
+            {
+                /* Go back to RX */
+                startRx();
+            }
         }
 
-        if ( (bleAdvertiser.type != Concentrator_AdvertiserNone) &&
-             (latestRxPacket.header.packetType == RADIO_PACKET_TYPE_DM_SENSOR_PACKET) )
+        /* If a time sync packet is due, it waits for a pending ack as both
+         * use txPacket */
+        if ((events & RADIO_EVENT_SEND_TIME_SYNC) && ackPending)
+        {
+            timeSyncPending = true;
+        }
+        else if (events & RADIO_EVENT_SEND_TIME_SYNC)
         {
-            //send ble advertisement
-            sendBleAdvertisement(latestRxPacket.dmSensorPacket);
+            Trace_begin(CONCENTRATOR_TRACE_TIME_SYNC, 0);
+            sendTimeSync();
+            Trace_end(CONCENTRATOR_TRACE_TIME_SYNC, 0);
         }
 
-        if (bleAdvertiser.type == Concentrator_AdvertiserNone) {
-            sendEmptyBleAdvertisement();
+        /* Listen for node beacons, unless we are advertising ourselves */
+        if (events & RADIO_EVENT_BLE_SCAN)
+        {
+            startBleScan();
         }
 
-        /* If invalid packet received */
-        if (events & RADIO_EVENT_INVALID_PACKET_RECEIVED)
+        /* Readings from node beacons go the same way as the ones received on
+         * sub-1 GHz */
+        if (events & RADIO_EVENT_BLE_READING)
         {
-            /* Go back to RX */
-            if (EasyLink_receiveAsync(rxDoneCallback, 0) != EasyLink_Status_Success)
-            {
-                System_abort("EasyLink_receiveAsync failed");
-            }
+            handleBleReadings();
         }
 
     }
 }
 
-static uint8_t isKnownNodeAddress(uint8_t address) {
-    uint8_t found = 0;
-    uint8_t i;
-    for (i = 0; i < CONCENTRATOR_MAX_NODES; i++)
+static uint32_t timeForLastRXForAdress(uint16_t address) {
+    uint16_t slot = NodeRegistry_find(address);
+    if ((slot != NODEREGISTRY_NO_SLOT) && (knownSensorNodeRXs[slot].address == address))
     {
-        if (knownSensorNodeRXs[i].address == address)
-        {
-            found = 1;
-            break;
-        }
+        return knownSensorNodeRXs[slot].timeForLastRX;
     }
-    return found;
+    return 0;
 }
 
-static uint8_t numberOfNodes(void) {
-    uint8_t i;
-    for (i = 0; i < CONCENTRATOR_MAX_NODES; i++)
+static void updateNodeRX(union ConcentratorPacket* packet) {
+    uint16_t address = packet->header.sourceAddress;
+    uint16_t slot = NodeRegistry_add(address);
+    uint16_t intervalS = 0;
+
+    if (knownSensorNodeRXs[slot].address != address)
     {
-        if (knownSensorNodeRXs[i].address == 0)
-        {
-            break;
-        }
+        /* The slot was taken over from another node */
+        knownSensorNodeRXs[slot].address = address;
+        knownSensorNodeRXs[slot].hasTemp = false;
+        knownSensorNodeRXs[slot].hasSeqNumber = false;
+        knownSensorNodeRXs[slot].hasFrameCounter = false;
     }
-    return i;
-}
+    knownSensorNodeRXs[slot].timeForLastRX = (Clock_getTicks() * Clock_tickPeriod) / 1000000;
 
-static uint32_t timeForLastRXForAdress(uint8_t address) {
-    uint8_t i;
-    for (i = 0; i < CONCENTRATOR_MAX_NODES; i++)
+    if (packet->header.packetType == RADIO_PACKET_TYPE_DM_SENSOR_PACKET)
     {
-        if (knownSensorNodeRXs[i].address == address)
-        {
-            return knownSensorNodeRXs[i].timeForLastRX;
-        }
+        knownSensorNodeRXs[slot].temp = packet->dmSensorPacket.temp;
+        knownSensorNodeRXs[slot].hasTemp = true;
+        knownSensorNodeRXs[slot].lastSeqNumber = packet->dmSensorPacket.seqNumber;
+        knownSensorNodeRXs[slot].hasSeqNumber = true;
+        intervalS = packet->dmSensorPacket.heartbeatS;
     }
-    return 0;
+    NodeLiveness_heard(slot, address, intervalS);
 }
 
-static void updateNodeRX(struct SensorNodeRX* node) {
-    uint8_t i;
-    for (i = 0; i < CONCENTRATOR_MAX_NODES; i++) {
-        if (knownSensorNodeRXs[i].address == node->address)
-        {
-            knownSensorNodeRXs[i].timeForLastRX = (Clock_getTicks() * Clock_tickPeriod) / 1000000;
-            break;
-        }
-    }
-}
 
-static void addNewNodeRX(struct SensorNodeRX* node) {
-    *lastAddedSensorNodeRX = *node;
+#if RADIO_SECURITY_ENABLED
+/* Remembers the frame counter of the packet just opened for the replay check */
+static void updateFrameCounter(uint16_t address) {
+    uint16_t slot = NodeRegistry_find(address);
 
-    /* Increment and wrap */
-    lastAddedSensorNodeRX++;
-    if (lastAddedSensorNodeRX > &knownSensorNodeRXs[CONCENTRATOR_MAX_NODES-1])
+    if (slot != NODEREGISTRY_NO_SLOT)
     {
-        lastAddedSensorNodeRX = knownSensorNodeRXs;
+        knownSensorNodeRXs[slot].lastFrameCounter = latestFrameCounter;
+        knownSensorNodeRXs[slot].hasFrameCounter = true;
     }
 }
-
+#endif
 
 static void sendBleAdvertisement(struct DualModeInternalTempSensorPacket sensorPacket)
 {
+    /* Skip this advertisement if the last one or a scan is still in progress */
+    if (bleBusy())
+    {
+        return;
+    }
 
 #ifdef __CC1350_LAUNCHXL_BOARD_H__
     //Swtich RF switch to 2.4G antenna
@@ -350,9 +529,8 @@ static void sendBleAdvertisement(struct DualModeInternalTempSensorPacket sensorP
     PIN_setOutputValue(ledPinHandle, CONCENTRATOR_BLE_ACTIVITY_LED,!PIN_getOutputValue(CONCENTRATOR_BLE_ACTIVITY_LED));
 
     // Prepare TLM frame
-    uint8_t txCnt, chan;
-    char url_format[] = "https://m4bd.se/s/%02x/";
-    char url_ready[21];
+    char url_format[] = "https://m4bd.se/s/%04x/";
+    char url_ready[24];
     sprintf(url_ready, url_format, sensorPacket.header.sourceAddress);
     SEB_initUrl(url_ready , CONCENTRATOR_0M_TXPOWER);
     uint32_t timeSinceLastRx = 0;
@@ -369,21 +547,90 @@ static void sendBleAdvertisement(struct DualModeInternalTempSensorPacket sensorP
 
     SEB_initTLM(sensorPacket.batt, sensorPacket.temp, timeSinceLastRx);
 
-    for (txCnt = 0; txCnt < SimpleBeacon_AdvertisementTimes; txCnt++)
+    sendBleTrain();
+}
+
+static void sendEmptyBleAdvertisement(void)
+{
+    /* Skip this advertisement if the last one or a scan is still in progress */
+    if (bleBusy())
     {
-        for (chan = 37; chan < 40; chan++)
-        {
-            SEB_sendFrame(SEB_FrameType_Url, bleMacAddr, 1, (uint64_t) 1<<chan);
-            SEB_sendFrame(SEB_FrameType_Tlm, bleMacAddr, 1, (uint64_t) 1<<chan);
-        }
+        return;
+    }
+
+#ifdef __CC1350_LAUNCHXL_BOARD_H__
+    //Swtich RF switch to 2.4G antenna
+    PIN_setOutputValue(ledPinHandle, Board_DIO1_RFSW, 0);
+#endif //__CC1350_LAUNCHXL_BOARD_H__
+
+    /* Toggle activity LED */
+    PIN_setOutputValue(ledPinHandle, CONCENTRATOR_BLE_ACTIVITY_LED,!PIN_getOutputValue(CONCENTRATOR_BLE_ACTIVITY_LED));
+
+    // Prepare TLM frame
+    char url_format[] = "https://m4bd.se/c/%04x/";
+    char url_ready[24];
+    sprintf(url_ready, url_format, concentratorAddress);
+    SEB_initUrl(url_ready , CONCENTRATOR_0M_TXPOWER);
+
+    SEB_initTLM(0, INT2FIXED((uint32_t)NodeLiveness_countAlive()), 0);
+
+    sendBleTrain();
+}
+
+/* Advertises the URL and TLM frames, and the readings of the next nodes in
+ * the registry if there are any. The radio times the whole train and the
+ * callback restores the antenna when it is done. */
+static void sendBleTrain(void)
+{
+    SimpleBeacon_Frame frames[3];
+    struct MultiNodeBeacon_Record records[MULTINODEBEACON_MAX_RECORDS];
+    uint8_t numRecords;
+    SimpleBeacon_Status status;
 
-        // Sleep on all but last advertisement
-        if(txCnt+1 < SimpleBeacon_AdvertisementTimes)
+    SEB_getFrame(SEB_FrameType_Url, bleMacAddr, &frames[0]);
+    SEB_getFrame(SEB_FrameType_Tlm, bleMacAddr, &frames[1]);
+
+    numRecords = nextBeaconRecords(records);
+    if (numRecords > 0)
+    {
+        MultiNodeBeacon_build(&frames[2], bleMacAddr, records, numRecords);
+    }
+
+    status = SimpleBeacon_sendTrain(frames, (numRecords > 0) ? 3 : 2,
+                                    SimpleBeacon_AdvertisementTimes, (uint64_t)7 << 37, bleAdvDoneCallback);
+    if (status != SimpleBeacon_Status_Success)
+    {
+        bleAdvDoneCallback(status, 0);
+    }
+}
+
+/* Takes the readings of the next nodes round robin through the registry
+ * slots, so that every node is advertised in turn, and returns their number */
+static uint8_t nextBeaconRecords(struct MultiNodeBeacon_Record* records)
+{
+    uint32_t now = (Clock_getTicks() * Clock_tickPeriod) / 1000000;
+    uint8_t numRecords = 0;
+    uint16_t slot = nextBeaconSlot;
+    uint16_t i;
+
+    for (i = 0; (i < NODEREGISTRY_MAX_NODES) && (numRecords < MULTINODEBEACON_MAX_RECORDS); i++)
+    {
+        if (knownSensorNodeRXs[slot].hasTemp)
         {
-            Task_sleep(SimpleBeacon_AdvertisementIntervals[txCnt]);
+            records[numRecords].address = knownSensorNodeRXs[slot].address;
+            records[numRecords].temp = knownSensorNodeRXs[slot].temp;
+            records[numRecords].ageS = now - knownSensorNodeRXs[slot].timeForLastRX;
+            numRecords++;
         }
+        slot = (slot + 1) % NODEREGISTRY_MAX_NODES;
     }
+    nextBeaconSlot = slot;
+
+    return numRecords;
+}
 
+static void bleAdvDoneCallback(SimpleBeacon_Status status, uint32_t radioTime)
+{
 #ifdef __CC1350_LAUNCHXL_BOARD_H__
     //Switch RF switch to Sub1G antenna
     PIN_setOutputValue(ledPinHandle, Board_DIO1_RFSW, 1);
@@ -393,65 +640,394 @@ static void sendBleAdvertisement(struct DualModeInternalTempSensorPacket sensorP
     PIN_setOutputValue(ledPinHandle, CONCENTRATOR_BLE_ACTIVITY_LED,!PIN_getOutputValue(CONCENTRATOR_BLE_ACTIVITY_LED));
 }
 
-static void sendEmptyBleAdvertisement(void)
+static bool bleBusy(void)
+{
+    return SimpleBeacon_trainBusy() || SimpleBeacon_scanBusy();
+}
+
+static void startBleScan(void)
 {
+    if (bleBusy())
+    {
+        return;
+    }
 
 #ifdef __CC1350_LAUNCHXL_BOARD_H__
-    //Swtich RF switch to 2.4G antenna
+    //Switch RF switch to 2.4G antenna
     PIN_setOutputValue(ledPinHandle, Board_DIO1_RFSW, 0);
 #endif //__CC1350_LAUNCHXL_BOARD_H__
 
-    /* Toggle activity LED */
-    PIN_setOutputValue(ledPinHandle, CONCENTRATOR_BLE_ACTIVITY_LED,!PIN_getOutputValue(CONCENTRATOR_BLE_ACTIVITY_LED));
+    if (BleObserver_startScan(CONCENTRATOR_BLE_SCAN_WINDOW_MS * CONCENTRATOR_RAT_TICKS_PER_MS,
+                              bleScanDoneCallback) != SimpleBeacon_Status_Success)
+    {
+        bleScanDoneCallback(SimpleBeacon_Status_Config_Error);
+    }
+}
 
-    // Prepare TLM frame
-    uint8_t txCnt, chan;
-    char url_format[] = "https://m4bd.se/c/%02x/";
-    char url_ready[21];
-    sprintf(url_ready, url_format, concentratorAddress);
-    SEB_initUrl(url_ready , CONCENTRATOR_0M_TXPOWER);
+static void bleScanDoneCallback(SimpleBeacon_Status status)
+{
+#ifdef __CC1350_LAUNCHXL_BOARD_H__
+    //Switch RF switch to Sub1G antenna
+    PIN_setOutputValue(ledPinHandle, Board_DIO1_RFSW, 1);
+#endif //__CC1350_LAUNCHXL_BOARD_H__
+}
 
-    SEB_initTLM(0, INT2FIXED((uint32_t)numberOfNodes()), 0);
+/* Hands the readings from node beacons to the concentrator task as DM sensor
+ * packets. A reading the node also sent on sub-1 GHz has the same sequence
+ * number as the last packet of the node and is dropped. */
+static void handleBleReadings(void)
+{
+    struct BleObserver_Reading reading;
+    union ConcentratorPacket packet;
+    uint16_t slot;
 
-    for (txCnt = 0; txCnt < SimpleBeacon_AdvertisementTimes; txCnt++)
+    while (BleObserver_getReading(&reading))
     {
-        for (chan = 37; chan < 40; chan++)
+        slot = NodeRegistry_find(reading.address);
+        if ((slot != NODEREGISTRY_NO_SLOT) &&
+            (knownSensorNodeRXs[slot].address == reading.address) &&
+            knownSensorNodeRXs[slot].hasSeqNumber &&
+            (knownSensorNodeRXs[slot].lastSeqNumber == reading.seqNumber))
         {
-            SEB_sendFrame(SEB_FrameType_Url, bleMacAddr, 1, (uint64_t) 1<<chan);
-            SEB_sendFrame(SEB_FrameType_Tlm, bleMacAddr, 1, (uint64_t) 1<<chan);
+            continue;
         }
 
-        // Sleep on all but last advertisement
-        if(txCnt+1 < SimpleBeacon_AdvertisementTimes)
+        memset(&packet, 0, sizeof(packet));
+        packet.header.sourceAddress = reading.address;
+        packet.header.packetType = RADIO_PACKET_TYPE_DM_SENSOR_PACKET;
+        packet.dmSensorPacket.temp = reading.temp;
+        /* The beacon only has the one temperature */
+        packet.dmSensorPacket.internalTemp = reading.temp;
+        /* Back from mV to the battery monitor format the nodes send */
+        packet.dmSensorPacket.batt = ((uint32_t)reading.battMv << 5) / 125;
+        packet.dmSensorPacket.time100MiliSec = reading.uptimeS * 10;
+        packet.dmSensorPacket.seqNumber = reading.seqNumber;
+
+        updateNodeRX(&packet);
+        if (packetReceivedCallback)
         {
-            Task_sleep(SimpleBeacon_AdvertisementIntervals[txCnt]);
+            packetReceivedCallback(&packet, reading.rssi);
         }
     }
+}
 
-#ifdef __CC1350_LAUNCHXL_BOARD_H__
-    //Switch RF switch to Sub1G antenna
-    PIN_setOutputValue(ledPinHandle, Board_DIO1_RFSW, 1);
-#endif //__CC1350_LAUNCHXL_BOARD_H__
+static void bleScanClockCallback(UArg arg0)
+{
+    Trace_eventPost(radioOperationEventHandle, RADIO_EVENT_BLE_SCAN);
+}
 
-    /* Toggle activity LED */
-    PIN_setOutputValue(ledPinHandle, CONCENTRATOR_BLE_ACTIVITY_LED,!PIN_getOutputValue(CONCENTRATOR_BLE_ACTIVITY_LED));
+static void bleReadingCallback(void)
+{
+    /* Called from the RF callback, leave the work to the task */
+    Trace_eventPost(radioOperationEventHandle, RADIO_EVENT_BLE_READING);
 }
 
-static void sendAck(uint8_t latestSourceAddress) {
+uint32_t ConcentratorRadioTask_getNetworkTimeMs(void)
+{
+    return getNetworkTimeMs();
+}
+
+/* Network time in ms since the concentrator started, kept from the radio
+ * timer extended to 64 bits. Must be called at least once per radio timer
+ * wrap around (1073s), which the time sync period guarantees. */
+static uint32_t getNetworkTimeMs(void)
+{
+    static uint32_t lastRatTime = 0;
+    static uint32_t ratTimeHigh = 0;
+    uint32_t ratTime;
+    uint64_t ratTime64;
+    UInt key;
+
+    /* Also called from other tasks */
+    key = Task_disable();
+    ratTime = EasyLink_getAbsTime();
+    if (ratTime < lastRatTime)
+    {
+        ratTimeHigh++;
+    }
+    lastRatTime = ratTime;
+    ratTime64 = ((uint64_t)ratTimeHigh << 32) | ratTime;
+    Task_restore(key);
+
+    return (uint32_t)(ratTime64 / CONCENTRATOR_RAT_TICKS_PER_MS);
+}
+
+/* Network time in ms at a recent radio time */
+static uint32_t ratTimeToNetworkTime(uint32_t ratTime)
+{
+    uint32_t nowMs = getNetworkTimeMs();
+    uint32_t ageMs = (EasyLink_getAbsTime() - ratTime) / CONCENTRATOR_RAT_TICKS_PER_MS;
+
+    return nowMs - ageMs;
+}
+
+/* Radio time at which the network time is the given ms */
+static uint32_t networkTimeToRatTime(uint32_t networkTimeMs)
+{
+    return networkTimeMs * CONCENTRATOR_RAT_TICKS_PER_MS;
+}
+
+static void scheduleTimeSync(void)
+{
+    uint32_t now = getNetworkTimeMs();
+    uint32_t delayMs;
+
+    nextTimeSyncMs = (now / RADIO_TIME_SYNC_PERIOD_MS + 1) * RADIO_TIME_SYNC_PERIOD_MS;
+
+    /* Wake up a bit before, the TX itself is started by the radio timer */
+    delayMs = nextTimeSyncMs - now;
+    if (delayMs > CONCENTRATOR_TIME_SYNC_WAKEUP_MS)
+    {
+        delayMs -= CONCENTRATOR_TIME_SYNC_WAKEUP_MS;
+    }
+    Clock_setTimeout(timeSyncClockHandle, (delayMs * 1000) / Clock_tickPeriod);
+    Clock_start(timeSyncClockHandle);
+}
+
+/* Starts RX on the PHY scheduled for the current time, until the next PHY
+ * change or at most CONCENTRATOR_RX_TIMEOUT_MS */
+static void startRx(void)
+{
+    uint32_t periodTimeMs = getNetworkTimeMs() % RADIO_TIME_SYNC_PERIOD_MS;
+    uint32_t rxTimeMs;
+
+    if ((periodTimeMs >= RADIO_FAST_PHY_WINDOW_OFFSET_MS) &&
+        (periodTimeMs < RADIO_FAST_PHY_WINDOW_OFFSET_MS + RADIO_FAST_PHY_WINDOW_MS))
+    {
+        setPhy(RADIO_EASYLINK_FAST_MODULATION);
+        rxTimeMs = RADIO_FAST_PHY_WINDOW_OFFSET_MS + RADIO_FAST_PHY_WINDOW_MS - periodTimeMs;
+    }
+    else
+    {
+        setPhy(RADIO_EASYLINK_MODULATION);
+        if (periodTimeMs < RADIO_FAST_PHY_WINDOW_OFFSET_MS)
+        {
+            rxTimeMs = RADIO_FAST_PHY_WINDOW_OFFSET_MS - periodTimeMs;
+        }
+        else
+        {
+            rxTimeMs = RADIO_TIME_SYNC_PERIOD_MS - periodTimeMs + RADIO_FAST_PHY_WINDOW_OFFSET_MS;
+        }
+        if (rxTimeMs > CONCENTRATOR_RX_TIMEOUT_MS)
+        {
+            rxTimeMs = CONCENTRATOR_RX_TIMEOUT_MS;
+        }
+    }
+
+    rxCmd.type = EasyLink_CmdType_Rx;
+    rxCmd.priority = EasyLink_Priority_Rx;
+    rxCmd.deadline = 0;
+    rxCmd.rxAbsTime = 0;
+    rxCmd.rxTimeout = EasyLink_ms_To_RadioTime(rxTimeMs);
+    rxCmd.cb = rxDoneCallback;
+    if (EasyLink_submit(&rxCmd) != EasyLink_Status_Success)
+    {
+        System_abort("EasyLink_submit failed");
+    }
+}
+
+static void setPhy(EasyLink_PhyType phy)
+{
+    if (phy == currentPhy)
+    {
+        return;
+    }
+
+    if (EasyLink_init(phy) != EasyLink_Status_Success)
+    {
+        System_abort("EasyLink_init failed");
+    }
+
+    /* EasyLink_init resets the address size and filter */
+    EasyLink_setCtrl(EasyLink_Ctrl_AddSize, RADIO_ADDRESS_SIZE);
+    EasyLink_enableRxAddrFilter(addrFilterTable, RADIO_ADDRESS_SIZE, 1);
+    currentPhy = phy;
+
+    /* Listen all the time in the fast PHY window, the nodes only use it when
+     * synchronized so they send the normal short preamble there */
+    EasyLink_setCtrl(EasyLink_Ctrl_Sniff_Interval, (phy == RADIO_EASYLINK_FAST_MODULATION) ?
+                     0 : EasyLink_ms_To_RadioTime(RADIO_SNIFF_INTERVAL_MS));
+}
+
+static void timeSyncClockCallback(UArg arg0)
+{
+    Trace_eventPost(radioOperationEventHandle, RADIO_EVENT_SEND_TIME_SYNC);
+}
+
+static void sendTimeSync(void)
+{
+    /* Skip this one if we were held up too long to start the TX on time, as
+     * nodes rely on it being sent exactly at the network time it carries */
+    if ((int32_t)(nextTimeSyncMs - getNetworkTimeMs()) >= CONCENTRATOR_TIME_SYNC_MIN_LEAD_MS)
+    {
+        allocTxPacket();
+        txPacket->dstAddr[0] = (RADIO_BROADCAST_ADDRESS & 0xFF00) >> 8;
+        txPacket->dstAddr[1] = (RADIO_BROADCAST_ADDRESS & 0xFF);
+        txPacket->payload[0] = (concentratorAddress & 0xFF00) >> 8;
+        txPacket->payload[1] = (concentratorAddress & 0xFF);
+        txPacket->payload[2] = RADIO_PACKET_TYPE_TIME_SYNC_PACKET;
+        txPacket->payload[3] = (nextTimeSyncMs & 0xFF000000) >> 24;
+        txPacket->payload[4] = (nextTimeSyncMs & 0x00FF0000) >> 16;
+        txPacket->payload[5] = (nextTimeSyncMs & 0xFF00) >> 8;
+        txPacket->payload[6] = (nextTimeSyncMs & 0xFF);
+        txPacket->len = RADIO_TIME_SYNC_PACKET_LENGTH;
+        txPacket->absTime = networkTimeToRatTime(nextTimeSyncMs);
+
+        /* Stop RX, rxDoneCallback ignores the resulting abort */
+        rxStopped = true;
+        EasyLink_abort();
+        rxStopped = false;
+
+        /* Time sync always goes out on the default PHY, which all nodes listen on */
+        setPhy(RADIO_EASYLINK_MODULATION);
+
+        transmitAndFreeTxPacket();
+
+        /* Go back to RX */
+        startRx();
+    }
+
+    scheduleTimeSync();
+}
+
+/* PHY a node should use for its next uplink, from the RSSI of its last one
+ * scaled to full TX power, as nodes regulate their power down to a fixed link
+ * margin. The gap between the thresholds keeps nodes near the limit from
+ * toggling. */
+static EasyLink_PhyType selectPhy(int8_t rssi, int8_t txPower)
+{
+    rssi += RADIO_MAX_TX_POWER - txPower;
+
+    if ((currentPhy == RADIO_EASYLINK_MODULATION) && (rssi >= RADIO_FAST_PHY_RSSI_UPPER_THRESHOLD))
+    {
+        return RADIO_EASYLINK_FAST_MODULATION;
+    }
+    else if ((currentPhy == RADIO_EASYLINK_FAST_MODULATION) && (rssi < RADIO_FAST_PHY_RSSI_LOWER_THRESHOLD))
+    {
+        return RADIO_EASYLINK_MODULATION;
+    }
+
+    return currentPhy;
+}
+
+static void sendAck(uint16_t latestSourceAddress) {
+    buildAck(latestSourceAddress);
+    submitAck();
+}
+
+/* A join response is an ACK which also carries the address of the node */
+static void sendJoinResponse(uint16_t latestSourceAddress, uint16_t address) {
+    buildAck(latestSourceAddress);
+
+    txPacket->payload[2] = RADIO_PACKET_TYPE_JOIN_RESPONSE_PACKET;
+    txPacket->payload[10] = (address & 0xFF00) >> 8;
+    txPacket->payload[11] = (address & 0xFF);
+    memcpy(&txPacket->payload[12], latestRxPacket.joinRequestPacket.ieeeAddr, RADIO_IEEE_ADDRESS_SIZE);
+    txPacket->len = RADIO_JOIN_RESPONSE_PACKET_LENGTH;
+
+    submitAck();
+}
+
+static void buildAck(uint16_t latestSourceAddress) {
+
+    /* Send the ACK on a whole network time ms, a fixed turnaround after the
+     * end of the received packet however late the task got to it, so nodes
+     * can both sync to it and predict it */
+    uint32_t ackTimeMs = ratTimeToNetworkTime(lentRxDoneTime) + RADIO_ACK_TURNAROUND_TIME_MS + 1;
+    int8_t sensitivity = (currentPhy == RADIO_EASYLINK_FAST_MODULATION) ? RADIO_FSK_SENSITIVITY : RADIO_LRM_SENSITIVITY;
+
+    allocTxPacket();
 
     /* Set destinationAdress, but use EasyLink layers destination address capability */
-    txPacket.dstAddr[0] = latestSourceAddress;
+    txPacket->dstAddr[0] = (latestSourceAddress & 0xFF00) >> 8;
+    txPacket->dstAddr[1] = (latestSourceAddress & 0xFF);
+
+    /* Copy ACK packet to payload, skipping the destination address bytes.
+     * Note that the EasyLink API will implicitly both add the length byte and the destination address bytes. */
+    txPacket->payload[0] = (ackPacket.header.sourceAddress & 0xFF00) >> 8;
+    txPacket->payload[1] = (ackPacket.header.sourceAddress & 0xFF);
+    txPacket->payload[2] = ackPacket.header.packetType;
+    txPacket->payload[3] = (ackTimeMs & 0xFF000000) >> 24;
+    txPacket->payload[4] = (ackTimeMs & 0x00FF0000) >> 16;
+    txPacket->payload[5] = (ackTimeMs & 0xFF00) >> 8;
+    txPacket->payload[6] = (ackTimeMs & 0xFF);
+    txPacket->payload[7] = selectPhy(latestRssi, latestTxPower);
+    txPacket->payload[8] = latestRssi;
+    txPacket->payload[9] = latestRssi - sensitivity;
+    txPacket->len = RADIO_ACK_PACKET_LENGTH;
+    txPacket->absTime = networkTimeToRatTime(ackTimeMs);
+}
 
-    /* Copy ACK packet to payload, skipping the destination address byte.
-     * Note that the EasyLink API will implicitly both add the length byte and the destination address byte. */
-    memcpy(txPacket.payload, &ackPacket.header, sizeof(ackPacket));
-    txPacket.len = sizeof(ackPacket);
+static void submitAck(void) {
 
-    /* Send packet */
-    if (EasyLink_transmit(&txPacket) != EasyLink_Status_Success)
+    /* Queue the packet ahead of anything else, the node stops listening
+     * shortly after ackTimeMs so it is dropped if it can not start by then */
+    ackCmd.type = EasyLink_CmdType_Tx;
+    ackCmd.priority = EasyLink_Priority_Ack;
+    ackCmd.deadline = txPacket->absTime;
+    ackCmd.txPacket = txPacket;
+    ackCmd.cb = ackDoneCallback;
+    if (EasyLink_submit(&ackCmd) != EasyLink_Status_Success)
+    {
+        System_abort("EasyLink_submit failed");
+    }
+    ackPending = true;
+}
+
+/* Assigns the node its address, from the table of joined nodes, and gives
+ * it a slot in the registry under that address. A node the table has no room
+ * for gets no answer and tries again later, as does a replayed request. */
+static void handleJoinRequest(void)
+{
+#if RADIO_SECURITY_ENABLED
+    uint16_t address = NodeJoin_join(latestRxPacket.joinRequestPacket.ieeeAddr, latestFrameCounter);
+#else
+    uint16_t address = NodeJoin_join(latestRxPacket.joinRequestPacket.ieeeAddr, 0);
+#endif
+
+    if (address == NODEJOIN_NO_ADDRESS)
+    {
+        /* Go back to RX, no ack is coming to do it */
+        startRx();
+        return;
+    }
+
+    sendJoinResponse(latestRxPacket.header.sourceAddress, address);
+
+    latestRxPacket.header.sourceAddress = address;
+    updateNodeRX(&latestRxPacket);
+#if RADIO_SECURITY_ENABLED
+    /* Frame counters of the node are only accepted from this one on */
+    updateFrameCounter(address);
+#endif
+}
+
+static void ackDoneCallback(EasyLink_Cmd * cmd, EasyLink_Status status, EasyLink_RxLentPacket * rxPacket)
+{
+    /* A lost ack is retried by the node, so the task just goes on */
+    Trace_eventPost(radioOperationEventHandle, RADIO_EVENT_ACK_DONE);
+}
+
+static void allocTxPacket(void)
+{
+    /* The pool is sized for a packet being sent while RX still holds its
+     * buffers, so this only fails on a leak */
+    txPacket = PacketPool_alloc();
+    if (txPacket == NULL)
+    {
+        System_abort("PacketPool_alloc failed");
+    }
+}
+
+static void transmitAndFreeTxPacket(void)
+{
+    if (EasyLink_transmit(txPacket) != EasyLink_Status_Success)
     {
         System_abort("EasyLink_transmit failed");
     }
+
+    PacketPool_free(txPacket);
+    txPacket = NULL;
 }
 
 static void notifyPacketReceived(union ConcentratorPacket* latestRxPacket)
@@ -460,52 +1036,182 @@ static void notifyPacketReceived(union ConcentratorPacket* latestRxPacket)
     {
         packetReceivedCallback(latestRxPacket, latestRssi);
     }
-    if (latestRxPacket->header.packetType == RADIO_PACKET_TYPE_DM_SENSOR_PACKET) {
-        latestActiveSensorNodeRX.address = latestRxPacket->header.sourceAddress;
+}
+
+static void rxDoneCallback(EasyLink_Cmd * cmd, EasyLink_Status status, EasyLink_RxLentPacket * rxPacket)
+{
+    /* RX was stopped by the task itself, which also restarts it */
+    if (rxStopped)
+    {
+        EasyLink_releaseRx(rxPacket);
+        return;
+    }
+
+    /* If we received a valid packet, keep it where the radio received it
+     * for the task to decode */
+    if ((status == EasyLink_Status_Success) && isValidPacket(rxPacket))
+    {
+        /* The packet's own timestamp is at its sync word, while the ACK
+         * turnaround counts from its end, which is now */
+        lentRxDoneTime = EasyLink_getAbsTime();
+        lentRxPacket = rxPacket;
+
+        /* Signal packet received */
+        Trace_eventPost(radioOperationEventHandle, RADIO_EVENT_VALID_PACKET_RECEIVED);
+    }
+    else
+    {
+        EasyLink_releaseRx(rxPacket);
+
+        /* Signal invalid packet received */
+        Trace_eventPost(radioOperationEventHandle, RADIO_EVENT_INVALID_PACKET_RECEIVED);
     }
 }
 
-static void rxDoneCallback(EasyLink_RxPacket * rxPacket, EasyLink_Status status)
+static bool isValidPacket(EasyLink_RxLentPacket * rxPacket)
 {
-    union ConcentratorPacket* tmpRxPacket;
+#if RADIO_SECURITY_ENABLED
+    /* The payload is checked by the task once it is opened */
+    return (rxPacket->len >= RADIO_PACKET_HEADER_LENGTH + PACKETCRYPTO_OVERHEAD);
+#else
+    return isValidPayload(rxPacket->payload, rxPacket->len);
+#endif
+}
 
-    /* If we received a packet successfully */
-    if (status == EasyLink_Status_Success)
+static bool isValidPayload(uint8_t* payload, uint8_t len)
+{
+    if (len < RADIO_PACKET_HEADER_LENGTH)
+    {
+        return false;
+    }
+
+    switch (payload[2])
+    {
+    case RADIO_PACKET_TYPE_DM_SENSOR_PACKET:
+        return (len == RADIO_DM_SENSOR_PACKET_LENGTH);
+    case RADIO_PACKET_TYPE_ENERGY_PACKET:
+        return (len == RADIO_ENERGY_PACKET_LENGTH);
+    case RADIO_PACKET_TYPE_TASK_STATS_PACKET:
+        return ((len > 3) && (payload[3] <= RADIO_MAX_TASK_STATS) &&
+                (len == RADIO_TASK_STATS_PACKET_LENGTH(payload[3])));
+    case RADIO_PACKET_TYPE_JOIN_REQUEST_PACKET:
+        return (len == RADIO_JOIN_REQUEST_PACKET_LENGTH);
+    default:
+        return false;
+    }
+}
+
+#if RADIO_SECURITY_ENABLED
+/* Opens a sealed packet in the radio's buffer, leaving the plain packet for
+ * decodePacket. The frame counters of a node must increase, it keeps them
+ * increasing across reboots, so any older packet is dropped as a replay. */
+static bool openPacket(EasyLink_RxLentPacket * rxPacket)
+{
+    uint16_t address = (rxPacket->payload[0] << 8) | rxPacket->payload[1];
+    uint16_t slot;
+    uint8_t len;
+    bool known;
+
+    len = PacketCrypto_open(rxPacket->payload, RADIO_PACKET_HEADER_LENGTH, rxPacket->len,
+                            PACKETCRYPTO_SOURCE_SUB1GHZ, address, &latestFrameCounter);
+    if ((len == 0) || !isValidPayload(rxPacket->payload, len))
+    {
+        return false;
+    }
+
+    slot = NodeRegistry_find(address);
+    known = (slot != NODEREGISTRY_NO_SLOT) && (knownSensorNodeRXs[slot].address == address) &&
+            knownSensorNodeRXs[slot].hasFrameCounter;
+    if (known && (latestFrameCounter <= knownSensorNodeRXs[slot].lastFrameCounter))
     {
-        /* Save the latest RSSI, which is later sent to the receive callback */
-        latestRssi = (int8_t)rxPacket->rssi;
+        return false;
+    }
+
+    /* The frame counters of a node are forgotten on a reboot, or when it
+     * drops out of the registry, so its other packets are only accepted after
+     * a join, once NodeJoin has persisted the join's frame counter that a
+     * replayed join is checked against */
+    if ((rxPacket->payload[2] != RADIO_PACKET_TYPE_JOIN_REQUEST_PACKET) &&
+        (!known || !NodeJoin_isPersisted(address)))
+    {
+        return false;
+    }
 
-        /* Check that this is a valid packet */
-        tmpRxPacket = (union ConcentratorPacket*)(rxPacket->payload);
+    rxPacket->len = len;
+    return true;
+}
+#endif
+
+/* Decodes a packet checked by isValidPacket directly from the radio's buffer */
+static void decodePacket(EasyLink_RxLentPacket * rxPacket)
+{
+    uint8_t* payload = rxPacket->payload;
+
+    /* Save the latest RSSI, which is later sent to the receive callback */
+    latestRssi = (int8_t)rxPacket->rssi;
+
+    latestRxPacket.header.sourceAddress = (payload[0] << 8) | payload[1];
+    latestRxPacket.header.packetType = payload[2];
+
+    if (latestRxPacket.header.packetType == RADIO_PACKET_TYPE_DM_SENSOR_PACKET)
+    {
+        latestRxPacket.dmSensorPacket.temp = (payload[3] << 8) | payload[4];
+        latestRxPacket.dmSensorPacket.batt = (payload[5] << 8) | payload[6];
+        latestRxPacket.dmSensorPacket.internalTemp = (payload[7] << 8) | payload[8];
+        latestRxPacket.dmSensorPacket.time100MiliSec = (payload[9] << 24) |
+                                                       (payload[10] << 16) |
+                                                       (payload[11] << 8) |
+                                                        payload[12];
+        latestRxPacket.dmSensorPacket.networkTime100MiliSec = (payload[13] << 24) |
+                                                              (payload[14] << 16) |
+                                                              (payload[15] << 8) |
+                                                               payload[16];
+        latestRxPacket.dmSensorPacket.txPower = (int8_t)payload[17];
+        latestTxPower = latestRxPacket.dmSensorPacket.txPower;
+        latestRxPacket.dmSensorPacket.seqNumber = payload[18];
+        latestRxPacket.dmSensorPacket.samplePeriodS = (payload[19] << 8) | payload[20];
+        latestRxPacket.dmSensorPacket.heartbeatS = (payload[21] << 8) | payload[22];
+    }
+    else if (latestRxPacket.header.packetType == RADIO_PACKET_TYPE_ENERGY_PACKET)
+    {
+        uint8_t i;
 
-        if (tmpRxPacket->header.packetType == RADIO_PACKET_TYPE_DM_SENSOR_PACKET)
+        latestRxPacket.energyPacket.readings = (payload[3] << 24) |
+                                               (payload[4] << 16) |
+                                               (payload[5] << 8) |
+                                                payload[6];
+        for (i = 0; i < RADIO_ENERGY_ACTIVITIES; i++)
         {
-            /* Save packet */
-            latestRxPacket.header.sourceAddress = rxPacket->payload[0];
-            latestRxPacket.header.packetType = rxPacket->payload[1];
-            latestRxPacket.dmSensorPacket.temp = (rxPacket->payload[2] << 8) |
-                                                  rxPacket->payload[3];
-            latestRxPacket.dmSensorPacket.batt = (rxPacket->payload[4] << 8) |
-                                                  rxPacket->payload[5];
-            latestRxPacket.dmSensorPacket.internalTemp = (rxPacket->payload[6] << 8) |
-                                                          rxPacket->payload[7];
-            latestRxPacket.dmSensorPacket.time100MiliSec = (rxPacket->payload[8] << 24) |
-                                                           (rxPacket->payload[9] << 16) |
-                                                           (rxPacket->payload[10] << 8) |
-                                                            rxPacket->payload[11];
-
-            /* Signal packet received */
-            Event_post(radioOperationEventHandle, RADIO_EVENT_VALID_PACKET_RECEIVED);
+            latestRxPacket.energyPacket.chargeNah[i] = (payload[7 + 4 * i] << 24) |
+                                                       (payload[8 + 4 * i] << 16) |
+                                                       (payload[9 + 4 * i] << 8) |
+                                                        payload[10 + 4 * i];
         }
-        else
+        latestRxPacket.energyPacket.txPower = (int8_t)payload[27];
+        latestTxPower = latestRxPacket.energyPacket.txPower;
+    }
+    else if (latestRxPacket.header.packetType == RADIO_PACKET_TYPE_TASK_STATS_PACKET)
+    {
+        uint8_t* entry;
+        uint8_t i;
+
+        latestRxPacket.taskStatsPacket.numTasks = payload[3];
+        for (i = 0; i < latestRxPacket.taskStatsPacket.numTasks; i++)
         {
-            /* Signal invalid packet received */
-            Event_post(radioOperationEventHandle, RADIO_EVENT_INVALID_PACKET_RECEIVED);
+            entry = &payload[4 + RADIO_TASK_STATS_ENTRY_LENGTH * i];
+            latestRxPacket.taskStatsPacket.tasks[i].priority = entry[0];
+            latestRxPacket.taskStatsPacket.tasks[i].loadPermille = (entry[1] << 8) | entry[2];
+            latestRxPacket.taskStatsPacket.tasks[i].stackSize = (entry[3] << 8) | entry[4];
+            latestRxPacket.taskStatsPacket.tasks[i].stackUsed = (entry[5] << 8) | entry[6];
         }
+        latestRxPacket.taskStatsPacket.txPower = (int8_t)payload[4 + RADIO_TASK_STATS_ENTRY_LENGTH * i];
+        latestTxPower = latestRxPacket.taskStatsPacket.txPower;
     }
-    else
+    else if (latestRxPacket.header.packetType == RADIO_PACKET_TYPE_JOIN_REQUEST_PACKET)
     {
-        /* Signal invalid packet received */
-        Event_post(radioOperationEventHandle, RADIO_EVENT_INVALID_PACKET_RECEIVED);
+        memcpy(latestRxPacket.joinRequestPacket.ieeeAddr, &payload[3], RADIO_IEEE_ADDRESS_SIZE);
+
+        /* Nodes join at full power */
+        latestTxPower = RADIO_MAX_TX_POWER;
     }
 }
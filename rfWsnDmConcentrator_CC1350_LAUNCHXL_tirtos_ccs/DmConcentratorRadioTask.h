@@ -36,7 +36,7 @@
 #include "stdint.h"
 #include "RadioProtocol.h"
 
-#define CONCENTRATOR_ADVERTISE_INVALID  0x00
+#define CONCENTRATOR_ADVERTISE_INVALID  0x0000
 
 enum ConcentratorRadioOperationStatus {
     ConcentratorRadioStatus_Success,
@@ -54,11 +54,14 @@ typedef enum
 union ConcentratorPacket {
     struct PacketHeader header;
     struct DualModeInternalTempSensorPacket dmSensorPacket;
+    struct EnergyPacket energyPacket;
+    struct TaskStatsPacket taskStatsPacket;
+    struct JoinRequestPacket joinRequestPacket;
 };
 
 typedef struct
 {
-    uint8_t sourceAddress;
+    uint16_t sourceAddress;
     Concentrator_AdvertiserType type;
 } ConcentratorAdvertiser;
 
@@ -73,6 +76,9 @@ void ConcentratorRadioTask_registerPacketReceivedCallback(ConcentratorRadio_Pack
 /* set BLE advertiser settings */
 void ConcentratorRadioTask_setAdvertiser(ConcentratorAdvertiser advertiser);
 
+/* Network time in ms since the concentrator started */
+uint32_t ConcentratorRadioTask_getNetworkTimeMs(void);
+
 #define FRACT_BITS 8
 #define FIXED2DOUBLE(x) (((double)(x)) / (1 << FRACT_BITS))
 #define FLOAT2FIXED(x) ((int)((x) * (1 << FRACT_BITS)))
@@ -37,10 +37,12 @@
 #include <xdc/runtime/System.h>
 
 #include <string.h>
+#include <math.h>
 
 #include <ti/sysbios/BIOS.h>
 
 #include <ti/sysbios/knl/Task.h>
+#include <ti/sysbios/knl/Clock.h>
 #include <ti/sysbios/knl/Semaphore.h>
 #include <ti/sysbios/knl/Event.h>
 
@@ -54,6 +56,16 @@
 #include "Board.h"
 
 #include "RadioProtocol.h"
+#include "trace/Trace.h"
+#include "trace/TaskMonitor.h"
+#include "NodeRegistry.h"
+#include "NodeLiveness.h"
+#include "NodeStats.h"
+#include "NodeHistory.h"
+#include "NodeJoin.h"
+#include "HistoryConsole.h"
+#include "UartLog.h"
+#include "pool/PacketPool.h"
 
 
 
@@ -62,17 +74,48 @@
 #define CONCENTRATOR_TASK_PRIORITY   3
 #define CONCENTRATOR_EVENT_ALL                         0xFFFFFFFF
 #define CONCENTRATOR_EVENT_NEW_ADC_SENSOR_VALUE    (uint32_t)(1 << 0)
-#define CONCENTRATOR_EVENT_UPDATE_LCD    (uint32_t)(1 << 1)
-#define CONCENTRATOR_MAX_NODES 7
+#define CONCENTRATOR_EVENT_SPILL_HISTORY    (uint32_t)(1 << 1)
+#define CONCENTRATOR_EVENT_PERSIST_JOINS    (uint32_t)(1 << 2)
 #define CONCENTRATOR_DISPLAY_LINES 10
 
+/* The LCD and UART are drawn by the render task, below every other task so a
+ * slow frame never holds up the radio */
+#define CONCENTRATOR_RENDER_TASK_STACK_SIZE 1024
+#define CONCENTRATOR_RENDER_TASK_PRIORITY   1
+#define CONCENTRATOR_RENDER_EVENT_ALL       0xFFFFFFFF
+#define CONCENTRATOR_RENDER_EVENT_UPDATE    (uint32_t)(1 << 0)
+#define CONCENTRATOR_RENDER_EVENT_DUMP      (uint32_t)(1 << 1)
+
+/* Shortest time between two frames, the requests made meanwhile are all
+ * served by the next frame */
+#ifndef CONCENTRATOR_FRAME_PERIOD_MS
+#define CONCENTRATOR_FRAME_PERIOD_MS        250
+#endif
+
 /***** Type declarations *****/
 struct AdcSensorNode {
-    uint8_t address;
+    uint16_t address;
     uint16_t latestTempValue; //fixed 8.8 notation
     int32_t latestInternalTempValue;
     uint8_t button;
     int8_t latestRssi;
+    uint32_t latestNetworkTime100MiliSec; //network time of the reading, 0 if the node is not synchronized
+    uint16_t samplePeriodS; //current sampling period of the node
+    uint16_t heartbeatS; //longest time between two readings from the node
+    uint32_t chargePerReadingNah; //from the latest energy report, 0 if none received
+    uint8_t numTasks; //from the latest task stats report, 0 if none received
+    struct TaskStats tasks[RADIO_MAX_TASK_STATS];
+    NodeStats stats; //running statistics of the readings since the node was added
+};
+
+/* The part of a node updateLcd shows, copied in one go from the entry the
+ * radio task writes */
+struct NodeDisplayLine {
+    uint16_t address;
+    uint16_t latestTempValue;
+    int8_t latestRssi;
+    uint32_t latestNetworkTime100MiliSec;
+    uint32_t chargePerReadingNah;
 };
 
 /*
@@ -91,23 +134,36 @@ Task_Struct concentratorTask;    /* not static so you can see in ROV */
 static uint8_t concentratorTaskStack[CONCENTRATOR_TASK_STACK_SIZE];
 Event_Struct concentratorEvent;  /* not static so you can see in ROV */
 static Event_Handle concentratorEventHandle;
-static struct AdcSensorNode latestActiveAdcSensorNode;
-struct AdcSensorNode knownSensorNodes[CONCENTRATOR_MAX_NODES];
-static struct AdcSensorNode* lastAddedSensorNode = knownSensorNodes;
-static uint8_t selectedNode = 0;
+static Task_Params renderTaskParams;
+Task_Struct renderTask;    /* not static so you can see in ROV */
+static uint8_t renderTaskStack[CONCENTRATOR_RENDER_TASK_STACK_SIZE];
+Event_Struct renderEvent;  /* not static so you can see in ROV */
+static Event_Handle renderEventHandle;
+static uint16_t latestSensorSlot;
+static bool latestSensorIsNew;
+struct AdcSensorNode knownSensorNodes[NODEREGISTRY_MAX_NODES]; /* indexed by NodeRegistry slot */
+static uint16_t selectedNode = 0;
 static Display_Handle hDisplayLcd;
-static Display_Handle hDisplaySerial;
 static PIN_Handle buttonPinHandle;
 static PIN_State buttonPinState;
 static ConcentratorAdvertiser advertiser;
 
 /***** Prototypes *****/
 static void concentratorTaskFunction(UArg arg0, UArg arg1);
+static void renderTaskFunction(UArg arg0, UArg arg1);
+static void requestRender(uint32_t events);
 static void packetReceivedCallback(union ConcentratorPacket* packet, int8_t rssi);
+static void livenessEventCallback(uint16_t address, NodeLiveness_State state);
+static void historyEventCallback(void);
+static void joinEventCallback(void);
+static char livenessChar(struct NodeDisplayLine* node);
 static void updateLcd(void);
-static void addNewNode(struct AdcSensorNode* node);
-static void updateNode(struct AdcSensorNode* node);
-static uint8_t isKnownNodeAddress(uint8_t address);
+static void selectNode(uint16_t slot, bool isNew);
+static void printNodeTaskStats(struct AdcSensorNode* node);
+static void printRxStats(void);
+static void printNodeStats(struct AdcSensorNode* node, bool detailed);
+static void printTraceLine(const char* line);
+static void printMonitorLine(const char* line);
 void buttonCallback(PIN_Handle handle, PIN_Id pinId);
 
 /***** Function definitions *****/
@@ -118,6 +174,8 @@ void ConcentratorTask_init(void) {
     Event_Params_init(&eventParam);
     Event_construct(&concentratorEvent, &eventParam);
     concentratorEventHandle = Event_handle(&concentratorEvent);
+    Event_construct(&renderEvent, &eventParam);
+    renderEventHandle = Event_handle(&renderEvent);
     advertiser.sourceAddress = CONCENTRATOR_ADVERTISE_INVALID;
     /* Create the concentrator radio protocol task */
     Task_Params_init(&concentratorTaskParams);
@@ -125,18 +183,84 @@ void ConcentratorTask_init(void) {
     concentratorTaskParams.priority = CONCENTRATOR_TASK_PRIORITY;
     concentratorTaskParams.stack = &concentratorTaskStack;
     Task_construct(&concentratorTask, concentratorTaskFunction, &concentratorTaskParams, NULL);
+
+    /* Create the render task, which opens the displays */
+    Task_Params_init(&renderTaskParams);
+    renderTaskParams.stackSize = CONCENTRATOR_RENDER_TASK_STACK_SIZE;
+    renderTaskParams.priority = CONCENTRATOR_RENDER_TASK_PRIORITY;
+    renderTaskParams.stack = &renderTaskStack;
+    Task_construct(&renderTask, renderTaskFunction, &renderTaskParams, NULL);
 }
 
 static void concentratorTaskFunction(UArg arg0, UArg arg1)
 {
-    /* Initialize display and try to open both UART and LCD types of display. */
+    buttonPinHandle = PIN_open(&buttonPinState, buttonPinTable);
+    if(!buttonPinHandle)
+    {
+        System_abort("Error initializing button pins\n");
+    }
+
+    /* Setup callback for button pins */
+    if (PIN_registerIntCb(buttonPinHandle, &buttonCallback) != 0)
+    {
+        System_abort("Error registering button callback function");
+    }
+
+    /* Register a packet received callback with the radio task */
+    ConcentratorRadioTask_registerPacketReceivedCallback(packetReceivedCallback);
+
+    /* Register for the nodes going late, dead or alive again */
+    NodeLiveness_registerEventCallback(livenessEventCallback);
+
+    /* Keep the readings, spilling them to the external flash from this task */
+    NodeHistory_init();
+    NodeHistory_registerEventCallback(historyEventCallback);
+
+    /* Read the addresses of the joined nodes from the same flash, nodes can
+     * join from then on */
+    NodeJoin_registerEventCallback(joinEventCallback);
+    NodeJoin_init();
+
+    /* Enter main task loop */
+    while (1)
+    {
+        /* Wait for event */
+        uint32_t events = Event_pend(concentratorEventHandle, 0, CONCENTRATOR_EVENT_ALL, BIOS_WAIT_FOREVER);
+
+        /* If we got a new ADC sensor value */
+        if (events & CONCENTRATOR_EVENT_NEW_ADC_SENSOR_VALUE)
+        {
+            selectNode(latestSensorSlot, latestSensorIsNew);
+
+            /* Update the values on the LCD */
+            requestRender(CONCENTRATOR_RENDER_EVENT_UPDATE);
+        }
+
+        /* Move full history blocks from RAM to the external flash */
+        if (events & CONCENTRATOR_EVENT_SPILL_HISTORY)
+        {
+            NodeHistory_spill();
+        }
+
+        /* Keep the addresses of newly joined nodes over a reboot */
+        if (events & CONCENTRATOR_EVENT_PERSIST_JOINS)
+        {
+            NodeJoin_persist();
+        }
+    }
+}
+
+static void renderTaskFunction(UArg arg0, UArg arg1)
+{
+    /* Initialize display and try to open the LCD type of display. */
     Display_Params params;
     Display_Params_init(&params);
     params.lineClearMode = DISPLAY_CLEAR_BOTH;
 
-    /* Open both an available LCD display and an UART display.
-     * Whether the open call is successful depends on what is present in the
-     * Display_config[] array of the board file.
+    /* Open an available LCD display. Whether the open call is successful
+     * depends on what is present in the Display_config[] array of the board
+     * file. The UART is written through UartLog, so that drawing a frame
+     * never waits for the serial port.
      *
      * Note that for SensorTag evaluation boards combined with the SHARP96x96
      * Watch DevPack, there is a pin conflict with UART such that one must be
@@ -144,13 +268,16 @@ static void concentratorTaskFunction(UArg arg0, UArg arg1)
      * DevPack, add the precompiler define BOARD_DISPLAY_EXCLUDE_UART.
      */
     hDisplayLcd = Display_open(Display_Type_LCD, &params);
-    hDisplaySerial = Display_open(Display_Type_UART, &params);
 
-    /* Check if the selected Display type was found and successfully opened */
-    if (hDisplaySerial)
+#ifndef BOARD_DISPLAY_EXCLUDE_UART
+    if (UartLog_init(Board_UART0))
     {
-        Display_printf(hDisplaySerial, 0, 0, "Waiting for nodes...");
+        UartLog_printf("Waiting for nodes...");
+
+        /* Answer history queries on the same UART */
+        HistoryConsole_init();
     }
+#endif
 
     /* Check if the selected Display type was found and successfully opened */
     if (hDisplayLcd)
@@ -158,138 +285,305 @@ static void concentratorTaskFunction(UArg arg0, UArg arg1)
         Display_printf(hDisplayLcd, 0, 0, "Waiting for nodes...");
     }
 
-    buttonPinHandle = PIN_open(&buttonPinState, buttonPinTable);
-    if(!buttonPinHandle)
-    {
-        System_abort("Error initializing button pins\n");
-    }
-
-    /* Setup callback for button pins */
-    if (PIN_registerIntCb(buttonPinHandle, &buttonCallback) != 0)
-    {
-        System_abort("Error registering button callback function");
-    }
-
-    /* Register a packet received callback with the radio task */
-    ConcentratorRadioTask_registerPacketReceivedCallback(packetReceivedCallback);
-
     /* Enter main task loop */
     while (1)
     {
-        /* Wait for event */
-        uint32_t events = Event_pend(concentratorEventHandle, 0, CONCENTRATOR_EVENT_ALL, BIOS_WAIT_FOREVER);
+        /* Wait for a frame to be requested */
+        uint32_t events = Event_pend(renderEventHandle, 0, CONCENTRATOR_RENDER_EVENT_ALL, BIOS_WAIT_FOREVER);
 
-        /* If we got a new ADC sensor value */
-        if (events & CONCENTRATOR_EVENT_NEW_ADC_SENSOR_VALUE)
+        /* Dump the trace buffer, for tools/trace2chrome.py, and the full
+         * statistics of all nodes on the UART */
+        if (events & CONCENTRATOR_RENDER_EVENT_DUMP)
         {
-            /* If we knew this node from before, update the value */
-            if (isKnownNodeAddress(latestActiveAdcSensorNode.address))
-            {
-                updateNode(&latestActiveAdcSensorNode);
-            }
-            else
+            struct AdcSensorNode* nodePointer;
+
+            Trace_dump(printTraceLine);
+
+            for (nodePointer = knownSensorNodes; nodePointer < &knownSensorNodes[NODEREGISTRY_MAX_NODES]; nodePointer++)
             {
-                /* Else add it */
-                addNewNode(&latestActiveAdcSensorNode);
+                if (nodePointer->address != 0)
+                {
+                    printNodeStats(nodePointer, true);
+                }
             }
-
-            /* Update the values on the LCD */
-            updateLcd();
         }
 
-        if (events & CONCENTRATOR_EVENT_UPDATE_LCD)
+        if (events & CONCENTRATOR_RENDER_EVENT_UPDATE)
         {
             /* Update the values on the LCD */
             updateLcd();
         }
+
+        /* Stay within the frame budget, the requests made until then are
+         * left pending and drawn together */
+        Task_sleep((CONCENTRATOR_FRAME_PERIOD_MS * 1000) / Clock_tickPeriod);
     }
 }
 
+/* Runs in the radio task, which has registered the node before calling, and
+ * writes the values straight into the node's entry */
 static void packetReceivedCallback(union ConcentratorPacket* packet, int8_t rssi)
 {
+    uint16_t slot = NodeRegistry_find(packet->header.sourceAddress);
+    struct AdcSensorNode* node;
+    UInt key;
+
+    if (slot == NODEREGISTRY_NO_SLOT)
+    {
+        return;
+    }
+    node = &knownSensorNodes[slot];
+
+    /* Keep the render task from seeing a half written entry */
+    key = Task_disable();
+
     if (packet->header.packetType == RADIO_PACKET_TYPE_DM_SENSOR_PACKET)
     {
+        latestSensorIsNew = (node->address != packet->header.sourceAddress);
+        if (latestSensorIsNew)
+        {
+            /* New node, or a new node in the slot of one that was replaced */
+            memset(node, 0, sizeof(struct AdcSensorNode));
+            node->address = packet->header.sourceAddress;
+        }
+
         /* Save the values */
-        latestActiveAdcSensorNode.address = packet->header.sourceAddress;
-        latestActiveAdcSensorNode.latestTempValue = packet->dmSensorPacket.temp;
-        latestActiveAdcSensorNode.latestInternalTempValue = packet->dmSensorPacket.internalTemp;
-        latestActiveAdcSensorNode.latestRssi = rssi;
+        node->latestTempValue = packet->dmSensorPacket.temp;
+        node->latestInternalTempValue = packet->dmSensorPacket.internalTemp;
+        node->latestRssi = rssi;
+        node->latestNetworkTime100MiliSec = packet->dmSensorPacket.networkTime100MiliSec;
+        node->samplePeriodS = packet->dmSensorPacket.samplePeriodS;
+        node->heartbeatS = packet->dmSensorPacket.heartbeatS;
+        if (NodeStats_addReading(&node->stats, packet->dmSensorPacket.seqNumber,
+                                 (int16_t)packet->dmSensorPacket.temp,
+                                 (int16_t)packet->dmSensorPacket.internalTemp, rssi))
+        {
+            NodeHistory_add(slot, node->address, ConcentratorRadioTask_getNetworkTimeMs() / 1000,
+                            (int16_t)packet->dmSensorPacket.temp,
+                            (int16_t)packet->dmSensorPacket.internalTemp);
+        }
+        latestSensorSlot = slot;
 
         Event_post(concentratorEventHandle, CONCENTRATOR_EVENT_NEW_ADC_SENSOR_VALUE);
     }
-}
-
-static uint8_t isKnownNodeAddress(uint8_t address) {
-    uint8_t found = 0;
-    uint8_t i;
-    for (i = 0; i < CONCENTRATOR_MAX_NODES; i++)
+    /* Reports are only kept for nodes that have sent a reading */
+    else if ((node->address == packet->header.sourceAddress) &&
+             (packet->header.packetType == RADIO_PACKET_TYPE_ENERGY_PACKET))
     {
-        if (knownSensorNodes[i].address == address)
+        uint32_t charge = 0;
+        uint8_t i;
+
+        for (i = 0; i < RADIO_ENERGY_ACTIVITIES; i++)
         {
-            found = 1;
-            break;
+            charge += packet->energyPacket.chargeNah[i];
         }
+
+        /* Save the values */
+        node->chargePerReadingNah = (packet->energyPacket.readings != 0) ?
+                                    (charge / packet->energyPacket.readings) : 0;
+
+        requestRender(CONCENTRATOR_RENDER_EVENT_UPDATE);
+    }
+    else if ((node->address == packet->header.sourceAddress) &&
+             (packet->header.packetType == RADIO_PACKET_TYPE_TASK_STATS_PACKET))
+    {
+        /* Save the values */
+        node->numTasks = packet->taskStatsPacket.numTasks;
+        memcpy(node->tasks, packet->taskStatsPacket.tasks, sizeof(node->tasks));
+
+        requestRender(CONCENTRATOR_RENDER_EVENT_UPDATE);
     }
-    return found;
+
+    Task_restore(key);
 }
 
-static void updateNode(struct AdcSensorNode* node) {
-    uint8_t i;
-    for (i = 0; i < CONCENTRATOR_MAX_NODES; i++) {
-        if (knownSensorNodes[i].address == node->address)
+static void livenessEventCallback(uint16_t address, NodeLiveness_State state)
+{
+    /* Called from the liveness clock Swi, update the node states on the LCD */
+    requestRender(CONCENTRATOR_RENDER_EVENT_UPDATE);
+}
+
+static void historyEventCallback(void)
+{
+    /* Called from the radio task, which must not wait for the flash */
+    Event_post(concentratorEventHandle, CONCENTRATOR_EVENT_SPILL_HISTORY);
+}
+
+static void joinEventCallback(void)
+{
+    /* Called from the radio task, which must not wait for the flash */
+    Event_post(concentratorEventHandle, CONCENTRATOR_EVENT_PERSIST_JOINS);
+}
+
+/* Can be called from any context, the render task draws the frame once its
+ * frame budget allows */
+static void requestRender(uint32_t events)
+{
+    Event_post(renderEventHandle, events);
+}
+
+static char livenessChar(struct NodeDisplayLine* node) {
+    switch (NodeLiveness_getState(NodeRegistry_find(node->address), node->address))
+    {
+    case NodeLiveness_StateAlive:
+        return ' ';
+    case NodeLiveness_StateLate:
+        return 'L';
+    case NodeLiveness_StateDead:
+        return 'D';
+    default:
+        return '?';
+    }
+}
+
+static void selectNode(uint16_t slot, bool isNew) {
+    if (isNew)
+    {
+        if(advertiser.sourceAddress == CONCENTRATOR_ADVERTISE_INVALID)
         {
-            knownSensorNodes[i].latestTempValue = node->latestTempValue;
-            knownSensorNodes[i].latestInternalTempValue = node->latestInternalTempValue;
-            knownSensorNodes[i].latestRssi = node->latestRssi;
-            knownSensorNodes[i].button = node->button;
-            selectedNode = i;
+            /* set first node as advertiser */
             advertiser.type = Concentrator_AdvertiserUrl;
-            advertiser.sourceAddress = knownSensorNodes[i].address;
+            advertiser.sourceAddress = knownSensorNodes[slot].address;
             ConcentratorRadioTask_setAdvertiser(advertiser);
-            break;
         }
     }
+    else
+    {
+        selectedNode = slot;
+        advertiser.type = Concentrator_AdvertiserUrl;
+        advertiser.sourceAddress = knownSensorNodes[slot].address;
+        ConcentratorRadioTask_setAdvertiser(advertiser);
+    }
+}
+
+/* The trace dump is requested by the user and larger than the UART ring, so
+ * it waits for room rather than losing lines */
+static void printTraceLine(const char* line) {
+    UartLog_printfBulk("%s", line);
+}
+
+static void printMonitorLine(const char* line) {
+    UartLog_printf("%s", line);
 }
 
-static void addNewNode(struct AdcSensorNode* node) {
-    *lastAddedSensorNode = *node;
+static void printNodeTaskStats(struct AdcSensorNode* node) {
+    struct TaskStats tasks[RADIO_MAX_TASK_STATS];
+    uint8_t numTasks;
+    uint8_t i;
+    UInt key;
+
+    /* Copy, as the radio task updates them */
+    key = Task_disable();
+    numTasks = node->numTasks;
+    memcpy(tasks, node->tasks, sizeof(tasks));
+    Task_restore(key);
 
-    /* Increment and wrap */
-    lastAddedSensorNode++;
-    if (lastAddedSensorNode > &knownSensorNodes[CONCENTRATOR_MAX_NODES-1])
+    for (i = 0; i < numTasks; i++)
     {
-        lastAddedSensorNode = knownSensorNodes;
+        UartLog_printf("0x%04x    %d  %3d.%d%%  %4d/%4d", node->address,
+                tasks[i].priority, tasks[i].loadPermille / 10, tasks[i].loadPermille % 10,
+                tasks[i].stackUsed, tasks[i].stackSize);
     }
+}
+
+static void printRxStats(void) {
+    EasyLink_RxStats rxStats;
+    PacketPool_Stats poolStats;
+    UartLog_Stats uartStats;
+    uint32_t received;
+    uint32_t perPermille = 0;
+
+    EasyLink_getRxStats(&rxStats, false);
+    PacketPool_getStats(&poolStats);
+    UartLog_getStats(&uartStats);
 
-    if(advertiser.sourceAddress == CONCENTRATOR_ADVERTISE_INVALID)
+    /* Packet error rate of the packets received with a valid sync word */
+    received = rxStats.nRxOk + rxStats.nRxNok + rxStats.nRxIgnored;
+    if (received != 0)
     {
-        /* set first node as advertiser */
-        advertiser.type = Concentrator_AdvertiserUrl;
-        advertiser.sourceAddress = node->address;
-        ConcentratorRadioTask_setAdvertiser(advertiser);
+        perPermille = (rxStats.nRxNok * 1000) / received;
+    }
+
+    UartLog_printf("RX ok: %d crc: %d filtered: %d overrun: %d PER: %d.%d%%",
+            rxStats.nRxOk, rxStats.nRxNok, rxStats.nRxIgnored, rxStats.nRxBufFull,
+            perPermille / 10, perPermille % 10);
+    UartLog_printf("Sniff idle: %d busy: %d",
+            rxStats.nSniffIdle, rxStats.nSniffBusy);
+    UartLog_printf("Packet pool free: %d min: %d failed: %d",
+            poolStats.numFree, poolStats.minFree, poolStats.allocFailures);
+    UartLog_printf("UART dropped: %d max used: %d/%d",
+            uartStats.overflows, uartStats.maxUsed, UARTLOG_RING_SIZE);
+}
+
+static void printNodeStats(struct AdcSensorNode* node, bool detailed) {
+    /* The detailed statistics are a dump requested by the user, see printTraceLine */
+    bool (*print)(const char* format, ...) = detailed ? UartLog_printfBulk : UartLog_printf;
+    NodeStats stats;
+    uint16_t lossPermille;
+    uint8_t i;
+    UInt key;
+
+    /* Copy, as the radio task updates them */
+    key = Task_disable();
+    stats = node->stats;
+    Task_restore(key);
+
+    lossPermille = NodeStats_lossPermille(&stats);
+
+    print("0x%04x n: %d lost: %d.%d%% dup: %d int: %dms T: %.2f/%.2f/%.2f sd: %.2f",
+            node->address, stats.readings, lossPermille / 10, lossPermille % 10, stats.duplicates,
+            NodeStats_meanIntervalMs(&stats), FIXED2DOUBLE(stats.temp.min), stats.temp.mean,
+            FIXED2DOUBLE(stats.temp.max), sqrtf(NodeStats_variance(&stats, &stats.temp)));
+
+    if (!detailed)
+    {
+        return;
+    }
+
+    print("0x%04x Tint: %.2f/%.2f/%.2f sd: %.2f", node->address,
+            FIXED2DOUBLE(stats.internalTemp.min), stats.internalTemp.mean,
+            FIXED2DOUBLE(stats.internalTemp.max), sqrtf(NodeStats_variance(&stats, &stats.internalTemp)));
+    print("0x%04x sample: %ds heartbeat: %ds", node->address,
+            node->samplePeriodS, node->heartbeatS);
+
+    for (i = 0; i < NODESTATS_RSSI_BUCKETS; i++)
+    {
+        print("0x%04x RSSI %4d: %d", node->address,
+                NodeStats_rssiBucketDbm(i), stats.rssiHistogram[i]);
     }
 }
 
 static void updateLcd(void) {
     struct AdcSensorNode* nodePointer = knownSensorNodes;
+    struct NodeDisplayLine line;
     uint8_t currentLcdLine;
     char selectedChar;
+    UInt key;
 
     Display_clear(hDisplayLcd);
     Display_printf(hDisplayLcd, 0, 0, "Mik4el");
     Display_printf(hDisplayLcd, 2, 0, "Nodes TempA");
 
     //clear screen, put cursor to beginning of terminal and print the header
-    Display_printf(hDisplaySerial, 0, 0, "\033[2J \033[0;0HNodes    Value    RSSI");
+    UartLog_printf("\033[2J \033[0;0HNodes    Value    RSSI    Time    nAh/rd");
 
     /* Start on the fourth line */
     currentLcdLine = 3;
 
     /* Write one line per node */
-    while ((nodePointer < &knownSensorNodes[CONCENTRATOR_MAX_NODES]) &&
+    while ((nodePointer < &knownSensorNodes[NODEREGISTRY_MAX_NODES]) &&
           (nodePointer->address != 0) &&
           (currentLcdLine < CONCENTRATOR_DISPLAY_LINES))
     {
+        /* Copy the node, the radio task may update it while we draw */
+        key = Task_disable();
+        line.address = nodePointer->address;
+        line.latestTempValue = nodePointer->latestTempValue;
+        line.latestRssi = nodePointer->latestRssi;
+        line.latestNetworkTime100MiliSec = nodePointer->latestNetworkTime100MiliSec;
+        line.chargePerReadingNah = nodePointer->chargePerReadingNah;
+        Task_restore(key);
+
         if ( currentLcdLine == (selectedNode + 3))
         {
             selectedChar = '*';
@@ -299,22 +593,24 @@ static void updateLcd(void) {
             selectedChar = ' ';
         }
 
-        double tempFormatted = FIXED2DOUBLE(nodePointer->latestTempValue);
+        double tempFormatted = FIXED2DOUBLE(line.latestTempValue);
         if (tempFormatted > 128.0) {
             tempFormatted = tempFormatted - 256.0; //display negative temperature correct
         }
 
         /* print to LCD */
-        Display_printf(hDisplayLcd, currentLcdLine, 0, "%c0x%02x %2f", selectedChar,
-                nodePointer->address, tempFormatted);
+        Display_printf(hDisplayLcd, currentLcdLine, 0, "%c0x%04x%c %2f", selectedChar,
+                line.address, livenessChar(&line), tempFormatted);
 
         currentLcdLine++;
 
-        Display_printf(hDisplayLcd, currentLcdLine, 0, "RSSI: %04d", nodePointer->latestRssi);
+        Display_printf(hDisplayLcd, currentLcdLine, 0, "RSSI: %04d", line.latestRssi);
 
         /* print to UART */
-        Display_printf(hDisplaySerial, currentLcdLine, 0, "%c0x%02x %02f %04d", selectedChar,
-                nodePointer->address, tempFormatted, nodePointer->latestRssi);
+        UartLog_printf("%c0x%04x%c %02f %04d %d.%d %d", selectedChar,
+                line.address, livenessChar(&line), tempFormatted, line.latestRssi,
+                line.latestNetworkTime100MiliSec / 10, line.latestNetworkTime100MiliSec % 10,
+                line.chargePerReadingNah);
 
         nodePointer++;
         currentLcdLine++;
@@ -338,7 +634,31 @@ static void updateLcd(void) {
         /* print to LCD */
         Display_printf(hDisplayLcd, currentLcdLine+1, 0, "Beacon: %s", advMode);
         /* print to UART */
-        Display_printf(hDisplaySerial, 0, 0, "Advertiser Mode: %s", advMode);
+        UartLog_printf("Advertiser Mode: %s", advMode);
+    }
+
+    /* print the radio receive statistics since boot to UART */
+    printRxStats();
+
+    /* print the summary of the readings of each node to UART */
+    for (nodePointer = knownSensorNodes; nodePointer < &knownSensorNodes[NODEREGISTRY_MAX_NODES]; nodePointer++)
+    {
+        if (nodePointer->address != 0)
+        {
+            printNodeStats(nodePointer, false);
+        }
+    }
+
+    /* print the task CPU load and stack use, of the concentrator and then of
+     * the nodes that have reported it, to UART */
+    UartLog_printf("");
+    TaskMonitor_print(printMonitorLine);
+    for (nodePointer = knownSensorNodes; nodePointer < &knownSensorNodes[NODEREGISTRY_MAX_NODES]; nodePointer++)
+    {
+        if (nodePointer->address != 0)
+        {
+            printNodeTaskStats(nodePointer);
+        }
     }
 }
 
@@ -356,7 +676,7 @@ void buttonCallback(PIN_Handle handle, PIN_Id pinId)
         // Toggle between beaconing for nodes or concentrator
         if (advertiser.type == Concentrator_AdvertiserNone) {
             advertiser.type = Concentrator_AdvertiserUrl;
-            advertiser.sourceAddress = latestActiveAdcSensorNode.address;
+            advertiser.sourceAddress = knownSensorNodes[latestSensorSlot].address;
         } else {
             advertiser.type = Concentrator_AdvertiserNone;
             advertiser.sourceAddress = CONCENTRATOR_ADVERTISE_INVALID;
@@ -364,11 +684,11 @@ void buttonCallback(PIN_Handle handle, PIN_Id pinId)
 
         //trigger LCD update
         ConcentratorRadioTask_setAdvertiser(advertiser);
-        Event_post(concentratorEventHandle, CONCENTRATOR_EVENT_UPDATE_LCD);
+        requestRender(CONCENTRATOR_RENDER_EVENT_UPDATE);
     }
     else if (PIN_getInputValue(Board_PIN_BUTTON1) == 0)
     {
-        //trigger LCD update
-        Event_post(concentratorEventHandle, CONCENTRATOR_EVENT_UPDATE_LCD);
+        //dump the trace and node statistics and trigger LCD update
+        requestRender(CONCENTRATOR_RENDER_EVENT_DUMP | CONCENTRATOR_RENDER_EVENT_UPDATE);
     }
 }
@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2015-2016, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/***** Includes *****/
+#include "HistoryConsole.h"
+
+#include <xdc/std.h>
+
+#include <stdlib.h>
+
+#include <ti/sysbios/BIOS.h>
+#include <ti/sysbios/knl/Task.h>
+
+#include "DmConcentratorRadioTask.h"
+#include "NodeHistory.h"
+#include "UartLog.h"
+
+/***** Defines *****/
+#define HISTORYCONSOLE_TASK_STACK_SIZE 1024
+/* Below the radio and concentrator tasks, a bulk download only runs when
+ * they are idle */
+#define HISTORYCONSOLE_TASK_PRIORITY   1
+#define HISTORYCONSOLE_LINE_LENGTH     40
+
+/***** Variable declarations *****/
+static Task_Params consoleTaskParams;
+Task_Struct consoleTask;    /* not static so you can see in ROV */
+static uint8_t consoleTaskStack[HISTORYCONSOLE_TASK_STACK_SIZE];
+static char line[HISTORYCONSOLE_LINE_LENGTH];
+
+/***** Prototypes *****/
+static void consoleTaskFunction(UArg arg0, UArg arg1);
+static void handleHistory(char* args);
+static void handleTime(void);
+static void printReading(uint16_t address, uint32_t timeS, int16_t temp, int16_t internalTemp);
+
+/***** Function definitions *****/
+void HistoryConsole_init(void)
+{
+    Task_Params_init(&consoleTaskParams);
+    consoleTaskParams.stackSize = HISTORYCONSOLE_TASK_STACK_SIZE;
+    consoleTaskParams.priority = HISTORYCONSOLE_TASK_PRIORITY;
+    consoleTaskParams.stack = &consoleTaskStack;
+    Task_construct(&consoleTask, consoleTaskFunction, &consoleTaskParams, NULL);
+}
+
+static void consoleTaskFunction(UArg arg0, UArg arg1)
+{
+    int length;
+
+    while (1)
+    {
+        /* Returns at newline, with the line echoed */
+        length = UartLog_readLine(line, sizeof(line) - 1);
+        if (length <= 0)
+        {
+            continue;
+        }
+        line[length] = '\0';
+
+        switch (line[0])
+        {
+        case 'h':
+            handleHistory(&line[1]);
+            break;
+        case 't':
+            handleTime();
+            break;
+        case '\r':
+        case '\n':
+            break;
+        default:
+            UartLog_printf("# unknown command, use h <address|*> [<from s> [<to s>]] or t");
+            break;
+        }
+    }
+}
+
+static void handleHistory(char* args)
+{
+    uint16_t address;
+    uint32_t fromS = 0;
+    uint32_t toS = 0xFFFFFFFF;
+    uint32_t found;
+    char* end;
+
+    while (*args == ' ')
+    {
+        args++;
+    }
+
+    if (*args == '*')
+    {
+        address = NODEHISTORY_ALL_NODES;
+        end = args + 1;
+    }
+    else
+    {
+        address = strtoul(args, &end, 16);
+        if (end == args)
+        {
+            UartLog_printf("# missing address");
+            return;
+        }
+    }
+
+    args = end;
+    fromS = strtoul(args, &end, 10);
+    if (end != args)
+    {
+        args = end;
+        toS = strtoul(args, &end, 10);
+        if (end == args)
+        {
+            toS = 0xFFFFFFFF;
+        }
+    }
+
+    found = NodeHistory_query(address, fromS, toS, printReading);
+    UartLog_printfBulk("# %d readings", found);
+}
+
+static void handleTime(void)
+{
+    NodeHistory_Stats stats;
+
+    NodeHistory_getStats(&stats);
+    UartLog_printf("# time %d s, history blocks ram: %d flash: %d dropped: %d",
+            ConcentratorRadioTask_getNetworkTimeMs() / 1000, stats.ramBlocks, stats.flashBlocks,
+            stats.droppedBlocks);
+}
+
+/* A download is requested by the user and can be larger than the UartLog
+ * ring, so wait for room rather than losing readings */
+static void printReading(uint16_t address, uint32_t timeS, int16_t temp, int16_t internalTemp)
+{
+    UartLog_printfBulk("0x%04x %d %.2f %.2f", address, timeS,
+            FIXED2DOUBLE(temp), FIXED2DOUBLE(internalTemp));
+}
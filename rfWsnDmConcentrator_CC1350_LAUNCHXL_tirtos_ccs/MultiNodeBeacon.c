@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2015-2016, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/***** Includes *****/
+#include "MultiNodeBeacon.h"
+#include "crypto/PacketCrypto.h"
+
+/***** Defines *****/
+#define MULTINODEBEACON_FLAGS_LEN       3
+#define MULTINODEBEACON_HEADER_LEN      5   /* length, type, company ID, format */
+#define MULTINODEBEACON_RECORD_LEN      5
+#define MULTINODEBEACON_MAX_AGE         255
+
+#define MULTINODEBEACON_AD_TYPE_FLAGS   0x01
+#define MULTINODEBEACON_AD_TYPE_MANUFACTURER_DATA   0xFF
+
+/* LE General Discoverable, BR/EDR not supported */
+#define MULTINODEBEACON_FLAGS           0x06
+
+#if RADIO_SECURITY_ENABLED
+#define MULTINODEBEACON_TRAILER_LEN     PACKETCRYPTO_OVERHEAD
+#else
+#define MULTINODEBEACON_TRAILER_LEN     0
+#endif
+
+/***** Variable declarations *****/
+static uint8_t advData[MULTINODEBEACON_FLAGS_LEN + MULTINODEBEACON_HEADER_LEN +
+                       MULTINODEBEACON_MAX_RECORDS * MULTINODEBEACON_RECORD_LEN +
+                       MULTINODEBEACON_TRAILER_LEN];
+#if RADIO_SECURITY_ENABLED
+static uint32_t frameCounter; /* of the next sealed advertisement */
+#endif
+
+/***** Function definitions *****/
+void MultiNodeBeacon_init(void)
+{
+#if RADIO_SECURITY_ENABLED
+    frameCounter = PacketCrypto_randomCounter();
+#endif
+}
+
+void MultiNodeBeacon_build(SimpleBeacon_Frame* frame, uint8_t* deviceAddress,
+                           const struct MultiNodeBeacon_Record* records, uint8_t numRecords)
+{
+    uint8_t* pData = advData;
+    uint8_t* pLength;
+    uint8_t i;
+
+    if (numRecords > MULTINODEBEACON_MAX_RECORDS)
+    {
+        numRecords = MULTINODEBEACON_MAX_RECORDS;
+    }
+
+    *pData++ = 2;
+    *pData++ = MULTINODEBEACON_AD_TYPE_FLAGS;
+    *pData++ = MULTINODEBEACON_FLAGS;
+
+    pLength = pData++;
+    *pData++ = MULTINODEBEACON_AD_TYPE_MANUFACTURER_DATA;
+    *pData++ = (MULTINODEBEACON_COMPANY_ID & 0xFF);
+    *pData++ = (MULTINODEBEACON_COMPANY_ID & 0xFF00) >> 8;
+#if RADIO_SECURITY_ENABLED
+    *pData++ = MULTINODEBEACON_FORMAT_SEALED;
+#else
+    *pData++ = MULTINODEBEACON_FORMAT;
+#endif
+
+    for (i = 0; i < numRecords; i++)
+    {
+        uint32_t age = records[i].ageS / MULTINODEBEACON_AGE_UNIT_S;
+
+        *pData++ = (records[i].address & 0xFF00) >> 8;
+        *pData++ = (records[i].address & 0xFF);
+        *pData++ = (records[i].temp & 0xFF00) >> 8;
+        *pData++ = (records[i].temp & 0xFF);
+        *pData++ = (age > MULTINODEBEACON_MAX_AGE) ? MULTINODEBEACON_MAX_AGE : age;
+    }
+
+#if RADIO_SECURITY_ENABLED
+    {
+        /* Authenticate all records at once, they are not encrypted so that
+         * any observer can still read them */
+        uint8_t* pManufacturerData = pLength + 2;
+        uint8_t length = pData - pManufacturerData;
+
+        pData = pManufacturerData + PacketCrypto_seal(pManufacturerData, length, length, PACKETCRYPTO_SOURCE_BEACON,
+                                                      RADIO_CONCENTRATOR_ADDRESS, frameCounter++);
+    }
+#endif
+
+    /* The length counts the type and data bytes */
+    *pLength = pData - pLength - 1;
+
+    frame->deviceAddress = deviceAddress;
+    frame->length = pData - advData;
+    frame->pAdvData = advData;
+}
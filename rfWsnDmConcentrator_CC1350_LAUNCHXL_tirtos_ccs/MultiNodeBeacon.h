@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2015-2016, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MULTINODEBEACON_H_
+#define MULTINODEBEACON_H_
+
+#include "stdint.h"
+#include "seb/SimpleBeacon.h"
+#include "RadioProtocol.h"
+
+/* BLE advertisement with the latest reading of several nodes, so that a phone
+ * sees the whole cell from a few advertisements instead of one node per
+ * train. The advertising data is the flags and one manufacturer specific
+ * data structure:
+ *
+ *   company ID (2, little endian), format (1), records (5 each)
+ *
+ * where each record is the node address (2), its fixed 8.8 temperature (2),
+ * both big endian, and the age of the reading in units of
+ * MULTINODEBEACON_AGE_UNIT_S, saturating at 255.
+ *
+ * With RADIO_SECURITY_ENABLED the format is MULTINODEBEACON_FORMAT_SEALED and
+ * the records are followed by a frame counter and a MIC, as described in
+ * crypto/PacketCrypto.h, with RADIO_CONCENTRATOR_ADDRESS as the address. The
+ * company ID, format and records are the authenticated header, so a single
+ * MIC covers the readings of all nodes in the advertisement. */
+
+/* Texas Instruments Bluetooth company identifier */
+#define MULTINODEBEACON_COMPANY_ID      0x000D
+#define MULTINODEBEACON_FORMAT          0x01
+#define MULTINODEBEACON_FORMAT_SEALED   0x02
+
+#define MULTINODEBEACON_AGE_UNIT_S      8
+
+/* Records that fit in the 31 bytes of advertising data, with the frame
+ * counter and MIC if sealed */
+#if RADIO_SECURITY_ENABLED
+#define MULTINODEBEACON_MAX_RECORDS     3
+#else
+#define MULTINODEBEACON_MAX_RECORDS     4
+#endif
+
+struct MultiNodeBeacon_Record {
+    uint16_t address;
+    uint16_t temp;      /* fixed 8.8 */
+    uint32_t ageS;
+};
+
+/* Starts the frame counter of the sealed advertisements, after
+ * PacketCrypto_init */
+void MultiNodeBeacon_init(void);
+
+/* Builds the advertisement from numRecords records, at most
+ * MULTINODEBEACON_MAX_RECORDS, into frame. The advertising data is kept in
+ * this module until the next call. */
+void MultiNodeBeacon_build(SimpleBeacon_Frame* frame, uint8_t* deviceAddress,
+                           const struct MultiNodeBeacon_Record* records, uint8_t numRecords);
+
+#endif /* MULTINODEBEACON_H_ */
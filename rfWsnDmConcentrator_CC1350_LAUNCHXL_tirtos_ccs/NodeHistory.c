@@ -0,0 +1,531 @@
+/*
+ * Copyright (c) 2015-2016, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/***** Includes *****/
+#include "NodeHistory.h"
+
+#include <string.h>
+
+#include <xdc/std.h>
+
+#include <ti/sysbios/BIOS.h>
+#include <ti/sysbios/knl/Task.h>
+#include <ti/sysbios/knl/Semaphore.h>
+
+#include "NodeRegistry.h"
+#include "extflash/ExtFlash.h"
+
+/***** Defines *****/
+#define NODEHISTORY_HEADER_SIZE         12
+#define NODEHISTORY_DATA_SIZE           (NODEHISTORY_BLOCK_SIZE - NODEHISTORY_HEADER_SIZE)
+#define NODEHISTORY_NO_BLOCK            0xFF
+
+/* A reading is at most a 5 byte varint for the time and 3 for each value */
+#define NODEHISTORY_MAX_READING_SIZE    11
+
+#define NODEHISTORY_FLASH_BLOCKS        (NODEHISTORY_FLASH_SIZE / NODEHISTORY_BLOCK_SIZE)
+#define NODEHISTORY_BLOCKS_PER_SECTOR   (EXT_FLASH_PAGE_SIZE / NODEHISTORY_BLOCK_SIZE)
+
+/***** Type declarations *****/
+/* Written to the flash as is */
+struct HistoryBlock {
+    uint16_t address;
+    uint8_t count;              /* readings in data */
+    uint8_t used;               /* bytes of data used */
+    uint32_t serial;            /* increases with every block opened, 0 if free */
+    uint32_t firstTimeS;
+    uint8_t data[NODEHISTORY_DATA_SIZE];
+};
+
+typedef char NodeHistory_blockSizeCheck[(sizeof(struct HistoryBlock) == NODEHISTORY_BLOCK_SIZE) ? 1 : -1];
+
+/* Encoder state of the block a node is adding to */
+struct HistoryWriter {
+    uint8_t block;              /* NODEHISTORY_NO_BLOCK if none */
+    uint32_t prevTimeS;
+    int32_t prevDeltaS;
+    int16_t prevTemp;
+    int16_t prevInternalTemp;
+};
+
+/* Decoder state of a block */
+struct HistoryReader {
+    uint8_t pos;
+    uint32_t timeS;
+    int32_t deltaS;
+    int16_t temp;
+    int16_t internalTemp;
+};
+
+/***** Variable declarations *****/
+struct HistoryBlock historyBlocks[NODEHISTORY_NUM_BLOCKS]; /* not static so you can see in ROV */
+static struct HistoryWriter writers[NODEREGISTRY_MAX_NODES]; /* indexed by NodeRegistry slot */
+static uint32_t nextSerial = 1;
+static uint16_t numFreeBlocks = NODEHISTORY_NUM_BLOCKS;
+static uint32_t droppedBlocks = 0;
+static NodeHistory_EventCallback eventCallback;
+
+/* The log is NODEHISTORY_FLASH_BLOCKS long. Blocks are numbered in the order
+ * they were written since boot, block n is at n % NODEHISTORY_FLASH_BLOCKS and
+ * the last flashCount of the flashWritten blocks are still there. */
+static bool flashAvailable = false;
+static uint32_t flashWritten = 0;
+static uint32_t flashCount = 0;
+static Semaphore_Struct flashMutex;
+
+/***** Prototypes *****/
+static uint8_t allocBlock(void);
+static uint8_t oldestFullBlock(void);
+static bool isOpenBlock(uint8_t block);
+static uint8_t putVarint(uint8_t* buf, uint32_t value);
+static uint8_t getVarint(const uint8_t* buf, uint8_t pos, uint8_t used, uint32_t* value);
+static uint32_t zigzag(int32_t value);
+static int32_t unzigzag(uint32_t value);
+static bool decodeReading(const struct HistoryBlock* block, struct HistoryReader* reader);
+static uint32_t queryBlock(const struct HistoryBlock* block, uint16_t address, uint32_t fromS, uint32_t toS,
+                           NodeHistory_ReadingCallback callback);
+
+/***** Function definitions *****/
+void NodeHistory_init(void)
+{
+    uint16_t i;
+    Semaphore_Params semParams;
+
+    for (i = 0; i < NODEREGISTRY_MAX_NODES; i++)
+    {
+        writers[i].block = NODEHISTORY_NO_BLOCK;
+    }
+
+    Semaphore_Params_init(&semParams);
+    semParams.mode = Semaphore_Mode_BINARY;
+    Semaphore_construct(&flashMutex, 1, &semParams);
+
+    flashAvailable = ExtFlash_open();
+}
+
+void NodeHistory_registerEventCallback(NodeHistory_EventCallback callback)
+{
+    eventCallback = callback;
+}
+
+void NodeHistory_add(uint16_t slot, uint16_t address, uint32_t timeS,
+                     int16_t temp, int16_t internalTemp)
+{
+    struct HistoryWriter* writer = &writers[slot];
+    struct HistoryBlock* block;
+    uint8_t reading[NODEHISTORY_MAX_READING_SIZE];
+    uint8_t length;
+    int32_t deltaS;
+    bool spill;
+    UInt key = Task_disable();
+
+    /* Start a new block for a new node in the slot, or when this one is full */
+    block = (writer->block != NODEHISTORY_NO_BLOCK) ? &historyBlocks[writer->block] : NULL;
+    if ((block != NULL) && (block->address == address))
+    {
+        deltaS = (int32_t)(timeS - writer->prevTimeS);
+        length = putVarint(reading, zigzag(deltaS - writer->prevDeltaS));
+        length += putVarint(&reading[length], zigzag(temp - writer->prevTemp));
+        length += putVarint(&reading[length], zigzag(internalTemp - writer->prevInternalTemp));
+        if (block->used + length > NODEHISTORY_DATA_SIZE)
+        {
+            block = NULL;
+        }
+    }
+    else
+    {
+        block = NULL;
+    }
+
+    if (block == NULL)
+    {
+        writer->block = allocBlock();
+        block = &historyBlocks[writer->block];
+        block->address = address;
+        block->firstTimeS = timeS;
+        writer->prevTimeS = timeS;
+        writer->prevDeltaS = 0;
+        writer->prevTemp = 0;
+        writer->prevInternalTemp = 0;
+
+        deltaS = 0;
+        length = putVarint(reading, zigzag(0));
+        length += putVarint(&reading[length], zigzag(temp));
+        length += putVarint(&reading[length], zigzag(internalTemp));
+    }
+
+    memcpy(&block->data[block->used], reading, length);
+    block->used += length;
+    block->count++;
+
+    writer->prevTimeS = timeS;
+    writer->prevDeltaS = deltaS;
+    writer->prevTemp = temp;
+    writer->prevInternalTemp = internalTemp;
+
+    spill = flashAvailable && (numFreeBlocks < NODEHISTORY_MIN_FREE_BLOCKS);
+
+    Task_restore(key);
+
+    if (spill && eventCallback)
+    {
+        eventCallback();
+    }
+}
+
+void NodeHistory_spill(void)
+{
+    struct HistoryBlock copy;
+    uint32_t offset;
+    uint8_t index;
+    UInt key;
+
+    if (!flashAvailable)
+    {
+        return;
+    }
+
+    Semaphore_pend(Semaphore_handle(&flashMutex), BIOS_WAIT_FOREVER);
+
+    while (1)
+    {
+        key = Task_disable();
+        index = (numFreeBlocks < NODEHISTORY_MIN_FREE_BLOCKS) ? oldestFullBlock() : NODEHISTORY_NO_BLOCK;
+        if (index != NODEHISTORY_NO_BLOCK)
+        {
+            copy = historyBlocks[index];
+        }
+        Task_restore(key);
+
+        if (index == NODEHISTORY_NO_BLOCK)
+        {
+            break;
+        }
+
+        /* Erase a sector when entering it, losing the oldest blocks */
+        offset = NODEHISTORY_FLASH_OFFSET + (flashWritten % NODEHISTORY_FLASH_BLOCKS) * NODEHISTORY_BLOCK_SIZE;
+        if ((flashWritten % NODEHISTORY_BLOCKS_PER_SECTOR) == 0)
+        {
+            if (flashCount > NODEHISTORY_FLASH_BLOCKS - NODEHISTORY_BLOCKS_PER_SECTOR)
+            {
+                flashCount = NODEHISTORY_FLASH_BLOCKS - NODEHISTORY_BLOCKS_PER_SECTOR;
+            }
+            ExtFlash_erase(offset, EXT_FLASH_PAGE_SIZE);
+        }
+        ExtFlash_write(offset, NODEHISTORY_BLOCK_SIZE, (uint8_t*)&copy);
+        flashWritten++;
+        flashCount++;
+
+        /* Free the block, unless it was dropped and reused meanwhile */
+        key = Task_disable();
+        if (historyBlocks[index].serial == copy.serial)
+        {
+            historyBlocks[index].serial = 0;
+            numFreeBlocks++;
+        }
+        Task_restore(key);
+    }
+
+    Semaphore_post(Semaphore_handle(&flashMutex));
+}
+
+uint32_t NodeHistory_query(uint16_t address, uint32_t fromS, uint32_t toS,
+                           NodeHistory_ReadingCallback callback)
+{
+    struct HistoryBlock copy;
+    uint32_t found = 0;
+    uint32_t next;              /* next block of the log to read */
+    uint32_t lastSerial = 0;    /* newest block read from RAM */
+    bool inRam = false;
+    bool haveBlock;
+    uint8_t index;
+    uint8_t i;
+    UInt key;
+
+    Semaphore_pend(Semaphore_handle(&flashMutex), BIOS_WAIT_FOREVER);
+    next = flashWritten - flashCount;
+    Semaphore_post(Semaphore_handle(&flashMutex));
+
+    /* The lock is only held to copy one block, the callback can take long
+     * when it waits for the UART and the concentrator task must be able to
+     * spill meanwhile. The log is read first, including the blocks spilled
+     * while reading it, then the blocks in RAM in the order they were opened.
+     * A block spilled once the RAM is being read was already read there,
+     * unless it is newer than the last one read. */
+    while (1)
+    {
+        Semaphore_pend(Semaphore_handle(&flashMutex), BIOS_WAIT_FOREVER);
+
+        haveBlock = false;
+        if ((int32_t)(next - (flashWritten - flashCount)) < 0)
+        {
+            /* Overwritten while the callback ran */
+            next = flashWritten - flashCount;
+        }
+        while (!haveBlock && (next != flashWritten))
+        {
+            uint32_t offset = NODEHISTORY_FLASH_OFFSET + (next % NODEHISTORY_FLASH_BLOCKS) * NODEHISTORY_BLOCK_SIZE;
+
+            haveBlock = ExtFlash_read(offset, NODEHISTORY_BLOCK_SIZE, (uint8_t*)&copy) &&
+                        (!inRam || (copy.serial > lastSerial));
+            next++;
+        }
+
+        if (!haveBlock)
+        {
+            /* Copied, as the radio task keeps adding to them */
+            inRam = true;
+            key = Task_disable();
+            index = NODEHISTORY_NO_BLOCK;
+            for (i = 0; i < NODEHISTORY_NUM_BLOCKS; i++)
+            {
+                if ((historyBlocks[i].serial > lastSerial) &&
+                    ((index == NODEHISTORY_NO_BLOCK) || (historyBlocks[i].serial < historyBlocks[index].serial)))
+                {
+                    index = i;
+                }
+            }
+            if (index != NODEHISTORY_NO_BLOCK)
+            {
+                copy = historyBlocks[index];
+                lastSerial = copy.serial;
+                haveBlock = true;
+            }
+            Task_restore(key);
+        }
+
+        Semaphore_post(Semaphore_handle(&flashMutex));
+
+        if (!haveBlock)
+        {
+            break;
+        }
+
+        found += queryBlock(&copy, address, fromS, toS, callback);
+    }
+
+    return found;
+}
+
+void NodeHistory_getStats(NodeHistory_Stats* stats)
+{
+    UInt key = Task_disable();
+
+    stats->ramBlocks = NODEHISTORY_NUM_BLOCKS - numFreeBlocks;
+    stats->flashBlocks = flashCount;
+    stats->droppedBlocks = droppedBlocks;
+
+    Task_restore(key);
+}
+
+bool NodeHistory_lockFlash(void)
+{
+    if (!flashAvailable)
+    {
+        return false;
+    }
+
+    Semaphore_pend(Semaphore_handle(&flashMutex), BIOS_WAIT_FOREVER);
+    return true;
+}
+
+void NodeHistory_unlockFlash(void)
+{
+    Semaphore_post(Semaphore_handle(&flashMutex));
+}
+
+/* Takes a free block, or drops the oldest full one if there is none. Called
+ * with tasks disabled. */
+static uint8_t allocBlock(void)
+{
+    uint8_t index = NODEHISTORY_NO_BLOCK;
+    uint8_t i;
+
+    for (i = 0; i < NODEHISTORY_NUM_BLOCKS; i++)
+    {
+        if (historyBlocks[i].serial == 0)
+        {
+            index = i;
+            numFreeBlocks--;
+            break;
+        }
+    }
+
+    /* There are more blocks than nodes, so one is always full */
+    if (index == NODEHISTORY_NO_BLOCK)
+    {
+        index = oldestFullBlock();
+        droppedBlocks++;
+    }
+
+    historyBlocks[index].serial = nextSerial++;
+    historyBlocks[index].count = 0;
+    historyBlocks[index].used = 0;
+
+    return index;
+}
+
+/* Full block opened first, NODEHISTORY_NO_BLOCK if none. Called with tasks
+ * disabled. */
+static uint8_t oldestFullBlock(void)
+{
+    uint8_t index = NODEHISTORY_NO_BLOCK;
+    uint8_t i;
+
+    for (i = 0; i < NODEHISTORY_NUM_BLOCKS; i++)
+    {
+        if ((historyBlocks[i].serial != 0) && !isOpenBlock(i) &&
+            ((index == NODEHISTORY_NO_BLOCK) || (historyBlocks[i].serial < historyBlocks[index].serial)))
+        {
+            index = i;
+        }
+    }
+
+    return index;
+}
+
+static bool isOpenBlock(uint8_t block)
+{
+    uint16_t i;
+
+    for (i = 0; i < NODEREGISTRY_MAX_NODES; i++)
+    {
+        if (writers[i].block == block)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* LEB128, 7 bits per byte with the top bit set on all but the last */
+static uint8_t putVarint(uint8_t* buf, uint32_t value)
+{
+    uint8_t length = 0;
+
+    while (value >= 0x80)
+    {
+        buf[length++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    buf[length++] = value;
+
+    return length;
+}
+
+/* Returns the position after the varint at pos, or 0 if it runs past used */
+static uint8_t getVarint(const uint8_t* buf, uint8_t pos, uint8_t used, uint32_t* value)
+{
+    uint8_t shift = 0;
+
+    *value = 0;
+    while (pos < used)
+    {
+        *value |= (uint32_t)(buf[pos] & 0x7F) << shift;
+        if ((buf[pos++] & 0x80) == 0)
+        {
+            return pos;
+        }
+        shift += 7;
+    }
+
+    return 0;
+}
+
+/* Maps small negative and positive values to small unsigned ones */
+static uint32_t zigzag(int32_t value)
+{
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t unzigzag(uint32_t value)
+{
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+/* Decodes the next reading of block into reader, which starts zeroed with
+ * the time at firstTimeS */
+static bool decodeReading(const struct HistoryBlock* block, struct HistoryReader* reader)
+{
+    uint32_t value;
+    uint8_t pos = reader->pos;
+
+    if (((pos = getVarint(block->data, pos, block->used, &value)) == 0))
+    {
+        return false;
+    }
+    reader->deltaS += unzigzag(value);
+    reader->timeS += reader->deltaS;
+
+    if (((pos = getVarint(block->data, pos, block->used, &value)) == 0))
+    {
+        return false;
+    }
+    reader->temp += unzigzag(value);
+
+    if (((pos = getVarint(block->data, pos, block->used, &value)) == 0))
+    {
+        return false;
+    }
+    reader->internalTemp += unzigzag(value);
+
+    reader->pos = pos;
+    return true;
+}
+
+static uint32_t queryBlock(const struct HistoryBlock* block, uint16_t address, uint32_t fromS, uint32_t toS,
+                           NodeHistory_ReadingCallback callback)
+{
+    struct HistoryReader reader;
+    uint32_t found = 0;
+    uint8_t i;
+
+    if ((address != NODEHISTORY_ALL_NODES) && (block->address != address))
+    {
+        return 0;
+    }
+
+    memset(&reader, 0, sizeof(reader));
+    reader.timeS = block->firstTimeS;
+
+    for (i = 0; (i < block->count) && decodeReading(block, &reader); i++)
+    {
+        if ((reader.timeS >= fromS) && (reader.timeS <= toS))
+        {
+            callback(block->address, reader.timeS, reader.temp, reader.internalTemp);
+            found++;
+        }
+    }
+
+    return found;
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2015-2016, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef NODEHISTORY_H_
+#define NODEHISTORY_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+
+/* History of the readings of the nodes. Readings are appended to per-node
+ * blocks of NODEHISTORY_BLOCK_SIZE bytes, compressed as zigzag varints of the
+ * delta-of-delta of the time and the deltas of the values, so a node reporting
+ * at a fixed interval with a slowly changing temperature needs about three
+ * bytes per reading. Full blocks stay in RAM until the pool runs low, and are
+ * then spilled to a circular log in the external flash. */
+
+/* Blocks in RAM, of which NODEHISTORY_MIN_FREE_BLOCKS are kept free by
+ * spilling, so readings are not dropped while a spill is pending */
+#ifndef NODEHISTORY_NUM_BLOCKS
+#define NODEHISTORY_NUM_BLOCKS          16
+#endif
+#define NODEHISTORY_MIN_FREE_BLOCKS     4
+#define NODEHISTORY_BLOCK_SIZE          64
+
+/* Area of the external flash used for the log, whole sectors */
+#ifndef NODEHISTORY_FLASH_OFFSET
+#define NODEHISTORY_FLASH_OFFSET        0x00000
+#endif
+#ifndef NODEHISTORY_FLASH_SIZE
+#define NODEHISTORY_FLASH_SIZE          0x40000
+#endif
+
+/* Address to query the readings of all nodes */
+#define NODEHISTORY_ALL_NODES           0xFFFF
+
+typedef struct {
+    uint16_t ramBlocks;         /* in use, including the ones being written */
+    uint32_t flashBlocks;       /* spilled since boot and not yet overwritten */
+    uint32_t droppedBlocks;     /* lost as RAM was full and not spilled in time */
+} NodeHistory_Stats;
+
+/* Called when full blocks should be spilled with NodeHistory_spill, from the
+ * context adding the reading, so it must not block */
+typedef void (*NodeHistory_EventCallback)(void);
+
+/* Called for each reading found by NodeHistory_query, temperatures in fixed 8.8 */
+typedef void (*NodeHistory_ReadingCallback)(uint16_t address, uint32_t timeS,
+                                            int16_t temp, int16_t internalTemp);
+
+/* Opens the external flash, the log starts empty at every boot */
+void NodeHistory_init(void);
+
+/* Register a callback for when blocks should be spilled */
+void NodeHistory_registerEventCallback(NodeHistory_EventCallback callback);
+
+/* Add a reading of the node with address, in registry slot, at network time
+ * timeS. Does not block. */
+void NodeHistory_add(uint16_t slot, uint16_t address, uint32_t timeS,
+                     int16_t temp, int16_t internalTemp);
+
+/* Writes full blocks to the external flash until NODEHISTORY_MIN_FREE_BLOCKS
+ * are free. Blocks on the flash, call from a task. */
+void NodeHistory_spill(void);
+
+/* Calls callback, oldest first, for the readings of the node with address, or
+ * of all nodes for NODEHISTORY_ALL_NODES, from fromS to toS inclusive. Blocks
+ * on the flash, call from a task. The flash lock is not held while callback
+ * runs, so it may block. Returns the number of readings found. */
+uint32_t NodeHistory_query(uint16_t address, uint32_t fromS, uint32_t toS,
+                           NodeHistory_ReadingCallback callback);
+
+void NodeHistory_getStats(NodeHistory_Stats* stats);
+
+/* The external flash opened by NodeHistory_init is shared with the other
+ * modules through this lock, held around each access. Returns false without
+ * taking the lock if there is no flash. Blocks, call from a task. */
+bool NodeHistory_lockFlash(void);
+void NodeHistory_unlockFlash(void);
+
+#endif /* NODEHISTORY_H_ */
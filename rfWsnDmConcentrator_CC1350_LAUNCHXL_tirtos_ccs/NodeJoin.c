@@ -0,0 +1,421 @@
+/*
+ * Copyright (c) 2015-2016, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/***** Includes *****/
+#include "NodeJoin.h"
+#include "NodeHistory.h"
+
+#include <xdc/std.h>
+#include <ti/sysbios/knl/Task.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "extflash/ExtFlash.h"
+
+/***** Defines *****/
+#define NODEJOIN_ENTRY_SIZE             16
+
+/* Marks a written entry, an erased one reads 0xFFFF. It is written after the
+ * rest of the entry, so an entry cut short by a power loss has none. */
+#define NODEJOIN_ENTRY_MAGIC            0x4A4E
+
+/* Frame counter of an entry from a node that never joined with one */
+#define NODEJOIN_NO_FRAME_COUNTER       0xFFFFFFFF
+
+/* The log alternates between two sectors. Each starts with a header entry
+ * carrying a generation number in place of the address, and the sector with
+ * the latest one holds the table. A node's entry is appended again each time
+ * its join frame counter changes, and the last one counts. */
+#define NODEJOIN_HEADER_MAGIC           0x4A48
+#define NODEJOIN_SECTORS                2
+#define NODEJOIN_SECTOR_ENTRIES         (EXT_FLASH_PAGE_SIZE / NODEJOIN_ENTRY_SIZE - 1)
+#define NODEJOIN_NO_SECTOR              0xFF
+#define NODEJOIN_SECTOR_OFFSET(sector)  (NODEJOIN_FLASH_OFFSET + (sector) * EXT_FLASH_PAGE_SIZE)
+
+/* Keeps the compiler from moving the writes of a new entry past the update
+ * of numEntries that publishes it. The TI compiler does not move memory
+ * accesses across an asm statement. */
+#if defined(__TI_COMPILER_VERSION__)
+#define NODEJOIN_BARRIER()              __asm(" dmb")
+#else
+#define NODEJOIN_BARRIER()              __asm volatile ("" ::: "memory")
+#endif
+
+/***** Type declarations *****/
+/* An entry as it is kept in RAM and in the flash log */
+struct JoinEntry {
+    uint8_t ieeeAddr[RADIO_IEEE_ADDRESS_SIZE];
+    uint16_t address;
+    uint16_t magic;
+    uint8_t frameCounter[4]; /* of the latest join accepted, big endian */
+};
+
+typedef char NodeJoin_entrySizeCheck[(sizeof(struct JoinEntry) == NODEJOIN_ENTRY_SIZE) ? 1 : -1];
+typedef char NodeJoin_sectorSizeCheck[(NODEJOIN_MAX_NODES <= NODEJOIN_SECTOR_ENTRIES) ? 1 : -1];
+
+/***** Variable declarations *****/
+struct JoinEntry nodeJoinEntries[NODEJOIN_MAX_NODES]; /* not static so you can see it in the memory browser */
+static volatile uint16_t numEntries = 0;
+static volatile bool pending[NODEJOIN_MAX_NODES]; /* entry not in the log as it is */
+static struct JoinEntry logEntry; /* copy being written by NodeJoin_persist */
+static uint8_t activeSector = NODEJOIN_NO_SECTOR;
+static uint16_t generation = 0; /* of the header of activeSector */
+static uint16_t logLength = 0; /* entries after the header of activeSector */
+static bool logBroken = false; /* activeSector can not be appended to */
+static volatile bool loaded = false;
+static NodeJoin_EventCallback eventCallback = NULL;
+
+/***** Prototypes *****/
+static bool readHeader(uint8_t sector, uint16_t* headerGeneration);
+static bool readLog(uint32_t offset);
+static bool appendEntry(uint32_t offset, uint16_t index);
+static bool rewriteLog(void);
+#if RADIO_SECURITY_ENABLED
+static uint32_t getFrameCounter(const struct JoinEntry* entry);
+#endif
+static void setFrameCounter(struct JoinEntry* entry, uint32_t frameCounter);
+static bool isErased(const struct JoinEntry* entry);
+
+/***** Function definitions *****/
+void NodeJoin_init(void)
+{
+    uint16_t headerGeneration;
+    uint8_t sector;
+    bool complete;
+
+    if (NodeHistory_lockFlash())
+    {
+        for (sector = 0; sector < NODEJOIN_SECTORS; sector++)
+        {
+            if (readHeader(sector, &headerGeneration) &&
+                ((activeSector == NODEJOIN_NO_SECTOR) || ((int16_t)(headerGeneration - generation) > 0)))
+            {
+                activeSector = sector;
+                generation = headerGeneration;
+            }
+        }
+
+        if (activeSector != NODEJOIN_NO_SECTOR)
+        {
+            complete = readLog(NODEJOIN_SECTOR_OFFSET(activeSector) + NODEJOIN_ENTRY_SIZE);
+        }
+        else
+        {
+            /* A table from before the log had headers starts the first sector */
+            complete = readLog(NODEJOIN_SECTOR_OFFSET(0));
+            complete = complete && (numEntries == 0);
+        }
+
+        /* Anything else after the log can not be written over. The table
+         * goes to the other sector right away, and the sector it was read
+         * from is only erased by the next rewrite, once this one is done. */
+        logBroken = !complete && !rewriteLog();
+        NodeHistory_unlockFlash();
+    }
+
+    loaded = true;
+
+    if (logBroken && eventCallback)
+    {
+        eventCallback();
+    }
+}
+
+void NodeJoin_registerEventCallback(NodeJoin_EventCallback callback)
+{
+    eventCallback = callback;
+}
+
+uint16_t NodeJoin_join(const uint8_t* ieeeAddr, uint32_t frameCounter)
+{
+    struct JoinEntry* entry;
+    uint16_t i;
+
+    if (!loaded)
+    {
+        return NODEJOIN_NO_ADDRESS;
+    }
+
+    for (i = 0; i < numEntries; i++)
+    {
+        entry = &nodeJoinEntries[i];
+        if (memcmp(entry->ieeeAddr, ieeeAddr, RADIO_IEEE_ADDRESS_SIZE) == 0)
+        {
+#if RADIO_SECURITY_ENABLED
+            /* A join request replayed from before the last one */
+            if ((getFrameCounter(entry) != NODEJOIN_NO_FRAME_COUNTER) &&
+                (frameCounter <= getFrameCounter(entry)))
+            {
+                return NODEJOIN_NO_ADDRESS;
+            }
+
+            setFrameCounter(entry, frameCounter);
+            NODEJOIN_BARRIER();
+            pending[i] = true;
+            if (eventCallback)
+            {
+                eventCallback();
+            }
+#endif
+            return entry->address;
+        }
+    }
+
+    if (numEntries == NODEJOIN_MAX_NODES)
+    {
+        return NODEJOIN_NO_ADDRESS;
+    }
+
+    /* Addresses follow the entries, so they start at 1 and are unique */
+    entry = &nodeJoinEntries[numEntries];
+    memcpy(entry->ieeeAddr, ieeeAddr, RADIO_IEEE_ADDRESS_SIZE);
+    entry->address = numEntries + 1;
+    entry->magic = NODEJOIN_ENTRY_MAGIC;
+#if RADIO_SECURITY_ENABLED
+    setFrameCounter(entry, frameCounter);
+#else
+    setFrameCounter(entry, NODEJOIN_NO_FRAME_COUNTER);
+#endif
+    pending[numEntries] = true;
+
+    /* Only count the entry once it is complete, for NodeJoin_persist */
+    NODEJOIN_BARRIER();
+    numEntries++;
+
+    if (eventCallback)
+    {
+        eventCallback();
+    }
+
+    return entry->address;
+}
+
+bool NodeJoin_isPersisted(uint16_t address)
+{
+    return (address >= 1) && (address <= numEntries) && !pending[address - 1];
+}
+
+void NodeJoin_persist(void)
+{
+    uint16_t end = numEntries;
+    uint16_t i;
+
+    if (!NodeHistory_lockFlash())
+    {
+        return;
+    }
+
+    /* Append the changed entries to the log, or rewrite it if there is none
+     * yet or it is full. An append that fails may have left a partial entry,
+     * so the log is rewritten then too. If that fails as well, this is tried
+     * again on the next join. */
+    for (i = 0; (i < end) && !logBroken; i++)
+    {
+        if (!pending[i])
+        {
+            continue;
+        }
+
+        if ((activeSector == NODEJOIN_NO_SECTOR) || (logLength == NODEJOIN_SECTOR_ENTRIES) ||
+            !appendEntry(NODEJOIN_SECTOR_OFFSET(activeSector) + (logLength + 1) * NODEJOIN_ENTRY_SIZE, i))
+        {
+            logBroken = true;
+        }
+        else
+        {
+            logLength++;
+        }
+    }
+    if (logBroken)
+    {
+        logBroken = !rewriteLog();
+    }
+    NodeHistory_unlockFlash();
+}
+
+/* Whether the sector starts with a header, and its generation. Called with
+ * the flash locked. */
+static bool readHeader(uint8_t sector, uint16_t* headerGeneration)
+{
+    struct JoinEntry header;
+
+    if (!ExtFlash_read(NODEJOIN_SECTOR_OFFSET(sector), NODEJOIN_ENTRY_SIZE, (uint8_t*)&header) ||
+        (header.magic != NODEJOIN_HEADER_MAGIC))
+    {
+        return false;
+    }
+
+    *headerGeneration = header.address;
+    return true;
+}
+
+/* Reads the log from offset on into the table, a later entry of a node
+ * replacing its earlier one. Returns false if the log is followed by
+ * something other than erased flash, or could not be read. Called with the
+ * flash locked. */
+static bool readLog(uint32_t offset)
+{
+    struct JoinEntry entry;
+    uint16_t i;
+
+    for (logLength = 0; logLength < NODEJOIN_SECTOR_ENTRIES; logLength++)
+    {
+        if (!ExtFlash_read(offset + logLength * NODEJOIN_ENTRY_SIZE, NODEJOIN_ENTRY_SIZE, (uint8_t*)&entry))
+        {
+            return false;
+        }
+        if (entry.magic != NODEJOIN_ENTRY_MAGIC)
+        {
+            return isErased(&entry);
+        }
+
+        for (i = 0; i < numEntries; i++)
+        {
+            if (memcmp(nodeJoinEntries[i].ieeeAddr, entry.ieeeAddr, RADIO_IEEE_ADDRESS_SIZE) == 0)
+            {
+                break;
+            }
+        }
+        if (i < NODEJOIN_MAX_NODES)
+        {
+            nodeJoinEntries[i] = entry;
+            if (i == numEntries)
+            {
+                numEntries++;
+            }
+        }
+    }
+
+    return true;
+}
+
+/* Writes the table entry at offset, the magic last. Clears its pending flag,
+ * and sets it again if the write fails. Called with the flash locked. */
+static bool appendEntry(uint32_t offset, uint16_t index)
+{
+    UInt key;
+
+    /* NodeJoin_join may change the entry meanwhile, which sets the flag
+     * again */
+    key = Task_disable();
+    logEntry = nodeJoinEntries[index];
+    pending[index] = false;
+    Task_restore(key);
+
+    logEntry.magic = 0xFFFF;
+    if (ExtFlash_write(offset, NODEJOIN_ENTRY_SIZE, (uint8_t*)&logEntry))
+    {
+        logEntry.magic = NODEJOIN_ENTRY_MAGIC;
+        if (ExtFlash_write(offset + offsetof(struct JoinEntry, magic), sizeof(logEntry.magic),
+                           (uint8_t*)&logEntry.magic))
+        {
+            return true;
+        }
+    }
+
+    pending[index] = true;
+    return false;
+}
+
+/* Writes the whole table to the sector not holding the log, and the header
+ * last, so the new log only takes over once it is complete. Without a log
+ * the second sector is used, as the first may hold a table from before the
+ * headers. Called with the flash locked. */
+static bool rewriteLog(void)
+{
+    uint8_t sector = (activeSector == NODEJOIN_NO_SECTOR) ? 1 : (activeSector + 1) % NODEJOIN_SECTORS;
+    uint16_t end = numEntries;
+    struct JoinEntry header;
+    uint16_t i;
+
+    memset(&header, 0xFF, sizeof(header));
+    header.address = generation + 1;
+    header.magic = NODEJOIN_HEADER_MAGIC;
+
+    if (!ExtFlash_erase(NODEJOIN_SECTOR_OFFSET(sector), EXT_FLASH_PAGE_SIZE))
+    {
+        return false;
+    }
+    for (i = 0; i < end; i++)
+    {
+        if (!appendEntry(NODEJOIN_SECTOR_OFFSET(sector) + (i + 1) * NODEJOIN_ENTRY_SIZE, i))
+        {
+            break;
+        }
+    }
+    if ((i < end) ||
+        !ExtFlash_write(NODEJOIN_SECTOR_OFFSET(sector), NODEJOIN_ENTRY_SIZE, (uint8_t*)&header))
+    {
+        /* The old log still holds what was written to the new one */
+        while (i > 0)
+        {
+            pending[--i] = true;
+        }
+        return false;
+    }
+
+    activeSector = sector;
+    generation = header.address;
+    logLength = end;
+    return true;
+}
+
+#if RADIO_SECURITY_ENABLED
+static uint32_t getFrameCounter(const struct JoinEntry* entry)
+{
+    return ((uint32_t)entry->frameCounter[0] << 24) | (entry->frameCounter[1] << 16) |
+           (entry->frameCounter[2] << 8) | entry->frameCounter[3];
+}
+#endif
+
+static void setFrameCounter(struct JoinEntry* entry, uint32_t frameCounter)
+{
+    entry->frameCounter[0] = (frameCounter & 0xFF000000) >> 24;
+    entry->frameCounter[1] = (frameCounter & 0x00FF0000) >> 16;
+    entry->frameCounter[2] = (frameCounter & 0xFF00) >> 8;
+    entry->frameCounter[3] = (frameCounter & 0xFF);
+}
+
+static bool isErased(const struct JoinEntry* entry)
+{
+    const uint8_t* bytes = (const uint8_t*)entry;
+    uint8_t i;
+
+    for (i = 0; i < NODEJOIN_ENTRY_SIZE; i++)
+    {
+        if (bytes[i] != 0xFF)
+        {
+            return false;
+        }
+    }
+    return true;
+}
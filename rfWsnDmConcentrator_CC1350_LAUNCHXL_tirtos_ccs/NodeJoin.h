@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2015-2016, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef NODEJOIN_H_
+#define NODEJOIN_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+#include "RadioProtocol.h"
+
+/* Short addresses assigned to the nodes that have joined, by IEEE address.
+ * Addresses are handed out in order from 1 and never reused, so two nodes
+ * can not get the same one. The table is appended to a log in the external
+ * flash, from which it is read back at boot, so a node that joins again
+ * after a reboot of either side gets its old address. When the log can not
+ * be appended to, the whole table is written to a second sector before the
+ * first is erased.
+ *
+ * With RADIO_SECURITY_ENABLED the table also keeps the frame counter of the
+ * latest join request of each node, and only accepts a later one. The
+ * concentrator forgets the frame counters of the other packets on a reboot
+ * or when a node drops out of the registry, and only accepts them again
+ * after a join whose frame counter is persisted, so none is replayed.
+ *
+ * The table is only changed by NodeJoin_join, and only read meanwhile by
+ * NodeJoin_persist, which copies each entry with tasks disabled, so the two
+ * may run in different tasks without a lock. */
+
+/* Number of nodes that can join */
+#ifndef NODEJOIN_MAX_NODES
+#define NODEJOIN_MAX_NODES              32
+#endif
+
+/* First of the two sectors of the external flash holding the log, after the
+ * history log */
+#ifndef NODEJOIN_FLASH_OFFSET
+#define NODEJOIN_FLASH_OFFSET           0x40000
+#endif
+
+#define NODEJOIN_NO_ADDRESS             0xFFFF
+
+/* Called when new entries should be written with NodeJoin_persist, from the
+ * context of NodeJoin_join, so it must not block */
+typedef void (*NodeJoin_EventCallback)(void);
+
+/* Reads the table from the external flash opened by NodeHistory_init. Until
+ * then no node can join. Blocks on the flash, call from a task. */
+void NodeJoin_init(void);
+
+/* Register a callback for when entries should be persisted */
+void NodeJoin_registerEventCallback(NodeJoin_EventCallback callback);
+
+/* Returns the address of the node with ieeeAddr, assigning the next one if it
+ * has not joined before, or NODEJOIN_NO_ADDRESS if the table is full or not
+ * read yet. With RADIO_SECURITY_ENABLED also if frameCounter, of the join
+ * request, is not above the one of the node's previous join. Does not
+ * block. */
+uint16_t NodeJoin_join(const uint8_t* ieeeAddr, uint32_t frameCounter);
+
+/* Whether the latest join of the node with the address is in the external
+ * flash */
+bool NodeJoin_isPersisted(uint16_t address);
+
+/* Writes the entries added or changed since the last call to the external
+ * flash. Blocks on the flash, call from a task. */
+void NodeJoin_persist(void);
+
+#endif /* NODEJOIN_H_ */
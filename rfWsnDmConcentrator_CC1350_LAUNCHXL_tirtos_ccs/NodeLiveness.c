@@ -0,0 +1,282 @@
+/*
+ * Copyright (c) 2015-2016, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/***** Includes *****/
+#include "NodeLiveness.h"
+
+#include <xdc/std.h>
+#include <stdbool.h>
+
+#include <ti/sysbios/BIOS.h>
+#include <ti/sysbios/knl/Clock.h>
+#include <ti/sysbios/knl/Swi.h>
+
+/***** Defines *****/
+#define NODELIVENESS_WHEEL_MASK     (NODELIVENESS_WHEEL_SIZE - 1)
+#define NODELIVENESS_NO_TIMER       0xFFFF
+
+/***** Type declarations *****/
+struct NodeTimer {
+    uint16_t address;
+    uint8_t state;              /* NodeLiveness_State */
+    uint16_t next;              /* next timer in the same bucket */
+    uint16_t prev;
+    uint32_t deadline;          /* wheel tick of the next state change */
+    uint32_t lastHeard;         /* wheel tick of the latest packet */
+    uint16_t intervalS;         /* learnt or reported report interval */
+    bool intervalReported;      /* intervalS is from the node, do not learn */
+};
+
+/***** Variable declarations *****/
+Clock_Struct livenessClock;     /* not static so you can see in ROV */
+struct NodeTimer nodeTimers[NODEREGISTRY_MAX_NODES]; /* indexed by NodeRegistry slot */
+static uint16_t wheel[NODELIVENESS_WHEEL_SIZE];
+static uint32_t wheelTick = 0;
+static uint16_t nodesAlive = 0;
+static NodeLiveness_EventCallback eventCallback;
+
+/***** Prototypes *****/
+static void livenessClockCallback(UArg arg0);
+static void schedule(uint16_t slot, uint32_t deadline);
+static void unschedule(uint16_t slot);
+static void setState(uint16_t slot, NodeLiveness_State state);
+static uint32_t ticksAfter(uint16_t intervalS, uint16_t percent);
+
+/***** Function definitions *****/
+void NodeLiveness_init(void)
+{
+    uint16_t i;
+
+    for (i = 0; i < NODELIVENESS_WHEEL_SIZE; i++)
+    {
+        wheel[i] = NODELIVENESS_NO_TIMER;
+    }
+
+    Clock_Params clockParams;
+    Clock_Params_init(&clockParams);
+    clockParams.period = 1000000 / Clock_tickPeriod;
+    clockParams.startFlag = TRUE;
+    Clock_construct(&livenessClock, livenessClockCallback, 1000000 / Clock_tickPeriod, &clockParams);
+}
+
+void NodeLiveness_registerEventCallback(NodeLiveness_EventCallback callback)
+{
+    eventCallback = callback;
+}
+
+void NodeLiveness_heard(uint16_t slot, uint16_t address, uint16_t intervalS)
+{
+    struct NodeTimer* timer = &nodeTimers[slot];
+    UInt key = Swi_disable();
+
+    if ((timer->state == NodeLiveness_StateUnknown) || (timer->address != address))
+    {
+        /* New node, or a new node in the slot of an evicted one. Only a node
+         * that is not dead yet still has a timer in the wheel. */
+        if ((timer->state == NodeLiveness_StateAlive) || (timer->state == NodeLiveness_StateLate))
+        {
+            unschedule(slot);
+            nodesAlive--;
+        }
+        timer->address = address;
+        timer->state = NodeLiveness_StateUnknown;
+        timer->intervalS = NODELIVENESS_DEFAULT_INTERVAL_S;
+        timer->intervalReported = false;
+    }
+    else if (timer->intervalReported || (intervalS != 0))
+    {
+        if (timer->state != NodeLiveness_StateDead)
+        {
+            unschedule(slot);
+        }
+    }
+    else
+    {
+        /* Learn the report interval, as a moving average over the time
+         * between packets, ignoring gaps long enough to have been dead */
+        uint32_t gap = wheelTick - timer->lastHeard;
+        if (timer->state != NodeLiveness_StateDead)
+        {
+            if (gap < NODELIVENESS_MIN_INTERVAL_S)
+            {
+                gap = NODELIVENESS_MIN_INTERVAL_S;
+            }
+            timer->intervalS = (3 * timer->intervalS + gap) / 4;
+            if (timer->intervalS > NODELIVENESS_MAX_INTERVAL_S)
+            {
+                timer->intervalS = NODELIVENESS_MAX_INTERVAL_S;
+            }
+            unschedule(slot);
+        }
+    }
+
+    /* The node knows its cadence better than we can learn it */
+    if (intervalS != 0)
+    {
+        if (intervalS < NODELIVENESS_MIN_INTERVAL_S)
+        {
+            intervalS = NODELIVENESS_MIN_INTERVAL_S;
+        }
+        else if (intervalS > NODELIVENESS_MAX_INTERVAL_S)
+        {
+            intervalS = NODELIVENESS_MAX_INTERVAL_S;
+        }
+        timer->intervalS = intervalS;
+        timer->intervalReported = true;
+    }
+
+    timer->lastHeard = wheelTick;
+    schedule(slot, wheelTick + ticksAfter(timer->intervalS, NODELIVENESS_LATE_PERCENT));
+    setState(slot, NodeLiveness_StateAlive);
+
+    Swi_restore(key);
+}
+
+NodeLiveness_State NodeLiveness_getState(uint16_t slot, uint16_t address)
+{
+    NodeLiveness_State state = NodeLiveness_StateUnknown;
+    UInt key = Swi_disable();
+
+    if ((slot < NODEREGISTRY_MAX_NODES) && (nodeTimers[slot].address == address))
+    {
+        state = (NodeLiveness_State)nodeTimers[slot].state;
+    }
+
+    Swi_restore(key);
+
+    return state;
+}
+
+uint16_t NodeLiveness_countAlive(void)
+{
+    return nodesAlive;
+}
+
+/* Turns the wheel one second and expires the deadlines of the new bucket.
+ * Timers more than one turn ahead stay in the bucket until their turn. */
+static void livenessClockCallback(UArg arg0)
+{
+    uint16_t slot;
+    uint16_t next;
+
+    wheelTick++;
+
+    for (slot = wheel[wheelTick & NODELIVENESS_WHEEL_MASK]; slot != NODELIVENESS_NO_TIMER; slot = next)
+    {
+        struct NodeTimer* timer = &nodeTimers[slot];
+        next = timer->next;
+
+        if (timer->deadline != wheelTick)
+        {
+            continue;
+        }
+
+        unschedule(slot);
+        if (timer->state == NodeLiveness_StateAlive)
+        {
+            schedule(slot, timer->lastHeard + ticksAfter(timer->intervalS, NODELIVENESS_DEAD_PERCENT));
+            setState(slot, NodeLiveness_StateLate);
+        }
+        else
+        {
+            setState(slot, NodeLiveness_StateDead);
+        }
+    }
+}
+
+static void schedule(uint16_t slot, uint32_t deadline)
+{
+    uint16_t* bucket = &wheel[deadline & NODELIVENESS_WHEEL_MASK];
+
+    nodeTimers[slot].deadline = deadline;
+    nodeTimers[slot].prev = NODELIVENESS_NO_TIMER;
+    nodeTimers[slot].next = *bucket;
+    if (*bucket != NODELIVENESS_NO_TIMER)
+    {
+        nodeTimers[*bucket].prev = slot;
+    }
+    *bucket = slot;
+}
+
+static void unschedule(uint16_t slot)
+{
+    struct NodeTimer* timer = &nodeTimers[slot];
+
+    if (timer->prev != NODELIVENESS_NO_TIMER)
+    {
+        nodeTimers[timer->prev].next = timer->next;
+    }
+    else
+    {
+        wheel[timer->deadline & NODELIVENESS_WHEEL_MASK] = timer->next;
+    }
+
+    if (timer->next != NODELIVENESS_NO_TIMER)
+    {
+        nodeTimers[timer->next].prev = timer->prev;
+    }
+
+    timer->next = NODELIVENESS_NO_TIMER;
+    timer->prev = NODELIVENESS_NO_TIMER;
+}
+
+static void setState(uint16_t slot, NodeLiveness_State state)
+{
+    struct NodeTimer* timer = &nodeTimers[slot];
+
+    if (timer->state == state)
+    {
+        return;
+    }
+
+    if (state == NodeLiveness_StateDead)
+    {
+        nodesAlive--;
+    }
+    else if ((timer->state == NodeLiveness_StateUnknown) || (timer->state == NodeLiveness_StateDead))
+    {
+        nodesAlive++;
+    }
+    timer->state = state;
+
+    if (eventCallback)
+    {
+        eventCallback(timer->address, state);
+    }
+}
+
+/* Wheel ticks until percent of intervalS has passed, at least one */
+static uint32_t ticksAfter(uint16_t intervalS, uint16_t percent)
+{
+    uint32_t ticks = ((uint32_t)intervalS * percent) / 100;
+    return (ticks != 0) ? ticks : 1;
+}
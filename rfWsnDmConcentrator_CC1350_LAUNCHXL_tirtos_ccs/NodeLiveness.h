@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2015-2016, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef NODELIVENESS_H_
+#define NODELIVENESS_H_
+
+#include "stdint.h"
+#include "NodeRegistry.h"
+
+/* Liveness of the nodes in the NodeRegistry. Each slot has a deadline for the
+ * next report from its node, kept in a hashed timer wheel that a Clock turns
+ * once per second. A node that misses its deadline is first marked late and
+ * then dead. The expected report interval of a node is the one it reports in
+ * its packets, or learnt from the time between its packets if it reports
+ * none. */
+
+/* The wheel has 2^NODELIVENESS_WHEEL_BITS buckets of one second each */
+#ifndef NODELIVENESS_WHEEL_BITS
+#define NODELIVENESS_WHEEL_BITS         5
+#endif
+#define NODELIVENESS_WHEEL_SIZE         (1 << NODELIVENESS_WHEEL_BITS)
+
+/* Report interval assumed for a node until it has been heard twice, and the
+ * limits of the learnt or reported interval, in seconds */
+#define NODELIVENESS_DEFAULT_INTERVAL_S 10
+#define NODELIVENESS_MIN_INTERVAL_S     1
+#define NODELIVENESS_MAX_INTERVAL_S     3600
+
+/* A node is late, respectively dead, when it has not been heard for this
+ * percentage of its report interval */
+#define NODELIVENESS_LATE_PERCENT       150
+#define NODELIVENESS_DEAD_PERCENT       400
+
+typedef enum {
+    NodeLiveness_StateUnknown = 0,
+    NodeLiveness_StateAlive,
+    NodeLiveness_StateLate,
+    NodeLiveness_StateDead,
+} NodeLiveness_State;
+
+/* Called on every state change of a node, from Swi context when a deadline
+ * expires, so it must not block */
+typedef void (*NodeLiveness_EventCallback)(uint16_t address, NodeLiveness_State state);
+
+/* Starts the wheel clock */
+void NodeLiveness_init(void);
+
+/* Register a callback for the state changes of the nodes */
+void NodeLiveness_registerEventCallback(NodeLiveness_EventCallback callback);
+
+/* Note a packet from address, in registry slot. intervalS is the longest time
+ * until the next packet as reported by the node, or 0 if the packet does not
+ * carry one. Once a node has reported an interval, it is kept until the node
+ * reports another. */
+void NodeLiveness_heard(uint16_t slot, uint16_t address, uint16_t intervalS);
+
+/* State of the node with address, in registry slot, which may be
+ * NODEREGISTRY_NO_SLOT */
+NodeLiveness_State NodeLiveness_getState(uint16_t slot, uint16_t address);
+
+/* Number of nodes that are alive or late */
+uint16_t NodeLiveness_countAlive(void);
+
+#endif /* NODELIVENESS_H_ */
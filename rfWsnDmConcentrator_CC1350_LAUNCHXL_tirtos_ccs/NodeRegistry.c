@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2015-2016, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/***** Includes *****/
+#include "NodeRegistry.h"
+
+#include <xdc/std.h>
+
+#include <ti/sysbios/knl/Task.h>
+
+/***** Defines *****/
+#define NODEREGISTRY_INDEX_MASK     (NODEREGISTRY_INDEX_SIZE - 1)
+
+/* Hash index entries hold the slot + 1, 0 for an empty entry */
+#define NODEREGISTRY_INDEX_EMPTY    0
+
+/***** Variable declarations *****/
+uint16_t nodeRegistryAddresses[NODEREGISTRY_MAX_NODES]; /* not static so you can see it in the memory browser */
+static uint16_t nodeRegistryIndex[NODEREGISTRY_INDEX_SIZE];
+static uint16_t numberOfNodes = 0;
+
+/* Slots in order of use, a list from the most to the least recently heard */
+static uint16_t lruNext[NODEREGISTRY_MAX_NODES];
+static uint16_t lruPrev[NODEREGISTRY_MAX_NODES];
+static uint16_t mostRecentSlot = NODEREGISTRY_NO_SLOT;
+static uint16_t leastRecentSlot = NODEREGISTRY_NO_SLOT;
+
+/***** Prototypes *****/
+static uint16_t hash(uint16_t address);
+static uint16_t findIndexEntry(uint16_t address);
+static void removeIndexEntry(uint16_t entry);
+static void unlinkSlot(uint16_t slot);
+static void linkSlotFirst(uint16_t slot);
+
+/***** Function definitions *****/
+uint16_t NodeRegistry_find(uint16_t address)
+{
+    uint16_t slot = NODEREGISTRY_NO_SLOT;
+    uint16_t entry;
+    UInt key = Task_disable();
+
+    entry = findIndexEntry(address);
+    if (nodeRegistryIndex[entry] != NODEREGISTRY_INDEX_EMPTY)
+    {
+        slot = nodeRegistryIndex[entry] - 1;
+    }
+
+    Task_restore(key);
+
+    return slot;
+}
+
+uint16_t NodeRegistry_add(uint16_t address)
+{
+    uint16_t slot;
+    uint16_t entry;
+    UInt key = Task_disable();
+
+    entry = findIndexEntry(address);
+    if (nodeRegistryIndex[entry] != NODEREGISTRY_INDEX_EMPTY)
+    {
+        slot = nodeRegistryIndex[entry] - 1;
+        unlinkSlot(slot);
+    }
+    else
+    {
+        /* Take a free slot, or replace the least recently heard node */
+        if (numberOfNodes < NODEREGISTRY_MAX_NODES)
+        {
+            slot = numberOfNodes++;
+        }
+        else
+        {
+            slot = leastRecentSlot;
+            unlinkSlot(slot);
+            removeIndexEntry(findIndexEntry(nodeRegistryAddresses[slot]));
+
+            /* The removal may have moved the empty entry for address */
+            entry = findIndexEntry(address);
+        }
+
+        nodeRegistryAddresses[slot] = address;
+        nodeRegistryIndex[entry] = slot + 1;
+    }
+    linkSlotFirst(slot);
+
+    Task_restore(key);
+
+    return slot;
+}
+
+uint16_t NodeRegistry_count(void)
+{
+    return numberOfNodes;
+}
+
+/* Fibonacci hashing, spreads sequential addresses over the index */
+static uint16_t hash(uint16_t address)
+{
+    return (uint16_t)(address * 40503u) >> (16 - NODEREGISTRY_INDEX_BITS);
+}
+
+/* Returns the index entry holding address, or the empty entry ending its
+ * probe sequence */
+static uint16_t findIndexEntry(uint16_t address)
+{
+    uint16_t entry = hash(address);
+
+    while ((nodeRegistryIndex[entry] != NODEREGISTRY_INDEX_EMPTY) &&
+           (nodeRegistryAddresses[nodeRegistryIndex[entry] - 1] != address))
+    {
+        entry = (entry + 1) & NODEREGISTRY_INDEX_MASK;
+    }
+
+    return entry;
+}
+
+/* Removes an index entry with linear probing, moving later entries of the
+ * same probe sequence back so no lookup stops early at the new hole */
+static void removeIndexEntry(uint16_t entry)
+{
+    uint16_t next = entry;
+    uint16_t home;
+
+    while (1)
+    {
+        next = (next + 1) & NODEREGISTRY_INDEX_MASK;
+        if (nodeRegistryIndex[next] == NODEREGISTRY_INDEX_EMPTY)
+        {
+            break;
+        }
+
+        /* The entry at next can fill the hole unless its home lies cyclically
+         * in (entry, next] */
+        home = hash(nodeRegistryAddresses[nodeRegistryIndex[next] - 1]);
+        if (((next > entry) && ((home <= entry) || (home > next))) ||
+            ((next < entry) && ((home <= entry) && (home > next))))
+        {
+            nodeRegistryIndex[entry] = nodeRegistryIndex[next];
+            entry = next;
+        }
+    }
+
+    nodeRegistryIndex[entry] = NODEREGISTRY_INDEX_EMPTY;
+}
+
+static void unlinkSlot(uint16_t slot)
+{
+    if (lruPrev[slot] != NODEREGISTRY_NO_SLOT)
+    {
+        lruNext[lruPrev[slot]] = lruNext[slot];
+    }
+    else
+    {
+        mostRecentSlot = lruNext[slot];
+    }
+
+    if (lruNext[slot] != NODEREGISTRY_NO_SLOT)
+    {
+        lruPrev[lruNext[slot]] = lruPrev[slot];
+    }
+    else
+    {
+        leastRecentSlot = lruPrev[slot];
+    }
+}
+
+static void linkSlotFirst(uint16_t slot)
+{
+    lruPrev[slot] = NODEREGISTRY_NO_SLOT;
+    lruNext[slot] = mostRecentSlot;
+    if (mostRecentSlot != NODEREGISTRY_NO_SLOT)
+    {
+        lruPrev[mostRecentSlot] = slot;
+    }
+    else
+    {
+        leastRecentSlot = slot;
+    }
+    mostRecentSlot = slot;
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2015-2016, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef NODEREGISTRY_H_
+#define NODEREGISTRY_H_
+
+#include "stdint.h"
+
+/* Registry of the nodes heard by the concentrator. Each node gets a slot,
+ * which the tasks use as index into their own per node arrays, and the slot
+ * of a 16-bit node address is found through an open addressing hash index in
+ * constant time on average.
+ *
+ * The slots are kept in order of use. When all slots are taken the least
+ * recently heard node is replaced, so a task that finds another address in its
+ * array entry for a slot must start the entry over.
+ */
+
+/* Number of node slots */
+#ifndef NODEREGISTRY_MAX_NODES
+#define NODEREGISTRY_MAX_NODES      7
+#endif
+
+/* The hash index has 2^NODEREGISTRY_INDEX_BITS entries, at least twice the
+ * number of slots to keep the probe sequences short */
+#ifndef NODEREGISTRY_INDEX_BITS
+#define NODEREGISTRY_INDEX_BITS     4
+#endif
+#define NODEREGISTRY_INDEX_SIZE     (1 << NODEREGISTRY_INDEX_BITS)
+
+#define NODEREGISTRY_NO_SLOT        0xFFFF
+
+/* Returns the slot of address, or NODEREGISTRY_NO_SLOT if it is not known */
+uint16_t NodeRegistry_find(uint16_t address);
+
+/* Returns the slot of address, adding it in the slot of the least recently
+ * heard node if it is not known, and marks it as the most recently heard */
+uint16_t NodeRegistry_add(uint16_t address);
+
+/* Number of slots in use */
+uint16_t NodeRegistry_count(void);
+
+#endif /* NODEREGISTRY_H_ */
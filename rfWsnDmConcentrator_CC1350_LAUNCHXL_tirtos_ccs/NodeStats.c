@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2015-2016, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/***** Includes *****/
+#include "NodeStats.h"
+
+#include <string.h>
+
+#include <xdc/std.h>
+
+#include <ti/devices/DeviceFamily.h>
+#include DEVICE_FAMILY_PATH(driverlib/aon_rtc.h)
+
+/***** Prototypes *****/
+static void addToAggregate(NodeStats_Aggregate* aggregate, uint32_t n, int16_t value);
+
+/***** Function definitions *****/
+void NodeStats_reset(NodeStats* stats)
+{
+    memset(stats, 0, sizeof(NodeStats));
+}
+
+bool NodeStats_addReading(NodeStats* stats, uint8_t seqNumber, int16_t temp,
+                          int16_t internalTemp, int8_t rssi)
+{
+    /* The RTC rather than the Clock ticks, which wrap after about 12 hours
+     * and would give a wrong interval for a node silent that long */
+    uint64_t now = AONRTCCurrent64BitValueGet();
+    int16_t bucket;
+
+    if (stats->readings != 0)
+    {
+        uint8_t gap = seqNumber - stats->lastSeqNumber;
+        uint64_t elapsed = now - stats->lastRxRtc;
+        uint32_t intervalMs = UINT32_MAX;
+
+        if (gap == 0)
+        {
+            /* The node did not get our ack and sent the reading again */
+            if (stats->duplicates < UINT16_MAX)
+            {
+                stats->duplicates++;
+            }
+            return false;
+        }
+        if ((gap <= NODESTATS_MAX_SEQ_GAP) && (stats->lost <= UINT16_MAX - (gap - 1)))
+        {
+            stats->lost += gap - 1;
+        }
+
+        /* A running mean like the temperatures, of stats->readings intervals
+         * with this one, so it does not overflow however long the node lives.
+         * A gap too long for a uint32_t in ms is clamped. */
+        if ((elapsed >> 32) < (UINT32_MAX / 1000))
+        {
+            intervalMs = (uint32_t)((elapsed * 1000) >> 32);
+        }
+        stats->meanIntervalMs += ((float)intervalMs - stats->meanIntervalMs) / stats->readings;
+    }
+
+    stats->readings++;
+    stats->lastSeqNumber = seqNumber;
+    stats->lastRxRtc = now;
+
+    addToAggregate(&stats->temp, stats->readings, temp);
+    addToAggregate(&stats->internalTemp, stats->readings, internalTemp);
+
+    bucket = (rssi - NODESTATS_RSSI_MIN_DBM) / NODESTATS_RSSI_BUCKET_DB;
+    if (rssi < NODESTATS_RSSI_MIN_DBM)
+    {
+        bucket = 0;
+    }
+    else if (bucket >= NODESTATS_RSSI_BUCKETS)
+    {
+        bucket = NODESTATS_RSSI_BUCKETS - 1;
+    }
+    if (stats->rssiHistogram[bucket] < UINT16_MAX)
+    {
+        stats->rssiHistogram[bucket]++;
+    }
+
+    return true;
+}
+
+float NodeStats_variance(const NodeStats* stats, const NodeStats_Aggregate* aggregate)
+{
+    if (stats->readings < 2)
+    {
+        return 0;
+    }
+    return aggregate->m2 / (stats->readings - 1);
+}
+
+uint16_t NodeStats_lossPermille(const NodeStats* stats)
+{
+    uint32_t sent = stats->readings + stats->lost;
+
+    if (sent == 0)
+    {
+        return 0;
+    }
+    return (uint16_t)((stats->lost * 1000) / sent);
+}
+
+uint32_t NodeStats_meanIntervalMs(const NodeStats* stats)
+{
+    if (stats->readings < 2)
+    {
+        return 0;
+    }
+    return (uint32_t)stats->meanIntervalMs;
+}
+
+int8_t NodeStats_rssiBucketDbm(uint8_t bucket)
+{
+    return NODESTATS_RSSI_MIN_DBM + bucket * NODESTATS_RSSI_BUCKET_DB;
+}
+
+/* Welford's update, n is the number of values including this one */
+static void addToAggregate(NodeStats_Aggregate* aggregate, uint32_t n, int16_t value)
+{
+    float x = value / 256.0f;
+    float delta = x - aggregate->mean;
+
+    if ((n == 1) || (value < aggregate->min))
+    {
+        aggregate->min = value;
+    }
+    if ((n == 1) || (value > aggregate->max))
+    {
+        aggregate->max = value;
+    }
+
+    aggregate->mean += delta / n;
+    aggregate->m2 += delta * (x - aggregate->mean);
+}
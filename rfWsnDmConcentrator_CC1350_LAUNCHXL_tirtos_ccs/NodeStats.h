@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2015-2016, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef NODESTATS_H_
+#define NODESTATS_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+
+/* Running statistics of the readings of one node, updated in O(1) per packet
+ * so that a summary can be reported instead of every reading. Mean and
+ * variance use Welford's algorithm, losses are counted from the gaps in the
+ * sequence numbers of the packets. */
+
+/* RSSI histogram buckets of NODESTATS_RSSI_BUCKET_DB dB each, the first
+ * starting at NODESTATS_RSSI_MIN_DBM. RSSIs outside are counted in the
+ * first and last bucket. */
+#define NODESTATS_RSSI_BUCKETS          8
+#define NODESTATS_RSSI_BUCKET_DB        8
+#define NODESTATS_RSSI_MIN_DBM          -124
+
+/* A larger forward jump in sequence numbers is taken as a node reboot rather
+ * than lost readings */
+#define NODESTATS_MAX_SEQ_GAP           64
+
+/* Aggregate of a fixed 8.8 temperature. The mean and sum of squared
+ * differences from the mean are in degrees C. */
+typedef struct {
+    int16_t min;                /* fixed 8.8 */
+    int16_t max;                /* fixed 8.8 */
+    float mean;
+    float m2;
+} NodeStats_Aggregate;
+
+typedef struct {
+    uint32_t readings;          /* in the aggregates, duplicates excluded */
+    uint16_t lost;              /* from sequence number gaps */
+    uint16_t duplicates;        /* retries of a reading already counted */
+    uint8_t lastSeqNumber;
+    uint64_t lastRxRtc;         /* RTC time of the latest reading, 32.32 s */
+    float meanIntervalMs;       /* running mean of the inter-arrival times */
+    NodeStats_Aggregate temp;
+    NodeStats_Aggregate internalTemp;
+    uint16_t rssiHistogram[NODESTATS_RSSI_BUCKETS];
+} NodeStats;
+
+/* Restart the statistics, e.g. for a new node */
+void NodeStats_reset(NodeStats* stats);
+
+/* Add a reading with sequence number seqNumber and fixed 8.8 temperatures.
+ * Returns false if it was a duplicate, which is not added. */
+bool NodeStats_addReading(NodeStats* stats, uint8_t seqNumber, int16_t temp,
+                          int16_t internalTemp, int8_t rssi);
+
+/* Sample variance of an aggregate of stats, in degrees C squared */
+float NodeStats_variance(const NodeStats* stats, const NodeStats_Aggregate* aggregate);
+
+/* Share of the readings lost, in permille */
+uint16_t NodeStats_lossPermille(const NodeStats* stats);
+
+/* Mean time between readings in ms, 0 until two were received */
+uint32_t NodeStats_meanIntervalMs(const NodeStats* stats);
+
+/* Lower bound in dBm of histogram bucket */
+int8_t NodeStats_rssiBucketDbm(uint8_t bucket);
+
+#endif /* NODESTATS_H_ */
@@ -0,0 +1,385 @@
+/*
+ * Copyright (c) 2015-2016, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/***** Includes *****/
+#include "UartLog.h"
+
+#include <xdc/std.h>
+#include <xdc/runtime/Types.h>
+
+#include <stdarg.h>
+#include <string.h>
+
+#include <ti/sysbios/BIOS.h>
+#include <ti/sysbios/hal/Hwi.h>
+#include <ti/sysbios/knl/Task.h>
+#include <ti/sysbios/knl/Clock.h>
+#include <ti/sysbios/knl/Semaphore.h>
+
+#include <ti/drivers/PIN.h>
+#include <ti/drivers/pin/PINCC26XX.h>
+#include <ti/drivers/Power.h>
+#include <ti/drivers/power/PowerCC26XX.h>
+#include <ti/drivers/UART.h>
+#include <ti/drivers/uart/UARTCC26XX.h>
+#include <ti/drivers/dma/UDMACC26XX.h>
+#include <ti/drivers/dpl/SystemP.h>
+
+#include <ti/devices/DeviceFamily.h>
+#include DEVICE_FAMILY_PATH(inc/hw_memmap.h)
+#include DEVICE_FAMILY_PATH(inc/hw_uart.h)
+#include DEVICE_FAMILY_PATH(driverlib/ioc.h)
+#include DEVICE_FAMILY_PATH(driverlib/uart.h)
+#include DEVICE_FAMILY_PATH(driverlib/udma.h)
+
+/***** Defines *****/
+/* Longest uDMA transfer */
+#define UARTLOG_MAX_TRANSFER    1024
+
+/* How long a bulk writer sleeps before looking for room again */
+#define UARTLOG_BULK_RETRY_MS   10
+
+#define UARTLOG_TX_CHANNEL_MASK (1 << UDMA_CHAN_UART0_TX)
+
+/***** Variable declarations *****/
+/* The ring is only changed with Hwis disabled. txTail and txInFlight belong
+ * to the transfer running, txHead to the writers. */
+static uint8_t txRing[UARTLOG_RING_SIZE];
+static uint16_t txHead; //where the next byte is written
+static uint16_t txTail; //oldest byte not sent yet
+static uint16_t txCount; //bytes in the ring, including those being sent
+static uint16_t txInFlight; //bytes the running transfer sends from txTail
+UartLog_Stats uartLogStats; /* not static so you can see it in the memory browser */
+
+/* The line being received, handed to UartLog_readLine when it ends */
+static char rxLine[UARTLOG_RX_LINE_LENGTH];
+static uint16_t rxLength;
+static bool rxLineReady = false;
+static Semaphore_Struct rxSemaphore;
+
+static bool isOpen = false;
+static const UARTCC26XX_HWAttrsV2* hwAttrs;
+static Hwi_Struct uartHwi;
+static PIN_State uartPinState;
+static PIN_Handle uartPinHandle;
+static UDMACC26XX_Handle udmaHandle;
+
+ALLOCATE_CONTROL_TABLE_ENTRY(dmaUart0TxControlTableEntry, UDMA_CHAN_UART0_TX);
+
+/***** Prototypes *****/
+static void uartHwiFxn(UArg arg);
+static void receiveChar(char c);
+static bool enqueue(const char* data, uint16_t length, bool countOverflow);
+static void startTransfer(void);
+static uint16_t formatLine(char* line, const char* format, va_list args);
+
+/***** Function definitions *****/
+bool UartLog_init(uint_least8_t uartIndex)
+{
+    PIN_Config uartPinTable[3];
+    Semaphore_Params semaphoreParams;
+    Hwi_Params hwiParams;
+    Types_FreqHz freq;
+
+    hwAttrs = (const UARTCC26XX_HWAttrsV2*)UART_config[uartIndex].hwAttrs;
+
+    /* The TX uDMA channel is the one of UART0, the only UART of the device */
+    if (hwAttrs->baseAddr != UART0_BASE)
+    {
+        return false;
+    }
+
+    uartPinTable[0] = hwAttrs->txPin | PIN_GPIO_OUTPUT_EN | PIN_GPIO_HIGH | PIN_PUSHPULL | PIN_INPUT_DIS;
+    uartPinTable[1] = hwAttrs->rxPin | PIN_INPUT_EN | PIN_PULLDOWN;
+    uartPinTable[2] = PIN_TERMINATE;
+    uartPinHandle = PIN_open(&uartPinState, uartPinTable);
+    if (uartPinHandle == NULL)
+    {
+        return false;
+    }
+    PINCC26XX_setMux(uartPinHandle, hwAttrs->txPin, IOC_PORT_MCU_UART0_TX);
+    PINCC26XX_setMux(uartPinHandle, hwAttrs->rxPin, IOC_PORT_MCU_UART0_RX);
+
+    /* The UART needs the high frequency clock, so it keeps the device out of
+     * standby, like the UART driver does while a read is pending */
+    Power_setDependency(hwAttrs->powerMngrId);
+    Power_setConstraint(PowerCC26XX_SB_DISALLOW);
+
+    udmaHandle = UDMACC26XX_open();
+    uDMAChannelAttributeDisable(UDMA0_BASE, UDMA_CHAN_UART0_TX, UDMA_ATTR_ALL);
+    uDMAChannelControlSet(UDMA0_BASE, UDMA_CHAN_UART0_TX | UDMA_PRI_SELECT,
+                          UDMA_SIZE_8 | UDMA_SRC_INC_8 | UDMA_DST_INC_NONE | UDMA_ARB_4);
+    UDMACC26XX_clearChannelDone(udmaHandle, UARTLOG_TX_CHANNEL_MASK);
+
+    Semaphore_Params_init(&semaphoreParams);
+    semaphoreParams.mode = Semaphore_Mode_BINARY;
+    Semaphore_construct(&rxSemaphore, 0, &semaphoreParams);
+
+    Hwi_Params_init(&hwiParams);
+    hwiParams.priority = hwAttrs->intPriority;
+    Hwi_construct(&uartHwi, hwAttrs->intNum, uartHwiFxn, &hwiParams, NULL);
+
+    /* 8N1, the uDMA is asked for more when the TX FIFO is half empty */
+    BIOS_getCpuFreq(&freq);
+    UARTDisable(UART0_BASE);
+    UARTConfigSetExpClk(UART0_BASE, freq.lo, UARTLOG_BAUD_RATE,
+                        UART_CONFIG_WLEN_8 | UART_CONFIG_STOP_ONE | UART_CONFIG_PAR_NONE);
+    UARTFIFOLevelSet(UART0_BASE, UART_FIFO_TX4_8, UART_FIFO_RX4_8);
+    UARTDMAEnable(UART0_BASE, UART_DMA_TX);
+    UARTIntClear(UART0_BASE, UART_INT_RX | UART_INT_RT | UART_INT_OE | UART_INT_BE |
+                 UART_INT_PE | UART_INT_FE);
+    UARTIntEnable(UART0_BASE, UART_INT_RX | UART_INT_RT);
+    UARTEnable(UART0_BASE);
+
+    isOpen = true;
+
+    return true;
+}
+
+bool UartLog_write(const char* data, uint16_t length)
+{
+    if (!isOpen)
+    {
+        return false;
+    }
+
+    return enqueue(data, length, true);
+}
+
+bool UartLog_printf(const char* format, ...)
+{
+    char line[UARTLOG_LINE_LENGTH];
+    uint16_t length;
+    va_list args;
+
+    if (!isOpen)
+    {
+        return false;
+    }
+
+    va_start(args, format);
+    length = formatLine(line, format, args);
+    va_end(args);
+
+    return enqueue(line, length, true);
+}
+
+bool UartLog_printfBulk(const char* format, ...)
+{
+    char line[UARTLOG_LINE_LENGTH];
+    uint16_t length;
+    va_list args;
+
+    if (!isOpen)
+    {
+        return true;
+    }
+
+    va_start(args, format);
+    length = formatLine(line, format, args);
+    va_end(args);
+
+    while (!enqueue(line, length, false))
+    {
+        Task_sleep((UARTLOG_BULK_RETRY_MS * 1000) / Clock_tickPeriod);
+    }
+
+    return true;
+}
+
+int UartLog_readLine(char* buffer, uint16_t size)
+{
+    uint16_t length;
+    UInt key;
+
+    Semaphore_pend(Semaphore_handle(&rxSemaphore), BIOS_WAIT_FOREVER);
+
+    key = Hwi_disable();
+    length = (rxLength < size) ? rxLength : size;
+    memcpy(buffer, rxLine, length);
+    rxLength = 0;
+    rxLineReady = false;
+    Hwi_restore(key);
+
+    return length;
+}
+
+void UartLog_getStats(UartLog_Stats* stats)
+{
+    UInt key = Hwi_disable();
+    *stats = uartLogStats;
+    stats->used = txCount;
+    Hwi_restore(key);
+}
+
+static void uartHwiFxn(UArg arg)
+{
+    uint32_t status = UARTIntStatus(UART0_BASE, true);
+
+    UARTIntClear(UART0_BASE, status);
+
+    if (status & (UART_INT_RX | UART_INT_RT))
+    {
+        while (UARTCharsAvail(UART0_BASE))
+        {
+            receiveChar((char)UARTCharGetNonBlocking(UART0_BASE));
+        }
+    }
+
+    /* The uDMA signals the end of a transfer on the UART interrupt */
+    if (UDMACC26XX_channelDone(udmaHandle, UARTLOG_TX_CHANNEL_MASK))
+    {
+        UDMACC26XX_clearChannelDone(udmaHandle, UARTLOG_TX_CHANNEL_MASK);
+
+        txTail = (txTail + txInFlight) & (UARTLOG_RING_SIZE - 1);
+        txCount -= txInFlight;
+        txInFlight = 0;
+        startTransfer();
+    }
+}
+
+/* Collects a line and echoes it, like the UART driver in text mode. Characters
+ * arriving before the previous line has been read are dropped. */
+static void receiveChar(char c)
+{
+    if (rxLineReady)
+    {
+        return;
+    }
+
+    if ((c == '\r') || (c == '\n'))
+    {
+        enqueue("\r\n", 2, true);
+    }
+    else
+    {
+        enqueue(&c, 1, true);
+    }
+
+    rxLine[rxLength++] = c;
+    if ((c == '\r') || (c == '\n') || (rxLength == UARTLOG_RX_LINE_LENGTH))
+    {
+        rxLineReady = true;
+        Semaphore_post(Semaphore_handle(&rxSemaphore));
+    }
+}
+
+/* Copies the bytes in with Hwis disabled, which takes about as long as
+ * formatting a few characters */
+static bool enqueue(const char* data, uint16_t length, bool countOverflow)
+{
+    uint16_t first;
+    UInt key = Hwi_disable();
+
+    if (length > (UARTLOG_RING_SIZE - txCount))
+    {
+        if (countOverflow)
+        {
+            uartLogStats.overflows++;
+        }
+        Hwi_restore(key);
+        return false;
+    }
+
+    /* Up to the end of the ring, then from its start */
+    first = UARTLOG_RING_SIZE - txHead;
+    if (first > length)
+    {
+        first = length;
+    }
+    memcpy(&txRing[txHead], data, first);
+    memcpy(txRing, &data[first], length - first);
+    txHead = (txHead + length) & (UARTLOG_RING_SIZE - 1);
+    txCount += length;
+
+    uartLogStats.bytesWritten += length;
+    if (txCount > uartLogStats.maxUsed)
+    {
+        uartLogStats.maxUsed = txCount;
+    }
+
+    if (txInFlight == 0)
+    {
+        startTransfer();
+    }
+
+    Hwi_restore(key);
+
+    return true;
+}
+
+/* Sends what is in the ring up to its end, the rest goes in the next transfer.
+ * Called with Hwis disabled, or from the UART Hwi. */
+static void startTransfer(void)
+{
+    uint16_t length = txCount;
+
+    if (length == 0)
+    {
+        return;
+    }
+
+    if (length > (UARTLOG_RING_SIZE - txTail))
+    {
+        length = UARTLOG_RING_SIZE - txTail;
+    }
+    if (length > UARTLOG_MAX_TRANSFER)
+    {
+        length = UARTLOG_MAX_TRANSFER;
+    }
+
+    uDMAChannelTransferSet(UDMA0_BASE, UDMA_CHAN_UART0_TX | UDMA_PRI_SELECT, UDMA_MODE_BASIC,
+                           &txRing[txTail], (void*)(UART0_BASE + UART_O_DR), length);
+    txInFlight = length;
+    UDMACC26XX_channelEnable(udmaHandle, UARTLOG_TX_CHANNEL_MASK);
+}
+
+static uint16_t formatLine(char* line, const char* format, va_list args)
+{
+    /* The formatter of the display drivers, which knows %f */
+    int length = SystemP_vsnprintf(line, UARTLOG_LINE_LENGTH - 2, format, args);
+
+    /* A longer line is cut, the return value is the length it would have had */
+    if (length < 0)
+    {
+        length = 0;
+    }
+    else if (length > (UARTLOG_LINE_LENGTH - 3))
+    {
+        length = UARTLOG_LINE_LENGTH - 3;
+    }
+
+    line[length++] = '\r';
+    line[length++] = '\n';
+
+    return length;
+}
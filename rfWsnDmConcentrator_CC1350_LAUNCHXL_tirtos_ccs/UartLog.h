@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2015-2016, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef UARTLOG_H_
+#define UARTLOG_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+
+/* UART output that never makes the writer wait for the serial port.
+ *
+ * Lines are formatted on the caller's stack and copied into a RAM ring, from
+ * which the uDMA feeds the UART TX FIFO. The end of each transfer is signaled
+ * on the UART interrupt, which starts the next one, so the ring drains at the
+ * full baud rate without a task involved. A line that does not fit in the
+ * ring is dropped and counted.
+ *
+ * The module owns UART0 and also collects received characters into lines for
+ * UartLog_readLine, so the UART driver and DisplayUart must not open it. */
+
+#ifndef UARTLOG_BAUD_RATE
+#define UARTLOG_BAUD_RATE       115200
+#endif
+
+/* Size of the TX ring, a power of two */
+#ifndef UARTLOG_RING_SIZE
+#define UARTLOG_RING_SIZE       2048
+#endif
+
+/* Longest formatted line, including the "\r\n" added to it */
+#define UARTLOG_LINE_LENGTH     128
+
+/* Longest received line */
+#define UARTLOG_RX_LINE_LENGTH  64
+
+typedef struct
+{
+    uint32_t bytesWritten;
+    uint32_t overflows; //lines dropped because the ring was full
+    uint16_t used; //bytes in the ring now
+    uint16_t maxUsed; //high-water mark of the ring
+} UartLog_Stats;
+
+/* Opens the UART of UART_config[uartIndex], e.g. Board_UART0, with the pins
+ * of its board configuration. Returns false if the UART cannot be used. */
+bool UartLog_init(uint_least8_t uartIndex);
+
+/* Queues length bytes as they are. Can be called from any context. Returns
+ * false, and counts an overflow, if they do not fit in the ring. */
+bool UartLog_write(const char* data, uint16_t length);
+
+/* Formats a line and queues it followed by "\r\n", from task context. Returns
+ * false if the line was dropped. */
+bool UartLog_printf(const char* format, ...);
+
+/* Like UartLog_printf, but sleeps until the ring has room instead of dropping
+ * the line. Only for bulk dumps from the lowest priority tasks, which may
+ * wait without holding anything else up. Always returns true. */
+bool UartLog_printfBulk(const char* format, ...);
+
+/* Blocks until a line is received and copies up to size bytes of it, ending
+ * with the '\r' or '\n' that ended it. Returns the number of bytes copied. */
+int UartLog_readLine(char* buffer, uint16_t size);
+
+void UartLog_getStats(UartLog_Stats* stats);
+
+#endif /* UARTLOG_H_ */
@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2015-2016, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/***** Includes *****/
+#include "PacketCrypto.h"
+
+#include <xdc/std.h>
+#include <xdc/runtime/System.h>
+
+#include <ti/drivers/Power.h>
+#include <ti/drivers/power/PowerCC26XX.h>
+#include <ti/drivers/crypto/CryptoCC26XX.h>
+#include <string.h>
+
+#include "Board.h"
+
+#ifdef DEVICE_FAMILY
+    #undef DEVICE_FAMILY_PATH
+    #define DEVICE_FAMILY_PATH(x) <ti/devices/DEVICE_FAMILY/x>
+    #include DEVICE_FAMILY_PATH(driverlib/trng.h)
+#else
+    #error "You must define DEVICE_FAMILY at the project level as one of cc26x0, cc26x0r2, cc13x0, etc."
+#endif
+
+/***** Defines *****/
+/* Size of the CCM length field, frames are shorter than 64 kB, which leaves
+ * 13 bytes for the nonce */
+#define PACKETCRYPTO_LENGTH_FIELD_SIZE  2
+#define PACKETCRYPTO_NONCE_LENGTH       (15 - PACKETCRYPTO_LENGTH_FIELD_SIZE)
+
+/* Samples per random number, the smallest the TRNG allows as the counter is
+ * only taken once per boot */
+#define PACKETCRYPTO_TRNG_MIN_SAMPLES   (1 << 6)
+#define PACKETCRYPTO_TRNG_MAX_SAMPLES   (1 << 8)
+
+/***** Variable declarations *****/
+static const uint32_t networkKey[4] = PACKETCRYPTO_KEY;
+static CryptoCC26XX_Handle cryptoHandle;
+static int keyIndex;
+
+/* The engine reads the nonce and writes the MIC by words, so both are kept
+ * aligned here */
+static uint32_t nonce[(PACKETCRYPTO_NONCE_LENGTH + 3) / 4];
+static uint32_t mic[(PACKETCRYPTO_MIC_LENGTH + 3) / 4];
+
+/***** Prototypes *****/
+static void buildNonce(uint8_t source, uint16_t address, uint32_t frameCounter);
+static void initTransaction(CryptoCC26XX_AESCCM_Transaction* trans, CryptoCC26XX_Operation opType,
+                            uint8_t* data, uint8_t headerLength, uint16_t msgLength);
+
+/***** Function definitions *****/
+void PacketCrypto_init(void)
+{
+    CryptoCC26XX_Params params;
+
+    CryptoCC26XX_init();
+    CryptoCC26XX_Params_init(&params);
+    cryptoHandle = CryptoCC26XX_open(Board_CRYPTO0, false, &params);
+    if (cryptoHandle == NULL)
+    {
+        System_abort("CryptoCC26XX_open failed");
+    }
+
+    /* The key stays in the key store, so it is not loaded for every frame */
+    keyIndex = CryptoCC26XX_allocateKey(cryptoHandle, CRYPTOCC26XX_KEY_ANY, networkKey);
+    if (keyIndex == CRYPTOCC26XX_STATUS_ERROR)
+    {
+        System_abort("CryptoCC26XX_allocateKey failed");
+    }
+}
+
+uint32_t PacketCrypto_randomCounter(void)
+{
+    uint32_t value;
+
+    Power_setDependency(PowerCC26XX_PERIPH_TRNG);
+    TRNGConfigure(PACKETCRYPTO_TRNG_MIN_SAMPLES, PACKETCRYPTO_TRNG_MAX_SAMPLES, 0);
+    TRNGEnable();
+    while (!(TRNGStatusGet() & TRNG_NUMBER_READY));
+    value = TRNGNumberGet(TRNG_LOW_WORD);
+    TRNGDisable();
+    Power_releaseDependency(PowerCC26XX_PERIPH_TRNG);
+
+    return value;
+}
+
+uint8_t PacketCrypto_seal(uint8_t* data, uint8_t headerLength, uint8_t length,
+                          uint8_t source, uint16_t address, uint32_t frameCounter)
+{
+    CryptoCC26XX_AESCCM_Transaction trans;
+    uint8_t bodyLength = length - headerLength;
+    uint8_t* counter = &data[headerLength];
+
+    /* Move the body up to make room for the frame counter after the header */
+    memmove(&counter[PACKETCRYPTO_COUNTER_LENGTH], counter, bodyLength);
+    counter[0] = (frameCounter & 0xFF000000) >> 24;
+    counter[1] = (frameCounter & 0x00FF0000) >> 16;
+    counter[2] = (frameCounter & 0xFF00) >> 8;
+    counter[3] = (frameCounter & 0xFF);
+
+    buildNonce(source, address, frameCounter);
+    initTransaction(&trans, CRYPTOCC26XX_OP_AES_CCM_ENCRYPT, data, headerLength, bodyLength);
+    if (CryptoCC26XX_transactPolling(cryptoHandle, (CryptoCC26XX_Transaction*)&trans) != CRYPTOCC26XX_STATUS_SUCCESS)
+    {
+        System_abort("CryptoCC26XX_transactPolling failed");
+    }
+
+    memcpy(&counter[PACKETCRYPTO_COUNTER_LENGTH + bodyLength], mic, PACKETCRYPTO_MIC_LENGTH);
+
+    return length + PACKETCRYPTO_OVERHEAD;
+}
+
+uint8_t PacketCrypto_open(uint8_t* data, uint8_t headerLength, uint8_t length,
+                          uint8_t source, uint16_t address, uint32_t* frameCounter)
+{
+    CryptoCC26XX_AESCCM_Transaction trans;
+    uint8_t bodyLength;
+    uint8_t* counter = &data[headerLength];
+    uint32_t receivedCounter;
+
+    if (length < headerLength + PACKETCRYPTO_OVERHEAD)
+    {
+        return 0;
+    }
+    bodyLength = length - headerLength - PACKETCRYPTO_OVERHEAD;
+
+    receivedCounter = (counter[0] << 24) | (counter[1] << 16) | (counter[2] << 8) | counter[3];
+
+    /* The engine checks the MIC following the body */
+    buildNonce(source, address, receivedCounter);
+    initTransaction(&trans, CRYPTOCC26XX_OP_AES_CCM_DECRYPT, data, headerLength,
+                    bodyLength + PACKETCRYPTO_MIC_LENGTH);
+    if (CryptoCC26XX_transactPolling(cryptoHandle, (CryptoCC26XX_Transaction*)&trans) != CRYPTOCC26XX_STATUS_SUCCESS)
+    {
+        return 0;
+    }
+
+    /* Give back the plain frame without the frame counter */
+    memmove(counter, &counter[PACKETCRYPTO_COUNTER_LENGTH], bodyLength);
+    *frameCounter = receivedCounter;
+
+    return headerLength + bodyLength;
+}
+
+/* The nonce is the source, the address and the frame counter, big endian,
+ * padded with zeros */
+static void buildNonce(uint8_t source, uint16_t address, uint32_t frameCounter)
+{
+    uint8_t* pNonce = (uint8_t*)nonce;
+
+    memset(nonce, 0, sizeof(nonce));
+    pNonce[0] = source;
+    pNonce[1] = (address & 0xFF00) >> 8;
+    pNonce[2] = (address & 0xFF);
+    pNonce[3] = (frameCounter & 0xFF000000) >> 24;
+    pNonce[4] = (frameCounter & 0x00FF0000) >> 16;
+    pNonce[5] = (frameCounter & 0xFF00) >> 8;
+    pNonce[6] = (frameCounter & 0xFF);
+}
+
+/* The header and the frame counter are the additional authenticated data,
+ * the msgLength bytes after them are encrypted or decrypted in place */
+static void initTransaction(CryptoCC26XX_AESCCM_Transaction* trans, CryptoCC26XX_Operation opType,
+                            uint8_t* data, uint8_t headerLength, uint16_t msgLength)
+{
+    CryptoCC26XX_Transac_init((CryptoCC26XX_Transaction*)trans, opType);
+    trans->keyIndex = keyIndex;
+    trans->authLength = PACKETCRYPTO_MIC_LENGTH;
+    trans->nonce = (char*)nonce;
+    trans->header = (char*)data;
+    trans->headerLength = headerLength + PACKETCRYPTO_COUNTER_LENGTH;
+    trans->msgIn = (char*)&data[headerLength + PACKETCRYPTO_COUNTER_LENGTH];
+    trans->msgInLength = msgLength;
+    trans->msgOut = mic;
+    trans->fieldLength = PACKETCRYPTO_LENGTH_FIELD_SIZE;
+}
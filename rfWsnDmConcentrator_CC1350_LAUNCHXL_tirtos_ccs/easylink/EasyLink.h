@@ -59,18 +59,42 @@
 //   - RX is enabled by calling EasyLink_receive() or EasyLink_receiveAsync().
 //   - Entering RX can be immediate or scheduled.
 //   - EasyLink_receive() is blocking and EasyLink_receiveAsync() is nonblocking.
-//   - the EasyLink API does not queue messages so calling another API function
-//     while in EasyLink_receiveAsync() will return EasyLink_Status_Busy_Error
+//   - these functions do not queue, calling another one while in
+//     EasyLink_receiveAsync() will return EasyLink_Status_Busy_Error. Use
+//     EasyLink_submit() to queue commands instead, see below.
 //   - an Async operation can be cancelled with EasyLink_abort()
+//   - Sniffing can be enabled with EasyLink_Ctrl_Sniff_Interval. An async Rx
+//     then only turns the receiver on for a short carrier sense once per
+//     interval, and stays in Rx when it finds a preamble or a signal above
+//     EasyLink_Ctrl_Sniff_RssiThreshold. The transmitter must send a preamble
+//     longer than the interval plus the carrier sense time, and shorter than
+//     twice the interval, see EasyLink_Ctrl_Preamble_Time.
 //   .
 // The following apply for transmit operation:
 //   - TX is enabled by calling EasyLink_transmit() or EasyLink_transmitAsync().
 //   - TX can be immediate or scheduled.
 //   - EasyLink_transmit() is blocking and EasyLink_transmitAsync() is nonblocking
 //   - EasyLink_transmit() for a scheduled command, or if TX can not start
-//   - the EasyLink API does not queue messages so calling another API function
-//     while in EasyLink_transmitAsync() will return EasyLink_Status_Busy_Error
+//   - these functions do not queue, calling another one while in
+//     EasyLink_transmitAsync() will return EasyLink_Status_Busy_Error. Use
+//     EasyLink_submit() to queue commands instead, see below.
 //   - an Async operation can be cancelled with EasyLink_abort()
+//   - Listen before talk (CSMA) can be enabled with EasyLink_Ctrl_Csma_Enable.
+//     The Tx is then chained behind a carrier sense command and is retried
+//     with a random exponential backoff while the channel is busy, up to
+//     EasyLink_Ctrl_Csma_MaxAttempts times. If the channel never cleared the
+//     Tx returns EasyLink_Status_Channel_Busy.
+//   - A long preamble, for a receiver that is sniffing, can be set with
+//     EasyLink_Ctrl_Preamble_Time.
+//   .
+// Commands can instead be submitted with EasyLink_submit(), which queues them
+// rather than returning EasyLink_Status_Busy_Error:
+//   - Queued commands run one at a time in order of EasyLink_Priority, and in
+//     submission order within a priority.
+//   - A running Rx submitted this way is stopped for any more urgent command
+//     and queued again behind it, so an ACK never waits for a long Rx.
+//   - Each command has its own completion callback and an optional deadline
+//     by which it must have been started.
 //
 // # Error handling #
 //    The EasyLink API will return EasyLink_Status containing success or error
@@ -85,6 +109,8 @@
 //    EasyLink_Status_Rx_Timeout
 //    EasyLink_Status_Busy_Error
 //    EasyLink_Status_Aborted
+//    EasyLink_Status_Channel_Busy
+//    EasyLink_Status_Deadline_Error
 //   .
 //
 // # Power Management #
@@ -156,6 +182,18 @@ extern "C"
 /// \brief defines the Max number of Rx Address filters
 #define EASYLINK_MAX_ADDR_FILTERS     3
 
+/// \brief default RSSI threshold in dBm above which CSMA treats the channel as busy
+#define EASYLINK_CSMA_DEFAULT_RSSI_THRESHOLD    -90
+
+/// \brief default max number of carrier sense attempts per Tx when CSMA is enabled
+#define EASYLINK_CSMA_DEFAULT_MAX_ATTEMPTS      5
+
+/// \brief default CSMA backoff unit in Radio Time Ticks (10ms)
+#define EASYLINK_CSMA_DEFAULT_BACKOFF_UNIT      EasyLink_ms_To_RadioTime(10)
+
+/// \brief default RSSI threshold in dBm above which a sniff stays in Rx
+#define EASYLINK_SNIFF_DEFAULT_RSSI_THRESHOLD   -90
+
 /// \brief macro to convert from Radio Time Ticks to ms
 #define EasyLink_RadioTime_To_ms(radioTime) ((1000 * radioTime) / 4000000)
 
@@ -175,7 +213,9 @@ typedef enum
     EasyLink_Status_Rx_Timeout      = 7, ///Rx Error
     EasyLink_Status_Rx_Buffer_Error = 8, ///Rx Buffer Error
     EasyLink_Status_Busy_Error      = 9, ///Busy Error
-    EasyLink_Status_Aborted         = 10 ///Cmd stopped or aborted
+    EasyLink_Status_Aborted         = 10, ///Cmd stopped or aborted
+    EasyLink_Status_Channel_Busy    = 11, ///Channel busy on all CSMA attempts
+    EasyLink_Status_Deadline_Error  = 12  ///Queued cmd not started by its deadline
 } EasyLink_Status;
 
 
@@ -205,6 +245,27 @@ typedef enum
                                         ///0 means no timeout
     EasyLink_Ctrl_Test_Tone = 4, ///Enable/Disable Test mode for Tone
     EasyLink_Ctrl_Test_Signal = 5, ///Enable/Disable Test mode for Signal
+    EasyLink_Ctrl_Csma_Enable = 6, ///Enable/Disable listen before talk for
+                                   ///EasyLink_transmit and
+                                   ///EasyLink_transmitAsync
+    EasyLink_Ctrl_Csma_RssiThreshold = 7, ///RSSI in dBm (int8_t) above which
+                                          ///the channel is considered busy
+    EasyLink_Ctrl_Csma_MaxAttempts = 8, ///Max number of carrier sense
+                                        ///attempts before giving up a Tx
+    EasyLink_Ctrl_Csma_BackoffUnit = 9, ///Backoff unit in Radio Time Ticks,
+                                        ///the backoff is a random number of
+                                        ///units that doubles per attempt
+    EasyLink_Ctrl_Csma_Attempts = 10, ///Number of carrier sense attempts
+                                      ///used by the last Tx (read only)
+    EasyLink_Ctrl_Sniff_Interval = 11, ///Time in Radio Time Ticks between
+                                       ///the carrier senses of a sniffing
+                                       ///async Rx. 0 (default) for a
+                                       ///continuous Rx
+    EasyLink_Ctrl_Sniff_RssiThreshold = 12, ///RSSI in dBm (int8_t) above
+                                            ///which a sniff stays in Rx
+    EasyLink_Ctrl_Preamble_Time = 13, ///Time in Radio Time Ticks the Tx
+                                      ///sends the preamble for. 0 (default)
+                                      ///for the preamble of the PHY
 } EasyLink_CtrlOption;
 
 /// \brief Structure for the TX Packet
@@ -231,17 +292,98 @@ typedef struct
         uint8_t payload[EASYLINK_MAX_DATA_LENGTH]; ///payload of RX'ed packet
 } EasyLink_RxPacket;
 
+/// \brief Structure for the Rx statistics accumulated over all Rx commands
+typedef struct
+{
+        uint32_t nRxOk;          ///Packets received with CRC OK and
+                                 ///passing the address filter
+        uint32_t nRxNok;         ///Packets received with CRC error
+        uint32_t nRxIgnored;     ///Packets ignored by the address filter
+        uint32_t nRxStopped;     ///Packets not received because the Rx
+                                 ///command was stopped or aborted
+        uint32_t nRxBufFull;     ///Packets discarded with the Rx buffer full
+        uint32_t nSniffIdle;     ///Sniffs that found the channel idle
+        uint32_t nSniffBusy;     ///Sniffs that found the channel busy and
+                                 ///stayed in Rx
+        int8_t lastRssi;         ///RSSI of the last packet received
+} EasyLink_RxStats;
+
+/// \brief Structure for a RX'ed packet lent to the application, pointing
+/// into the radio's data entry instead of holding a copy
+typedef struct
+{
+        int8_t rssi;             ///rssi of RX'ed packet
+        uint8_t len;             ///length of RX'ed packet
+        uint32_t absTime;        ///Absolute time that packet was Rx
+        uint8_t *dstAddr;        ///Dst Address of RX'ed packet
+        uint8_t *payload;        ///payload of RX'ed packet
+} EasyLink_RxLentPacket;
+
 /** \brief EasyLink Callback function type for Received packet, registered
  *   with EasyLink_ReceiveAsync
  */
 typedef void (*EasyLink_ReceiveCb)(EasyLink_RxPacket * rxPacket,
         EasyLink_Status status);
 
+/** \brief EasyLink Callback function type for Received packet, registered
+ *   with EasyLink_receiveLentAsync. On EasyLink_Status_Success the callee
+ *   owns rxPacket and must give it back with EasyLink_releaseRx, else
+ *   rxPacket is NULL.
+ */
+typedef void (*EasyLink_ReceiveLentCb)(EasyLink_RxLentPacket * rxPacket,
+        EasyLink_Status status);
+
 /** \brief EasyLink Callback function type for Tx Done registered with
  *  EasyLink_TransmitAsync
  */
 typedef void (*EasyLink_TxDoneCb)(EasyLink_Status status);
 
+/// \brief Priorities of the commands submitted with EasyLink_submit, most
+/// urgent first
+typedef enum
+{
+    EasyLink_Priority_Ack = 0,   ///Acknowledgement Tx
+    EasyLink_Priority_Tx,        ///Data Tx
+    EasyLink_Priority_Rx,        ///Rx (re-)arm
+    EasyLink_Priority_Test,      ///Test and other background commands
+    EasyLink_Priority_Count,
+} EasyLink_Priority;
+
+/// \brief Types of the commands submitted with EasyLink_submit
+typedef enum
+{
+    EasyLink_CmdType_Tx = 0,     ///Tx of txPacket
+    EasyLink_CmdType_Rx,         ///Rx of one packet
+} EasyLink_CmdType;
+
+struct EasyLink_Cmd;
+
+/** \brief EasyLink Callback function type for a command submitted with
+ *  EasyLink_submit. For a successful Rx the callee owns rxPacket as with
+ *  EasyLink_receiveLentAsync, else rxPacket is NULL.
+ */
+typedef void (*EasyLink_CmdDoneCb)(struct EasyLink_Cmd *cmd,
+        EasyLink_Status status, EasyLink_RxLentPacket *rxPacket);
+
+/// \brief Structure for a command submitted with EasyLink_submit. It is
+/// owned by the caller, and must be kept unchanged with its txPacket until
+/// its callback is called.
+typedef struct EasyLink_Cmd
+{
+        struct EasyLink_Cmd *next;   ///Used by EasyLink while queued
+        EasyLink_CmdType type;       ///Tx or Rx
+        EasyLink_Priority priority;  ///Queue priority
+        uint32_t deadline;           ///Absolute radio time by which the cmd
+                                     ///must have been started (0 for none)
+        EasyLink_TxPacket *txPacket; ///Packet to Tx, absTime as for
+                                     ///EasyLink_transmit
+        uint32_t rxAbsTime;          ///Absolute time to turn on Rx
+                                     ///(0 for immediate)
+        uint32_t rxTimeout;          ///Relative time in ticks from Rx start
+                                     ///to Rx TimeOut (0 for no timeout)
+        EasyLink_CmdDoneCb cb;       ///Called once the cmd completed
+} EasyLink_Cmd;
+
 //*****************************************************************************
 //
 //! \brief Initializes the radio with specified Phy settings
@@ -342,6 +484,57 @@ extern EasyLink_Status EasyLink_receive(EasyLink_RxPacket *rxPacket);
 //*****************************************************************************
 extern EasyLink_Status EasyLink_receiveAsync(EasyLink_ReceiveCb cb, uint32_t absTime);
 
+//*****************************************************************************
+//
+//! \brief Enables Asynchronous Packet Rx, lending the packet to the callback.
+//!
+//! This function works as EasyLink_receiveAsync, but the callback gets the
+//! packet where the radio received it instead of a copy. The application
+//! keeps it, e.g. to decode it in a task, until it calls EasyLink_releaseRx,
+//! so no packet storage other than the Rx buffers is needed. Each packet kept
+//! holds a PacketPool block, which the next Rx needs for its buffer.
+//!
+//! \param cb        - The rx function pointer.
+//! \param absTime   - Start time of Rx (0: now !0: absolute radio time to
+//!                    start Rx)
+//!
+//! \return EasyLink_Status
+//
+//*****************************************************************************
+extern EasyLink_Status EasyLink_receiveLentAsync(EasyLink_ReceiveLentCb cb, uint32_t absTime);
+
+//*****************************************************************************
+//
+//! \brief Gives back a packet lent by EasyLink_receiveLentAsync.
+//!
+//! May be called from any context.
+//!
+//! \param rxPacket - The packet from the callback, NULL is ignored.
+//
+//*****************************************************************************
+extern void EasyLink_releaseRx(EasyLink_RxLentPacket *rxPacket);
+
+//*****************************************************************************
+//
+//! \brief Queues a Tx or Rx command with non blocking call.
+//!
+//! This function queues the command and returns, the command is started as
+//! soon as the radio is free and no more urgent command is queued. A running
+//! Rx submitted this way is stopped for a more urgent command and queued again
+//! at the front of its priority, so a scheduled Rx still ends at its original
+//! timeout. A command not started by its deadline completes with
+//! EasyLink_Status_Deadline_Error without being run.
+//!
+//! May be called from Task and Swi context, including the callbacks.
+//!
+//! \param cmd - The command, owned by the caller until its callback.
+//!
+//! \return EasyLink_Status of the submission, the command's own status is
+//!         given to its callback
+//
+//*****************************************************************************
+extern EasyLink_Status EasyLink_submit(EasyLink_Cmd *cmd);
+
 //*****************************************************************************
 //
 //! \brief Abort a previously call Async Tx/Rx.
@@ -416,6 +609,23 @@ extern EasyLink_Status EasyLink_enableRxAddrFilter(uint8_t* pui8AddrFilterTable,
 //*****************************************************************************
 extern EasyLink_Status EasyLink_getIeeeAddr(uint8_t *ieeeAddr);
 
+//*****************************************************************************
+//
+//! \brief Gets the accumulated Rx statistics
+//!
+//! This function gets the Rx statistics accumulated since boot or the last
+//! reset, across re-initializations with EasyLink_init. The statistics of
+//! each Rx command are added when the command ends. Getting and resetting is
+//! atomic, so no packet counted while resetting is lost.
+//!
+//! \param stats pointer to the structure to copy the statistics to
+//! \param reset true to restart the counters from zero
+//!
+//! \return EasyLink_Status
+//
+//*****************************************************************************
+extern EasyLink_Status EasyLink_getRxStats(EasyLink_RxStats *stats, bool reset);
+
 //*****************************************************************************
 //
 //! \brief Sets the TX Power
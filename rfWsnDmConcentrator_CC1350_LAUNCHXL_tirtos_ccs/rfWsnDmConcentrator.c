@@ -52,6 +52,8 @@
 
 #include "DmConcentratorRadioTask.h"
 #include "DmConcentratorTask.h"
+#include "trace/TaskMonitor.h"
+#include "NodeLiveness.h"
 
 
 /*
@@ -67,6 +69,12 @@ int main(void)
     UART_init();
     SPI_init();
 
+    /* Measure the task CPU load every 10 s */
+    TaskMonitor_init(10000);
+
+    /* Track the report deadlines of the nodes */
+    NodeLiveness_init();
+
     /* Initialize concentrator tasks */
     ConcentratorRadioTask_init();
     ConcentratorTask_init();
@@ -38,6 +38,7 @@
 /*********************************************************************
  * INCLUDES
  */
+#include <stddef.h>
 #include <string.h>
 #include "SEB.h"
 
@@ -62,6 +63,12 @@
 #define EDDYSTONE_UUID_FRAME_LEN                19
 #define EDDYSTONE_TLM_FRAME_LEN                 14
 
+#define EDDYSTONE_FRAME_TYPES                   3
+
+#define EDDYSTONE_AD_TYPE_SVC_DATA              0x16
+#define EDDYSTONE_UUID_LSB                      0xaa
+#define EDDYSTONE_UUID_MSB                      0xfe
+
 // # of URL Scheme Prefix types
 #define EDDYSTONE_URL_PREFIX_MAX        4
 // # of encodable URL words
@@ -172,7 +179,7 @@ static char* eddystoneURLEncoding[EDDYSTONE_URL_ENCODING_MAX] =
 
 static uint32_t advCount = 0;
 
-static SEB_EddystoneAdvData_t eddystoneAdv =
+static const SEB_EddystoneAdvData_t eddystoneAdvHeader =
 {
     0x02,   // length1 2
     1,      // Flags data type
@@ -193,6 +200,9 @@ static SEB_EddystoneAdvData_t eddystoneAdv =
     //Eddysone Frame to be copied in dynamically
 };
 
+static SEB_EddystoneAdvData_t eddystoneAdv;
+static SEB_EddystoneAdvData_t eddystoneTrainAdv[EDDYSTONE_FRAME_TYPES];
+
 static SEB_EUID_t eUidFrame;
 static SEB_EURL_t eUrlFrame;
 static SEB_ETLM_t eTlmFrame;
@@ -203,6 +213,84 @@ static uint8_t urlFrameLen;
  * LOCAL FUNCTIONS
  */
 
+//Fills in an advertisement with the frame and returns its length
+static uint8_t buildAdvData(SEB_FrameType type, SEB_EddystoneAdvData_t *adv)
+{
+    //Copy in the flags and service headers
+    memcpy(adv, &eddystoneAdvHeader, offsetof(SEB_EddystoneAdvData_t, frame));
+
+    switch(type)
+    {
+    case SEB_FrameType_Uuid:
+        //Set length
+        adv->length = EDDYSTONE_SVC_DATA_OVERHEAD_LEN + EDDYSTONE_UUID_FRAME_LEN;
+        //Copy in data
+        memcpy(&adv->frame, &eUidFrame, sizeof(SEB_EUID_t));
+        break;
+    case SEB_FrameType_Url:
+        //Set length
+        adv->length = urlFrameLen;
+        //Copy in data
+        memcpy(&adv->frame, &eUrlFrame, sizeof(SEB_EURL_t));
+        break;
+    case SEB_FrameType_Tlm:
+        //Set length
+        adv->length = EDDYSTONE_SVC_DATA_OVERHEAD_LEN + EDDYSTONE_TLM_FRAME_LEN;
+        //Copy in data
+        memcpy(&adv->frame, &eTlmFrame, sizeof(SEB_ETLM_t));
+        break;
+    }
+
+    return EDDYSTONE_FRAME_OVERHEAD_LEN + adv->length;
+}
+
+//Decodes an encoded URL of len bytes, the first being the prefix code.
+//Returns false if it has an invalid code or does not fit.
+static bool decodeUrl(uint8_t *encodedUrl, uint8_t len, char *url)
+{
+    const char *token;
+    uint8_t urlLen;
+    uint8_t tokenLen;
+    uint8_t i;
+
+    if ((len == 0) || (encodedUrl[0] >= EDDYSTONE_URL_PREFIX_MAX))
+    {
+        return false;
+    }
+
+    token = eddystoneURLPrefix[encodedUrl[0]];
+    urlLen = strlen(token);
+    strcpy(url, token);
+
+    for (i = 1; i < len; i++)
+    {
+        if (encodedUrl[i] < EDDYSTONE_URL_ENCODING_MAX)
+        {
+            token = eddystoneURLEncoding[encodedUrl[i]];
+            tokenLen = strlen(token);
+        }
+        else if ((encodedUrl[i] > 0x20) && (encodedUrl[i] < 0x7f))
+        {
+            token = (const char*)&encodedUrl[i];
+            tokenLen = 1;
+        }
+        else
+        {
+            return false;
+        }
+
+        if (urlLen + tokenLen >= SEB_MAX_URL_LEN)
+        {
+            return false;
+        }
+        memcpy(&url[urlLen], token, tokenLen);
+        urlLen += tokenLen;
+    }
+    url[urlLen] = '\0';
+
+    return true;
+}
+
 /*********************************************************************
  * PUBLIC FUNCTIONS
  */
@@ -389,6 +477,84 @@ SimpleBeacon_Status SEB_initTLM(uint16_t batt, uint16_t temp, uint32_t time100Mi
     return SimpleBeacon_Status_Success;
 }
 
+//*****************************************************************************
+//
+//! \brief Set the advertisement count of TLM frames
+//!
+//! This sets the count sent in the next TLM frame.
+//!
+//! \param count Advertisement count
+//!
+//! \return SimpleBeacon_Status
+//!
+//*****************************************************************************
+SimpleBeacon_Status SEB_setAdvCount(uint32_t count)
+{
+    advCount = count;
+
+    return SimpleBeacon_Status_Success;
+}
+
+//*****************************************************************************
+//
+//! \brief Parse a received Eddystone beacon
+//!
+//! This finds the Eddystone service data in advertising data and decodes
+//! URL and TLM frames.
+//!
+//! \param advData Advertising data
+//! \param advLen Length of the advertising data
+//! \param frame Filled in with the decoded frame
+//!
+//! \return SimpleBeacon_Status
+//!
+//*****************************************************************************
+SimpleBeacon_Status SEB_parseFrame(uint8_t *advData, uint8_t advLen, SEB_ParsedFrame *frame)
+{
+    uint8_t i = 0;
+
+    //Walk the AD structures, each a length byte followed by the type and data
+    while ((i + 1 < advLen) && (advData[i] != 0) && (i + 1 + advData[i] <= advLen))
+    {
+        uint8_t adLen = advData[i];
+        uint8_t *ad = &advData[i + 1];
+
+        if ((ad[0] == EDDYSTONE_AD_TYPE_SVC_DATA) && (adLen >= 4) &&
+            (ad[1] == EDDYSTONE_UUID_LSB) && (ad[2] == EDDYSTONE_UUID_MSB))
+        {
+            //ad[3] is the Eddystone frame type, the frame follows
+            uint8_t *pFrame = &ad[4];
+            uint8_t frameLen = adLen - 4;
+
+            if ((ad[3] == EDDYSTONE_FRAME_TYPE_URL) && (frameLen >= 2) &&
+                decodeUrl(&pFrame[1], frameLen - 1, frame->url))
+            {
+                //pFrame[0] is the Tx power
+                frame->type = SEB_FrameType_Url;
+                return SimpleBeacon_Status_Success;
+            }
+            if ((ad[3] == EDDYSTONE_FRAME_TYPE_TLM) &&
+                (frameLen >= EDDYSTONE_TLM_FRAME_LEN - 1) && (pFrame[0] == 0))
+            {
+                //pFrame[0] is the TLM version
+                frame->type = SEB_FrameType_Tlm;
+                frame->battMv = (pFrame[1] << 8) | pFrame[2];
+                frame->temp = (pFrame[3] << 8) | pFrame[4];
+                frame->advCnt = ((uint32_t)pFrame[5] << 24) | ((uint32_t)pFrame[6] << 16) |
+                                ((uint32_t)pFrame[7] << 8) | pFrame[8];
+                frame->secCnt = ((uint32_t)pFrame[9] << 24) | ((uint32_t)pFrame[10] << 16) |
+                                ((uint32_t)pFrame[11] << 8) | pFrame[12];
+                return SimpleBeacon_Status_Success;
+            }
+            return SimpleBeacon_Status_Param_Error;
+        }
+
+        i += adLen + 1;
+    }
+
+    return SimpleBeacon_Status_Param_Error;
+}
+
 //*****************************************************************************
 //
 //! \brief Send an Eddystone beacon
@@ -408,37 +574,8 @@ SimpleBeacon_Status SEB_sendFrame(SEB_FrameType type, uint8_t* deviceAddress, ui
     SimpleBeacon_Frame beaconFrame;
     SimpleBeacon_Status status = SimpleBeacon_Status_Success;
 
-    switch(type)
-    {
-    case SEB_FrameType_Uuid:
-        //Set length
-        eddystoneAdv.length = EDDYSTONE_SVC_DATA_OVERHEAD_LEN + EDDYSTONE_UUID_FRAME_LEN;
-        //Copy in data
-        memcpy(&eddystoneAdv.frame, &eUidFrame, sizeof(SEB_EUID_t));
-
-        beaconFrame.length = EDDYSTONE_FRAME_OVERHEAD_LEN + eddystoneAdv.length;
-        beaconFrame.pAdvData = (uint8_t*) &eddystoneAdv;
-
-        break;
-    case SEB_FrameType_Url:
-        //Set length
-        eddystoneAdv.length = urlFrameLen;
-        //Copy in data
-        memcpy(&eddystoneAdv.frame, &eUrlFrame, sizeof(SEB_EURL_t));
-
-        beaconFrame.length = EDDYSTONE_FRAME_OVERHEAD_LEN + eddystoneAdv.length;
-        beaconFrame.pAdvData = (uint8_t*) &eddystoneAdv;
-        break;
-    case SEB_FrameType_Tlm:
-        //Set length
-        eddystoneAdv.length = EDDYSTONE_SVC_DATA_OVERHEAD_LEN + EDDYSTONE_TLM_FRAME_LEN;
-        //Copy in data
-        memcpy(&eddystoneAdv.frame, &eTlmFrame, sizeof(SEB_ETLM_t));
-
-        beaconFrame.length = EDDYSTONE_FRAME_OVERHEAD_LEN + eddystoneAdv.length;
-        beaconFrame.pAdvData = (uint8_t*) &eddystoneAdv;
-        break;
-    }
+    beaconFrame.length = buildAdvData(type, &eddystoneAdv);
+    beaconFrame.pAdvData = (uint8_t*) &eddystoneAdv;
 
     //set the device address used in the rfc_CMD_BLE_ADV_NC_t command
     beaconFrame.deviceAddress = deviceAddress;
@@ -454,5 +591,78 @@ SimpleBeacon_Status SEB_sendFrame(SEB_FrameType type, uint8_t* deviceAddress, ui
     return status;
 }
 
+//*****************************************************************************
+//
+//! \brief Get an Eddystone beacon for a train
+//!
+//! This builds the frame into a buffer of its own for each frame type, that
+//! stays valid until the next call for the same type.
+//!
+//! \param type The frame type
+//! \param 6 Byte BLE MAC address
+//! \param beaconFrame Filled in with the beacon
+//!
+//! \return SimpleBeacon_Status
+//!
+//*****************************************************************************
+SimpleBeacon_Status SEB_getFrame(SEB_FrameType type, uint8_t* deviceAddress, SimpleBeacon_Frame *beaconFrame)
+{
+    if (type >= EDDYSTONE_FRAME_TYPES)
+    {
+        return SimpleBeacon_Status_Param_Error;
+    }
+
+    beaconFrame->length = buildAdvData(type, &eddystoneTrainAdv[type]);
+    beaconFrame->pAdvData = (uint8_t*) &eddystoneTrainAdv[type];
+    beaconFrame->deviceAddress = deviceAddress;
+
+    return SimpleBeacon_Status_Success;
+}
+
+//*****************************************************************************
+//
+//! \brief Send a train of Eddystone beacons
+//!
+//! This schedules a train of Eddystone advertisements and returns without
+//! waiting for them.
+//!
+//! \param types The frame types sent in each advertisement
+//! \param numTypes Number of frame types, at most SimpleBeacon_MaxTrainFrames
+//! \param 6 Byte BLE MAC address
+//! \param numTx Number of advertisements
+//! \param chanMask channel mask of channels to Tx on
+//! \param cb Callback called when the train is done, can be NULL
+//!
+//! \return SimpleBeacon_Status
+//!
+//*****************************************************************************
+SimpleBeacon_Status SEB_sendTrain(SEB_FrameType *types, uint8_t numTypes, uint8_t* deviceAddress,
+                                  uint32_t numTx, uint64_t chanMask, SimpleBeacon_TrainCb cb)
+{
+    SimpleBeacon_Frame beaconFrames[SimpleBeacon_MaxTrainFrames];
+    uint8_t i;
+
+    if (numTypes > SimpleBeacon_MaxTrainFrames)
+    {
+        return SimpleBeacon_Status_Param_Error;
+    }
+
+    //The advertisement data of a train in progress is still in use
+    if (SimpleBeacon_trainBusy())
+    {
+        return SimpleBeacon_Status_Busy;
+    }
+
+    for (i = 0; i < numTypes; i++)
+    {
+        if (SEB_getFrame(types[i], deviceAddress, &beaconFrames[i]) != SimpleBeacon_Status_Success)
+        {
+            return SimpleBeacon_Status_Param_Error;
+        }
+    }
+
+    return SimpleBeacon_sendTrain(beaconFrames, numTypes, numTx, chanMask, cb);
+}
+
 /*********************************************************************
 *********************************************************************/
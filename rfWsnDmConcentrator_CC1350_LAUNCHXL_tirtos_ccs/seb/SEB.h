@@ -57,6 +57,9 @@ extern "C"
  * CONSTANTS
  */
 
+/// \brief Maximum length of a decoded URL, including the terminating NUL
+#define SEB_MAX_URL_LEN     48
+
 /*********************************************************************
  * TYPEDEFS
  */
@@ -69,6 +72,17 @@ typedef enum
     SEB_FrameType_Tlm          = 2, ///TLM Frame
 } SEB_FrameType;
 
+/// \brief Eddystone frame received from another beacon
+typedef struct
+{
+    SEB_FrameType type;             ///Frame type
+    char url[SEB_MAX_URL_LEN];      ///URL frame: decoded URL
+    uint16_t battMv;                ///TLM frame: battery voltage in mV
+    uint16_t temp;                  ///TLM frame: temperature, fixed 8.8
+    uint32_t advCnt;                ///TLM frame: advertisement count
+    uint32_t secCnt;                ///TLM frame: time since boot
+} SEB_ParsedFrame;
+
 
 /*********************************************************************
  * FUNCTIONS
@@ -133,6 +147,37 @@ extern SimpleBeacon_Status SEB_initUrl(char* urlOrg, int8_t txPower);
 //*****************************************************************************
 extern SimpleBeacon_Status SEB_initTLM(uint16_t batt, uint16_t temp, uint32_t time100MiliSec);
 
+//*****************************************************************************
+//
+//! \brief Set the advertisement count of TLM frames
+//!
+//! This sets the count sent in the next TLM frame, which is then incremented
+//! for every TLM frame as before.
+//!
+//! \param count Advertisement count
+//!
+//! \return SimpleBeacon_Status
+//!
+//*****************************************************************************
+extern SimpleBeacon_Status SEB_setAdvCount(uint32_t count);
+
+//*****************************************************************************
+//
+//! \brief Parse a received Eddystone beacon
+//!
+//! This finds the Eddystone service data in advertising data and decodes
+//! URL and TLM frames.
+//!
+//! \param advData Advertising data
+//! \param advLen Length of the advertising data
+//! \param frame Filled in with the decoded frame
+//!
+//! \return SimpleBeacon_Status, SimpleBeacon_Status_Param_Error if it is not
+//!         an Eddystone URL or TLM frame
+//!
+//*****************************************************************************
+extern SimpleBeacon_Status SEB_parseFrame(uint8_t *advData, uint8_t advLen, SEB_ParsedFrame *frame);
+
 //*****************************************************************************
 //
 //! \brief Send an Eddystone beacon
@@ -149,6 +194,45 @@ extern SimpleBeacon_Status SEB_initTLM(uint16_t batt, uint16_t temp, uint32_t ti
 //*****************************************************************************
 extern SimpleBeacon_Status SEB_sendFrame(SEB_FrameType type, uint8_t* deviceAddress, uint32_t numTxPerChan, uint64_t chanMask);
 
+//*****************************************************************************
+//
+//! \brief Get an Eddystone beacon for a train
+//!
+//! This builds the frame for SimpleBeacon_sendTrain, to send it together with
+//! other frames. The frame stays valid until the next call for the same type,
+//! or an SEB_sendTrain with that type.
+//!
+//! \param type The frame type
+//! \param 6 Byte BLE MAC address
+//! \param beaconFrame Filled in with the beacon
+//!
+//! \return SimpleBeacon_Status
+//!
+//*****************************************************************************
+extern SimpleBeacon_Status SEB_getFrame(SEB_FrameType type, uint8_t* deviceAddress, SimpleBeacon_Frame *beaconFrame);
+
+//*****************************************************************************
+//
+//! \brief Send a train of Eddystone beacons
+//!
+//! This schedules a train of Eddystone advertisements and returns without
+//! waiting for them. Each advertisement sends all the frame types on every
+//! channel in the mask, the frames are copied so they can be updated while
+//! the train is in progress.
+//!
+//! \param types The frame types sent in each advertisement
+//! \param numTypes Number of frame types, at most SimpleBeacon_MaxTrainFrames
+//! \param 6 Byte BLE MAC address
+//! \param numTx Number of advertisements
+//! \param chanMask channel mask of channels to Tx on
+//! \param cb Callback called when the train is done, can be NULL
+//!
+//! \return SimpleBeacon_Status
+//!
+//*****************************************************************************
+extern SimpleBeacon_Status SEB_sendTrain(SEB_FrameType *types, uint8_t numTypes, uint8_t* deviceAddress,
+                                         uint32_t numTx, uint64_t chanMask, SimpleBeacon_TrainCb cb);
+
 
 /*********************************************************************
 *********************************************************************/
@@ -39,7 +39,8 @@
 /*********************************************************************
  * INCLUDES
  */
-#include <ti/sysbios/knl/Task.h>
+#include <string.h>
+#include <ti/sysbios/knl/Clock.h>
 
 // DriverLib
 #include <ti/drivers/rf/RF.h>
@@ -51,8 +52,12 @@
  */
 
 #include "SimpleBeacon.h"
+#include "trace/Trace.h"
 #include "smartrf_settings/smartrf_settings_ble.h"
 
+#include DEVICE_FAMILY_PATH(driverlib/rf_data_entry.h)
+#include DEVICE_FAMILY_PATH(driverlib/rf_ble_mailbox.h)
+
 /*********************************************************************
  * MACROS
  */
@@ -66,6 +71,22 @@
 
 #define RF_MODE_MULTIPLE       0x05
 
+#define RAT_TICKS_PER_US       4
+
+//Received advertisements are kept in a ring of data entries, each with the
+//PDU header and length, the advertiser address, 31 bytes of advertising data
+//and the appended RSSI
+#define SCAN_NUM_ENTRIES       2
+#define SCAN_ENTRY_DATA_LEN    44
+#define SCAN_ENTRY_WORDS       ((sizeof(rfc_dataEntryGeneral_t) - 1 + SCAN_ENTRY_DATA_LEN + 3) / 4)
+
+#define BLE_PDU_TYPE_MASK      0x0F
+#define BLE_PDU_ADV_IND        0x00
+#define BLE_PDU_ADV_NONCONN    0x02
+#define BLE_PDU_ADV_SCAN       0x06
+#define BLE_PDU_LEN_MASK       0x3F
+#define BLE_ADDR_LEN           6
+
 /*********************************************************************
  * TYPEDEFS
  */
@@ -77,7 +98,7 @@
 /*********************************************************************
  * EXTERNAL VARIABLES
  */
-/// \brief advertisement interval array in 100us units, optimised for iOS.
+/// \brief advertisement interval array in Clock ticks, optimised for iOS.
 ///        iOS guidlines state 152.5ms 211.25ms 318.75ms 417.5ms 546.25ms
 ///        760ms 852.5ms 1022.5ms and 1285ms. In this application we can
 ///        only advertise for 1s as the sub1G packet rate can be as high
@@ -97,10 +118,143 @@ static RF_Handle bleRfHandle;
 
 static bool configured = false;
 
+//Advertising train, one chain of commands per advertisement that is posted
+//again for the next one from the RF callback
+static rfc_CMD_BLE_ADV_NC_t trainCmds[SimpleBeacon_MaxTrainFrames * SimpleBeacon_MaxTrainChannels];
+static rfc_bleAdvPar_t trainParams[SimpleBeacon_MaxTrainFrames];
+static rfc_bleAdvOutput_t trainStats;
+static SimpleBeacon_TrainCb trainCb;
+static uint32_t trainNumTx;
+static uint32_t trainTxCnt;
+static uint32_t trainRadioTime;
+static bool trainBusy = false;
+
+//Observer scan, one CMD_BLE_GENERIC_RX per scan window
+static rfc_CMD_BLE_GENERIC_RX_t scanCmd;
+static rfc_bleGenericRxPar_t scanParams;
+static dataQueue_t scanQueue;
+static uint32_t scanEntries[SCAN_NUM_ENTRIES][SCAN_ENTRY_WORDS];
+static rfc_dataEntryGeneral_t *scanCurrEntry;
+static SimpleBeacon_ScanRxCb scanRxCb;
+static SimpleBeacon_ScanDoneCb scanDoneCb;
+static bool scanBusy = false;
+
 /*********************************************************************
  * LOCAL FUNCTIONS
  */
 
+//Returns the time from the start of an advertisement to the next one in
+//radio timer ticks
+static uint32_t advInterval(uint32_t txCnt)
+{
+    uint32_t interval = SimpleBeacon_DefaultAdvertisementInterval;
+
+    if(txCnt < SimpleBeacon_AdvertisementTimes - 1)
+    {
+        interval = SimpleBeacon_AdvertisementIntervals[txCnt];
+    }
+
+    return interval * Clock_tickPeriod * RAT_TICKS_PER_US;
+}
+
+static void trainDoneCallback(RF_Handle h, RF_CmdHandle ch, RF_EventMask e);
+
+//Posts the command chain of the next advertisement at its start time
+static bool postTrainAdv(uint32_t startTime)
+{
+    RF_CmdHandle cmdHandle;
+
+    trainCmds[0].startTime = startTime;
+
+    Trace_record(Trace_Event_RfCmdPost, 0, trainCmds[0].commandNo);
+    cmdHandle = RF_postCmd(bleRfHandle, (RF_Op*)&trainCmds[0],
+            RF_PriorityNormal, trainDoneCallback, 0);
+
+    return (cmdHandle >= 0);
+}
+
+static void trainDoneCallback(RF_Handle h, RF_CmdHandle ch, RF_EventMask e)
+{
+    SimpleBeacon_Status status = SimpleBeacon_Status_Success;
+    uint32_t startTime = trainCmds[0].startTime;
+    SimpleBeacon_TrainCb cb;
+
+    Trace_record(Trace_Event_RfCmdDone, Trace_rfStatus(trainCmds[0].status),
+            trainCmds[0].commandNo);
+
+    trainRadioTime += RF_getCurrentTime() - startTime;
+    trainTxCnt++;
+
+    if (!(e & RF_EventLastCmdDone))
+    {
+        status = SimpleBeacon_Status_Tx_Error;
+    }
+    else if (trainTxCnt < trainNumTx)
+    {
+        if (postTrainAdv(startTime + advInterval(trainTxCnt - 1)))
+        {
+            return;
+        }
+        status = SimpleBeacon_Status_Config_Error;
+    }
+
+    cb = trainCb;
+    trainBusy = false;
+
+    if (cb != NULL)
+    {
+        cb(status, trainRadioTime);
+    }
+}
+
+//Passes the advertisement in a finished scan entry to the callback
+static void scanProcessEntry(rfc_dataEntryGeneral_t *entry)
+{
+    uint8_t *pdu = &entry->data;
+    uint8_t pduType = pdu[0] & BLE_PDU_TYPE_MASK;
+    uint8_t payloadLen = pdu[1] & BLE_PDU_LEN_MASK;
+
+    if (((pduType == BLE_PDU_ADV_NONCONN) || (pduType == BLE_PDU_ADV_SCAN) ||
+         (pduType == BLE_PDU_ADV_IND)) &&
+        (payloadLen >= BLE_ADDR_LEN) &&
+        (2 + payloadLen < SCAN_ENTRY_DATA_LEN))
+    {
+        //The RSSI is appended after the payload
+        scanRxCb(&pdu[2], &pdu[2 + BLE_ADDR_LEN], payloadLen - BLE_ADDR_LEN,
+                 (int8_t)pdu[2 + payloadLen]);
+    }
+}
+
+static void scanDoneCallback(RF_Handle h, RF_CmdHandle ch, RF_EventMask e)
+{
+    SimpleBeacon_ScanDoneCb cb;
+
+    //Hand every finished entry to the callback and give it back to the radio
+    while (scanCurrEntry->status == DATA_ENTRY_FINISHED)
+    {
+        scanProcessEntry(scanCurrEntry);
+        scanCurrEntry->status = DATA_ENTRY_PENDING;
+        scanCurrEntry = (rfc_dataEntryGeneral_t*)scanCurrEntry->pNextEntry;
+    }
+
+    if (!(e & RF_EventLastCmdDone))
+    {
+        return;
+    }
+
+    Trace_record(Trace_Event_RfCmdDone, Trace_rfStatus(scanCmd.status), scanCmd.commandNo);
+
+    cb = scanDoneCb;
+    scanBusy = false;
+
+    if (cb != NULL)
+    {
+        cb(((scanCmd.status == BLE_DONE_OK) || (scanCmd.status == BLE_DONE_RXTIMEOUT) ||
+            (scanCmd.status == BLE_DONE_ENDED)) ?
+           SimpleBeacon_Status_Success : SimpleBeacon_Status_Rx_Error);
+    }
+}
+
 /*********************************************************************
  * PUBLIC FUNCTIONS
  */
@@ -159,6 +313,7 @@ SimpleBeacon_Status SimpleBeacon_sendFrame(SimpleBeacon_Frame beaconFrame, uint3
     SimpleBeacon_Status status = SimpleBeacon_Status_Success;
     uint32_t txCnt;
     uint32_t chIdx;
+    uint32_t startTime = 0;
     rfc_bleAdvOutput_t advStats = {0};
 
     if(!configured)
@@ -166,14 +321,17 @@ SimpleBeacon_Status SimpleBeacon_sendFrame(SimpleBeacon_Frame beaconFrame, uint3
         return SimpleBeacon_Status_Config_Error;
     }
 
+    if(trainBusy || scanBusy)
+    {
+        return SimpleBeacon_Status_Busy;
+    }
+
     if(numTxPerChan == 0)
     {
         numTxPerChan = SimpleBeacon_AdvertisementTimes;
     }
 
-    RF_ble_pCmdBleAdvNc->startTrigger.triggerType = TRIG_NOW;
     RF_ble_pCmdBleAdvNc->startTrigger.pastTrig = 1;
-    RF_ble_pCmdBleAdvNc->startTime = 0;
 
     RF_ble_pCmdBleAdvNc->pParams->advLen = beaconFrame.length;
 
@@ -201,26 +359,30 @@ SimpleBeacon_Status SimpleBeacon_sendFrame(SimpleBeacon_Frame beaconFrame, uint3
                 RF_ble_pCmdBleAdvNc->channel = chIdx;
                 RF_ble_pCmdBleAdvNc->whitening.init = 0x40 + chIdx;
 
+                if (txCnt == 0)
+                {
+                    RF_ble_pCmdBleAdvNc->startTrigger.triggerType = TRIG_NOW;
+                    startTime = RF_getCurrentTime();
+                }
+                else
+                {
+                    //start one interval after the previous advertisement,
+                    //timed by the radio
+                    RF_ble_pCmdBleAdvNc->startTrigger.triggerType = TRIG_ABSTIME;
+                    startTime += advInterval(txCnt - 1);
+                }
+                RF_ble_pCmdBleAdvNc->startTime = startTime;
+
+                Trace_record(Trace_Event_RfCmdPost, 0, RF_ble_pCmdBleAdvNc->commandNo);
                 result = RF_runCmd(bleRfHandle, (RF_Op*)RF_ble_pCmdBleAdvNc,
                         RF_PriorityNormal, 0, 0);
+                Trace_record(Trace_Event_RfCmdDone, Trace_rfStatus(RF_ble_pCmdBleAdvNc->status),
+                        RF_ble_pCmdBleAdvNc->commandNo);
 
                 if (!(result & RF_EventLastCmdDone))
                 {
                     status = SimpleBeacon_Status_Tx_Error;
                 }
-
-                //sleep on all but last advertisement
-                if (txCnt+1 < numTxPerChan)
-                {
-                    uint32_t sleepTime = SimpleBeacon_DefaultAdvertisementInterval;
-
-                    if(txCnt < SimpleBeacon_AdvertisementTimes)
-                    {
-                        sleepTime = SimpleBeacon_AdvertisementIntervals[txCnt];
-                    }
-
-                    Task_sleep(sleepTime);
-                }
             }
         }
     }
@@ -233,6 +395,231 @@ SimpleBeacon_Status SimpleBeacon_sendFrame(SimpleBeacon_Frame beaconFrame, uint3
     return status;
 }
 
+//*****************************************************************************
+//
+//! \brief Send a train of advertisements
+//!
+//! This function schedules numTx advertisements, spaced by the
+//! SimpleBeacon_AdvertisementIntervals, and returns without waiting for them.
+//!
+//! \param beaconFrames Array of numFrames beacons to be advertised
+//! \param numFrames Number of frames, at most SimpleBeacon_MaxTrainFrames
+//! \param numTx Number of advertisements, if 0 use default
+//! \param chanMask channel mask of channels to advertise on
+//! \param cb Callback called when the train is done, can be NULL
+//!
+//! \return SimpleBeacon_Status
+//!
+//*****************************************************************************
+SimpleBeacon_Status SimpleBeacon_sendTrain(SimpleBeacon_Frame *beaconFrames, uint8_t numFrames,
+                                           uint32_t numTx, uint64_t chanMask, SimpleBeacon_TrainCb cb)
+{
+    uint32_t numCmds = 0;
+    uint32_t chIdx;
+    uint8_t frameIdx;
+
+    if(!configured)
+    {
+        return SimpleBeacon_Status_Config_Error;
+    }
+
+    if((beaconFrames == NULL) || (numFrames == 0) ||
+       (numFrames > SimpleBeacon_MaxTrainFrames))
+    {
+        return SimpleBeacon_Status_Param_Error;
+    }
+
+    if(trainBusy || scanBusy)
+    {
+        return SimpleBeacon_Status_Busy;
+    }
+
+    if(numTx == 0)
+    {
+        numTx = SimpleBeacon_AdvertisementTimes;
+    }
+
+    for (frameIdx = 0; frameIdx < numFrames; frameIdx++)
+    {
+        memcpy(&trainParams[frameIdx], RF_ble_pCmdBleAdvNc->pParams, sizeof(rfc_bleAdvPar_t));
+        trainParams[frameIdx].advLen = beaconFrames[frameIdx].length;
+        trainParams[frameIdx].pAdvData = beaconFrames[frameIdx].pAdvData;
+        trainParams[frameIdx].pDeviceAddress = (uint16_t*) beaconFrames[frameIdx].deviceAddress;
+    }
+
+    //chain all frames on all channels, only the first command of the chain
+    //waits for the start of the advertisement
+    for (chIdx = 0; chIdx < 40; chIdx++)
+    {
+        if (!(chanMask & ((uint64_t)1<<chIdx)))
+        {
+            continue;
+        }
+
+        for (frameIdx = 0; frameIdx < numFrames; frameIdx++)
+        {
+            rfc_CMD_BLE_ADV_NC_t *pCmd;
+
+            if (numCmds == SimpleBeacon_MaxTrainFrames * SimpleBeacon_MaxTrainChannels)
+            {
+                return SimpleBeacon_Status_Param_Error;
+            }
+
+            pCmd = &trainCmds[numCmds];
+            memcpy(pCmd, RF_ble_pCmdBleAdvNc, sizeof(rfc_CMD_BLE_ADV_NC_t));
+            pCmd->channel = chIdx;
+            pCmd->whitening.init = 0x40 + chIdx;
+            pCmd->pParams = &trainParams[frameIdx];
+            pCmd->pOutput = &trainStats;
+            pCmd->startTrigger.triggerType = TRIG_NOW;
+            pCmd->startTrigger.pastTrig = 1;
+            pCmd->startTime = 0;
+            pCmd->condition.rule = COND_NEVER;
+            pCmd->pNextOp = NULL;
+
+            if (numCmds > 0)
+            {
+                trainCmds[numCmds - 1].condition.rule = COND_ALWAYS;
+                trainCmds[numCmds - 1].pNextOp = (rfc_radioOp_t*)pCmd;
+            }
+            numCmds++;
+        }
+    }
+
+    if (numCmds == 0)
+    {
+        return SimpleBeacon_Status_Param_Error;
+    }
+
+    trainCmds[0].startTrigger.triggerType = TRIG_ABSTIME;
+
+    trainCb = cb;
+    trainNumTx = numTx;
+    trainTxCnt = 0;
+    trainRadioTime = 0;
+    trainBusy = true;
+
+    if (!postTrainAdv(RF_getCurrentTime()))
+    {
+        trainBusy = false;
+        return SimpleBeacon_Status_Config_Error;
+    }
+
+    return SimpleBeacon_Status_Success;
+}
+
+//*****************************************************************************
+//
+//! \brief Checks for an advertising train in progress
+//!
+//! \return true from SimpleBeacon_sendTrain until the train callback
+//!
+//*****************************************************************************
+bool SimpleBeacon_trainBusy(void)
+{
+    return trainBusy;
+}
+
+//*****************************************************************************
+//
+//! \brief Scan for advertisements
+//!
+//! This function starts listening for advertisements on one channel for
+//! scanTime and returns without waiting for it.
+//!
+//! \param channel BLE channel to listen on, 37 to 39
+//! \param scanTime Length of the scan window in radio timer ticks
+//! \param rxCb Callback called for each advertisement
+//! \param doneCb Callback called when the scan window is over, can be NULL
+//!
+//! \return SimpleBeacon_Status
+//!
+//*****************************************************************************
+SimpleBeacon_Status SimpleBeacon_startScan(uint8_t channel, uint32_t scanTime,
+                                           SimpleBeacon_ScanRxCb rxCb, SimpleBeacon_ScanDoneCb doneCb)
+{
+    RF_CmdHandle cmdHandle;
+    uint8_t i;
+
+    if(!configured)
+    {
+        return SimpleBeacon_Status_Config_Error;
+    }
+
+    if((channel < 37) || (channel > 39) || (rxCb == NULL))
+    {
+        return SimpleBeacon_Status_Param_Error;
+    }
+
+    if(trainBusy || scanBusy)
+    {
+        return SimpleBeacon_Status_Busy;
+    }
+
+    //Ring of pending entries for the radio to receive into
+    for (i = 0; i < SCAN_NUM_ENTRIES; i++)
+    {
+        rfc_dataEntryGeneral_t *entry = (rfc_dataEntryGeneral_t*)scanEntries[i];
+
+        entry->pNextEntry = (uint8_t*)scanEntries[(i + 1) % SCAN_NUM_ENTRIES];
+        entry->status = DATA_ENTRY_PENDING;
+        entry->config.type = DATA_ENTRY_TYPE_GEN;
+        entry->config.lenSz = 0;
+        entry->length = SCAN_ENTRY_DATA_LEN;
+    }
+    scanQueue.pCurrEntry = (uint8_t*)scanEntries[0];
+    scanQueue.pLastEntry = NULL;
+    scanCurrEntry = (rfc_dataEntryGeneral_t*)scanEntries[0];
+
+    memcpy(&scanParams, RF_ble_pCmdBleGenericRx->pParams, sizeof(rfc_bleGenericRxPar_t));
+    scanParams.pRxQ = &scanQueue;
+    scanParams.rxConfig.bAutoFlushIgnored = 1;
+    scanParams.rxConfig.bAutoFlushCrcErr = 1;
+    scanParams.rxConfig.bIncludeLenByte = 1;
+    scanParams.rxConfig.bIncludeCrc = 0;
+    scanParams.rxConfig.bAppendRssi = 1;
+    scanParams.rxConfig.bAppendStatus = 0;
+    scanParams.bRepeat = 1;
+    scanParams.endTrigger.triggerType = TRIG_REL_START;
+    scanParams.endTime = scanTime;
+
+    memcpy(&scanCmd, RF_ble_pCmdBleGenericRx, sizeof(rfc_CMD_BLE_GENERIC_RX_t));
+    scanCmd.channel = channel;
+    scanCmd.whitening.init = 0x40 + channel;
+    scanCmd.pParams = &scanParams;
+    scanCmd.pOutput = NULL;
+    scanCmd.startTrigger.triggerType = TRIG_NOW;
+    scanCmd.startTrigger.pastTrig = 1;
+    scanCmd.startTime = 0;
+
+    scanRxCb = rxCb;
+    scanDoneCb = doneCb;
+    scanBusy = true;
+
+    Trace_record(Trace_Event_RfCmdPost, 0, scanCmd.commandNo);
+    cmdHandle = RF_postCmd(bleRfHandle, (RF_Op*)&scanCmd, RF_PriorityNormal,
+            scanDoneCallback, RF_EventRxEntryDone);
+    if (cmdHandle < 0)
+    {
+        scanBusy = false;
+        return SimpleBeacon_Status_Config_Error;
+    }
+
+    return SimpleBeacon_Status_Success;
+}
+
+//*****************************************************************************
+//
+//! \brief Checks for a scan in progress
+//!
+//! \return true from SimpleBeacon_startScan until the done callback
+//!
+//*****************************************************************************
+bool SimpleBeacon_scanBusy(void)
+{
+    return scanBusy;
+}
+
 //*****************************************************************************
 //
 //! \brief Gets the IEEE address
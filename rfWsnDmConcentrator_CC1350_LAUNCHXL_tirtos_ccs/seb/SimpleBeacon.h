@@ -69,6 +69,7 @@ typedef enum
     SimpleBeacon_Status_Param_Error     = 2, ///Param error
     SimpleBeacon_Status_Tx_Error        = 5, ///Tx Error
     SimpleBeacon_Status_Rx_Error        = 6, ///Tx Error
+    SimpleBeacon_Status_Busy            = 7, ///Advertising train in progress
 } SimpleBeacon_Status;
 
 /// \brief Structure for the BLE Advertisement Packet
@@ -80,7 +81,27 @@ typedef struct
     uint8_t *pAdvData;            ///Advertisement data
 } SimpleBeacon_Frame;
 
-/// \brief advertisement interval array in 100us units, optimised for iOS.
+/// \brief Advertising train complete callback, called from the RF driver
+///        callback context.
+///
+/// \param status Success, or the error that ended the train
+/// \param radioTime Radio timer ticks spent advertising
+typedef void (*SimpleBeacon_TrainCb)(SimpleBeacon_Status status, uint32_t radioTime);
+
+/// \brief Advertisement received callback, called from the RF driver
+///        callback context. The data is only valid during the call.
+///
+/// \param advAddress 6 byte address of the advertiser
+/// \param advData Advertising data
+/// \param advLen Length of the advertising data
+/// \param rssi RSSI of the advertisement in dBm
+typedef void (*SimpleBeacon_ScanRxCb)(uint8_t *advAddress, uint8_t *advData, uint8_t advLen, int8_t rssi);
+
+/// \brief Scan window done callback, called from the RF driver callback
+///        context.
+typedef void (*SimpleBeacon_ScanDoneCb)(SimpleBeacon_Status status);
+
+/// \brief advertisement interval array in Clock ticks, optimised for iOS.
 ///        iOS guidlines state 152.5ms 211.25ms 318.75ms 417.5ms 546.25ms
 ///        760ms 852.5ms 1022.5ms and 1285ms. In this application we can
 ///        only advertise for 1s as the sub1G packet rate can be as high
@@ -95,6 +116,13 @@ extern uint32_t SimpleBeacon_AdvertisementIntervals[];
 /// \brief number of advertisement packets sent in 1 period.
 #define SimpleBeacon_AdvertisementTimes  10
 
+/// \brief maximum number of frames sent back to back in each advertisement
+///        of a train
+#define SimpleBeacon_MaxTrainFrames  3
+
+/// \brief maximum number of channels in the channel mask of a train
+#define SimpleBeacon_MaxTrainChannels  3
+
 /*********************************************************************
  * FUNCTIONS
  */
@@ -154,6 +182,68 @@ extern SimpleBeacon_Status SimpleBeacon_close(void);
 //*****************************************************************************
 extern SimpleBeacon_Status SimpleBeacon_sendFrame(SimpleBeacon_Frame beaconFrame, uint32_t numTxPerChan, uint64_t chanMask);
 
+//*****************************************************************************
+//
+//! \brief Send a train of advertisements
+//!
+//! This function schedules numTx advertisements, spaced by the
+//! SimpleBeacon_AdvertisementIntervals, and returns without waiting for them.
+//! Each advertisement sends all frames on every channel in the mask back to
+//! back. The start of every advertisement is timed by the radio, so the CPU
+//! can sleep in between. The frames and their data must stay valid until the
+//! callback is called.
+//!
+//! \param beaconFrames Array of numFrames beacons to be advertised
+//! \param numFrames Number of frames, at most SimpleBeacon_MaxTrainFrames
+//! \param numTx Number of advertisements, if 0 use default
+//! \param chanMask channel mask of channels to advertise on, at most
+//!                 SimpleBeacon_MaxTrainChannels channels
+//! \param cb Callback called when the train is done, can be NULL
+//!
+//! \return SimpleBeacon_Status
+//!
+//*****************************************************************************
+extern SimpleBeacon_Status SimpleBeacon_sendTrain(SimpleBeacon_Frame *beaconFrames, uint8_t numFrames,
+                                                  uint32_t numTx, uint64_t chanMask, SimpleBeacon_TrainCb cb);
+
+//*****************************************************************************
+//
+//! \brief Checks for an advertising train in progress
+//!
+//! \return true from SimpleBeacon_sendTrain until the train callback
+//!
+//*****************************************************************************
+extern bool SimpleBeacon_trainBusy(void);
+
+//*****************************************************************************
+//
+//! \brief Scan for advertisements
+//!
+//! This function starts listening for advertisements on one channel for
+//! scanTime and returns without waiting for it. rxCb is called for every
+//! non-connectable, scannable or connectable undirected advertisement with a
+//! valid CRC.
+//!
+//! \param channel BLE channel to listen on, 37 to 39
+//! \param scanTime Length of the scan window in radio timer ticks
+//! \param rxCb Callback called for each advertisement
+//! \param doneCb Callback called when the scan window is over, can be NULL
+//!
+//! \return SimpleBeacon_Status
+//!
+//*****************************************************************************
+extern SimpleBeacon_Status SimpleBeacon_startScan(uint8_t channel, uint32_t scanTime,
+                                                  SimpleBeacon_ScanRxCb rxCb, SimpleBeacon_ScanDoneCb doneCb);
+
+//*****************************************************************************
+//
+//! \brief Checks for a scan in progress
+//!
+//! \return true from SimpleBeacon_startScan until the done callback
+//!
+//*****************************************************************************
+extern bool SimpleBeacon_scanBusy(void);
+
 /*********************************************************************
 *********************************************************************/
 
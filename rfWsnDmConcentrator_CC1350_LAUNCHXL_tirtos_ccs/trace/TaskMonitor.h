@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2015-2016, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TASKMONITOR_H_
+#define TASKMONITOR_H_
+
+#include "stdint.h"
+
+#include <ti/sysbios/knl/Task.h>
+
+/* Per task CPU load and stack high-water marks.
+ *
+ * The run time of each task is measured by TaskMonitor_taskSwitchHook, which
+ * release.cfg installs as a Task hook, and turned into a load every period
+ * given to TaskMonitor_init. Time spent in Hwis and Swis is counted to the
+ * task they preempted. The stack high-water mark is found by Task_stat, which
+ * scans the stack for the fill pattern written when the task was created.
+ *
+ * The trace/ directory is shared, keep all projects' copies identical.
+ */
+
+/* Number of tasks tracked, tasks seen after this are not measured */
+#ifndef TASKMONITOR_MAX_TASKS
+#define TASKMONITOR_MAX_TASKS   6
+#endif
+
+typedef struct
+{
+    Task_Handle handle;
+    uint8_t priority;
+    uint16_t loadPermille; //share of the CPU time in the last completed period
+    uint16_t stackSize;
+    uint16_t stackUsed; //high-water mark since the task was created
+} TaskMonitor_Stats;
+
+/* Line printer used by TaskMonitor_print, e.g. a UART Display_printf wrapper */
+typedef void (*TaskMonitor_PrintFxn)(const char* line);
+
+/* Starts computing the load every periodMs */
+void TaskMonitor_init(uint32_t periodMs);
+
+/* Fills in up to maxTasks entries of stats, from task context since the stacks
+ * are scanned. Returns the number of entries filled in. */
+uint8_t TaskMonitor_getStats(TaskMonitor_Stats* stats, uint8_t maxTasks);
+
+/* Prints one line per task, from task context */
+void TaskMonitor_print(TaskMonitor_PrintFxn printFxn);
+
+/* Task switch hook, installed from release.cfg */
+void TaskMonitor_taskSwitchHook(Task_Handle prev, Task_Handle next);
+
+#endif /* TASKMONITOR_H_ */
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2015-2016, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/***** Includes *****/
+#include "AdaptiveSampler.h"
+#include "SceAdc.h"
+
+#include <xdc/std.h>
+#include <stdlib.h>
+
+#include <ti/sysbios/knl/Clock.h>
+
+/***** Variable declarations *****/
+static uint16_t periodS;
+static bool haveReading;
+static int16_t lastTemp;
+static int16_t lastSentTemp;
+static uint32_t lastReadingTicks;
+static uint32_t lastSentTicks;
+
+/***** Prototypes *****/
+static uint32_t secondsSince(uint32_t ticks, uint32_t now);
+
+/***** Function definitions *****/
+void AdaptiveSampler_init(void)
+{
+    haveReading = false;
+    periodS = ADAPTIVESAMPLER_MIN_PERIOD_S;
+    SceAdc_setPeriod(periodS);
+}
+
+bool AdaptiveSampler_addReading(int16_t temp)
+{
+    uint32_t now = Clock_getTicks();
+    uint32_t nextS;
+    bool send;
+
+    if (!haveReading)
+    {
+        haveReading = true;
+        send = true;
+    }
+    else
+    {
+        /* Rate of change since the previous reading, per minute */
+        uint32_t elapsedS = secondsSince(lastReadingTicks, now);
+        uint32_t rate = ((uint32_t)abs(temp - lastTemp) * 60) / ((elapsedS != 0) ? elapsedS : 1);
+
+        if (rate >= ADAPTIVESAMPLER_FAST_RATE)
+        {
+            periodS = ADAPTIVESAMPLER_MIN_PERIOD_S;
+        }
+        else if (periodS < ADAPTIVESAMPLER_MAX_PERIOD_S / 2)
+        {
+            periodS *= 2;
+        }
+        else
+        {
+            periodS = ADAPTIVESAMPLER_MAX_PERIOD_S;
+        }
+
+        /* Send if the value moved, or if the heartbeat would pass before a
+         * sample at the minimum period */
+        send = (abs(temp - lastSentTemp) >= ADAPTIVESAMPLER_SEND_DELTA) ||
+               (secondsSince(lastSentTicks, now) + ADAPTIVESAMPLER_MIN_PERIOD_S > ADAPTIVESAMPLER_HEARTBEAT_S);
+    }
+
+    lastTemp = temp;
+    lastReadingTicks = now;
+    if (send)
+    {
+        lastSentTemp = temp;
+        lastSentTicks = now;
+    }
+
+    /* Take the next sample no later than the heartbeat deadline, which is at
+     * least the minimum period away as the reading was not sent otherwise */
+    nextS = ADAPTIVESAMPLER_HEARTBEAT_S - secondsSince(lastSentTicks, now);
+    if (nextS > periodS)
+    {
+        nextS = periodS;
+    }
+    SceAdc_setPeriod(nextS);
+
+    return send;
+}
+
+uint16_t AdaptiveSampler_getPeriodS(void)
+{
+    return periodS;
+}
+
+uint16_t AdaptiveSampler_getHeartbeatS(void)
+{
+    return ADAPTIVESAMPLER_HEARTBEAT_S;
+}
+
+/* Whole seconds from ticks to now, Clock ticks wrap after about 12 hours
+ * which is well beyond the heartbeat */
+static uint32_t secondsSince(uint32_t ticks, uint32_t now)
+{
+    return ((now - ticks) / (1000000 / Clock_tickPeriod));
+}
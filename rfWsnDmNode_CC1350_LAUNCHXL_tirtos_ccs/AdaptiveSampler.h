@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2015-2016, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ADAPTIVESAMPLER_H_
+#define ADAPTIVESAMPLER_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+
+/* Adapts the SCE sampling period to how fast the temperature changes, and
+ * decides which readings are sent. The period drops to the minimum while the
+ * temperature changes faster than the fast rate and doubles after each slower
+ * reading, up to the maximum. A reading is sent when it differs from the last
+ * one sent by the send delta, or when the heartbeat would otherwise pass
+ * without a packet. The sampling is scheduled so a sample is always taken
+ * before the heartbeat runs out.
+ *
+ * The limits can be overridden at the project level. Temperatures are in
+ * fixed 8.8 notation. */
+
+#ifndef ADAPTIVESAMPLER_MIN_PERIOD_S
+#define ADAPTIVESAMPLER_MIN_PERIOD_S    10
+#endif
+#ifndef ADAPTIVESAMPLER_MAX_PERIOD_S
+#define ADAPTIVESAMPLER_MAX_PERIOD_S    600
+#endif
+#ifndef ADAPTIVESAMPLER_HEARTBEAT_S
+#define ADAPTIVESAMPLER_HEARTBEAT_S     600
+#endif
+
+/* 0.25 C */
+#ifndef ADAPTIVESAMPLER_SEND_DELTA
+#define ADAPTIVESAMPLER_SEND_DELTA      64
+#endif
+
+/* 0.5 C per minute */
+#ifndef ADAPTIVESAMPLER_FAST_RATE
+#define ADAPTIVESAMPLER_FAST_RATE       128
+#endif
+
+#if ADAPTIVESAMPLER_HEARTBEAT_S < ADAPTIVESAMPLER_MIN_PERIOD_S
+#error "The heartbeat must be at least the minimum sampling period"
+#endif
+
+/* Sets the minimum sampling period, call after SceAdc_init */
+void AdaptiveSampler_init(void);
+
+/* Takes a new reading, sets the period until the next one and returns true
+ * if the reading should be sent */
+bool AdaptiveSampler_addReading(int16_t temp);
+
+/* Current sampling period, before it is cut short by the heartbeat */
+uint16_t AdaptiveSampler_getPeriodS(void);
+
+/* Longest time between two sent readings */
+uint16_t AdaptiveSampler_getHeartbeatS(void);
+
+#endif /* ADAPTIVESAMPLER_H_ */
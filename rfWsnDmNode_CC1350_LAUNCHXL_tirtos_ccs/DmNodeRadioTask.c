@@ -44,6 +44,7 @@
 #include <seb/SEB.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 /* Drivers */
 #include <ti/drivers/rf/RF.h>
@@ -55,7 +56,6 @@
 #ifdef DEVICE_FAMILY
     #undef DEVICE_FAMILY_PATH
     #define DEVICE_FAMILY_PATH(x) <ti/devices/DEVICE_FAMILY/x>
-    #include DEVICE_FAMILY_PATH(driverlib/trng.h)
     #include DEVICE_FAMILY_PATH(driverlib/aon_batmon.h)
     #include DEVICE_FAMILY_PATH(driverlib/aux_adc.h) //for ADC operations
 #else
@@ -64,7 +64,16 @@
 #include <DmNodeRadioTask.h>
 
 #include "easylink/EasyLink.h"
+#include "smartrf_settings/smartrf_settings_predefined.h"
 #include "RadioProtocol.h"
+#include "TimeSync.h"
+#include "EnergyMonitor.h"
+#include "AdaptiveSampler.h"
+#include "trace/TaskMonitor.h"
+#include "pool/PacketPool.h"
+#include "trace/Trace.h"
+#include "crypto/PacketCrypto.h"
+#include "extflash/ExtFlash.h"
 
 
 /***** Defines *****/
@@ -77,15 +86,57 @@
 #define RADIO_EVENT_ACK_TIMEOUT         (uint32_t)(1 << 2)
 #define RADIO_EVENT_SEND_FAIL           (uint32_t)(1 << 3)
 #define RADIO_EVENT_SEND_BLE_BEACON     (uint32_t)(1 << 4)
+#define RADIO_EVENT_TIME_SYNC_DONE      (uint32_t)(1 << 5)
+#define RADIO_EVENT_SEND_ENERGY_REPORT  (uint32_t)(1 << 6)
+#define RADIO_EVENT_SEND_TASK_STATS     (uint32_t)(1 << 7)
 
 #define NODERADIO_MAX_RETRIES 2
 #define NORERADIO_ACK_TIMEOUT_TIME_MS (160)
 
+/* Guard time on each side of a learned ACK receive window, covering the whole
+ * ms scheduling of the ACK and the interrupt latency on both sides */
+#define NODERADIO_ACK_GUARD_TIME        EasyLink_ms_To_RadioTime(3)
+
+/* How long before a scheduled receive window the task wakes up */
+#define NODERADIO_WAKEUP_LEAD_TIME      EasyLink_ms_To_RadioTime(5)
+
+/* Part of the concentrator fast PHY window used for the first TX, leaving
+ * room for the concentrator to switch PHY before and for retries after */
+#define NODERADIO_FAST_PHY_TX_START_MS  200
+#define NODERADIO_FAST_PHY_TX_END_MS    (RADIO_FAST_PHY_WINDOW_MS - 600)
+
+/* Link margin the TX power is regulated to, in dB above the concentrator's
+ * sensitivity, and how far the margin may drift before the power is changed */
+#define NODERADIO_TARGET_LINK_MARGIN        15
+#define NODERADIO_LINK_MARGIN_HYSTERESIS    5
+
+/* The address assigned by the concentrator is kept in the external flash,
+ * as a magic number, the address, the frame counter limit and a sequence
+ * number, big endian, followed by a check byte. The record alternates between
+ * the first two sectors, so the previous one stays valid until the new one is
+ * written and the one with the highest sequence number is used. */
+#define NODERADIO_ADDRESS_FLASH_OFFSET  0x00000
+#define NODERADIO_ADDRESS_MAGIC         0x4A43
+#define NODERADIO_ADDRESS_RECORD_SIZE   13
+#define NODERADIO_ADDRESS_RECORD_SLOTS  2
+
+/* Frame counters are reserved in blocks of this many, so the record is only
+ * written once per block of packets */
+#define NODERADIO_FRAME_COUNTER_BLOCK   1024
+
+/* Pause after a join attempt and its retries got no answer */
+#define NODERADIO_JOIN_RETRY_MS         10000
+
+/* Trace marker ids */
+#define NODERADIO_TRACE_BLE_ADV         1
+#define NODERADIO_TRACE_TIME_SYNC       2
+
 #define NODE_0M_TXPOWER    -10
 
 /***** Type declarations *****/
 struct RadioOperation {
-    EasyLink_TxPacket easyLinkTxPacket;
+    EasyLink_TxPacket* easyLinkTxPacket; //From the PacketPool until the operation is done
+    uint8_t txPowerOffset; //Payload byte holding the TX power, updated on retries
     uint8_t retriesDone;
     uint8_t maxNumberOfRetries;
     uint32_t ackTimeoutMs;
@@ -104,11 +155,39 @@ Semaphore_Struct radioResultSem;  /* not static so you can see in ROV */
 static Semaphore_Handle radioResultSemHandle;
 static struct RadioOperation currentRadioOperation;
 static uint16_t adcData;
-static uint8_t nodeAddress = 0;
+static uint16_t nodeAddress = 0;
+static uint8_t ieeeAddr[RADIO_IEEE_ADDRESS_SIZE];
+static bool joining = false;
+static uint16_t joinedAddress; /* from the join response */
 static struct DualModeInternalTempSensorPacket dmInternalTempSensorPacket;
 static uint32_t prevTicks;
 static uint8_t bleMacAddr[6];
 static Node_AdvertiserType advertiserType = Node_AdvertiserNone;
+static uint32_t txDoneTime;
+/* Learned time from the end of our TX to the ACK sync word, and from the ACK
+ * sync word to the end of the ACK. 0 until the first ACK is received. */
+static uint32_t ackLatency = 0;
+static uint32_t ackDuration = 0;
+static bool listeningForTimeSync = false;
+/* Radio time the current receive started, for the energy accounting */
+static uint32_t rxOnTime;
+static uint8_t addrFilterTable[EASYLINK_MAX_ADDR_SIZE * EASYLINK_MAX_ADDR_FILTERS];
+/* PHY EasyLink is initialized with, and the PHY the concentrator asked us to
+ * use for uplinks */
+static EasyLink_PhyType currentPhy = RADIO_EASYLINK_MODULATION;
+static EasyLink_PhyType uplinkPhy = RADIO_EASYLINK_MODULATION;
+/* Index into rfPowerTable of the current TX power, and the link margin
+ * reported in the latest ACK */
+static uint8_t txPowerIdx;
+#if RADIO_SECURITY_ENABLED
+static uint32_t frameCounter; /* of the next sealed packet */
+#endif
+/* Counters from here on have never been used, kept in the flash record */
+static uint32_t frameCounterLimit = 0;
+/* Flash slot and sequence number of the latest record */
+static uint8_t recordSlot = NODERADIO_ADDRESS_RECORD_SLOTS - 1;
+static uint32_t recordSequence = 0;
+static int8_t ackLinkMargin;
 
 /* Pin driver handle */
 extern PIN_Handle ledPinHandle;
@@ -117,9 +196,32 @@ extern PIN_Handle ledPinHandle;
 static void nodeRadioTaskFunction(UArg arg0, UArg arg1);
 static void returnRadioOperationStatus(enum NodeRadioOperationStatus status);
 static void sendDmPacket(struct DualModeInternalTempSensorPacket sensorPacket, uint8_t maxNumberOfRetries, uint32_t ackTimeoutMs);
+static void sendEnergyPacket(uint8_t maxNumberOfRetries, uint32_t ackTimeoutMs);
+static void sendTaskStatsPacket(uint8_t maxNumberOfRetries, uint32_t ackTimeoutMs);
 static void resendPacket();
-static void rxDoneCallback(EasyLink_RxPacket * rxPacket, EasyLink_Status status);
+static void allocTxPacket(void);
+static void setUplinkPhy(void);
+static void transmitAndWaitForAck(bool firstAttempt);
+static EasyLink_Status transmitPacket(EasyLink_TxPacket* txPacket);
+static void receiveTimeSync(void);
+static void applyRadioSettings(void);
+static uint16_t temporaryAddress(void);
+static void setNodeAddress(uint16_t address);
+static uint8_t recordCheck(uint8_t* record);
+static uint16_t loadRecord(uint32_t* counterLimit);
+static bool storeRecord(uint16_t address, uint32_t counterLimit);
+static void joinNetwork(void);
+static bool isJoinResponseForUs(EasyLink_RxLentPacket * rxPacket);
+static bool isValidDownlink(EasyLink_RxLentPacket * rxPacket);
+static void setPhy(EasyLink_PhyType phy);
+static uint32_t phySyncTime(EasyLink_PhyType phy);
+static void waitForFastPhyWindow(void);
+static uint8_t txPowerTableIndex(int8_t txPower);
+static void setTxPower(uint8_t idx);
+static void adjustTxPower(int8_t linkMargin);
+static void rxDoneCallback(EasyLink_RxLentPacket * rxPacket, EasyLink_Status status);
 static void sendBleAdvertisement(struct DualModeInternalTempSensorPacket sensorPacket);
+static void bleAdvDoneCallback(SimpleBeacon_Status status, uint32_t radioTime);
 
 /***** Function definitions *****/
 double convertADCToTempDouble(uint16_t adcValue) {
@@ -160,7 +262,7 @@ void NodeRadioTask_init(void) {
     Task_construct(&nodeRadioTask, nodeRadioTaskFunction, &nodeRadioTaskParams, NULL);
 }
 
-uint8_t nodeRadioTask_getNodeAddr(void) {
+uint16_t nodeRadioTask_getNodeAddr(void) {
     return nodeAddress;
 }
 
@@ -175,27 +277,39 @@ static void nodeRadioTaskFunction(UArg arg0, UArg arg1)
         System_abort("EasyLink_init failed");
     }
 
-    /* Use the True Random Number Generator to generate sensor node address randomly */
-    Power_setDependency(PowerCC26XX_PERIPH_TRNG);
-    TRNGEnable();
-    /* Do not accept the same address as the concentrator, in that case get a new random value */
-    do
-    {
-        while (!(TRNGStatusGet() & TRNG_NUMBER_READY))
-        {
-            //wait for random number generator
-        }
-        nodeAddress = (uint8_t)TRNGNumberGet(TRNG_LOW_WORD);
-    } while (nodeAddress == RADIO_CONCENTRATOR_ADDRESS);
-    TRNGDisable();
-    Power_releaseDependency(PowerCC26XX_PERIPH_TRNG);
-
-    /* Set the filter to the generated random address */
-    if (EasyLink_enableRxAddrFilter(&nodeAddress, 1, 1) != EasyLink_Status_Success)
+    /* Join with the address the concentrator assigned us before, or with a
+     * temporary one until it assigns one */
+    EasyLink_getIeeeAddr(ieeeAddr);
+    nodeAddress = loadRecord(&frameCounterLimit);
+    if (nodeAddress == RADIO_BROADCAST_ADDRESS)
     {
-        System_abort("EasyLink_enableRxAddrFilter failed");
+        nodeAddress = temporaryAddress();
     }
 
+    /* Set the filter to the node address and the broadcast address used for
+     * time sync */
+    addrFilterTable[2] = (RADIO_BROADCAST_ADDRESS & 0xFF00) >> 8;
+    addrFilterTable[3] = (RADIO_BROADCAST_ADDRESS & 0xFF);
+    setNodeAddress(nodeAddress);
+    txPowerIdx = txPowerTableIndex(EasyLink_getRfPwr());
+
+#if RADIO_SNIFF_INTERVAL_MS != 0
+    /* The concentrator only sniffs for a preamble once per interval on the
+     * default PHY, make ours long enough to be seen by one of the sniffs */
+    EasyLink_setCtrl(EasyLink_Ctrl_Preamble_Time, EasyLink_ms_To_RadioTime(RADIO_SNIFF_PREAMBLE_MS));
+#endif
+
+#if RADIO_SECURITY_ENABLED
+    /* Continue after every frame counter that may have been used before the
+     * reboot, so no nonce is used again and the concentrator sees the counters
+     * increase */
+    PacketCrypto_init();
+    frameCounter = frameCounterLimit;
+#endif
+
+    /* Join before anything else is sent, readings wait until then */
+    joinNetwork();
+
     /* Setup ADC sensor packet */
     dmInternalTempSensorPacket.header.sourceAddress = nodeAddress;
     dmInternalTempSensorPacket.header.packetType = RADIO_PACKET_TYPE_DM_SENSOR_PACKET;
@@ -215,7 +329,7 @@ static void nodeRadioTaskFunction(UArg arg0, UArg arg1)
     while (1)
     {
         /* Wait for an event */
-        uint32_t events = Event_pend(radioOperationEventHandle, 0, RADIO_EVENT_ALL, BIOS_WAIT_FOREVER);
+        uint32_t events = Trace_eventPend(radioOperationEventHandle, 0, RADIO_EVENT_ALL, BIOS_WAIT_FOREVER);
 
 #ifdef __CC1350_LAUNCHXL_BOARD_H__
     /* Enable power to RF switch to 2.4G antenna */
@@ -244,29 +358,65 @@ static void nodeRadioTaskFunction(UArg arg0, UArg arg1)
             dmInternalTempSensorPacket.batt = AONBatMonBatteryVoltageGet();
             dmInternalTempSensorPacket.internalTemp = INT2FIXED((int16_t)AONBatMonTemperatureGetDegC());
             dmInternalTempSensorPacket.temp = FLOAT2FIXED(convertADCToTempDouble(adcData));
+            dmInternalTempSensorPacket.networkTime100MiliSec = TimeSync_getNetworkTimeMs(EasyLink_getAbsTime()) / 100;
+            dmInternalTempSensorPacket.seqNumber++;
+            dmInternalTempSensorPacket.samplePeriodS = AdaptiveSampler_getPeriodS();
+            dmInternalTempSensorPacket.heartbeatS = AdaptiveSampler_getHeartbeatS();
+            EnergyMonitor_countReading();
 
+            setUplinkPhy();
             sendDmPacket(dmInternalTempSensorPacket, NODERADIO_MAX_RETRIES, NORERADIO_ACK_TIMEOUT_TIME_MS);
         }
 
+        /* If we should send the energy accounting */
+        if (events & RADIO_EVENT_SEND_ENERGY_REPORT)
+        {
+            setUplinkPhy();
+            sendEnergyPacket(NODERADIO_MAX_RETRIES, NORERADIO_ACK_TIMEOUT_TIME_MS);
+        }
+
+        /* If we should send the task CPU load and stack use */
+        if (events & RADIO_EVENT_SEND_TASK_STATS)
+        {
+            setUplinkPhy();
+            sendTaskStatsPacket(NODERADIO_MAX_RETRIES, NORERADIO_ACK_TIMEOUT_TIME_MS);
+        }
+
         /* If we get an ACK from the concentrator */
         if (events & RADIO_EVENT_DATA_ACK_RECEIVED)
         {
+            adjustTxPower(ackLinkMargin);
             returnRadioOperationStatus(NodeRadioStatus_Success);
         }
 
         /* If we get an ACK timeout */
         if (events & RADIO_EVENT_ACK_TIMEOUT)
         {
+            /* The margin we regulated to was not enough, retry at full power
+             * and work down from there again */
+            setTxPower(rfPowerTableSize - 1);
 
             /* If we haven't resent it the maximum number of times yet, then resend packet */
             if (currentRadioOperation.retriesDone < currentRadioOperation.maxNumberOfRetries)
             {
                 resendPacket();
             }
+            else if (currentPhy != RADIO_EASYLINK_MODULATION)
+            {
+                /* Fall back to the default PHY and start over, the next ACK
+                 * tells us if we may move back up. Full power is set after
+                 * the PHY, which reloads the TX power from the radio. */
+                uplinkPhy = RADIO_EASYLINK_MODULATION;
+                setPhy(RADIO_EASYLINK_MODULATION);
+                setTxPower(rfPowerTableSize - 1);
+                currentRadioOperation.easyLinkTxPacket->payload[currentRadioOperation.txPowerOffset] = rfPowerTable[txPowerIdx].dbm;
+                currentRadioOperation.retriesDone = 0;
+                transmitAndWaitForAck(false);
+            }
             else
             {
                 /* Else return send fail */
-                Event_post(radioOperationEventHandle, RADIO_EVENT_SEND_FAIL);
+                Trace_eventPost(radioOperationEventHandle, RADIO_EVENT_SEND_FAIL);
             }
         }
 
@@ -274,6 +424,23 @@ static void nodeRadioTaskFunction(UArg arg0, UArg arg1)
         if (events & RADIO_EVENT_SEND_FAIL)
         {
             returnRadioOperationStatus(NodeRadioStatus_Failed);
+
+#if RADIO_SECURITY_ENABLED
+            /* The concentrator forgets our frame counter when it reboots or
+             * drops us from its registry, and only takes our packets again
+             * after a join */
+            joinNetwork();
+            dmInternalTempSensorPacket.header.sourceAddress = nodeAddress;
+#endif
+
+            /* Refresh the time sync from the next broadcast while it is still
+             * good enough to only open a short receive window for it */
+            if (TimeSync_isSynced())
+            {
+                Trace_begin(NODERADIO_TRACE_TIME_SYNC, 0);
+                receiveTimeSync();
+                Trace_end(NODERADIO_TRACE_TIME_SYNC, 0);
+            }
         }
 
 #ifdef __CC1350_LAUNCHXL_BOARD_H__
@@ -298,7 +465,7 @@ enum NodeRadioOperationStatus NodeRadioTask_sendAdcData(uint16_t data)
     adcData = data;
 
     /* Raise RADIO_EVENT_SEND_ADC_DATA event */
-    Event_post(radioOperationEventHandle, RADIO_EVENT_SEND_ADC_DATA);
+    Trace_eventPost(radioOperationEventHandle, RADIO_EVENT_SEND_ADC_DATA);
 
     /* Wait for result */
     Semaphore_pend(radioResultSemHandle, BIOS_WAIT_FOREVER);
@@ -313,121 +480,869 @@ enum NodeRadioOperationStatus NodeRadioTask_sendAdcData(uint16_t data)
     PIN_setOutputValue(ledPinHandle, NODE_SUB1_ACTIVITY_LED,!PIN_getOutputValue(NODE_SUB1_ACTIVITY_LED));
 
     if (advertiserType == Node_AdvertiserUrl) {
+        Trace_begin(NODERADIO_TRACE_BLE_ADV, 0);
         sendBleAdvertisement(dmInternalTempSensorPacket);
     }
 
     return status;
 }
 
+enum NodeRadioOperationStatus NodeRadioTask_sendEnergyReport(void)
+{
+    enum NodeRadioOperationStatus status;
+
+    /* Get radio access semaphore */
+    Semaphore_pend(radioAccessSemHandle, BIOS_WAIT_FOREVER);
+
+    /* Raise RADIO_EVENT_SEND_ENERGY_REPORT event */
+    Trace_eventPost(radioOperationEventHandle, RADIO_EVENT_SEND_ENERGY_REPORT);
+
+    /* Wait for result */
+    Semaphore_pend(radioResultSemHandle, BIOS_WAIT_FOREVER);
+
+    /* Get result */
+    status = currentRadioOperation.result;
+
+    /* Return radio access semaphore */
+    Semaphore_post(radioAccessSemHandle);
+
+    return status;
+}
+
+enum NodeRadioOperationStatus NodeRadioTask_sendTaskStats(void)
+{
+    enum NodeRadioOperationStatus status;
+
+    /* Get radio access semaphore */
+    Semaphore_pend(radioAccessSemHandle, BIOS_WAIT_FOREVER);
+
+    /* Raise RADIO_EVENT_SEND_TASK_STATS event */
+    Trace_eventPost(radioOperationEventHandle, RADIO_EVENT_SEND_TASK_STATS);
+
+    /* Wait for result */
+    Semaphore_pend(radioResultSemHandle, BIOS_WAIT_FOREVER);
+
+    /* Get result */
+    status = currentRadioOperation.result;
+
+    /* Return radio access semaphore */
+    Semaphore_post(radioAccessSemHandle);
+
+    return status;
+}
+
 static void returnRadioOperationStatus(enum NodeRadioOperationStatus result)
 {
     /* Save result */
     currentRadioOperation.result = result;
 
+    /* No more retries, give the packet back */
+    PacketPool_free(currentRadioOperation.easyLinkTxPacket);
+    currentRadioOperation.easyLinkTxPacket = NULL;
+
     /* Post result semaphore */
     Semaphore_post(radioResultSemHandle);
 }
 
 static void sendDmPacket(struct DualModeInternalTempSensorPacket sensorPacket, uint8_t maxNumberOfRetries, uint32_t ackTimeoutMs)
 {
+    allocTxPacket();
+
     /* Set destination address in EasyLink API */
-    currentRadioOperation.easyLinkTxPacket.dstAddr[0] = RADIO_CONCENTRATOR_ADDRESS;
+    currentRadioOperation.easyLinkTxPacket->dstAddr[0] = (RADIO_CONCENTRATOR_ADDRESS & 0xFF00) >> 8;
+    currentRadioOperation.easyLinkTxPacket->dstAddr[1] = (RADIO_CONCENTRATOR_ADDRESS & 0xFF);
 
     /* Copy ADC packet to payload
-     * Note that the EasyLink API will implicitly both add the length byte and the destination address byte. */
-    currentRadioOperation.easyLinkTxPacket.payload[0] = dmInternalTempSensorPacket.header.sourceAddress;
-    currentRadioOperation.easyLinkTxPacket.payload[1] = dmInternalTempSensorPacket.header.packetType;
-    currentRadioOperation.easyLinkTxPacket.payload[2] = (dmInternalTempSensorPacket.temp & 0xFF00) >> 8;
-    currentRadioOperation.easyLinkTxPacket.payload[3] = (dmInternalTempSensorPacket.temp & 0xFF);
-    currentRadioOperation.easyLinkTxPacket.payload[4] = (dmInternalTempSensorPacket.batt & 0xFF00) >> 8;
-    currentRadioOperation.easyLinkTxPacket.payload[5] = (dmInternalTempSensorPacket.batt & 0xFF);
-    currentRadioOperation.easyLinkTxPacket.payload[6] = (dmInternalTempSensorPacket.internalTemp & 0xFF00) >> 8;
-    currentRadioOperation.easyLinkTxPacket.payload[7] = (dmInternalTempSensorPacket.internalTemp & 0xFF);
-    currentRadioOperation.easyLinkTxPacket.payload[8] = (dmInternalTempSensorPacket.time100MiliSec & 0xFF000000) >> 24;
-    currentRadioOperation.easyLinkTxPacket.payload[9] = (dmInternalTempSensorPacket.time100MiliSec & 0x00FF0000) >> 16;
-    currentRadioOperation.easyLinkTxPacket.payload[10] = (dmInternalTempSensorPacket.time100MiliSec & 0xFF00) >> 8;
-    currentRadioOperation.easyLinkTxPacket.payload[11] = (dmInternalTempSensorPacket.time100MiliSec & 0xFF);
-
-    currentRadioOperation.easyLinkTxPacket.len = sizeof(struct DualModeInternalTempSensorPacket);
+     * Note that the EasyLink API will implicitly both add the length byte and the destination address bytes. */
+    currentRadioOperation.easyLinkTxPacket->payload[0] = (dmInternalTempSensorPacket.header.sourceAddress & 0xFF00) >> 8;
+    currentRadioOperation.easyLinkTxPacket->payload[1] = (dmInternalTempSensorPacket.header.sourceAddress & 0xFF);
+    currentRadioOperation.easyLinkTxPacket->payload[2] = dmInternalTempSensorPacket.header.packetType;
+    currentRadioOperation.easyLinkTxPacket->payload[3] = (dmInternalTempSensorPacket.temp & 0xFF00) >> 8;
+    currentRadioOperation.easyLinkTxPacket->payload[4] = (dmInternalTempSensorPacket.temp & 0xFF);
+    currentRadioOperation.easyLinkTxPacket->payload[5] = (dmInternalTempSensorPacket.batt & 0xFF00) >> 8;
+    currentRadioOperation.easyLinkTxPacket->payload[6] = (dmInternalTempSensorPacket.batt & 0xFF);
+    currentRadioOperation.easyLinkTxPacket->payload[7] = (dmInternalTempSensorPacket.internalTemp & 0xFF00) >> 8;
+    currentRadioOperation.easyLinkTxPacket->payload[8] = (dmInternalTempSensorPacket.internalTemp & 0xFF);
+    currentRadioOperation.easyLinkTxPacket->payload[9] = (dmInternalTempSensorPacket.time100MiliSec & 0xFF000000) >> 24;
+    currentRadioOperation.easyLinkTxPacket->payload[10] = (dmInternalTempSensorPacket.time100MiliSec & 0x00FF0000) >> 16;
+    currentRadioOperation.easyLinkTxPacket->payload[11] = (dmInternalTempSensorPacket.time100MiliSec & 0xFF00) >> 8;
+    currentRadioOperation.easyLinkTxPacket->payload[12] = (dmInternalTempSensorPacket.time100MiliSec & 0xFF);
+    currentRadioOperation.easyLinkTxPacket->payload[13] = (dmInternalTempSensorPacket.networkTime100MiliSec & 0xFF000000) >> 24;
+    currentRadioOperation.easyLinkTxPacket->payload[14] = (dmInternalTempSensorPacket.networkTime100MiliSec & 0x00FF0000) >> 16;
+    currentRadioOperation.easyLinkTxPacket->payload[15] = (dmInternalTempSensorPacket.networkTime100MiliSec & 0xFF00) >> 8;
+    currentRadioOperation.easyLinkTxPacket->payload[16] = (dmInternalTempSensorPacket.networkTime100MiliSec & 0xFF);
+
+    currentRadioOperation.txPowerOffset = 17;
+    currentRadioOperation.easyLinkTxPacket->payload[17] = rfPowerTable[txPowerIdx].dbm;
+    currentRadioOperation.easyLinkTxPacket->payload[18] = dmInternalTempSensorPacket.seqNumber;
+    currentRadioOperation.easyLinkTxPacket->payload[19] = (dmInternalTempSensorPacket.samplePeriodS & 0xFF00) >> 8;
+    currentRadioOperation.easyLinkTxPacket->payload[20] = (dmInternalTempSensorPacket.samplePeriodS & 0xFF);
+    currentRadioOperation.easyLinkTxPacket->payload[21] = (dmInternalTempSensorPacket.heartbeatS & 0xFF00) >> 8;
+    currentRadioOperation.easyLinkTxPacket->payload[22] = (dmInternalTempSensorPacket.heartbeatS & 0xFF);
+
+    currentRadioOperation.easyLinkTxPacket->len = RADIO_DM_SENSOR_PACKET_LENGTH;
 
     /* Setup retries */
     currentRadioOperation.maxNumberOfRetries = maxNumberOfRetries;
     currentRadioOperation.ackTimeoutMs = ackTimeoutMs;
     currentRadioOperation.retriesDone = 0;
-    EasyLink_setCtrl(EasyLink_Ctrl_AsyncRx_TimeOut, EasyLink_ms_To_RadioTime(ackTimeoutMs));
 
-    /* Send packet  */
-    if (EasyLink_transmit(&currentRadioOperation.easyLinkTxPacket) != EasyLink_Status_Success)
+    /* Send packet and enter RX */
+    transmitAndWaitForAck(true);
+}
+
+static void sendEnergyPacket(uint8_t maxNumberOfRetries, uint32_t ackTimeoutMs)
+{
+    EnergyMonitor_Report report;
+    uint8_t* payload;
+    uint8_t i;
+
+    allocTxPacket();
+    payload = currentRadioOperation.easyLinkTxPacket->payload;
+
+    EnergyMonitor_getReport(&report);
+
+    /* Set destination address in EasyLink API */
+    currentRadioOperation.easyLinkTxPacket->dstAddr[0] = (RADIO_CONCENTRATOR_ADDRESS & 0xFF00) >> 8;
+    currentRadioOperation.easyLinkTxPacket->dstAddr[1] = (RADIO_CONCENTRATOR_ADDRESS & 0xFF);
+
+    /* Copy energy packet to payload */
+    payload[0] = (nodeAddress & 0xFF00) >> 8;
+    payload[1] = (nodeAddress & 0xFF);
+    payload[2] = RADIO_PACKET_TYPE_ENERGY_PACKET;
+    payload[3] = (report.readings & 0xFF000000) >> 24;
+    payload[4] = (report.readings & 0x00FF0000) >> 16;
+    payload[5] = (report.readings & 0xFF00) >> 8;
+    payload[6] = (report.readings & 0xFF);
+    for (i = 0; i < RADIO_ENERGY_ACTIVITIES; i++)
     {
-        System_abort("EasyLink_transmit failed");
+        payload[7 + 4 * i] = (report.chargeNah[i] & 0xFF000000) >> 24;
+        payload[8 + 4 * i] = (report.chargeNah[i] & 0x00FF0000) >> 16;
+        payload[9 + 4 * i] = (report.chargeNah[i] & 0xFF00) >> 8;
+        payload[10 + 4 * i] = (report.chargeNah[i] & 0xFF);
     }
+    currentRadioOperation.txPowerOffset = 27;
+    payload[27] = rfPowerTable[txPowerIdx].dbm;
 
-    /* Enter RX */
-    if (EasyLink_receiveAsync(rxDoneCallback, 0) != EasyLink_Status_Success)
+    currentRadioOperation.easyLinkTxPacket->len = RADIO_ENERGY_PACKET_LENGTH;
+
+    /* Setup retries */
+    currentRadioOperation.maxNumberOfRetries = maxNumberOfRetries;
+    currentRadioOperation.ackTimeoutMs = ackTimeoutMs;
+    currentRadioOperation.retriesDone = 0;
+
+    /* Send packet and enter RX */
+    transmitAndWaitForAck(true);
+}
+
+static void sendTaskStatsPacket(uint8_t maxNumberOfRetries, uint32_t ackTimeoutMs)
+{
+    TaskMonitor_Stats stats[RADIO_MAX_TASK_STATS];
+    uint8_t* payload;
+    uint8_t* entry;
+    uint8_t numTasks;
+    uint8_t i;
+
+    allocTxPacket();
+    payload = currentRadioOperation.easyLinkTxPacket->payload;
+
+    numTasks = TaskMonitor_getStats(stats, RADIO_MAX_TASK_STATS);
+
+    /* Set destination address in EasyLink API */
+    currentRadioOperation.easyLinkTxPacket->dstAddr[0] = (RADIO_CONCENTRATOR_ADDRESS & 0xFF00) >> 8;
+    currentRadioOperation.easyLinkTxPacket->dstAddr[1] = (RADIO_CONCENTRATOR_ADDRESS & 0xFF);
+
+    /* Copy task stats packet to payload */
+    payload[0] = (nodeAddress & 0xFF00) >> 8;
+    payload[1] = (nodeAddress & 0xFF);
+    payload[2] = RADIO_PACKET_TYPE_TASK_STATS_PACKET;
+    payload[3] = numTasks;
+    for (i = 0; i < numTasks; i++)
+    {
+        entry = &payload[4 + RADIO_TASK_STATS_ENTRY_LENGTH * i];
+        entry[0] = stats[i].priority;
+        entry[1] = (stats[i].loadPermille & 0xFF00) >> 8;
+        entry[2] = (stats[i].loadPermille & 0xFF);
+        entry[3] = (stats[i].stackSize & 0xFF00) >> 8;
+        entry[4] = (stats[i].stackSize & 0xFF);
+        entry[5] = (stats[i].stackUsed & 0xFF00) >> 8;
+        entry[6] = (stats[i].stackUsed & 0xFF);
+    }
+    currentRadioOperation.txPowerOffset = 4 + RADIO_TASK_STATS_ENTRY_LENGTH * numTasks;
+    payload[currentRadioOperation.txPowerOffset] = rfPowerTable[txPowerIdx].dbm;
+
+    currentRadioOperation.easyLinkTxPacket->len = RADIO_TASK_STATS_PACKET_LENGTH(numTasks);
+
+    /* Setup retries */
+    currentRadioOperation.maxNumberOfRetries = maxNumberOfRetries;
+    currentRadioOperation.ackTimeoutMs = ackTimeoutMs;
+    currentRadioOperation.retriesDone = 0;
+
+    /* Send packet and enter RX */
+    transmitAndWaitForAck(true);
+}
+
+static void allocTxPacket(void)
+{
+    /* Only one operation is in progress at a time, so the pool is sized to
+     * always have a block for it */
+    currentRadioOperation.easyLinkTxPacket = PacketPool_alloc();
+    if (currentRadioOperation.easyLinkTxPacket == NULL)
     {
-        System_abort("EasyLink_receiveAsync failed");
+        System_abort("PacketPool_alloc failed");
     }
 }
 
 static void resendPacket()
 {
+    /* The TX power may have changed since the last attempt */
+    currentRadioOperation.easyLinkTxPacket->payload[currentRadioOperation.txPowerOffset] = rfPowerTable[txPowerIdx].dbm;
+
+    /* Send packet and enter RX */
+    transmitAndWaitForAck(false);
+
+    /* Increase retries by one */
+    currentRadioOperation.retriesDone++;
+}
+
+static void transmitAndWaitForAck(bool firstAttempt)
+{
+    EasyLink_Status status;
+    uint32_t rxStartTime = 0;
+    uint32_t txStartTime = EasyLink_getAbsTime();
+
     /* Send packet  */
-    if (EasyLink_transmit(&currentRadioOperation.easyLinkTxPacket) != EasyLink_Status_Success)
+    status = transmitPacket(currentRadioOperation.easyLinkTxPacket);
+    if (status == EasyLink_Status_Channel_Busy)
+    {
+        /* Only carrier sense was done */
+        EnergyMonitor_addRadioTime(EnergyMonitor_Activity_Sub1GhzRx, txStartTime, EasyLink_getAbsTime());
+
+        /* Channel was busy on all CSMA attempts, treat as a missed ACK so the
+         * normal retry handling applies */
+        Trace_eventPost(radioOperationEventHandle, RADIO_EVENT_ACK_TIMEOUT);
+        return;
+    }
+    else if (status == EasyLink_Status_Config_Error)
+    {
+        /* Nothing was sent, as no frame counter could be reserved. Retried
+         * like a missed ACK, which tries the flash again. */
+        Trace_eventPost(radioOperationEventHandle, RADIO_EVENT_ACK_TIMEOUT);
+        return;
+    }
+    else if (status != EasyLink_Status_Success)
     {
         System_abort("EasyLink_transmit failed");
     }
+    txDoneTime = EasyLink_getAbsTime();
+    EnergyMonitor_addTxTime(txStartTime, txDoneTime, rfPowerTable[txPowerIdx].dbm);
+
+    if (firstAttempt && (ackLatency != 0))
+    {
+        /* The concentrator sends the ACK a fixed time after our packet, so
+         * only listen around the learned arrival time */
+        rxStartTime = txDoneTime + ackLatency - NODERADIO_ACK_GUARD_TIME;
+        EasyLink_setCtrl(EasyLink_Ctrl_AsyncRx_TimeOut, 2 * NODERADIO_ACK_GUARD_TIME + ackDuration);
+    }
+    else
+    {
+        /* Not learned yet or a retry, the ACK may have been delayed so use
+         * the full timeout */
+        EasyLink_setCtrl(EasyLink_Ctrl_AsyncRx_TimeOut, EasyLink_ms_To_RadioTime(currentRadioOperation.ackTimeoutMs));
+    }
 
     /* Enter RX and wait for ACK with timeout */
-    if (EasyLink_receiveAsync(rxDoneCallback, 0) != EasyLink_Status_Success)
+    rxOnTime = (rxStartTime != 0) ? rxStartTime : EasyLink_getAbsTime();
+    if (EasyLink_receiveLentAsync(rxDoneCallback, rxStartTime) != EasyLink_Status_Success)
     {
-        System_abort("EasyLink_receiveAsync failed");
+        System_abort("EasyLink_receiveLentAsync failed");
     }
+}
 
-    /* Increase retries by one */
-    currentRadioOperation.retriesDone++;
+/* With security on the packet is sealed in a copy, so that a retry can still
+ * update the TX power in the plain packet and gets a new frame counter.
+ * Returns EasyLink_Status_Config_Error without sending if the next frame
+ * counter could not be reserved. */
+static EasyLink_Status transmitPacket(EasyLink_TxPacket* txPacket)
+{
+#if RADIO_SECURITY_ENABLED
+    EasyLink_TxPacket* sealedTxPacket;
+    EasyLink_Status status;
+
+    /* Reserve the next block of counters before using the first of them.
+     * Only a limit that made it to the flash is used, so a counter is never
+     * used again after a reboot. */
+    if (frameCounter == frameCounterLimit)
+    {
+        if (!storeRecord(nodeAddress, frameCounterLimit + NODERADIO_FRAME_COUNTER_BLOCK))
+        {
+            return EasyLink_Status_Config_Error;
+        }
+        frameCounterLimit += NODERADIO_FRAME_COUNTER_BLOCK;
+    }
+
+    /* The pool has a spare block while no received packet is held */
+    sealedTxPacket = PacketPool_alloc();
+    if (sealedTxPacket == NULL)
+    {
+        System_abort("PacketPool_alloc failed");
+    }
+
+    memcpy(sealedTxPacket, txPacket, sizeof(EasyLink_TxPacket));
+    sealedTxPacket->len = PacketCrypto_seal(sealedTxPacket->payload, RADIO_PACKET_HEADER_LENGTH, txPacket->len,
+                                            PACKETCRYPTO_SOURCE_SUB1GHZ, nodeAddress, frameCounter++);
+    status = EasyLink_transmit(sealedTxPacket);
+
+    PacketPool_free(sealedTxPacket);
+    return status;
+#else
+    return EasyLink_transmit(txPacket);
+#endif
+}
+
+static void receiveTimeSync(void)
+{
+    uint32_t now;
+    uint32_t nextTimeSyncMs;
+    uint32_t timeSyncRxTime;
+    uint32_t guardTime;
+    uint32_t rxStartTime;
+    int32_t sleepTime;
+
+    /* Time sync packets are only sent on the default PHY */
+    setPhy(RADIO_EASYLINK_MODULATION);
+
+    now = EasyLink_getAbsTime();
+    nextTimeSyncMs = (TimeSync_getNetworkTimeMs(now) / RADIO_TIME_SYNC_PERIOD_MS + 1) * RADIO_TIME_SYNC_PERIOD_MS;
+    timeSyncRxTime = TimeSync_getRatTime(nextTimeSyncMs) + phySyncTime(currentPhy);
+    guardTime = TimeSync_getGuardTime(timeSyncRxTime);
+    rxStartTime = timeSyncRxTime - guardTime;
+    sleepTime = (int32_t)(rxStartTime - now) - NODERADIO_WAKEUP_LEAD_TIME;
+
+    /* Sleep until just before the window, keeping the radio free until then */
+    if (sleepTime > 0)
+    {
+        Task_sleep((sleepTime / 4) / Clock_tickPeriod);
+    }
+
+    /* The time sync packet has the same length as an ACK */
+    EasyLink_setCtrl(EasyLink_Ctrl_AsyncRx_TimeOut, 2 * guardTime +
+            ((ackDuration != 0) ? ackDuration : EasyLink_ms_To_RadioTime(NORERADIO_ACK_TIMEOUT_TIME_MS)));
+
+    listeningForTimeSync = true;
+    rxOnTime = rxStartTime;
+    if (EasyLink_receiveLentAsync(rxDoneCallback, rxStartTime) != EasyLink_Status_Success)
+    {
+        System_abort("EasyLink_receiveLentAsync failed");
+    }
+
+    /* Wait for the window to close, the sync itself is updated from the callback */
+    Trace_eventPend(radioOperationEventHandle, 0, RADIO_EVENT_TIME_SYNC_DONE, BIOS_WAIT_FOREVER);
+    listeningForTimeSync = false;
+}
+
+/* Folds the 64-bit IEEE address into a temporary 16-bit address, which only
+ * has to tell joining nodes apart until the join response is checked against
+ * the IEEE address */
+static uint16_t temporaryAddress(void)
+{
+    uint16_t address = 0;
+    uint8_t i;
+
+    for (i = 0; i < RADIO_IEEE_ADDRESS_SIZE; i += 2)
+    {
+        address ^= (ieeeAddr[i] << 8) | ieeeAddr[i + 1];
+    }
+    address |= RADIO_TEMPORARY_ADDRESS_FLAG;
+
+    if (address == RADIO_BROADCAST_ADDRESS)
+    {
+        address ^= 0x0001;
+    }
+
+    return address;
+}
+
+static void setNodeAddress(uint16_t address)
+{
+    nodeAddress = address;
+    addrFilterTable[0] = (nodeAddress & 0xFF00) >> 8;
+    addrFilterTable[1] = (nodeAddress & 0xFF);
+    applyRadioSettings();
+}
+
+/* Inverted sum of the record bytes before it, so a record cut short by a
+ * power loss, which leaves erased bytes, is not taken for a valid one */
+static uint8_t recordCheck(uint8_t* record)
+{
+    uint8_t sum = 0;
+    uint8_t i;
+
+    for (i = 0; i < NODERADIO_ADDRESS_RECORD_SIZE - 1; i++)
+    {
+        sum += record[i];
+    }
+
+    return ~sum;
 }
 
-static void rxDoneCallback(EasyLink_RxPacket * rxPacket, EasyLink_Status status)
+/* Returns the address stored by storeRecord, or RADIO_BROADCAST_ADDRESS if
+ * there is none, and the frame counter limit, or 0. This also leaves the
+ * external flash powered down. */
+static uint16_t loadRecord(uint32_t* counterLimit)
+{
+    uint8_t record[NODERADIO_ADDRESS_RECORD_SIZE];
+    uint16_t address = RADIO_BROADCAST_ADDRESS;
+    uint32_t sequence;
+    bool found = false;
+    uint8_t slot;
+
+    *counterLimit = 0;
+    if (ExtFlash_open())
+    {
+        for (slot = 0; slot < NODERADIO_ADDRESS_RECORD_SLOTS; slot++)
+        {
+            if (!ExtFlash_read(NODERADIO_ADDRESS_FLASH_OFFSET + slot * EXT_FLASH_PAGE_SIZE, sizeof(record), record) ||
+                (((record[0] << 8) | record[1]) != NODERADIO_ADDRESS_MAGIC) ||
+                (record[NODERADIO_ADDRESS_RECORD_SIZE - 1] != recordCheck(record)))
+            {
+                continue;
+            }
+
+            sequence = (record[8] << 24) | (record[9] << 16) | (record[10] << 8) | record[11];
+            if (!found || ((int32_t)(sequence - recordSequence) > 0))
+            {
+                found = true;
+                recordSlot = slot;
+                recordSequence = sequence;
+                address = (record[2] << 8) | record[3];
+                *counterLimit = (record[4] << 24) | (record[5] << 16) | (record[6] << 8) | record[7];
+            }
+        }
+        ExtFlash_close();
+    }
+
+    /* Only an address the concentrator can have assigned */
+    if ((address == RADIO_CONCENTRATOR_ADDRESS) || (address & RADIO_TEMPORARY_ADDRESS_FLAG))
+    {
+        address = RADIO_BROADCAST_ADDRESS;
+    }
+
+    return address;
+}
+
+/* A temporary address is stored as well, for the counter limit, but not
+ * loaded again. The record goes to the slot not holding the latest one, and
+ * is read back, so false means the latest record is still the previous one. */
+static bool storeRecord(uint16_t address, uint32_t counterLimit)
+{
+    uint8_t record[NODERADIO_ADDRESS_RECORD_SIZE];
+    uint8_t readBack[NODERADIO_ADDRESS_RECORD_SIZE];
+    uint8_t slot = (recordSlot + 1) % NODERADIO_ADDRESS_RECORD_SLOTS;
+    uint32_t sequence = recordSequence + 1;
+    size_t offset = NODERADIO_ADDRESS_FLASH_OFFSET + slot * EXT_FLASH_PAGE_SIZE;
+    bool stored;
+
+    record[0] = (NODERADIO_ADDRESS_MAGIC & 0xFF00) >> 8;
+    record[1] = (NODERADIO_ADDRESS_MAGIC & 0xFF);
+    record[2] = (address & 0xFF00) >> 8;
+    record[3] = (address & 0xFF);
+    record[4] = (counterLimit & 0xFF000000) >> 24;
+    record[5] = (counterLimit & 0x00FF0000) >> 16;
+    record[6] = (counterLimit & 0xFF00) >> 8;
+    record[7] = (counterLimit & 0xFF);
+    record[8] = (sequence & 0xFF000000) >> 24;
+    record[9] = (sequence & 0x00FF0000) >> 16;
+    record[10] = (sequence & 0xFF00) >> 8;
+    record[11] = (sequence & 0xFF);
+    record[12] = recordCheck(record);
+
+    if (!ExtFlash_open())
+    {
+        return false;
+    }
+    stored = ExtFlash_erase(offset, EXT_FLASH_PAGE_SIZE) &&
+             ExtFlash_write(offset, sizeof(record), record) &&
+             ExtFlash_read(offset, sizeof(readBack), readBack) &&
+             (memcmp(record, readBack, sizeof(record)) == 0);
+    ExtFlash_close();
+
+    if (stored)
+    {
+        recordSlot = slot;
+        recordSequence = sequence;
+    }
+
+    return stored;
+}
+
+/* Sends our IEEE address until the concentrator answers with the address to
+ * use from now on. A node that has joined before asks from its old address
+ * and gets it back in a single round trip. */
+static void joinNetwork(void)
+{
+    uint8_t* payload;
+    uint32_t events;
+    uint8_t attempts = 0;
+
+#ifdef __CC1350_LAUNCHXL_BOARD_H__
+    /* Enable power to RF switch to 2.4G antenna */
+    PIN_setOutputValue(ledPinHandle, Board_DIO30_SWPWR, 1);
+#endif //__CC1350_LAUNCHXL_BOARD_H__
+
+    /* Join at full power, the response regulates it down like an ACK */
+    setTxPower(rfPowerTableSize - 1);
+
+    allocTxPacket();
+    payload = currentRadioOperation.easyLinkTxPacket->payload;
+    currentRadioOperation.easyLinkTxPacket->dstAddr[0] = (RADIO_CONCENTRATOR_ADDRESS & 0xFF00) >> 8;
+    currentRadioOperation.easyLinkTxPacket->dstAddr[1] = (RADIO_CONCENTRATOR_ADDRESS & 0xFF);
+    payload[0] = (nodeAddress & 0xFF00) >> 8;
+    payload[1] = (nodeAddress & 0xFF);
+    payload[2] = RADIO_PACKET_TYPE_JOIN_REQUEST_PACKET;
+    memcpy(&payload[3], ieeeAddr, RADIO_IEEE_ADDRESS_SIZE);
+    currentRadioOperation.easyLinkTxPacket->len = RADIO_JOIN_REQUEST_PACKET_LENGTH;
+    currentRadioOperation.ackTimeoutMs = NORERADIO_ACK_TIMEOUT_TIME_MS;
+
+    joining = true;
+    while (1)
+    {
+        transmitAndWaitForAck(false);
+        events = Trace_eventPend(radioOperationEventHandle, 0,
+                                 RADIO_EVENT_DATA_ACK_RECEIVED | RADIO_EVENT_ACK_TIMEOUT, BIOS_WAIT_FOREVER);
+        if (events & RADIO_EVENT_DATA_ACK_RECEIVED)
+        {
+            break;
+        }
+
+        /* The concentrator may be down, or out of addresses */
+        if (++attempts > NODERADIO_MAX_RETRIES)
+        {
+            attempts = 0;
+            Task_sleep((NODERADIO_JOIN_RETRY_MS * 1000) / Clock_tickPeriod);
+        }
+    }
+    joining = false;
+
+    PacketPool_free(currentRadioOperation.easyLinkTxPacket);
+    currentRadioOperation.easyLinkTxPacket = NULL;
+    adjustTxPower(ackLinkMargin);
+
+    if (joinedAddress != nodeAddress)
+    {
+        setNodeAddress(joinedAddress);
+
+        /* If this fails we join again from a temporary address after a
+         * reboot, the counter limit in the previous record still holds */
+        storeRecord(joinedAddress, frameCounterLimit);
+    }
+
+#ifdef __CC1350_LAUNCHXL_BOARD_H__
+    /* Disable power to RF switch to 2.4G antenna */
+    PIN_setOutputValue(ledPinHandle, Board_DIO30_SWPWR, 0);
+#endif //__CC1350_LAUNCHXL_BOARD_H__
+}
+
+/* A join response may reach other nodes using the same temporary address */
+static bool isJoinResponseForUs(EasyLink_RxLentPacket * rxPacket)
+{
+    return (joining && (rxPacket->payload[2] == RADIO_PACKET_TYPE_JOIN_RESPONSE_PACKET) &&
+            (rxPacket->len == RADIO_JOIN_RESPONSE_PACKET_LENGTH) &&
+            (memcmp(&rxPacket->payload[12], ieeeAddr, RADIO_IEEE_ADDRESS_SIZE) == 0));
+}
+
+/* Only packets of the types we receive, and long enough for the fields read
+ * from them */
+static bool isValidDownlink(EasyLink_RxLentPacket * rxPacket)
+{
+    if (rxPacket->len < RADIO_PACKET_HEADER_LENGTH)
+    {
+        return false;
+    }
+
+    switch (rxPacket->payload[2])
+    {
+    case RADIO_PACKET_TYPE_ACK_PACKET:
+        return (rxPacket->len == RADIO_ACK_PACKET_LENGTH);
+    case RADIO_PACKET_TYPE_JOIN_RESPONSE_PACKET:
+        return (rxPacket->len == RADIO_JOIN_RESPONSE_PACKET_LENGTH);
+    case RADIO_PACKET_TYPE_TIME_SYNC_PACKET:
+        return (rxPacket->len == RADIO_TIME_SYNC_PACKET_LENGTH);
+    default:
+        return false;
+    }
+}
+
+/* Settings that EasyLink_init resets, applied after every (re)init */
+static void applyRadioSettings(void)
+{
+    /* Listen before talk, so we do not collide with other nodes or an ACK
+     * from the concentrator to another node */
+    EasyLink_setCtrl(EasyLink_Ctrl_Csma_Enable, 1);
+
+    EasyLink_setCtrl(EasyLink_Ctrl_AddSize, RADIO_ADDRESS_SIZE);
+    if (EasyLink_enableRxAddrFilter(addrFilterTable, RADIO_ADDRESS_SIZE, 2) != EasyLink_Status_Success)
+    {
+        System_abort("EasyLink_enableRxAddrFilter failed");
+    }
+}
+
+static void setPhy(EasyLink_PhyType phy)
+{
+    if (phy == currentPhy)
+    {
+        return;
+    }
+
+    if (EasyLink_init(phy) != EasyLink_Status_Success)
+    {
+        System_abort("EasyLink_init failed");
+    }
+    applyRadioSettings();
+    currentPhy = phy;
+
+#if RADIO_SNIFF_INTERVAL_MS != 0
+    /* The concentrator listens all the time in the fast PHY window */
+    EasyLink_setCtrl(EasyLink_Ctrl_Preamble_Time, (phy == RADIO_EASYLINK_FAST_MODULATION) ?
+                     0 : EasyLink_ms_To_RadioTime(RADIO_SNIFF_PREAMBLE_MS));
+#endif
+
+    /* EasyLink_init restores the TX power of the RF settings, the margin on
+     * the new PHY is regulated from there */
+    txPowerIdx = txPowerTableIndex(EasyLink_getRfPwr());
+
+    /* The ACK timing is different on the new PHY, learn it again */
+    ackLatency = 0;
+    ackDuration = 0;
+}
+
+static uint32_t phySyncTime(EasyLink_PhyType phy)
+{
+    return (phy == RADIO_EASYLINK_FAST_MODULATION) ? RADIO_FSK_SYNC_TIME : RADIO_LRM_SYNC_TIME;
+}
+
+/* Use the fast PHY if the concentrator asked for it and we know when it
+ * listens on it */
+static void setUplinkPhy(void)
+{
+    if ((uplinkPhy == RADIO_EASYLINK_FAST_MODULATION) && TimeSync_isSynced())
+    {
+        setPhy(RADIO_EASYLINK_FAST_MODULATION);
+        waitForFastPhyWindow();
+    }
+    else
+    {
+        setPhy(RADIO_EASYLINK_MODULATION);
+    }
+}
+
+/* Sleeps until the concentrator listens on the fast PHY */
+static void waitForFastPhyWindow(void)
+{
+    uint32_t now = EasyLink_getAbsTime();
+    uint32_t nowMs = TimeSync_getNetworkTimeMs(now);
+    uint32_t periodStartMs = nowMs - (nowMs % RADIO_TIME_SYNC_PERIOD_MS);
+    uint32_t txStartMs = periodStartMs + RADIO_FAST_PHY_WINDOW_OFFSET_MS + NODERADIO_FAST_PHY_TX_START_MS;
+    uint32_t txEndMs = periodStartMs + RADIO_FAST_PHY_WINDOW_OFFSET_MS + NODERADIO_FAST_PHY_TX_END_MS;
+    int32_t sleepTime;
+
+    if (nowMs >= txEndMs)
+    {
+        /* Too late for this period, use the next one */
+        txStartMs += RADIO_TIME_SYNC_PERIOD_MS;
+    }
+    else if (nowMs >= txStartMs)
+    {
+        /* Inside the window already */
+        return;
+    }
+
+    sleepTime = (int32_t)(TimeSync_getRatTime(txStartMs) - now);
+    if (sleepTime > 0)
+    {
+        Task_sleep((sleepTime / 4) / Clock_tickPeriod);
+    }
+}
+
+/* Highest rfPowerTable entry at or below txPower dBm */
+static uint8_t txPowerTableIndex(int8_t txPower)
+{
+    uint8_t idx = 0;
+
+    while ((idx < rfPowerTableSize - 1) && (rfPowerTable[idx + 1].dbm <= txPower))
+    {
+        idx++;
+    }
+
+    return idx;
+}
+
+static void setTxPower(uint8_t idx)
+{
+    EasyLink_Status status;
+
+    /* EasyLink refuses the top entry unless CCFG_FORCE_VDDR_HH is set, go one
+     * entry down until it is accepted */
+    while (idx != txPowerIdx)
+    {
+        status = EasyLink_setRfPwr(rfPowerTable[idx].dbm);
+        if (status == EasyLink_Status_Success)
+        {
+            txPowerIdx = idx;
+        }
+        else if ((status == EasyLink_Status_Config_Error) && (idx > 0))
+        {
+            idx--;
+        }
+        else
+        {
+            break;
+        }
+    }
+}
+
+/* Steps the TX power along rfPowerTable to hold the target link margin. The
+ * power goes down one entry per ACK, so a bad measurement costs little, and
+ * up by the whole deficit at once. */
+static void adjustTxPower(int8_t linkMargin)
+{
+    uint8_t idx = txPowerIdx;
+    int8_t txPower;
+
+    if (linkMargin > NODERADIO_TARGET_LINK_MARGIN + NODERADIO_LINK_MARGIN_HYSTERESIS)
+    {
+        if (idx > 0)
+        {
+            idx--;
+        }
+    }
+    else if (linkMargin < NODERADIO_TARGET_LINK_MARGIN - NODERADIO_LINK_MARGIN_HYSTERESIS)
+    {
+        txPower = rfPowerTable[idx].dbm + (NODERADIO_TARGET_LINK_MARGIN - linkMargin);
+        while ((idx < rfPowerTableSize - 1) && (rfPowerTable[idx].dbm < txPower))
+        {
+            idx++;
+        }
+    }
+
+    setTxPower(idx);
+}
+
+/* Reads the ACK and time sync packets where the radio received them, and
+ * gives the buffer back before returning */
+static void rxDoneCallback(EasyLink_RxLentPacket * rxPacket, EasyLink_Status status)
 {
     struct PacketHeader* packetHeader;
+    uint32_t rxDoneTime = EasyLink_getAbsTime();
 
-    /* If this callback is called because of a packet received */
-    if (status == EasyLink_Status_Success)
+    /* A scheduled receive that ended before it started was never on air */
+    if ((int32_t)(rxDoneTime - rxOnTime) > 0)
+    {
+        EnergyMonitor_addRadioTime(EnergyMonitor_Activity_Sub1GhzRx, rxOnTime, rxDoneTime);
+    }
+
+    /* If this callback is called because of a packet received, of a length
+     * we can read. Anything else is handled like an RX error below. */
+    if ((status == EasyLink_Status_Success) && isValidDownlink(rxPacket))
     {
         /* Check the payload header */
         packetHeader = (struct PacketHeader*)rxPacket->payload;
 
-        /* Check if this is an ACK packet */
-        if (packetHeader->packetType == RADIO_PACKET_TYPE_ACK_PACKET)
+        /* ACK, join response and time sync packets carry the network time
+         * they were sent at */
+        if ((packetHeader->packetType == RADIO_PACKET_TYPE_ACK_PACKET) ||
+            (packetHeader->packetType == RADIO_PACKET_TYPE_JOIN_RESPONSE_PACKET) ||
+            (packetHeader->packetType == RADIO_PACKET_TYPE_TIME_SYNC_PACKET))
+        {
+            TimeSync_update(rxPacket->absTime - phySyncTime(currentPhy),
+                            (rxPacket->payload[3] << 24) |
+                            (rxPacket->payload[4] << 16) |
+                            (rxPacket->payload[5] << 8) |
+                             rxPacket->payload[6]);
+        }
+
+        if (listeningForTimeSync)
         {
+            Trace_eventPost(radioOperationEventHandle, RADIO_EVENT_TIME_SYNC_DONE);
+        }
+        /* Check if this is an ACK packet, or while joining our join response */
+        else if (((packetHeader->packetType == RADIO_PACKET_TYPE_ACK_PACKET) && !joining) ||
+                 isJoinResponseForUs(rxPacket))
+        {
+            if (packetHeader->packetType == RADIO_PACKET_TYPE_ACK_PACKET)
+            {
+                /* Learn the ACK timing used for the next receive window */
+                uint32_t latency = rxPacket->absTime - txDoneTime;
+                if (ackLatency == 0)
+                {
+                    ackLatency = latency;
+                }
+                else
+                {
+                    ackLatency += ((int32_t)(latency - ackLatency)) / 4;
+                }
+                if ((rxDoneTime - rxPacket->absTime) > ackDuration)
+                {
+                    ackDuration = rxDoneTime - rxPacket->absTime;
+                }
+            }
+            else
+            {
+                joinedAddress = (rxPacket->payload[10] << 8) | rxPacket->payload[11];
+            }
+
+            /* PHY to use for the next uplink */
+            if ((rxPacket->payload[7] == RADIO_EASYLINK_MODULATION) ||
+                (rxPacket->payload[7] == RADIO_EASYLINK_FAST_MODULATION))
+            {
+                uplinkPhy = (EasyLink_PhyType)rxPacket->payload[7];
+            }
+
+            /* Link margin, applied to the TX power from the task */
+            ackLinkMargin = (int8_t)rxPacket->payload[9];
+
             /* Signal ACK packet received */
-            Event_post(radioOperationEventHandle, RADIO_EVENT_DATA_ACK_RECEIVED);
+            Trace_eventPost(radioOperationEventHandle, RADIO_EVENT_DATA_ACK_RECEIVED);
         }
         else
         {
             /* Packet Error, treat as a Timeout and Post a RADIO_EVENT_ACK_TIMEOUT
                event */
-            Event_post(radioOperationEventHandle, RADIO_EVENT_ACK_TIMEOUT);
+            Trace_eventPost(radioOperationEventHandle, RADIO_EVENT_ACK_TIMEOUT);
         }
     }
+    /* The time sync window closed without a packet */
+    else if (listeningForTimeSync)
+    {
+        Trace_eventPost(radioOperationEventHandle, RADIO_EVENT_TIME_SYNC_DONE);
+    }
     /* did the Rx timeout */
     else if(status == EasyLink_Status_Rx_Timeout)
     {
         /* Post a RADIO_EVENT_ACK_TIMEOUT event */
-        Event_post(radioOperationEventHandle, RADIO_EVENT_ACK_TIMEOUT);
+        Trace_eventPost(radioOperationEventHandle, RADIO_EVENT_ACK_TIMEOUT);
     }
     else
     {
         /* Rx Error, treat as a Timeout and Post a RADIO_EVENT_ACK_TIMEOUT
            event */
-        Event_post(radioOperationEventHandle, RADIO_EVENT_ACK_TIMEOUT);
+        Trace_eventPost(radioOperationEventHandle, RADIO_EVENT_ACK_TIMEOUT);
     }
 
+    EasyLink_releaseRx(rxPacket);
 }
 
 static void sendBleAdvertisement(struct DualModeInternalTempSensorPacket sensorPacket)
 {
-    uint8_t txCnt, chan;
+    SEB_FrameType frameTypes[] = {SEB_FrameType_Url, SEB_FrameType_Tlm};
+    SimpleBeacon_Status status;
+
+    /* Skip this reading if the last one is still being advertised */
+    if (SimpleBeacon_trainBusy())
+    {
+        Trace_end(NODERADIO_TRACE_BLE_ADV, SimpleBeacon_Status_Busy);
+        return;
+    }
 
     /* Toggle activity LED */
     PIN_setOutputValue(ledPinHandle, NODE_BLE_ACTIVITY_LED,!PIN_getOutputValue(NODE_BLE_ACTIVITY_LED));
@@ -438,26 +1353,28 @@ static void sendBleAdvertisement(struct DualModeInternalTempSensorPacket sensorP
 #endif //__CC1350_LAUNCHXL_BOARD_H__
 
     //Prepare TLM frame interleaved with URL and UID
-    char url_format[] = "https://m4bd.se/s/%02x/";
-    char url_ready[21];
+    char url_format[] = "https://m4bd.se/s/%04x/";
+    char url_ready[24];
     sprintf(url_ready, url_format, nodeAddress);
     SEB_initUrl(url_ready , NODE_0M_TXPOWER);
+    /* Count readings in the TLM frame, so a concentrator observing the beacons
+     * can tell them apart from the ones it received on sub-1 GHz */
+    SEB_setAdvCount(sensorPacket.seqNumber);
     SEB_initTLM(sensorPacket.batt, sensorPacket.temp, sensorPacket.time100MiliSec/10);
 
-    for (txCnt = 0; txCnt < SimpleBeacon_AdvertisementTimes; txCnt++)
+    /* The radio times the whole train, the callback restores the antenna
+     * when it is done */
+    status = SEB_sendTrain(frameTypes, sizeof(frameTypes) / sizeof(frameTypes[0]), bleMacAddr,
+                           SimpleBeacon_AdvertisementTimes, (uint64_t)7 << 37, bleAdvDoneCallback);
+    if (status != SimpleBeacon_Status_Success)
     {
-        for (chan = 37; chan < 40; chan++)
-        {
-            SEB_sendFrame(SEB_FrameType_Url, bleMacAddr, 1, (uint64_t) 1<<chan);
-            SEB_sendFrame(SEB_FrameType_Tlm, bleMacAddr, 1, (uint64_t) 1<<chan);
-        }
-
-        //sleep on all but last advertisement
-        if(txCnt+1 < SimpleBeacon_AdvertisementTimes)
-        {
-            Task_sleep(SimpleBeacon_AdvertisementIntervals[txCnt]);
-        }
+        bleAdvDoneCallback(status, 0);
     }
+}
+
+static void bleAdvDoneCallback(SimpleBeacon_Status status, uint32_t radioTime)
+{
+    EnergyMonitor_addRadioTime(EnergyMonitor_Activity_BleAdv, 0, radioTime);
 
 #ifdef __CC1350_LAUNCHXL_BOARD_H__
     //Switch RF switch to Sub1G antenna
@@ -466,4 +1383,6 @@ static void sendBleAdvertisement(struct DualModeInternalTempSensorPacket sensorP
 
     /* Toggle activity LED */
     PIN_setOutputValue(ledPinHandle, NODE_BLE_ACTIVITY_LED,!PIN_getOutputValue(NODE_BLE_ACTIVITY_LED));
+
+    Trace_end(NODERADIO_TRACE_BLE_ADV, status);
 }
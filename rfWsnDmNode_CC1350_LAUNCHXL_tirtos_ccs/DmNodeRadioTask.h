@@ -59,11 +59,17 @@ void NodeRadioTask_init(void);
 /* Sends an ADC value to the concentrator */
 enum NodeRadioOperationStatus NodeRadioTask_sendAdcData(uint16_t data);
 
+/* Sends the energy accounting since boot to the concentrator */
+enum NodeRadioOperationStatus NodeRadioTask_sendEnergyReport(void);
+
+/* Sends the CPU load and stack use of the tasks to the concentrator */
+enum NodeRadioOperationStatus NodeRadioTask_sendTaskStats(void);
+
 /* Sends a BLE beacon with latest data */
 void NodeRadioTask_toggleBLE();
 
 /* Get node address, return 0 if node address has not been set */
-uint8_t nodeRadioTask_getNodeAddr(void);
+uint16_t nodeRadioTask_getNodeAddr(void);
 
 /* Convert adc value to double */
 double convertADCToTempDouble(uint16_t adcValue);
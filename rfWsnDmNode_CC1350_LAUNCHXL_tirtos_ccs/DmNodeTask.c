@@ -48,11 +48,15 @@
 #include <ti/drivers/pin/PINCC26XX.h>
 #include <ti/display/Display.h>
 #include <ti/display/DisplayExt.h>
-#include "extflash/ExtFlash.h"
 
 /* Board Header files */
 #include "Board.h"
 #include "SceAdc.h"
+#include "AdaptiveSampler.h"
+#include "EnergyMonitor.h"
+#include "trace/TaskMonitor.h"
+#include "trace/Trace.h"
+#include "pool/PacketPool.h"
 
 #ifdef DEVICE_FAMILY
     #undef DEVICE_FAMILY_PATH
@@ -70,6 +74,11 @@
 #define NODE_EVENT_ALL              0xFFFFFFFF
 #define NODE_EVENT_NEW_ADC_VALUE    (uint32_t)(1 << 0)
 #define NODE_EVENT_UPDATE_LCD       (uint32_t)(1 << 1)
+#define NODE_EVENT_DUMP_TRACE       (uint32_t)(1 << 2)
+#define NODE_EVENT_SEND_ADC_VALUE   (uint32_t)(1 << 3)
+
+/* Number of readings sent between each energy report to the concentrator */
+#define NODE_ENERGY_REPORT_INTERVAL 60
 
 /***** Variable declarations *****/
 static Task_Params nodeTaskParams;
@@ -80,6 +89,7 @@ static Event_Handle nodeEventHandle;
 static uint16_t latestAdcValue;
 static int32_t latestInternalTempValue;
 static Node_BLEActiveType bleActive = Node_BLEActiveTypeNotActive;
+static uint16_t readingsSinceEnergyReport = 0;
 
 /* Pin driver handle */
 static PIN_Handle buttonPinHandle;
@@ -91,6 +101,7 @@ static PIN_State ledPinState;
 
 /* Display driver handles */
 static Display_Handle hDisplayLcd;
+static Display_Handle hDisplaySerial;
 
 /* Enable the 3.3V power domain used by the LCD */
 PIN_Config pinTable[] = {
@@ -111,11 +122,13 @@ PIN_Config buttonPinTable[] = {
     PIN_TERMINATE
 };
 
-static uint8_t nodeAddress = 0;
+static uint16_t nodeAddress = 0;
 
 /***** Prototypes *****/
 static void nodeTaskFunction(UArg arg0, UArg arg1);
 static void updateLcd(void);
+static void dumpTrace(void);
+static void printTraceLine(const char* line);
 void adcCallback(uint16_t adcValue);
 void buttonCallback(PIN_Handle handle, PIN_Id pinId);
 
@@ -138,10 +151,6 @@ void NodeTask_init(void)
 
 static void nodeTaskFunction(UArg arg0, UArg arg1)
 {
-    /* Turn off external flash for low power */
-    ExtFlash_open();
-    ExtFlash_close();
-
     /* Initialize display and try to open both UART and LCD types of display. */
     Display_Params params;
     Display_Params_init(&params);
@@ -170,6 +179,7 @@ static void nodeTaskFunction(UArg arg0, UArg arg1)
     SceAdc_init();
     SceAdc_registerAdcCallback(adcCallback);
     SceAdc_start();
+    AdaptiveSampler_init();
 
     buttonPinHandle = PIN_open(&buttonPinState, buttonPinTable);
     if (!buttonPinHandle)
@@ -188,19 +198,38 @@ static void nodeTaskFunction(UArg arg0, UArg arg1)
         /* Wait for event */
         uint32_t events = Event_pend(nodeEventHandle, 0, NODE_EVENT_ALL, BIOS_WAIT_FOREVER);
 
-        /* If new ADC value, send this data */
+        /* If new ADC value, adapt the sampling period and see if it should be sent */
         if (events & NODE_EVENT_NEW_ADC_VALUE) {
-            /* Send ADC value to concentrator */
-            NodeRadioTask_sendAdcData(latestAdcValue);
+            if (AdaptiveSampler_addReading(FLOAT2FIXED(convertADCToTempDouble(latestAdcValue)))) {
+                events |= NODE_EVENT_SEND_ADC_VALUE;
+            }
 
             /* update display */
             updateLcd();
         }
 
+        /* Send the latest ADC value */
+        if (events & NODE_EVENT_SEND_ADC_VALUE) {
+            /* Send ADC value to concentrator */
+            NodeRadioTask_sendAdcData(latestAdcValue);
+
+            /* Report the energy accounting and task stats now and then */
+            if (++readingsSinceEnergyReport >= NODE_ENERGY_REPORT_INTERVAL)
+            {
+                NodeRadioTask_sendEnergyReport();
+                NodeRadioTask_sendTaskStats();
+                readingsSinceEnergyReport = 0;
+            }
+        }
+
         if (events & NODE_EVENT_UPDATE_LCD) {
             /* update display */
             updateLcd();
         }
+
+        if (events & NODE_EVENT_DUMP_TRACE) {
+            dumpTrace();
+        }
     }
 
 }
@@ -216,10 +245,11 @@ static void updateLcd(void)
 
     /* print to LCD */
     Display_clear(hDisplayLcd);
-    Display_printf(hDisplayLcd, 0, 0, "NodeID: 0x%02x", nodeAddress);
+    Display_printf(hDisplayLcd, 0, 0, "NodeID: 0x%04x", nodeAddress);
     Display_printf(hDisplayLcd, 1, 0, "ADC: %04d", latestAdcValue);
     Display_printf(hDisplayLcd, 2, 0, "TempA: %3.3f", FIXED2DOUBLE(FLOAT2FIXED(convertADCToTempDouble(latestAdcValue))));  // Convert to match concentrator fixed 8.8 resolution
     Display_printf(hDisplayLcd, 3, 0, "TempI: %d", latestInternalTempValue);
+    Display_printf(hDisplayLcd, 4, 0, "nAh/rd: %d", EnergyMonitor_getChargePerReading());
     Display_printf(hDisplayLcd, 5, 0, "Mik4el");
 
     if (bleActive == Node_BLEActiveTypeActive) {
@@ -227,6 +257,33 @@ static void updateLcd(void)
     }
 }
 
+/* Dumps the task stats, the packet pool use and the trace buffer, for
+ * tools/trace2chrome.py, on the UART. The UART is only open while dumping to
+ * keep it from using power. */
+static void dumpTrace(void)
+{
+    Display_Params params;
+    Display_Params_init(&params);
+
+    hDisplaySerial = Display_open(Display_Type_UART, &params);
+    if (hDisplaySerial)
+    {
+        PacketPool_Stats poolStats;
+        PacketPool_getStats(&poolStats);
+
+        TaskMonitor_print(printTraceLine);
+        Display_printf(hDisplaySerial, 0, 0, "Packet pool free: %d min: %d failed: %d",
+                poolStats.numFree, poolStats.minFree, poolStats.allocFailures);
+        Trace_dump(printTraceLine);
+        Display_close(hDisplaySerial);
+    }
+}
+
+static void printTraceLine(const char* line)
+{
+    Display_printf(hDisplaySerial, 0, 0, "%s", line);
+}
+
 void adcCallback(uint16_t adcValue)
 {
     /* Calibrate and save latest values */
@@ -258,7 +315,11 @@ void buttonCallback(PIN_Handle handle, PIN_Id pinId)
         }
         NodeRadioTask_toggleBLE();
         if (bleActive == Node_BLEActiveTypeActive) {
-            Event_post(nodeEventHandle, NODE_EVENT_NEW_ADC_VALUE);
+            Event_post(nodeEventHandle, NODE_EVENT_SEND_ADC_VALUE);
         }
     }
+    else if (PIN_getInputValue(Board_PIN_BUTTON1) == 0)
+    {
+        Event_post(nodeEventHandle, NODE_EVENT_DUMP_TRACE);
+    }
 }
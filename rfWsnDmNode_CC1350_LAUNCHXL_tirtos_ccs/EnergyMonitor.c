@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2015-2016, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/***** Includes *****/
+#include "EnergyMonitor.h"
+
+#include <xdc/std.h>
+
+#include <ti/sysbios/hal/Hwi.h>
+#include <ti/drivers/Power.h>
+#include <ti/drivers/power/PowerCC26XX.h>
+#include <ti/drivers/rf/RF.h>
+
+/***** Defines *****/
+#define ENERGYMONITOR_RAT_TICKS_PER_MS  4000
+
+/* Charge is accumulated in 0.1uA radio timer ticks, this many make one nAh */
+#define ENERGYMONITOR_CHARGE_PER_NAH    144000000ULL
+
+/* Typical currents in 0.1uA, from the CC1350 datasheet */
+#define ENERGYMONITOR_RX_CURRENT        54000
+#define ENERGYMONITOR_BLE_ADV_CURRENT   94000
+#define ENERGYMONITOR_CPU_CURRENT       25000
+#define ENERGYMONITOR_STANDBY_CURRENT   7
+
+/***** Type declarations *****/
+struct TxCurrent {
+    int8_t txPower;
+    uint32_t current;
+};
+
+struct ActivityTotal {
+    uint64_t ticks;
+    uint64_t charge;
+};
+
+/***** Variable declarations *****/
+/* Sub-1 GHz TX current in 0.1uA at or above each TX power in dBm */
+static const struct TxCurrent txCurrentTable[] = {
+    {-10,  62000},
+    {  0,  87000},
+    { 10, 134000},
+    { 12, 170000},
+    { 14, 235000},
+};
+
+static struct ActivityTotal totals[EnergyMonitor_Activity_Count];
+static uint32_t readings = 0;
+static uint32_t lastWakeTime;
+static uint32_t standbyStartTime;
+static Power_NotifyObj standbyNotifyObj;
+
+/***** Prototypes *****/
+static void addTime(EnergyMonitor_Activity activity, uint32_t ticks, uint32_t current);
+static int_fast16_t standbyNotifyFxn(uint_fast16_t eventType, uintptr_t eventArg, uintptr_t clientArg);
+
+/***** Function definitions *****/
+void EnergyMonitor_init(void)
+{
+    lastWakeTime = RF_getCurrentTime();
+
+    Power_registerNotify(&standbyNotifyObj,
+                         PowerCC26XX_ENTERING_STANDBY | PowerCC26XX_AWAKE_STANDBY,
+                         standbyNotifyFxn, 0);
+}
+
+void EnergyMonitor_addRadioTime(EnergyMonitor_Activity activity, uint32_t startTime, uint32_t endTime)
+{
+    uint32_t current = (activity == EnergyMonitor_Activity_BleAdv) ? ENERGYMONITOR_BLE_ADV_CURRENT : ENERGYMONITOR_RX_CURRENT;
+
+    addTime(activity, endTime - startTime, current);
+}
+
+void EnergyMonitor_addTxTime(uint32_t startTime, uint32_t endTime, int8_t txPower)
+{
+    uint8_t i = 0;
+
+    while ((i < (sizeof(txCurrentTable) / sizeof(txCurrentTable[0])) - 1) &&
+           (txCurrentTable[i + 1].txPower <= txPower))
+    {
+        i++;
+    }
+
+    addTime(EnergyMonitor_Activity_Sub1GhzTx, endTime - startTime, txCurrentTable[i].current);
+}
+
+void EnergyMonitor_countReading(void)
+{
+    readings++;
+}
+
+void EnergyMonitor_getReport(EnergyMonitor_Report* report)
+{
+    uint64_t ticks;
+    uint64_t charge;
+    uint32_t awakeTicks;
+    uint8_t i;
+
+    UInt key = Hwi_disable();
+
+    /* The time since the last wake up is only added to the totals when going
+     * to standby, include it here */
+    awakeTicks = RF_getCurrentTime() - lastWakeTime;
+
+    for (i = 0; i < EnergyMonitor_Activity_Count; i++)
+    {
+        ticks = totals[i].ticks;
+        charge = totals[i].charge;
+        if (i == EnergyMonitor_Activity_CpuActive)
+        {
+            ticks += awakeTicks;
+            charge += (uint64_t)awakeTicks * ENERGYMONITOR_CPU_CURRENT;
+        }
+
+        report->timeMs[i] = (uint32_t)(ticks / ENERGYMONITOR_RAT_TICKS_PER_MS);
+        report->chargeNah[i] = (uint32_t)(charge / ENERGYMONITOR_CHARGE_PER_NAH);
+    }
+    report->readings = readings;
+
+    Hwi_restore(key);
+}
+
+uint32_t EnergyMonitor_getChargePerReading(void)
+{
+    EnergyMonitor_Report report;
+    uint32_t charge = 0;
+    uint8_t i;
+
+    EnergyMonitor_getReport(&report);
+    if (report.readings == 0)
+    {
+        return 0;
+    }
+
+    for (i = 0; i < EnergyMonitor_Activity_Count; i++)
+    {
+        charge += report.chargeNah[i];
+    }
+
+    return charge / report.readings;
+}
+
+static void addTime(EnergyMonitor_Activity activity, uint32_t ticks, uint32_t current)
+{
+    /* Radio activities are added from callbacks as well as tasks */
+    UInt key = Hwi_disable();
+
+    totals[activity].ticks += ticks;
+    totals[activity].charge += (uint64_t)ticks * current;
+
+    Hwi_restore(key);
+}
+
+/* Called with interrupts disabled around each standby period. The radio timer
+ * is not running in standby, but RF_getCurrentTime then derives the time from
+ * the RTC. Each period must be shorter than the 1073s wrap around time. */
+static int_fast16_t standbyNotifyFxn(uint_fast16_t eventType, uintptr_t eventArg, uintptr_t clientArg)
+{
+    uint32_t now = RF_getCurrentTime();
+
+    if (eventType == PowerCC26XX_ENTERING_STANDBY)
+    {
+        addTime(EnergyMonitor_Activity_CpuActive, now - lastWakeTime, ENERGYMONITOR_CPU_CURRENT);
+        standbyStartTime = now;
+    }
+    else
+    {
+        addTime(EnergyMonitor_Activity_Standby, now - standbyStartTime, ENERGYMONITOR_STANDBY_CURRENT);
+        lastWakeTime = now;
+    }
+
+    return Power_NOTIFYDONE;
+}
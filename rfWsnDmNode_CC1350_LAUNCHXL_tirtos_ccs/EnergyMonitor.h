@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2015-2016, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ENERGYMONITOR_H_
+#define ENERGYMONITOR_H_
+
+#include "stdint.h"
+
+/* Accumulates the time spent and the estimated charge used per activity since
+ * boot. Radio activities are added by the caller from radio timer (RAT)
+ * timestamps taken around the radio operations, standby is tracked through
+ * power notifications and the rest of the time is counted as CPU active.
+ *
+ * Charge is estimated from typical datasheet currents, so it is meant for
+ * comparing firmware changes rather than as a battery gauge. The radio
+ * currents are for the whole chip, so time where the radio is active is also
+ * counted as CPU active and the total is an upper bound.
+ */
+
+typedef enum
+{
+    EnergyMonitor_Activity_Sub1GhzTx = 0,
+    EnergyMonitor_Activity_Sub1GhzRx,
+    EnergyMonitor_Activity_BleAdv,
+    EnergyMonitor_Activity_CpuActive,
+    EnergyMonitor_Activity_Standby,
+    EnergyMonitor_Activity_Count,
+} EnergyMonitor_Activity;
+
+typedef struct
+{
+    uint32_t timeMs[EnergyMonitor_Activity_Count];
+    uint32_t chargeNah[EnergyMonitor_Activity_Count];
+    uint32_t readings;
+} EnergyMonitor_Report;
+
+/* Starts the accounting, call once before the radio is used */
+void EnergyMonitor_init(void);
+
+/* Adds the time between two radio timer timestamps to a radio activity */
+void EnergyMonitor_addRadioTime(EnergyMonitor_Activity activity, uint32_t startTime, uint32_t endTime);
+
+/* Adds sub-1 GHz TX time, with the current given by the TX power in dBm */
+void EnergyMonitor_addTxTime(uint32_t startTime, uint32_t endTime, int8_t txPower);
+
+/* Counts a sensor reading, so the charge per reading can be derived */
+void EnergyMonitor_countReading(void);
+
+/* Gets the totals since boot */
+void EnergyMonitor_getReport(EnergyMonitor_Report* report);
+
+/* Returns the average charge per reading since boot in nAh, 0 before the first reading */
+uint32_t EnergyMonitor_getChargePerReading(void);
+
+#endif /* ENERGYMONITOR_H_ */
@@ -36,18 +36,95 @@
 #include "stdint.h"
 #include "easylink/EasyLink.h"
 
-#define RADIO_CONCENTRATOR_ADDRESS     0x00
+/* Nodes use a 16-bit short address assigned by the concentrator when they
+ * join. The address is sent first in each packet and as the EasyLink
+ * destination address, most significant byte first. Until a node has joined
+ * it uses a temporary address derived from its IEEE address, with
+ * RADIO_TEMPORARY_ADDRESS_FLAG set, which assigned addresses never have. */
+#define RADIO_ADDRESS_SIZE             2
+#define RADIO_CONCENTRATOR_ADDRESS     0x0000
+#define RADIO_BROADCAST_ADDRESS        0xFFFF
+#define RADIO_TEMPORARY_ADDRESS_FLAG   0x8000
+#define RADIO_IEEE_ADDRESS_SIZE        8
 #define RADIO_EASYLINK_MODULATION     EasyLink_Phy_625bpsLrm
+#define RADIO_EASYLINK_FAST_MODULATION EasyLink_Phy_50kbps2gfsk
+
+/* The concentrator tells a node to move to the fast PHY when a packet on the
+ * default PHY is received above the upper threshold, and back when a packet on
+ * the fast PHY is received below the lower threshold (dBm) */
+#define RADIO_FAST_PHY_RSSI_UPPER_THRESHOLD    -95
+#define RADIO_FAST_PHY_RSSI_LOWER_THRESHOLD    -102
+
+/* The concentrator listens on the fast PHY in a window at this offset into
+ * every time sync period, and on the default PHY the rest of the time */
+#define RADIO_FAST_PHY_WINDOW_OFFSET_MS        500
+#define RADIO_FAST_PHY_WINDOW_MS               1500
+
+/* On the default PHY the concentrator sniffs for packets once per
+ * RADIO_SNIFF_INTERVAL_MS instead of listening all the time, 0 to listen all
+ * the time. Nodes send a preamble of RADIO_SNIFF_PREAMBLE_MS, which has to be
+ * longer than the interval plus the carrier sense time of up to 13 ms on LRM,
+ * and shorter than twice the interval, so one sniff always falls inside it.
+ * In the fast PHY window the concentrator listens all the time and nodes send
+ * the normal preamble, as a long one would take far longer than the packet. */
+#ifndef RADIO_SNIFF_INTERVAL_MS
+#define RADIO_SNIFF_INTERVAL_MS                200
+#endif
+#define RADIO_SNIFF_PREAMBLE_MS                (RADIO_SNIFF_INTERVAL_MS + 20)
+
+/* Approximate air time of the preamble and sync word, i.e. the time from the
+ * start of a TX to the receive timestamp, in radio time ticks. LRM sends a
+ * 5 byte preamble and 32 bit sync word at 5 kbaud, FSK 4 bytes and 32 bits at
+ * 50 kbps. */
+#define RADIO_LRM_SYNC_TIME                    57600
+#define RADIO_FSK_SYNC_TIME                    5120
+
+/* Approximate receiver sensitivity of the concentrator on each PHY (dBm), the
+ * link margin reported in the ACK is the RSSI above this */
+#define RADIO_LRM_SENSITIVITY                  -120
+#define RADIO_FSK_SENSITIVITY                  -108
+
+/* Highest TX power a node uses (dBm), the RSSI of a packet sent at lower power
+ * is scaled up to this before the concentrator picks a PHY */
+#define RADIO_MAX_TX_POWER                     14
 
 #define RADIO_PACKET_TYPE_ACK_PACKET             0
 #define RADIO_PACKET_TYPE_ADC_SENSOR_PACKET      1
 #define RADIO_PACKET_TYPE_DM_SENSOR_PACKET       2
+#define RADIO_PACKET_TYPE_TIME_SYNC_PACKET       3
+#define RADIO_PACKET_TYPE_ENERGY_PACKET          4
+#define RADIO_PACKET_TYPE_TASK_STATS_PACKET      5
+#define RADIO_PACKET_TYPE_JOIN_REQUEST_PACKET    6
+#define RADIO_PACKET_TYPE_JOIN_RESPONSE_PACKET   7
+
+/* The concentrator broadcasts a time sync packet each time the network time
+ * passes a multiple of this period */
+#define RADIO_TIME_SYNC_PERIOD_MS                30000
+
+/* Length of a time sync packet on air, the header and the network time in ms
+ * it is sent at */
+#define RADIO_TIME_SYNC_PACKET_LENGTH            7
+
+/* Minimum time from the end of a received packet to the start of the ACK.
+ * ACKs are sent exactly on a whole network time millisecond after this. */
+#define RADIO_ACK_TURNAROUND_TIME_MS             10
 
 struct PacketHeader {
-    uint8_t sourceAddress;
+    uint16_t sourceAddress;
     uint8_t packetType;
 };
 
+/* Length of a PacketHeader on air, without the padding of the struct */
+#define RADIO_PACKET_HEADER_LENGTH               3
+
+/* Set to 1 in both projects to encrypt and authenticate the packets the nodes
+ * send to the concentrator with AES-CCM, see crypto/PacketCrypto.h. The
+ * header stays in clear and each packet gets PACKETCRYPTO_OVERHEAD bytes
+ * longer. The lengths below are of the plain packets. */
+#ifndef RADIO_SECURITY_ENABLED
+#define RADIO_SECURITY_ENABLED                   0
+#endif
+
 struct AdcSensorPacket {
     struct PacketHeader header;
     uint16_t adcValue;
@@ -67,10 +144,88 @@ struct DualModeInternalTempSensorPacket {
     uint16_t batt;
     uint16_t internalTemp; //Fixed 8.8 notation
     uint32_t time100MiliSec;
+    uint32_t networkTime100MiliSec; //Network time of the reading, 0 if not synchronized
+    int8_t txPower; //dBm the packet was sent with
+    uint8_t seqNumber; //Incremented per reading sent, not per retry, so gaps are lost readings
+    uint16_t samplePeriodS; //Current sampling period of the node
+    uint16_t heartbeatS; //Longest time until the node sends its next reading
+};
+
+/* Length of a DualModeInternalTempSensorPacket on air, without the padding of
+ * the struct */
+#define RADIO_DM_SENSOR_PACKET_LENGTH            23
+
+/* Charge used by a node since boot per activity, in the order sub-1 GHz TX,
+ * sub-1 GHz RX, BLE advertising, CPU active and standby */
+#define RADIO_ENERGY_ACTIVITIES                  5
+
+struct EnergyPacket {
+    struct PacketHeader header;
+    uint32_t readings; //Sensor readings since boot
+    uint32_t chargeNah[RADIO_ENERGY_ACTIVITIES];
+    int8_t txPower; //dBm the packet was sent with
+};
+
+/* Length of an EnergyPacket on air */
+#define RADIO_ENERGY_PACKET_LENGTH               28
+
+/* CPU load and stack use of up to this many tasks of a node */
+#define RADIO_MAX_TASK_STATS                     4
+
+struct TaskStats {
+    uint8_t priority;
+    uint16_t loadPermille; //share of the CPU time over the last period
+    uint16_t stackSize;
+    uint16_t stackUsed; //high-water mark
 };
 
+struct TaskStatsPacket {
+    struct PacketHeader header;
+    uint8_t numTasks;
+    struct TaskStats tasks[RADIO_MAX_TASK_STATS];
+    int8_t txPower; //dBm the packet was sent with, after the numTasks entries
+};
+
+/* Length of a TaskStatsPacket with numTasks entries on air */
+#define RADIO_TASK_STATS_ENTRY_LENGTH            7
+#define RADIO_TASK_STATS_PACKET_LENGTH(numTasks) (5 + RADIO_TASK_STATS_ENTRY_LENGTH * (numTasks))
+
+/* Time sync and ACK packets are sent by the concentrator with the TX started
+ * exactly at networkTimeMs, so the receive timestamp of a node maps its own
+ * radio time to the network time */
 struct AckPacket {
     struct PacketHeader header;
+    uint32_t networkTimeMs;
+    uint8_t phy; //EasyLink_PhyType the node should use for its next uplink
+    int8_t rssi; //RSSI of the packet being acknowledged
+    int8_t linkMargin; //rssi above the sensitivity of the PHY it was received on
 };
 
+struct TimeSyncPacket {
+    struct PacketHeader header;
+    uint32_t networkTimeMs;
+};
+
+/* A node sends a join request before anything else after boot, from the
+ * address it was assigned before if it has one. The concentrator answers in
+ * place of the ACK with a join response, the ACK fields followed by the
+ * address the node uses from then on, sent to the address of the request. */
+struct JoinRequestPacket {
+    struct PacketHeader header;
+    uint8_t ieeeAddr[RADIO_IEEE_ADDRESS_SIZE];
+};
+
+/* Length of a JoinRequestPacket on air */
+#define RADIO_JOIN_REQUEST_PACKET_LENGTH         11
+
+struct JoinResponsePacket {
+    struct AckPacket ack;
+    uint16_t address;
+    uint8_t ieeeAddr[RADIO_IEEE_ADDRESS_SIZE]; //Of the node the address is for
+};
+
+/* Lengths of an AckPacket and a JoinResponsePacket on air */
+#define RADIO_ACK_PACKET_LENGTH                  10
+#define RADIO_JOIN_RESPONSE_PACKET_LENGTH        20
+
 #endif /* RADIOPROTOCOL_H_ */
@@ -36,6 +36,16 @@
 #include <xdc/std.h>
 #include <xdc/runtime/System.h>
 
+#include <ti/sysbios/hal/Hwi.h>
+
+#ifdef DEVICE_FAMILY
+    #undef DEVICE_FAMILY_PATH
+    #define DEVICE_FAMILY_PATH(x) <ti/devices/DEVICE_FAMILY/x>
+    #include DEVICE_FAMILY_PATH(driverlib/aon_rtc.h)
+#else
+    #error "You must define DEVICE_FAMILY at the project level as one of cc26x0, cc26x0r2, cc13x0, etc."
+#endif
+
 /* SCE Header files */
 #include "sce/scif.h"
 #include "sce/scif_framework.h"
@@ -60,12 +70,22 @@ void SceAdc_init(void) {
     scifInit(&scifDriverSetup);
 
     // Setup period for checking ADC
-    uint16_t seconds = 60*10;
+    uint16_t seconds = SCEADC_DEFAULT_PERIOD_S;
     uint16_t second_parts = 0;
     uint32_t period = (seconds << 16) | second_parts;
     scifStartRtcTicksNow(period);
 }
 
+void SceAdc_setPeriod(uint16_t seconds) {
+    uint32_t period = (uint32_t)seconds << 16;
+
+    // Move the next tick to one new period from now, as the RTC format is
+    // the same as the tick format
+    UInt key = Hwi_disable();
+    scifStartRtcTicks(AONRTCCurrentCompareValueGet() + period, period);
+    Hwi_restore(key);
+}
+
 void SceAdc_start(void) {
     // Start task
     scifStartTasksNbl((1 <<SCIF_SIMPLE_LMT70_ADC_TASK_ID));
@@ -36,6 +36,8 @@
 #include "stdint.h"
 #include "sce/scif.h"
 
+/* Sampling period until SceAdc_setPeriod is called */
+#define SCEADC_DEFAULT_PERIOD_S 600
 
 typedef void(*SceAdc_adcCallback)(uint16_t adcValue);
 
@@ -58,6 +60,11 @@ void SceAdc_init(void);
  */
 void SceAdc_registerAdcCallback(SceAdc_adcCallback callback);
 
+/* Changes the sampling period, the next sample is taken one period from now.
+ *
+ * Can be called while the task is running. */
+void SceAdc_setPeriod(uint16_t seconds);
+
 /* Starts the SCE ADC sampling task.
  *
  * The task has to be initialized using SceAdc_init before being started. */
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2015-2016, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/***** Includes *****/
+#include "TimeSync.h"
+
+#include <xdc/std.h>
+
+#include <ti/sysbios/knl/Clock.h>
+
+#include "easylink/EasyLink.h"
+
+/***** Defines *****/
+#define TIMESYNC_RAT_TICKS_PER_MS       4000
+
+/* Sync points older than this are not used to schedule receive windows. Must
+ * stay well below the 1073s wrap around time of the radio timer. */
+#define TIMESYNC_MAX_AGE_MS             (15 * 60 * 1000)
+
+/* Fixed guard time and the residual drift in ppm, after drift compensation,
+ * that the guard time is widened with since the last sync point */
+#define TIMESYNC_MIN_GUARD_TIME         EasyLink_ms_To_RadioTime(2)
+#define TIMESYNC_RESIDUAL_DRIFT_PPM     5
+
+/* Limit for the drift estimate, the crystals are specified to 40ppm each */
+#define TIMESYNC_MAX_DRIFT_PPB          100000
+
+/***** Type declarations *****/
+struct SyncPoint {
+    uint32_t ratTime;
+    uint32_t networkTimeMs;
+    uint32_t clockTicks;
+};
+
+/***** Variable declarations *****/
+static struct SyncPoint lastSync;
+static bool synced = false;
+/* Local radio timer rate relative to the network time, in parts per billion */
+static int32_t driftPpb = 0;
+
+/***** Function definitions *****/
+void TimeSync_update(uint32_t txStartTime, uint32_t networkTimeMs)
+{
+    uint32_t elapsedMs = networkTimeMs - lastSync.networkTimeMs;
+
+    /* Estimate the drift from the previous sync point if it is not too old */
+    if (synced && (elapsedMs > 0) && (elapsedMs < TIMESYNC_MAX_AGE_MS))
+    {
+        int64_t expected = (int64_t)elapsedMs * TIMESYNC_RAT_TICKS_PER_MS;
+        int64_t measured = (uint32_t)(txStartTime - lastSync.ratTime);
+        int32_t newDriftPpb = (int32_t)(((measured - expected) * 1000000000) / expected);
+
+        if ((newDriftPpb < TIMESYNC_MAX_DRIFT_PPB) && (newDriftPpb > -TIMESYNC_MAX_DRIFT_PPB))
+        {
+            /* Smooth the estimate as the timestamps have some jitter */
+            driftPpb += (newDriftPpb - driftPpb) / 2;
+        }
+    }
+
+    lastSync.ratTime = txStartTime;
+    lastSync.networkTimeMs = networkTimeMs;
+    lastSync.clockTicks = Clock_getTicks();
+    synced = true;
+}
+
+bool TimeSync_isSynced(void)
+{
+    return synced &&
+           (((Clock_getTicks() - lastSync.clockTicks) / (1000 / Clock_tickPeriod)) < TIMESYNC_MAX_AGE_MS);
+}
+
+uint32_t TimeSync_getNetworkTimeMs(uint32_t ratTime)
+{
+    if (!synced)
+    {
+        return 0;
+    }
+
+    /* Remove the drift of the local radio timer from the elapsed time */
+    int64_t elapsed = (uint32_t)(ratTime - lastSync.ratTime);
+    elapsed -= (elapsed * driftPpb) / 1000000000;
+
+    return lastSync.networkTimeMs + (uint32_t)(elapsed / TIMESYNC_RAT_TICKS_PER_MS);
+}
+
+uint32_t TimeSync_getRatTime(uint32_t networkTimeMs)
+{
+    int64_t elapsed = (int64_t)(networkTimeMs - lastSync.networkTimeMs) * TIMESYNC_RAT_TICKS_PER_MS;
+    elapsed += (elapsed * driftPpb) / 1000000000;
+
+    return lastSync.ratTime + (uint32_t)elapsed;
+}
+
+uint32_t TimeSync_getGuardTime(uint32_t ratTime)
+{
+    uint32_t elapsed = ratTime - lastSync.ratTime;
+
+    return TIMESYNC_MIN_GUARD_TIME + (elapsed / 1000000) * TIMESYNC_RESIDUAL_DRIFT_PPM;
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2015-2016, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TIMESYNC_H_
+#define TIMESYNC_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+
+/* Tracks the offset and drift between the local radio timer (RAT) and the
+ * network time kept by the concentrator.
+ *
+ * Every sync point is the local radio time at which the concentrator started
+ * sending a time sync or ACK packet, i.e. the receive timestamp minus the
+ * preamble and sync word air time of the PHY, together with the network time
+ * (in ms) carried in the packet. Keeping the PHY out of the sync points lets
+ * them be mixed across PHYs.
+ */
+
+/* Adds a new sync point, updating offset and drift */
+void TimeSync_update(uint32_t txStartTime, uint32_t networkTimeMs);
+
+/* Returns true if synchronized and the last sync point is recent enough to
+ * schedule receive windows from */
+bool TimeSync_isSynced(void);
+
+/* Converts a local radio time to network time in ms, returns 0 if not synchronized */
+uint32_t TimeSync_getNetworkTimeMs(uint32_t ratTime);
+
+/* Returns the local radio time at which the given network time occurs, add
+ * the PHY sync time to get the receive timestamp of a packet sent then */
+uint32_t TimeSync_getRatTime(uint32_t networkTimeMs);
+
+/* Returns the guard time in radio time ticks to use on each side of a receive
+ * window at the given local radio time, growing with the age of the last sync */
+uint32_t TimeSync_getGuardTime(uint32_t ratTime);
+
+#endif /* TIMESYNC_H_ */
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2015-2016, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PACKETCRYPTO_H_
+#define PACKETCRYPTO_H_
+
+#include "stdint.h"
+
+/* AES-CCM encryption and authentication of radio frames with the hardware
+ * crypto engine. A sealed frame is
+ *
+ *   header (clear), frame counter (4, big endian), encrypted body, MIC
+ *
+ * where the header and the frame counter are authenticated but not encrypted,
+ * so the receiver can find the sender before opening it. The nonce is built
+ * from the source, the sender address and the frame counter, so a sender must
+ * never seal two frames with the same counter.
+ *
+ * The network key is put in the crypto key store once by PacketCrypto_init
+ * and used by index for every frame. Frames are short, so the transactions
+ * poll the engine instead of blocking on its interrupt. The functions may
+ * only be called from one task.
+ *
+ * The crypto/ directory is shared, keep all projects' copies identical.
+ */
+
+/* 128-bit network key as four words, the same in all devices of a network.
+ * Change it for a deployment. */
+#ifndef PACKETCRYPTO_KEY
+#define PACKETCRYPTO_KEY    { 0x2B7E1516, 0x28AED2A6, 0xABF71588, 0x09CF4F3C }
+#endif
+
+#define PACKETCRYPTO_COUNTER_LENGTH     4
+#define PACKETCRYPTO_MIC_LENGTH         4
+
+/* Bytes a sealed frame is longer than the plain one */
+#define PACKETCRYPTO_OVERHEAD           (PACKETCRYPTO_COUNTER_LENGTH + PACKETCRYPTO_MIC_LENGTH)
+
+/* Kinds of frames, part of the nonce so frames of different kinds from the
+ * same sender never share one */
+#define PACKETCRYPTO_SOURCE_SUB1GHZ     0
+#define PACKETCRYPTO_SOURCE_BEACON      1
+
+/* Opens the crypto driver and loads the network key */
+void PacketCrypto_init(void);
+
+/* Returns a random frame counter to start from, so that a sender does not
+ * repeat the counters of its previous boot */
+uint32_t PacketCrypto_randomCounter(void);
+
+/* Seals the plain frame of length bytes in data in place: the first
+ * headerLength bytes are only authenticated, the rest is encrypted. A
+ * headerLength of length only authenticates the frame. data must have room
+ * for PACKETCRYPTO_OVERHEAD more bytes. Returns the sealed length. */
+uint8_t PacketCrypto_seal(uint8_t* data, uint8_t headerLength, uint8_t length,
+                          uint8_t source, uint16_t address, uint32_t frameCounter);
+
+/* Opens a sealed frame of length bytes in data in place, giving back the
+ * plain frame at the start of data and its frame counter. Returns the plain
+ * length, or 0 if the frame is too short or its MIC does not match. */
+uint8_t PacketCrypto_open(uint8_t* data, uint8_t headerLength, uint8_t length,
+                          uint8_t source, uint16_t address, uint32_t* frameCounter);
+
+#endif /* PACKETCRYPTO_H_ */
@@ -42,6 +42,7 @@
 #include <xdc/runtime/Error.h>
 #include <ti/sysbios/BIOS.h>
 #include <ti/sysbios/knl/Task.h>
+#include <ti/sysbios/hal/Hwi.h>
 
 #ifdef DEVICE_FAMILY
     #undef DEVICE_FAMILY_PATH
@@ -57,6 +58,8 @@
 #endif
 
 #include "Board.h"
+#include "trace/Trace.h"
+#include "pool/PacketPool.h"
 
 union setupCmd_t{
     rfc_CMD_PROP_RADIO_DIV_SETUP_t divSetup;
@@ -76,13 +79,41 @@ union setupCmd_t{
 
 #define EASYLINK_RF_CMD_HANDLE_INVALID -1
 
+//Trace the post and the end of each command (chain)
+#define EASYLINK_TRACE_POST(pOp)    Trace_record(Trace_Event_RfCmdPost, 0, \
+        ((RF_Op*)(pOp))->commandNo)
+#define EASYLINK_TRACE_DONE(pOp)    Trace_record(Trace_Event_RfCmdDone, \
+        Trace_rfStatus(((RF_Op*)(pOp))->status), ((RF_Op*)(pOp))->commandNo)
+
 #define RF_MODE_MULTIPLE 0x05
 
 #define EasyLink_CmdHandle_isValid(handle) (handle >= 0)
 
+//Carrier sense window per CSMA attempt, long enough for a valid RSSI in LRM
+#define EASYLINK_CSMA_CS_TIME          EasyLink_ms_To_RadioTime(5)
+//Min and max backoff exponent for the CSMA binary exponential backoff
+#define EASYLINK_CSMA_MIN_BE           2
+#define EASYLINK_CSMA_MAX_BE           5
+
+//Sniff carrier sense. Preamble correlation is checked over periods of two
+//preamble bytes, and the channel is idle when the RSSI is below the threshold
+//and EASYLINK_SNIFF_CORR_INVALID periods passed without a correlation. The
+//carrier sense ends one period later at the latest.
+#define EASYLINK_SNIFF_CORR_INVALID    3
+#define EASYLINK_SNIFF_CS_PERIODS      (EASYLINK_SNIFF_CORR_INVALID + 1)
+//Air time of a preamble byte in Radio Time Ticks, at 50 kbps FSK and for LRM,
+//which sends its preamble at 5 kbaud
+#define EASYLINK_FSK_PREAMBLE_BYTE_TIME    640
+#define EASYLINK_LRM_PREAMBLE_BYTE_TIME    6400
+
 /***** Prototypes *****/
 static EasyLink_TxDoneCb txCb;
 static EasyLink_ReceiveCb rxCb;
+static EasyLink_ReceiveLentCb rxLentCb;
+static EasyLink_Status startReceiveAsync(EasyLink_ReceiveCb cb, EasyLink_ReceiveLentCb lentCb,
+        uint32_t absTime, uint32_t timeout);
+static void dispatchCmds(void);
+static void rxDoneCallback(RF_Handle h, RF_CmdHandle ch, RF_EventMask e);
 
 /***** Variable declarations *****/
 
@@ -90,24 +121,28 @@ static RF_Object rfObject;
 static RF_Handle rfHandle;
 
 //Rx buffer includes data entry structure, hdr (len=1byte), dst addr (max of 8 bytes) and data
-//which must be aligned to 4B
-#if defined(__TI_COMPILER_VERSION__)
-    #pragma DATA_ALIGN (rxBuffer, 4);
-        static uint8_t rxBuffer[sizeof(rfc_dataEntryGeneral_t) + 1 + EASYLINK_MAX_ADDR_SIZE + EASYLINK_MAX_DATA_LENGTH];
-#elif defined(__IAR_SYSTEMS_ICC__)
-    #pragma data_alignment = 4
-        static uint8_t rxBuffer[sizeof(rfc_dataEntryGeneral_t) + 1 + EASYLINK_MAX_ADDR_SIZE + EASYLINK_MAX_DATA_LENGTH];
-#elif defined(__GNUC__)
-        static uint8_t rxBuffer[sizeof(rfc_dataEntryGeneral_t) + 1 + EASYLINK_MAX_ADDR_SIZE + EASYLINK_MAX_DATA_LENGTH];
-#else
-    #error This compiler is not supported.
-#endif
+//which must be aligned to 4B. It is taken from the PacketPool, which aligns
+//its blocks, for each Rx command. The block starts with an
+//EasyLink_RxLentPacket, so it can be lent to the application as it is, and
+//the data entry follows it
+#define EASYLINK_RX_BUFFER_SIZE (sizeof(rfc_dataEntryGeneral_t) + 1 + EASYLINK_MAX_ADDR_SIZE + EASYLINK_MAX_DATA_LENGTH)
+static EasyLink_RxLentPacket *rxBlock = NULL;
+static rfc_dataEntryGeneral_t *rxBuffer = NULL;
 
 static dataQueue_t dataQueue;
 static rfc_propRxOutput_t rxStatistics;
+//Rx statistics accumulated over all Rx commands, rxStatistics is cleared at
+//the start of every Rx
+static EasyLink_RxStats rxStatsTotal;
+
+//Tx buffer includes hdr (len=1byte), dst addr (max of 8 bytes) and data,
+//taken from the PacketPool for the duration of each Tx
+#define EASYLINK_TX_BUFFER_SIZE (1 + EASYLINK_MAX_ADDR_SIZE + EASYLINK_MAX_DATA_LENGTH)
+static uint8_t *txBuffer = NULL;
 
-//Tx buffer includes hdr (len=1byte), dst addr (max of 8 bytes) and data
-static uint8_t txBuffer[1 + EASYLINK_MAX_ADDR_SIZE + EASYLINK_MAX_DATA_LENGTH];
+//Fail the build if a PacketPool block can not hold the buffers
+typedef char EasyLink_rxBufferFitsPoolBlock[(sizeof(EasyLink_RxLentPacket) + EASYLINK_RX_BUFFER_SIZE <= PACKETPOOL_BLOCK_SIZE) ? 1 : -1];
+typedef char EasyLink_rxPacketFitsPoolBlock[(sizeof(EasyLink_RxPacket) <= PACKETPOOL_BLOCK_SIZE) ? 1 : -1];
 
 //Addr size for Filter and Tx/Rx operations
 //Set default to 1 byte addr to work with SmartRF
@@ -135,7 +170,29 @@ static union setupCmd_t EasyLink_cmdPropRadioSetup;
 static rfc_CMD_FS_t EasyLink_cmdFs;
 static RF_Mode EasyLink_RF_prop;
 static rfc_CMD_PROP_TX_t EasyLink_cmdPropTx;
-static rfc_CMD_PROP_RX_ADV_t EasyLink_cmdPropRxAdv;
+static rfc_CMD_PROP_TX_ADV_t EasyLink_cmdPropTxAdv;
+//Run as CMD_PROP_RX_ADV, or as CMD_PROP_RX_ADV_SNIFF when sniffing, which
+//extends it with the carrier sense fields
+static rfc_CMD_PROP_RX_ADV_SNIFF_t EasyLink_cmdPropRxAdv;
+static rfc_CMD_PROP_CS_t EasyLink_cmdPropCs;
+
+//CSMA (listen before talk) configuration and state
+static bool csmaEnabled = false;
+static int8_t csmaRssiThreshold = EASYLINK_CSMA_DEFAULT_RSSI_THRESHOLD;
+static uint8_t csmaMaxAttempts = EASYLINK_CSMA_DEFAULT_MAX_ATTEMPTS;
+static uint32_t csmaBackoffUnit = EASYLINK_CSMA_DEFAULT_BACKOFF_UNIT;
+static uint8_t csmaAttempts = 0;
+static uint32_t csmaRandomState = 0;
+//Requested start time of the current Tx, 0 for now
+static uint32_t txAbsTime = 0;
+//Preamble time of the Tx, 0 for the preamble of the PHY
+static uint32_t preambleTime = 0;
+
+//Sniff configuration, and the end of the current sniffing Rx if it has one
+static uint32_t sniffInterval = 0;
+static int8_t sniffRssiThreshold = EASYLINK_SNIFF_DEFAULT_RSSI_THRESHOLD;
+static uint32_t sniffRxEndTime;
+static bool sniffRxHasEndTime;
 
 // The table for setting the Rx Address Filters
 static uint8_t addrFilterTable[EASYLINK_MAX_ADDR_FILTERS * EASYLINK_MAX_ADDR_SIZE] = {0xaa};
@@ -146,16 +203,204 @@ static Semaphore_Handle busyMutex;
 //Handle for last Async command, which is needed by EasyLink_abort
 static RF_CmdHandle asyncCmdHndl = EASYLINK_RF_CMD_HANDLE_INVALID;
 
+//Commands submitted with EasyLink_submit, one FIFO per priority
+static EasyLink_Cmd *cmdQueueHead[EasyLink_Priority_Count];
+static EasyLink_Cmd *cmdQueueTail[EasyLink_Priority_Count];
+//Submitted command being run by the radio, and whether it is being stopped
+//for a more urgent one
+static EasyLink_Cmd *runningCmd = NULL;
+static bool runningCmdPreempted = false;
+
+//Pseudo random number for the CSMA backoff (xorshift32)
+static uint32_t csmaRandom(void)
+{
+    if (csmaRandomState == 0)
+    {
+        uint8_t ieeeAddr[8];
+        EasyLink_getIeeeAddr(ieeeAddr);
+        //Seed from the IEEE address so nodes powered up together diverge
+        csmaRandomState = ((ieeeAddr[4] << 24) | (ieeeAddr[5] << 16) |
+                (ieeeAddr[6] << 8) | ieeeAddr[7]) ^ RF_getCurrentTime();
+        if (csmaRandomState == 0)
+        {
+            csmaRandomState = 1;
+        }
+    }
+
+    csmaRandomState ^= csmaRandomState << 13;
+    csmaRandomState ^= csmaRandomState >> 17;
+    csmaRandomState ^= csmaRandomState << 5;
+
+    return csmaRandomState;
+}
+
+//Tx command for the preamble setting, the advanced Tx sends a long preamble
+static RF_Op* txCmd(void)
+{
+    return (preambleTime != 0) ? (RF_Op*)&EasyLink_cmdPropTxAdv : (RF_Op*)&EasyLink_cmdPropTx;
+}
+
+//Puts txPacket in the txBuffer for the Tx command. The advanced Tx sends the
+//length byte from the buffer as its header.
+static void setTxPacket(EasyLink_TxPacket *txPacket)
+{
+    uint8_t *pPkt = txBuffer;
+
+    if (preambleTime != 0)
+    {
+        *pPkt++ = txPacket->len + addrSize;
+        EasyLink_cmdPropTxAdv.pktLen = 1 + txPacket->len + addrSize;
+        EasyLink_cmdPropTxAdv.pPkt = txBuffer;
+        EasyLink_cmdPropTxAdv.preTime = preambleTime;
+    }
+
+    memcpy(pPkt, txPacket->dstAddr, addrSize);
+    memcpy(pPkt + addrSize, txPacket->payload, txPacket->len);
+
+    //packet length to Tx includes address
+    EasyLink_cmdPropTx.pktLen = txPacket->len + addrSize;
+    EasyLink_cmdPropTx.pPkt = txBuffer;
+}
+
+//Posts the Tx command, chained behind a carrier sense command when CSMA is
+//enabled. Each call is one CSMA attempt with a random backoff that doubles
+//in range for every attempt.
+static RF_CmdHandle postTxCmd(RF_Callback cb)
+{
+    RF_Op *pTx = txCmd();
+    RF_Op *pOp = pTx;
+
+    pTx->status = IDLE;
+
+    if (csmaEnabled)
+    {
+        uint8_t backoffExponent = EASYLINK_CSMA_MIN_BE + csmaAttempts;
+        uint32_t startTime = RF_getCurrentTime();
+
+        if (backoffExponent > EASYLINK_CSMA_MAX_BE)
+        {
+            backoffExponent = EASYLINK_CSMA_MAX_BE;
+        }
+        if ((txAbsTime != 0) && (csmaAttempts == 0))
+        {
+            startTime = txAbsTime;
+        }
+
+        EasyLink_cmdPropCs.status = IDLE;
+        EasyLink_cmdPropCs.rssiThr = csmaRssiThreshold;
+        EasyLink_cmdPropCs.startTrigger.triggerType = TRIG_ABSTIME;
+        EasyLink_cmdPropCs.startTrigger.pastTrig = 1;
+        EasyLink_cmdPropCs.startTime = startTime +
+                (csmaRandom() & ((1 << backoffExponent) - 1)) * csmaBackoffUnit;
+
+        //Tx follows directly when the carrier sense found the channel idle
+        EasyLink_cmdPropCs.pNextOp = pTx;
+        pTx->startTrigger.triggerType = TRIG_NOW;
+        pTx->startTrigger.pastTrig = 1;
+        pTx->startTime = 0;
+
+        pOp = (RF_Op*)&EasyLink_cmdPropCs;
+        csmaAttempts++;
+    }
+    else if (txAbsTime != 0)
+    {
+        pTx->startTrigger.triggerType = TRIG_ABSTIME;
+        pTx->startTrigger.pastTrig = 1;
+        pTx->startTime = txAbsTime;
+    }
+    else
+    {
+        pTx->startTrigger.triggerType = TRIG_NOW;
+        pTx->startTrigger.pastTrig = 1;
+        pTx->startTime = 0;
+    }
+
+    EASYLINK_TRACE_POST(pOp);
+    return RF_postCmd(rfHandle, pOp, RF_PriorityNormal, cb,
+            EASYLINK_RF_EVENT_MASK);
+}
+
+//Head of the chain posted by postTxCmd
+static RF_Op* txCmdHead(void)
+{
+    return csmaEnabled ? (RF_Op*)&EasyLink_cmdPropCs : txCmd();
+}
+
+//Returns true if the sniff that just ended found the channel idle
+static bool sniffFoundIdle(void)
+{
+    return ((EasyLink_cmdPropRxAdv.status == PROP_DONE_IDLE) ||
+            (EasyLink_cmdPropRxAdv.status == PROP_DONE_IDLETIMEOUT));
+}
+
+//Add the statistics of the Rx command that just ended to the totals, called
+//once per Rx command
+static void accumulateRxStats(void)
+{
+    UInt key = Hwi_disable();
+
+    rxStatsTotal.nRxOk += rxStatistics.nRxOk;
+    rxStatsTotal.nRxNok += rxStatistics.nRxNok;
+    rxStatsTotal.nRxIgnored += rxStatistics.nRxIgnored;
+    rxStatsTotal.nRxStopped += rxStatistics.nRxStopped;
+    rxStatsTotal.nRxBufFull += rxStatistics.nRxBufFull;
+    if ((rxStatistics.nRxOk + rxStatistics.nRxNok + rxStatistics.nRxIgnored) != 0)
+    {
+        rxStatsTotal.lastRssi = rxStatistics.lastRssi;
+    }
+    if (EasyLink_cmdPropRxAdv.commandNo == CMD_PROP_RX_ADV_SNIFF)
+    {
+        if (sniffFoundIdle())
+        {
+            rxStatsTotal.nSniffIdle++;
+        }
+        else if ((EasyLink_cmdPropRxAdv.status == PROP_DONE_OK) ||
+                (EasyLink_cmdPropRxAdv.status == PROP_DONE_RXERR) ||
+                (EasyLink_cmdPropRxAdv.status == PROP_DONE_RXTIMEOUT))
+        {
+            rxStatsTotal.nSniffBusy++;
+        }
+    }
+
+    Hwi_restore(key);
+}
+
+//Returns true if the carrier sense stopped the chain before the Tx started
+static bool csmaChannelBusy(void)
+{
+    return (csmaEnabled && (txCmd()->status == IDLE));
+}
+
 //Callback for Async Tx complete
 static void txDoneCallback(RF_Handle h, RF_CmdHandle ch, RF_EventMask e)
 {
     EasyLink_Status status;
 
+    EASYLINK_TRACE_DONE(txCmdHead());
+
+    if ((e & RF_EventLastCmdDone) && csmaChannelBusy() &&
+            (csmaAttempts < csmaMaxAttempts))
+    {
+        //Channel busy, back off and try again keeping the busyMutex
+        asyncCmdHndl = postTxCmd(txDoneCallback);
+        if (EasyLink_CmdHandle_isValid(asyncCmdHndl))
+        {
+            return;
+        }
+    }
+
+    PacketPool_free(txBuffer);
+    txBuffer = NULL;
+
     //Release now so user callback can call EasyLink API's
     Semaphore_post(busyMutex);
     asyncCmdHndl = EASYLINK_RF_CMD_HANDLE_INVALID;
 
-    if (e & RF_EventLastCmdDone)
+    if ((e & RF_EventLastCmdDone) && csmaChannelBusy())
+    {
+        status = EasyLink_Status_Channel_Busy;
+    }
+    else if (e & RF_EventLastCmdDone)
     {
         status = EasyLink_Status_Success;
     }
@@ -172,17 +417,91 @@ static void txDoneCallback(RF_Handle h, RF_CmdHandle ch, RF_EventMask e)
     {
         txCb(status);
     }
+
+    dispatchCmds();
+}
+
+//Takes a PacketPool block for an Rx and returns its data entry, or NULL
+static rfc_dataEntryGeneral_t* allocRxBuffer(void)
+{
+    rxBlock = PacketPool_alloc();
+    if (rxBlock == NULL)
+    {
+        return NULL;
+    }
+    //the lent packet header is a multiple of 4B, keeping the entry aligned
+    return (rfc_dataEntryGeneral_t*)((uint8_t*)rxBlock + sizeof(EasyLink_RxLentPacket));
+}
+
+static void freeRxBuffer(void)
+{
+    PacketPool_free(rxBlock);
+    rxBlock = NULL;
+    rxBuffer = NULL;
+}
+
+//Sets the start of a sniff, the carrier sense and Rx end are relative to it
+static void setSniffStart(uint32_t startTime)
+{
+    EasyLink_cmdPropRxAdv.startTrigger.triggerType = TRIG_ABSTIME;
+    EasyLink_cmdPropRxAdv.startTrigger.pastTrig = 1;
+    EasyLink_cmdPropRxAdv.startTime = startTime;
+}
+
+//Posts the next sniff of a sniffing Rx, one interval after the last one.
+//Returns false if the Rx timed out instead or the sniff could not be posted.
+static bool postNextSniff(void)
+{
+    uint32_t startTime = EasyLink_cmdPropRxAdv.startTime + sniffInterval;
+    uint32_t now = RF_getCurrentTime();
+
+    if ((int32_t)(now - startTime) > 0)
+    {
+        //Late, sniff at once rather than catching up
+        startTime = now;
+    }
+    if (sniffRxHasEndTime && ((int32_t)(startTime - sniffRxEndTime) >= 0))
+    {
+        return false;
+    }
+
+    setSniffStart(startTime);
+    memset(&rxStatistics, 0, sizeof(rfc_propRxOutput_t));
+    rxBuffer->status = 0;
+    dataQueue.pCurrEntry = (uint8_t*)rxBuffer;
+
+    EASYLINK_TRACE_POST(&EasyLink_cmdPropRxAdv);
+    asyncCmdHndl = RF_postCmd(rfHandle, (RF_Op*)&EasyLink_cmdPropRxAdv,
+            RF_PriorityNormal, rxDoneCallback, EASYLINK_RF_EVENT_MASK);
+
+    return EasyLink_CmdHandle_isValid(asyncCmdHndl);
 }
 
 //Callback for Async Rx complete
 static void rxDoneCallback(RF_Handle h, RF_CmdHandle ch, RF_EventMask e)
 {
     EasyLink_Status status = EasyLink_Status_Rx_Error;
-    //create rxPacket as a static so that the large payload buffer it is not
-    //allocated from the stack
-    static EasyLink_RxPacket rxPacket;
+    EasyLink_RxPacket *rxPacket = NULL;
+    EasyLink_RxLentPacket *lentPacket;
     rfc_dataEntryGeneral_t *pDataEntry;
-    pDataEntry = (rfc_dataEntryGeneral_t*) rxBuffer;
+
+    EASYLINK_TRACE_DONE(&EasyLink_cmdPropRxAdv);
+    accumulateRxStats();
+
+    //A sniff that found the channel idle, or that did not find a packet in
+    //what looked like a preamble, sniffs again keeping the busyMutex
+    if ((EasyLink_cmdPropRxAdv.commandNo == CMD_PROP_RX_ADV_SNIFF) &&
+            (e & RF_EventLastCmdDone) &&
+            (sniffFoundIdle() || (EasyLink_cmdPropRxAdv.status == PROP_DONE_RXTIMEOUT)) &&
+            postNextSniff())
+    {
+        return;
+    }
+
+    lentPacket = rxBlock;
+    pDataEntry = rxBuffer;
+    rxBlock = NULL;
+    rxBuffer = NULL;
 
     //Release now so user callback can call EasyLink API's
     Semaphore_post(busyMutex);
@@ -203,14 +522,13 @@ static void rxDoneCallback(RF_Handle h, RF_CmdHandle ch, RF_EventMask e)
                      ((EasyLink_cmdPropRxAdv.pktConf.filterOp == 1) &&
                       (rxStatistics.nRxIgnored == 1)) )
             {
-                //copy length from pDataEntry
-                rxPacket.len = *(uint8_t*)(&pDataEntry->data) - addrSize;
-                //copy address from packet payload (as it is not in hdr)
-                memcpy(&rxPacket.dstAddr, (&pDataEntry->data + 1), addrSize);
-                //copy payload
-                memcpy(&rxPacket.payload, (&pDataEntry->data + 1 + addrSize), rxPacket.len);
-                rxPacket.rssi = rxStatistics.lastRssi;
-                rxPacket.absTime = rxStatistics.timeStamp;
+                //point into the data entry, the address is in the payload
+                //as it is not in hdr
+                lentPacket->len = *(uint8_t*)(&pDataEntry->data) - addrSize;
+                lentPacket->dstAddr = (&pDataEntry->data + 1);
+                lentPacket->payload = (&pDataEntry->data + 1 + addrSize);
+                lentPacket->rssi = rxStatistics.lastRssi;
+                lentPacket->absTime = rxStatistics.timeStamp;
 
                 status = EasyLink_Status_Success;
             }
@@ -227,7 +545,8 @@ static void rxDoneCallback(RF_Handle h, RF_CmdHandle ch, RF_EventMask e)
                 status = EasyLink_Status_Rx_Error;
             }
         }
-        else if ( EasyLink_cmdPropRxAdv.status == PROP_DONE_RXTIMEOUT)
+        else if ( (EasyLink_cmdPropRxAdv.status == PROP_DONE_RXTIMEOUT) ||
+                  sniffFoundIdle() )
         {
             status = EasyLink_Status_Rx_Timeout;
         }
@@ -241,10 +560,51 @@ static void rxDoneCallback(RF_Handle h, RF_CmdHandle ch, RF_EventMask e)
         status = EasyLink_Status_Aborted;
     }
 
+    if (rxLentCb != NULL)
+    {
+        //the callback owns the packet from here on, and releases it
+        if (status != EasyLink_Status_Success)
+        {
+            PacketPool_free(lentPacket);
+            lentPacket = NULL;
+        }
+        rxLentCb(lentPacket, status);
+        dispatchCmds();
+        return;
+    }
+
+    //copy for the callback in a PacketPool block so that the large payload
+    //buffer is not allocated from the stack, nor kept when not receiving
+    if (status == EasyLink_Status_Success)
+    {
+        rxPacket = PacketPool_alloc();
+        if (rxPacket == NULL)
+        {
+            status = EasyLink_Status_Mem_Error;
+        }
+        else
+        {
+            rxPacket->len = lentPacket->len;
+            memcpy(rxPacket->dstAddr, lentPacket->dstAddr, addrSize);
+            memcpy(rxPacket->payload, lentPacket->payload, lentPacket->len);
+            rxPacket->rssi = lentPacket->rssi;
+            rxPacket->absTime = lentPacket->absTime;
+        }
+    }
+
+    //the data entry is copied, give it back before the user callback can
+    //start a new Rx
+    PacketPool_free(lentPacket);
+
+    //rxPacket is only valid during the callback. It is NULL unless the
+    //status is success
     if (rxCb != NULL)
     {
-        rxCb(&rxPacket, status);
+        rxCb(rxPacket, status);
     }
+    PacketPool_free(rxPacket);
+
+    dispatchCmds();
 }
 
 //Callback for Async TX Test mode
@@ -252,6 +612,202 @@ static void asyncCmdCallback(RF_Handle h, RF_CmdHandle ch, RF_EventMask e)
 {
     Semaphore_post(busyMutex);
     asyncCmdHndl = EASYLINK_RF_CMD_HANDLE_INVALID;
+
+    dispatchCmds();
+}
+
+//Appends cmd to the FIFO of its priority, or puts it back at the front when
+//it was stopped for a more urgent command. Called with interrupts disabled.
+static void queueCmd(EasyLink_Cmd *cmd, bool front)
+{
+    EasyLink_Priority priority = cmd->priority;
+
+    if (front)
+    {
+        cmd->next = cmdQueueHead[priority];
+        cmdQueueHead[priority] = cmd;
+        if (cmdQueueTail[priority] == NULL)
+        {
+            cmdQueueTail[priority] = cmd;
+        }
+    }
+    else
+    {
+        cmd->next = NULL;
+        if (cmdQueueTail[priority] == NULL)
+        {
+            cmdQueueHead[priority] = cmd;
+        }
+        else
+        {
+            cmdQueueTail[priority]->next = cmd;
+        }
+        cmdQueueTail[priority] = cmd;
+    }
+}
+
+//Most urgent priority with a queued command, EasyLink_Priority_Count if
+//none. Called with interrupts disabled.
+static EasyLink_Priority queuedPriority(void)
+{
+    uint8_t priority;
+
+    for (priority = 0; priority < EasyLink_Priority_Count; priority++)
+    {
+        if (cmdQueueHead[priority] != NULL)
+        {
+            break;
+        }
+    }
+
+    return (EasyLink_Priority)priority;
+}
+
+//Takes the most urgent queued command, NULL if none. Called with interrupts
+//disabled.
+static EasyLink_Cmd* dequeueCmd(void)
+{
+    EasyLink_Priority priority = queuedPriority();
+    EasyLink_Cmd *cmd;
+
+    if (priority == EasyLink_Priority_Count)
+    {
+        return NULL;
+    }
+
+    cmd = cmdQueueHead[priority];
+    cmdQueueHead[priority] = cmd->next;
+    if (cmdQueueHead[priority] == NULL)
+    {
+        cmdQueueTail[priority] = NULL;
+    }
+    cmd->next = NULL;
+
+    return cmd;
+}
+
+//Tx done callback of the submitted commands
+static void cmdTxDone(EasyLink_Status status)
+{
+    EasyLink_Cmd *cmd = runningCmd;
+    runningCmd = NULL;
+
+    cmd->cb(cmd, status, NULL);
+}
+
+//Rx done callback of the submitted commands
+static void cmdRxDone(EasyLink_RxLentPacket *rxPacket, EasyLink_Status status)
+{
+    EasyLink_Cmd *cmd = runningCmd;
+    UInt key = Hwi_disable();
+
+    runningCmd = NULL;
+    if (runningCmdPreempted && (status != EasyLink_Status_Success))
+    {
+        //Stopped for a more urgent command, listen again once it is done
+        runningCmdPreempted = false;
+        queueCmd(cmd, true);
+        Hwi_restore(key);
+        return;
+    }
+    runningCmdPreempted = false;
+    Hwi_restore(key);
+
+    cmd->cb(cmd, status, rxPacket);
+}
+
+//Stops the running submitted Rx if a more urgent command is queued, cmdRxDone
+//then queues it again
+static void preemptRx(void)
+{
+    RF_CmdHandle cmdHndl = EASYLINK_RF_CMD_HANDLE_INVALID;
+    UInt key = Hwi_disable();
+
+    if ((runningCmd != NULL) && (runningCmd->type == EasyLink_CmdType_Rx) &&
+            (!runningCmdPreempted) && EasyLink_CmdHandle_isValid(asyncCmdHndl) &&
+            (queuedPriority() < runningCmd->priority))
+    {
+        runningCmdPreempted = true;
+        cmdHndl = asyncCmdHndl;
+    }
+    Hwi_restore(key);
+
+    if (EasyLink_CmdHandle_isValid(cmdHndl))
+    {
+        //force abort, an ACK can not wait for a packet to end
+        RF_cancelCmd(rfHandle, cmdHndl, 0);
+    }
+}
+
+//Starts the most urgent queued command if the radio is free. Commands that
+//missed their deadline or fail to start are completed straight away, and the
+//next one is tried.
+static void dispatchCmds(void)
+{
+    EasyLink_Cmd *cmd;
+    EasyLink_Status status;
+    UInt key;
+
+    while (1)
+    {
+        key = Hwi_disable();
+        if ((runningCmd != NULL) || EasyLink_CmdHandle_isValid(asyncCmdHndl))
+        {
+            Hwi_restore(key);
+            return;
+        }
+        cmd = dequeueCmd();
+        runningCmd = cmd;
+        Hwi_restore(key);
+
+        if (cmd == NULL)
+        {
+            return;
+        }
+
+        if ((cmd->deadline != 0) &&
+                ((int32_t)(RF_getCurrentTime() - cmd->deadline) > 0))
+        {
+            status = EasyLink_Status_Deadline_Error;
+        }
+        else if (cmd->type == EasyLink_CmdType_Tx)
+        {
+            status = EasyLink_transmitAsync(cmd->txPacket, cmdTxDone);
+        }
+        else
+        {
+            status = startReceiveAsync(NULL, cmdRxDone, cmd->rxAbsTime,
+                    cmd->rxTimeout);
+        }
+
+        if (status == EasyLink_Status_Success)
+        {
+            //something more urgent may have been queued while starting
+            preemptRx();
+            return;
+        }
+
+        key = Hwi_disable();
+        runningCmd = NULL;
+        if (status == EasyLink_Status_Busy_Error)
+        {
+            //Taken by a blocking call, which dispatches again when done
+            queueCmd(cmd, true);
+            Hwi_restore(key);
+            return;
+        }
+        Hwi_restore(key);
+
+        cmd->cb(cmd, status, NULL);
+    }
+}
+
+//Releases the busyMutex taken by a blocking call, and starts the commands
+//submitted meanwhile
+static void releaseBusyMutex(void)
+{
+    Semaphore_post(busyMutex);
+    dispatchCmds();
 }
 
 static EasyLink_Status enableTestMode(EasyLink_CtrlOption mode)
@@ -337,6 +893,11 @@ EasyLink_Status EasyLink_init(EasyLink_PhyType ui32ModType)
         }
         RF_close(rfHandle);
     }
+    else if (busyMutex != NULL)
+    {
+        //Left free by a failed re-init, take it like a configured one
+        Semaphore_pend(busyMutex, 0);
+    }
 
     if (!rfParamsConfigured)
     {
@@ -395,7 +956,9 @@ EasyLink_Status EasyLink_init(EasyLink_PhyType ui32ModType)
     {
         if (busyMutex != NULL)
         {
-            Semaphore_post(busyMutex);
+            //RF is closed, so the commands submitted meanwhile fail
+            configured = 0;
+            releaseBusyMutex();
         }
         return EasyLink_Status_Param_Error;
     }
@@ -423,9 +986,58 @@ EasyLink_Status EasyLink_init(EasyLink_PhyType ui32ModType)
                                                  // for received data
     EasyLink_cmdPropRxAdv.pOutput = (uint8_t*)&rxStatistics;
 
+    //Set up the carrier sense command used for CSMA, the Tx is only run
+    //if the channel is found idle
+    memset(&EasyLink_cmdPropCs, 0, sizeof(rfc_CMD_PROP_CS_t));
+    EasyLink_cmdPropCs.commandNo = CMD_PROP_CS;
+    EasyLink_cmdPropCs.pNextOp = (rfc_radioOp_t*)&EasyLink_cmdPropTx;
+    EasyLink_cmdPropCs.condition.rule = COND_STOP_ON_FALSE;
+    EasyLink_cmdPropCs.csConf.bEnaRssi = 1;       //Use RSSI for carrier sense
+    EasyLink_cmdPropCs.csConf.busyOp = 1;         //End on channel busy
+    EasyLink_cmdPropCs.csConf.idleOp = 0;         //Keep sensing while idle
+    EasyLink_cmdPropCs.csConf.timeoutRes = 0;     //Invalid at timeout is busy
+    EasyLink_cmdPropCs.numRssiIdle = 1;
+    EasyLink_cmdPropCs.numRssiBusy = 1;
+    EasyLink_cmdPropCs.csEndTrigger.triggerType = TRIG_REL_START;
+    EasyLink_cmdPropCs.csEndTime = EASYLINK_CSMA_CS_TIME;
+
+    //Set up the advanced Tx used for a long preamble, which goes on until
+    //preambleTime after the start. The packet format is the same as for the
+    //Tx command, with the length byte as an 8 bit header.
+    memset(&EasyLink_cmdPropTxAdv, 0, sizeof(rfc_CMD_PROP_TX_ADV_t));
+    EasyLink_cmdPropTxAdv.commandNo = CMD_PROP_TX_ADV;
+    EasyLink_cmdPropTxAdv.condition.rule = COND_NEVER;
+    EasyLink_cmdPropTxAdv.pktConf.bUseCrc = 1;
+    EasyLink_cmdPropTxAdv.pktConf.bCrcIncHdr = 1;
+    EasyLink_cmdPropTxAdv.numHdrBits = 8;
+    EasyLink_cmdPropTxAdv.preTrigger.triggerType = TRIG_REL_START;
+    EasyLink_cmdPropTxAdv.preTrigger.pastTrig = 1;
+    EasyLink_cmdPropTxAdv.syncWord = EasyLink_cmdPropTx.syncWord;
+
+    //Set up the carrier sense of the Rx when sniffing. The channel is busy
+    //on a preamble correlation or an RSSI above the threshold, which ends
+    //the carrier sense and the Rx goes on. The command ends at once when
+    //the channel is idle.
+    EasyLink_cmdPropRxAdv.csConf.bEnaRssi = 1;
+    EasyLink_cmdPropRxAdv.csConf.bEnaCorr = 1;
+    EasyLink_cmdPropRxAdv.csConf.operation = 0;   //Busy if either is busy
+    EasyLink_cmdPropRxAdv.csConf.busyOp = 1;      //End carrier sense on busy
+    EasyLink_cmdPropRxAdv.csConf.idleOp = 1;      //End the Rx on idle
+    EasyLink_cmdPropRxAdv.csConf.timeoutRes = 1;  //Invalid at timeout is idle
+    EasyLink_cmdPropRxAdv.numRssiIdle = 1;
+    EasyLink_cmdPropRxAdv.numRssiBusy = 1;
+    EasyLink_cmdPropRxAdv.corrPeriod = 2 * ((ui32ModType == EasyLink_Phy_625bpsLrm) ?
+            EASYLINK_LRM_PREAMBLE_BYTE_TIME : EASYLINK_FSK_PREAMBLE_BYTE_TIME);
+    EasyLink_cmdPropRxAdv.corrConfig.numCorrInv = EASYLINK_SNIFF_CORR_INVALID;
+    EasyLink_cmdPropRxAdv.corrConfig.numCorrBusy = 1;
+    EasyLink_cmdPropRxAdv.csEndTrigger.triggerType = TRIG_REL_START;
+    EasyLink_cmdPropRxAdv.csEndTime = EASYLINK_SNIFF_CS_PERIODS * EasyLink_cmdPropRxAdv.corrPeriod;
+
     //Set the frequency
+    EASYLINK_TRACE_POST(&EasyLink_cmdFs);
     RF_runCmd(rfHandle, (RF_Op*)&EasyLink_cmdFs, RF_PriorityNormal, 0, //asyncCmdCallback,
             EASYLINK_RF_EVENT_MASK);
+    EASYLINK_TRACE_DONE(&EasyLink_cmdFs);
 
     //set default asyncRxTimeOut to 0
     asyncRxTimeOut = 0;
@@ -446,17 +1058,14 @@ EasyLink_Status EasyLink_init(EasyLink_PhyType ui32ModType)
         {
             return EasyLink_Status_Mem_Error;
         }
-
-        Semaphore_post(busyMutex);
-    }
-    else
-    {
-        //already configured and taken busyMutex, so release it
-        Semaphore_post(busyMutex);
     }
 
     configured = 1;
 
+    //Release the busyMutex, created or taken above, and start the commands
+    //submitted during a re-init, which waited for it
+    releaseBusyMutex();
+
     return EasyLink_Status_Success;
 }
 
@@ -481,15 +1090,17 @@ EasyLink_Status EasyLink_setFrequency(uint32_t ui32Freq)
             ((uint64_t)EasyLink_cmdFs.frequency * 1000000)) * 65536 / 1000000);
 
     /* Run command */
+    EASYLINK_TRACE_POST(&EasyLink_cmdFs);
     RF_EventMask result = RF_runCmd(rfHandle, (RF_Op*)&EasyLink_cmdFs,
             RF_PriorityNormal, 0, EASYLINK_RF_EVENT_MASK);
+    EASYLINK_TRACE_DONE(&EasyLink_cmdFs);
 
     if (result & RF_EventLastCmdDone)
     {
         status = EasyLink_Status_Success;
     }
 
-    Semaphore_post(busyMutex);
+    releaseBusyMutex();
 
     return status;
 }
@@ -548,7 +1159,7 @@ EasyLink_Status EasyLink_setRfPwr(int8_t i8txPowerdBm)
     if (i8txPowerdBm == rfPowerTable[rfPowerTableSize-1].dbm)
     {
         //Release the busyMutex
-        Semaphore_post(busyMutex);
+        releaseBusyMutex();
         return EasyLink_Status_Config_Error;
     }
 #endif
@@ -580,7 +1191,7 @@ EasyLink_Status EasyLink_setRfPwr(int8_t i8txPowerdBm)
     }
 
     //Release the busyMutex
-    Semaphore_post(busyMutex);
+    releaseBusyMutex();
 
     return status;
 }
@@ -644,43 +1255,45 @@ EasyLink_Status EasyLink_transmit(EasyLink_TxPacket *txPacket)
     {
         return EasyLink_Status_Param_Error;
     }
-
-    memcpy(txBuffer, txPacket->dstAddr, addrSize);
-    memcpy(txBuffer + addrSize, txPacket->payload, txPacket->len);
-
-    //packet length to Tx includes address
-    EasyLink_cmdPropTx.pktLen = txPacket->len + addrSize;
-    EasyLink_cmdPropTx.pPkt = txBuffer;
-
-    if (txPacket->absTime != 0)
+    txBuffer = PacketPool_alloc();
+    if (txBuffer == NULL)
     {
-        EasyLink_cmdPropTx.startTrigger.triggerType = TRIG_ABSTIME;
-        EasyLink_cmdPropTx.startTrigger.pastTrig = 1;
-        EasyLink_cmdPropTx.startTime = txPacket->absTime;
-    }
-    else
-    {
-        EasyLink_cmdPropTx.startTrigger.triggerType = TRIG_NOW;
-        EasyLink_cmdPropTx.startTrigger.pastTrig = 1;
-        EasyLink_cmdPropTx.startTime = 0;
+        releaseBusyMutex();
+        return EasyLink_Status_Mem_Error;
     }
 
-    // Send packet
-    RF_CmdHandle cmdHdl = RF_postCmd(rfHandle, (RF_Op*)&EasyLink_cmdPropTx,
-            RF_PriorityNormal, 0, EASYLINK_RF_EVENT_MASK);
+    setTxPacket(txPacket);
 
-    // Wait for Command to complete
-    RF_EventMask result = RF_pendCmd(rfHandle, cmdHdl,  (RF_EventLastCmdDone |
-            RF_EventCmdError));
+    txAbsTime = txPacket->absTime;
+    csmaAttempts = 0;
 
+    RF_EventMask result;
+    do
+    {
+        // Send packet, after carrier sense if CSMA is enabled
+        RF_CmdHandle cmdHdl = postTxCmd(0);
 
-    if (result & RF_EventLastCmdDone)
+        // Wait for Command to complete
+        result = RF_pendCmd(rfHandle, cmdHdl,  (RF_EventLastCmdDone |
+                RF_EventCmdError));
+        EASYLINK_TRACE_DONE(txCmdHead());
+    } while ((result & RF_EventLastCmdDone) && csmaChannelBusy() &&
+            (csmaAttempts < csmaMaxAttempts));
+
+    if ((result & RF_EventLastCmdDone) && csmaChannelBusy())
+    {
+        status = EasyLink_Status_Channel_Busy;
+    }
+    else if (result & RF_EventLastCmdDone)
     {
         status = EasyLink_Status_Success;
     }
 
+    PacketPool_free(txBuffer);
+    txBuffer = NULL;
+
     //Release the busyMutex
-    Semaphore_post(busyMutex);
+    releaseBusyMutex();
 
 
     return status;
@@ -704,38 +1317,33 @@ EasyLink_Status EasyLink_transmitAsync(EasyLink_TxPacket *txPacket, EasyLink_TxD
     {
         return EasyLink_Status_Param_Error;
     }
+    txBuffer = PacketPool_alloc();
+    if (txBuffer == NULL)
+    {
+        releaseBusyMutex();
+        return EasyLink_Status_Mem_Error;
+    }
 
     //store application callback
     txCb = cb;
 
-    memcpy(txBuffer, txPacket->dstAddr, addrSize);
-    memcpy(txBuffer + addrSize, txPacket->payload, txPacket->len);
+    setTxPacket(txPacket);
 
-    //packet length to Tx includes address
-    EasyLink_cmdPropTx.pktLen = txPacket->len + addrSize;
-    EasyLink_cmdPropTx.pPkt = txBuffer;
+    txAbsTime = txPacket->absTime;
+    csmaAttempts = 0;
 
-    if (txPacket->absTime != 0)
-    {
-        EasyLink_cmdPropTx.startTrigger.triggerType = TRIG_ABSTIME;
-        EasyLink_cmdPropTx.startTrigger.pastTrig = 1;
-        EasyLink_cmdPropTx.startTime = txPacket->absTime;
-    }
-    else
-    {
-        EasyLink_cmdPropTx.startTrigger.triggerType = TRIG_NOW;
-        EasyLink_cmdPropTx.startTrigger.pastTrig = 1;
-        EasyLink_cmdPropTx.startTime = 0;
-    }
-
-    /* Send packet */
-    asyncCmdHndl = RF_postCmd(rfHandle, (RF_Op*)&EasyLink_cmdPropTx,
-            RF_PriorityNormal, txDoneCallback, EASYLINK_RF_EVENT_MASK);
+    /* Send packet, retries on a busy channel are posted from the callback */
+    asyncCmdHndl = postTxCmd(txDoneCallback);
 
     if (EasyLink_CmdHandle_isValid(asyncCmdHndl))
     {
         status = EasyLink_Status_Success;
     }
+    else
+    {
+        PacketPool_free(txBuffer);
+        txBuffer = NULL;
+    }
 
     //busyMutex will be released by the callback
 
@@ -758,7 +1366,13 @@ EasyLink_Status EasyLink_receive(EasyLink_RxPacket *rxPacket)
         return EasyLink_Status_Busy_Error;
     }
 
-    pDataEntry = (rfc_dataEntryGeneral_t*) rxBuffer;
+    rxBuffer = allocRxBuffer();
+    if (rxBuffer == NULL)
+    {
+        releaseBusyMutex();
+        return EasyLink_Status_Mem_Error;
+    }
+    pDataEntry = rxBuffer;
     //data entry rx buffer includes hdr (len-1Byte), addr (max 8Bytes) and data
     pDataEntry->length = 1 + EASYLINK_MAX_ADDR_SIZE + EASYLINK_MAX_DATA_LENGTH;
     pDataEntry->status = 0;
@@ -766,6 +1380,8 @@ EasyLink_Status EasyLink_receive(EasyLink_RxPacket *rxPacket)
     dataQueue.pLastEntry = NULL;
     EasyLink_cmdPropRxAdv.pQueue = &dataQueue;               /* Set the Data Entity queue for received data */
     EasyLink_cmdPropRxAdv.pOutput = (uint8_t*)&rxStatistics;
+    //A blocking Rx never sniffs
+    EasyLink_cmdPropRxAdv.commandNo = CMD_PROP_RX_ADV;
 
     if (rxPacket->absTime != 0)
     {
@@ -782,8 +1398,10 @@ EasyLink_Status EasyLink_receive(EasyLink_RxPacket *rxPacket)
 
     if (rxPacket->rxTimeout != 0)
     {
+        //Timeout is relative to the start of the Rx
         EasyLink_cmdPropRxAdv.endTrigger.triggerType = TRIG_ABSTIME;
-        EasyLink_cmdPropRxAdv.endTime = RF_getCurrentTime() + rxPacket->rxTimeout;
+        EasyLink_cmdPropRxAdv.endTime = ((rxPacket->absTime != 0) ?
+                rxPacket->absTime : RF_getCurrentTime()) + rxPacket->rxTimeout;
     }
     else
     {
@@ -794,11 +1412,14 @@ EasyLink_Status EasyLink_receive(EasyLink_RxPacket *rxPacket)
     //Clear the Rx statistics structure
     memset(&rxStatistics, 0, sizeof(rfc_propRxOutput_t));
 
+    EASYLINK_TRACE_POST(&EasyLink_cmdPropRxAdv);
     RF_CmdHandle rx_cmd = RF_postCmd(rfHandle, (RF_Op*)&EasyLink_cmdPropRxAdv,
             RF_PriorityNormal, 0, EASYLINK_RF_EVENT_MASK);
 
     /* Wait for Command to complete */
     result = RF_pendCmd(rfHandle, rx_cmd, (RF_EventLastCmdDone | RF_EventCmdError));
+    EASYLINK_TRACE_DONE(&EasyLink_cmdPropRxAdv);
+    accumulateRxStats();
 
     if (result & RF_EventLastCmdDone)
     {
@@ -850,13 +1471,58 @@ EasyLink_Status EasyLink_receive(EasyLink_RxPacket *rxPacket)
         }
     }
 
+    freeRxBuffer();
+
     //Release the busyMutex
-    Semaphore_post(busyMutex);
+    releaseBusyMutex();
 
     return status;
 }
 
 EasyLink_Status EasyLink_receiveAsync(EasyLink_ReceiveCb cb, uint32_t absTime)
+{
+    return startReceiveAsync(cb, NULL, absTime, asyncRxTimeOut);
+}
+
+EasyLink_Status EasyLink_receiveLentAsync(EasyLink_ReceiveLentCb cb, uint32_t absTime)
+{
+    return startReceiveAsync(NULL, cb, absTime, asyncRxTimeOut);
+}
+
+void EasyLink_releaseRx(EasyLink_RxLentPacket *rxPacket)
+{
+    PacketPool_free(rxPacket);
+}
+
+EasyLink_Status EasyLink_submit(EasyLink_Cmd *cmd)
+{
+    UInt key;
+
+    if ( (!configured) || suspended)
+    {
+        return EasyLink_Status_Config_Error;
+    }
+    if ( (cmd == NULL) || (cmd->cb == NULL) ||
+            (cmd->priority >= EasyLink_Priority_Count) ||
+            ((cmd->type == EasyLink_CmdType_Tx) &&
+             ((cmd->txPacket == NULL) ||
+              (cmd->txPacket->len > EASYLINK_MAX_DATA_LENGTH))) )
+    {
+        return EasyLink_Status_Param_Error;
+    }
+
+    key = Hwi_disable();
+    queueCmd(cmd, false);
+    Hwi_restore(key);
+
+    dispatchCmds();
+    preemptRx();
+
+    return EasyLink_Status_Success;
+}
+
+static EasyLink_Status startReceiveAsync(EasyLink_ReceiveCb cb, EasyLink_ReceiveLentCb lentCb,
+        uint32_t absTime, uint32_t timeout)
 {
     EasyLink_Status status = EasyLink_Status_Rx_Error;
     rfc_dataEntryGeneral_t *pDataEntry;
@@ -873,8 +1539,15 @@ EasyLink_Status EasyLink_receiveAsync(EasyLink_ReceiveCb cb, uint32_t absTime)
     }
 
     rxCb = cb;
+    rxLentCb = lentCb;
 
-    pDataEntry = (rfc_dataEntryGeneral_t*) rxBuffer;
+    rxBuffer = allocRxBuffer();
+    if (rxBuffer == NULL)
+    {
+        releaseBusyMutex();
+        return EasyLink_Status_Mem_Error;
+    }
+    pDataEntry = rxBuffer;
     //data entry rx buffer includes hdr (len-1Byte), addr (max 8Bytes) and data
     pDataEntry->length = 1 + EASYLINK_MAX_ADDR_SIZE + EASYLINK_MAX_DATA_LENGTH;
     pDataEntry->status = 0;
@@ -883,33 +1556,56 @@ EasyLink_Status EasyLink_receiveAsync(EasyLink_ReceiveCb cb, uint32_t absTime)
     EasyLink_cmdPropRxAdv.pQueue = &dataQueue;               /* Set the Data Entity queue for received data */
     EasyLink_cmdPropRxAdv.pOutput = (uint8_t*)&rxStatistics;
 
-    if (absTime != 0)
+    if (sniffInterval != 0)
     {
-        EasyLink_cmdPropRxAdv.startTrigger.triggerType = TRIG_ABSTIME;
-        EasyLink_cmdPropRxAdv.startTrigger.pastTrig = 1;
-        EasyLink_cmdPropRxAdv.startTime = absTime;
+        //Sniff until a packet is received, the callback posts the next sniff
+        //until the timeout. A sniff that finds the channel busy listens for
+        //a preamble of up to twice the interval.
+        EasyLink_cmdPropRxAdv.commandNo = CMD_PROP_RX_ADV_SNIFF;
+        EasyLink_cmdPropRxAdv.rssiThr = sniffRssiThreshold;
+        EasyLink_cmdPropRxAdv.endTrigger.triggerType = TRIG_REL_START;
+        EasyLink_cmdPropRxAdv.endTime = 2 * sniffInterval;
+        setSniffStart((absTime != 0) ? absTime : RF_getCurrentTime());
+        sniffRxHasEndTime = (timeout != 0);
+        sniffRxEndTime = EasyLink_cmdPropRxAdv.startTime + timeout;
     }
     else
     {
-        EasyLink_cmdPropRxAdv.startTrigger.triggerType = TRIG_NOW;
-        EasyLink_cmdPropRxAdv.startTrigger.pastTrig = 1;
-        EasyLink_cmdPropRxAdv.startTime = 0;
-    }
+        EasyLink_cmdPropRxAdv.commandNo = CMD_PROP_RX_ADV;
 
-    if (asyncRxTimeOut != 0)
-    {
-        EasyLink_cmdPropRxAdv.endTrigger.triggerType = TRIG_ABSTIME;
-        EasyLink_cmdPropRxAdv.endTime = RF_getCurrentTime() + asyncRxTimeOut;
-    }
-    else
-    {
-        EasyLink_cmdPropRxAdv.endTrigger.triggerType = TRIG_NEVER;
-        EasyLink_cmdPropRxAdv.endTime = 0;
+        if (absTime != 0)
+        {
+            EasyLink_cmdPropRxAdv.startTrigger.triggerType = TRIG_ABSTIME;
+            EasyLink_cmdPropRxAdv.startTrigger.pastTrig = 1;
+            EasyLink_cmdPropRxAdv.startTime = absTime;
+        }
+        else
+        {
+            EasyLink_cmdPropRxAdv.startTrigger.triggerType = TRIG_NOW;
+            EasyLink_cmdPropRxAdv.startTrigger.pastTrig = 1;
+            EasyLink_cmdPropRxAdv.startTime = 0;
+        }
+
+        if (timeout != 0)
+        {
+            //Timeout is relative to the start of the Rx, an Rx started again
+            //after being preempted ends at once if that is already past
+            EasyLink_cmdPropRxAdv.endTrigger.triggerType = TRIG_ABSTIME;
+            EasyLink_cmdPropRxAdv.endTrigger.pastTrig = 1;
+            EasyLink_cmdPropRxAdv.endTime = ((absTime != 0) ?
+                    absTime : RF_getCurrentTime()) + timeout;
+        }
+        else
+        {
+            EasyLink_cmdPropRxAdv.endTrigger.triggerType = TRIG_NEVER;
+            EasyLink_cmdPropRxAdv.endTime = 0;
+        }
     }
 
     //Clear the Rx statistics structure
     memset(&rxStatistics, 0, sizeof(rfc_propRxOutput_t));
 
+    EASYLINK_TRACE_POST(&EasyLink_cmdPropRxAdv);
     asyncCmdHndl = RF_postCmd(rfHandle, (RF_Op*)&EasyLink_cmdPropRxAdv,
             RF_PriorityNormal, rxDoneCallback, EASYLINK_RF_EVENT_MASK);
 
@@ -917,6 +1613,10 @@ EasyLink_Status EasyLink_receiveAsync(EasyLink_ReceiveCb cb, uint32_t absTime)
     {
         status = EasyLink_Status_Success;
     }
+    else
+    {
+        freeRxBuffer();
+    }
 
     //busyMutex will be released in callback
 
@@ -991,7 +1691,7 @@ EasyLink_Status EasyLink_enableRxAddrFilter(uint8_t* pui8AddrFilterTable, uint8_
     }
 
     //Release the busyMutex
-    Semaphore_post(busyMutex);
+    releaseBusyMutex();
 
     return status;
 }
@@ -1028,6 +1728,40 @@ EasyLink_Status EasyLink_setCtrl(EasyLink_CtrlOption Ctrl, uint32_t ui32Value)
         case EasyLink_Ctrl_Test_Signal:
             status = enableTestMode(EasyLink_Ctrl_Test_Signal);
             break;
+        case EasyLink_Ctrl_Csma_Enable:
+            csmaEnabled = (bool) ui32Value;
+            status = EasyLink_Status_Success;
+            break;
+        case EasyLink_Ctrl_Csma_RssiThreshold:
+            csmaRssiThreshold = (int8_t) ui32Value;
+            status = EasyLink_Status_Success;
+            break;
+        case EasyLink_Ctrl_Csma_MaxAttempts:
+            if (ui32Value != 0)
+            {
+                csmaMaxAttempts = (uint8_t) ui32Value;
+                status = EasyLink_Status_Success;
+            }
+            break;
+        case EasyLink_Ctrl_Csma_BackoffUnit:
+            csmaBackoffUnit = ui32Value;
+            status = EasyLink_Status_Success;
+            break;
+        case EasyLink_Ctrl_Csma_Attempts:
+            //Read only
+            break;
+        case EasyLink_Ctrl_Sniff_Interval:
+            sniffInterval = ui32Value;
+            status = EasyLink_Status_Success;
+            break;
+        case EasyLink_Ctrl_Sniff_RssiThreshold:
+            sniffRssiThreshold = (int8_t) ui32Value;
+            status = EasyLink_Status_Success;
+            break;
+        case EasyLink_Ctrl_Preamble_Time:
+            preambleTime = ui32Value;
+            status = EasyLink_Status_Success;
+            break;
     }
 
     return status;
@@ -1060,6 +1794,38 @@ EasyLink_Status EasyLink_getCtrl(EasyLink_CtrlOption Ctrl, uint32_t* pui32Value)
             *pui32Value = 0;
             status = EasyLink_Status_Success;
             break;
+        case EasyLink_Ctrl_Csma_Enable:
+            *pui32Value = (uint32_t) csmaEnabled;
+            status = EasyLink_Status_Success;
+            break;
+        case EasyLink_Ctrl_Csma_RssiThreshold:
+            *pui32Value = (uint32_t) csmaRssiThreshold;
+            status = EasyLink_Status_Success;
+            break;
+        case EasyLink_Ctrl_Csma_MaxAttempts:
+            *pui32Value = csmaMaxAttempts;
+            status = EasyLink_Status_Success;
+            break;
+        case EasyLink_Ctrl_Csma_BackoffUnit:
+            *pui32Value = csmaBackoffUnit;
+            status = EasyLink_Status_Success;
+            break;
+        case EasyLink_Ctrl_Csma_Attempts:
+            *pui32Value = csmaAttempts;
+            status = EasyLink_Status_Success;
+            break;
+        case EasyLink_Ctrl_Sniff_Interval:
+            *pui32Value = sniffInterval;
+            status = EasyLink_Status_Success;
+            break;
+        case EasyLink_Ctrl_Sniff_RssiThreshold:
+            *pui32Value = (uint32_t) sniffRssiThreshold;
+            status = EasyLink_Status_Success;
+            break;
+        case EasyLink_Ctrl_Preamble_Time:
+            *pui32Value = preambleTime;
+            status = EasyLink_Status_Success;
+            break;
     }
 
     return status;
@@ -1103,3 +1869,23 @@ EasyLink_Status EasyLink_getIeeeAddr(uint8_t *ieeeAddr)
 
     return status;
 }
+
+EasyLink_Status EasyLink_getRxStats(EasyLink_RxStats *stats, bool reset)
+{
+    UInt key;
+
+    if (stats == NULL)
+    {
+        return EasyLink_Status_Param_Error;
+    }
+
+    key = Hwi_disable();
+    *stats = rxStatsTotal;
+    if (reset)
+    {
+        memset(&rxStatsTotal, 0, sizeof(EasyLink_RxStats));
+    }
+    Hwi_restore(key);
+
+    return EasyLink_Status_Success;
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2015-2016, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/***** Includes *****/
+#include "PacketPool.h"
+
+#include <xdc/std.h>
+
+#include <ti/sysbios/hal/Hwi.h>
+
+/***** Defines *****/
+#define PACKETPOOL_BLOCK_WORDS      ((PACKETPOOL_BLOCK_SIZE + 3) / 4)
+
+/***** Type declarations *****/
+/* A free block holds the link to the next free block in its first word */
+struct FreeBlock {
+    struct FreeBlock* next;
+};
+
+/***** Variable declarations *****/
+uint32_t packetPoolBlocks[PACKETPOOL_NUM_BLOCKS][PACKETPOOL_BLOCK_WORDS]; /* not static so you can see it in the memory browser */
+static struct FreeBlock* freeList = NULL;
+/* Blocks from this index on have never been allocated, and are not in the
+ * free list, so the pool needs no init */
+static uint16_t numNeverUsed = 0;
+static PacketPool_Stats poolStats = {PACKETPOOL_NUM_BLOCKS, PACKETPOOL_NUM_BLOCKS, 0};
+
+/***** Function definitions *****/
+void* PacketPool_alloc(void)
+{
+    void* block = NULL;
+    UInt key = Hwi_disable();
+
+    if (freeList != NULL)
+    {
+        block = freeList;
+        freeList = freeList->next;
+    }
+    else if (numNeverUsed < PACKETPOOL_NUM_BLOCKS)
+    {
+        block = packetPoolBlocks[numNeverUsed++];
+    }
+
+    if (block != NULL)
+    {
+        poolStats.numFree--;
+        if (poolStats.numFree < poolStats.minFree)
+        {
+            poolStats.minFree = poolStats.numFree;
+        }
+    }
+    else
+    {
+        poolStats.allocFailures++;
+    }
+
+    Hwi_restore(key);
+
+    return block;
+}
+
+void PacketPool_free(void* block)
+{
+    UInt key;
+
+    if (block == NULL)
+    {
+        return;
+    }
+
+    key = Hwi_disable();
+
+    ((struct FreeBlock*)block)->next = freeList;
+    freeList = (struct FreeBlock*)block;
+    poolStats.numFree++;
+
+    Hwi_restore(key);
+}
+
+void PacketPool_getStats(PacketPool_Stats* stats)
+{
+    UInt key = Hwi_disable();
+    *stats = poolStats;
+    Hwi_restore(key);
+}
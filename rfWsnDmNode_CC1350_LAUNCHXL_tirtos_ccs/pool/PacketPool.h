@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2015-2016, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PACKETPOOL_H_
+#define PACKETPOOL_H_
+
+#include "stdint.h"
+
+/* Pool of fixed size blocks for radio packets, shared by the EasyLink RX and
+ * TX buffers and the application packets instead of one worst case static
+ * buffer each. Only some of them are in use at the same time, since the radio
+ * either transmits or receives.
+ *
+ * Allocation and free are O(1) and may be called from Hwi, Swi and Task
+ * context. A block is always aligned to 4 bytes, as the RF core requires for
+ * its data entries.
+ *
+ * The pool/ directory is shared, keep all projects' copies identical.
+ */
+
+/* Fits the largest user, an EasyLink RX buffer: an EasyLink_RxLentPacket
+ * followed by a data entry with a header, 8 address bytes and 128 payload
+ * bytes */
+#define PACKETPOOL_BLOCK_SIZE       168
+
+/* One block for a packet being built by the application, one for the RX
+ * buffer or the TX buffer in EasyLink, and two for received packets that the
+ * application has not released yet */
+#ifndef PACKETPOOL_NUM_BLOCKS
+#define PACKETPOOL_NUM_BLOCKS       4
+#endif
+
+typedef struct
+{
+    uint16_t numFree;
+    uint16_t minFree;           //low-water mark of numFree since boot
+    uint32_t allocFailures;
+} PacketPool_Stats;
+
+/* Returns a block of PACKETPOOL_BLOCK_SIZE bytes, or NULL if all are in use */
+void* PacketPool_alloc(void);
+
+/* Returns a block from PacketPool_alloc to the pool */
+void PacketPool_free(void* block);
+
+/* Get the pool usage */
+void PacketPool_getStats(PacketPool_Stats* stats);
+
+#endif /* PACKETPOOL_H_ */
@@ -46,6 +46,8 @@
 
 #include "DmNodeRadioTask.h"
 #include "DmNodeTask.h"
+#include "EnergyMonitor.h"
+#include "trace/TaskMonitor.h"
 
 /*
  *  ======== main ========
@@ -59,6 +61,12 @@ int main(void)
     Display_init();
     SPI_init();
 
+    /* Start accounting where the energy goes */
+    EnergyMonitor_init();
+
+    /* Measure the task CPU load once a minute */
+    TaskMonitor_init(60000);
+
         /* Initialize sensor node tasks */
     NodeRadioTask_init();
     NodeTask_init();
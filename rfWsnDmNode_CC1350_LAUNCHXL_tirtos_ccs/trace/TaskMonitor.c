@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2015-2016, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/***** Includes *****/
+#include "TaskMonitor.h"
+
+#include <stdio.h>
+
+#include <xdc/std.h>
+#include <xdc/runtime/Timestamp.h>
+
+#include <ti/sysbios/BIOS.h>
+#include <ti/sysbios/knl/Clock.h>
+
+/***** Defines *****/
+#define TASKMONITOR_NO_TASK     0xFF
+
+/***** Type declarations *****/
+typedef struct
+{
+    Task_Handle handle;
+    uint32_t runTime; //Timestamp ticks run in the current period
+    uint16_t loadPermille; //of the last completed period
+} TaskMonitor_Entry;
+
+/***** Variable declarations *****/
+/* Only written by the switch hook, which runs with Swis disabled, and by the
+ * period Clock Swi, so neither needs to lock out the other */
+TaskMonitor_Entry taskMonitorEntries[TASKMONITOR_MAX_TASKS]; /* not static so you can see it in the memory browser */
+static volatile uint8_t taskMonitorNumEntries = 0;
+static uint8_t runningEntry = TASKMONITOR_NO_TASK;
+static uint32_t lastSwitchTime;
+static uint32_t periodStartTime;
+Clock_Struct taskMonitorClock; /* not static so you can see in ROV */
+
+/***** Prototypes *****/
+static uint8_t findEntry(Task_Handle handle);
+static void taskMonitorClockCallback(UArg arg0);
+
+/***** Function definitions *****/
+void TaskMonitor_init(uint32_t periodMs)
+{
+    Clock_Params clockParams;
+    uint32_t periodTicks = periodMs * 1000 / Clock_tickPeriod;
+
+    periodStartTime = Timestamp_get32();
+
+    Clock_Params_init(&clockParams);
+    clockParams.period = periodTicks;
+    clockParams.startFlag = TRUE;
+    Clock_construct(&taskMonitorClock, taskMonitorClockCallback, periodTicks, &clockParams);
+}
+
+uint8_t TaskMonitor_getStats(TaskMonitor_Stats* stats, uint8_t maxTasks)
+{
+    Task_Stat taskStat;
+    uint8_t numTasks = taskMonitorNumEntries;
+    uint8_t i;
+
+    if (numTasks > maxTasks)
+    {
+        numTasks = maxTasks;
+    }
+
+    for (i = 0; i < numTasks; i++)
+    {
+        Task_stat(taskMonitorEntries[i].handle, &taskStat);
+
+        stats[i].handle = taskMonitorEntries[i].handle;
+        stats[i].priority = (uint8_t)taskStat.priority;
+        stats[i].loadPermille = taskMonitorEntries[i].loadPermille;
+        stats[i].stackSize = (uint16_t)taskStat.stackSize;
+        stats[i].stackUsed = (uint16_t)taskStat.used;
+    }
+
+    return numTasks;
+}
+
+void TaskMonitor_print(TaskMonitor_PrintFxn printFxn)
+{
+    TaskMonitor_Stats stats[TASKMONITOR_MAX_TASKS];
+    uint8_t numTasks;
+    uint8_t i;
+    char line[40];
+
+    numTasks = TaskMonitor_getStats(stats, TASKMONITOR_MAX_TASKS);
+
+    printFxn("Task      Pri  Load    Stack");
+    for (i = 0; i < numTasks; i++)
+    {
+        sprintf(line, "%08lx  %d  %3d.%d%%  %4d/%4d", (unsigned long)stats[i].handle,
+                stats[i].priority, stats[i].loadPermille / 10, stats[i].loadPermille % 10,
+                stats[i].stackUsed, stats[i].stackSize);
+        printFxn(line);
+    }
+}
+
+void TaskMonitor_taskSwitchHook(Task_Handle prev, Task_Handle next)
+{
+    uint32_t now = Timestamp_get32();
+
+    /* No task was running before the first switch */
+    if (runningEntry != TASKMONITOR_NO_TASK)
+    {
+        taskMonitorEntries[runningEntry].runTime += now - lastSwitchTime;
+    }
+    lastSwitchTime = now;
+
+    runningEntry = findEntry(next);
+    if ((runningEntry == TASKMONITOR_NO_TASK) && (taskMonitorNumEntries < TASKMONITOR_MAX_TASKS))
+    {
+        runningEntry = taskMonitorNumEntries;
+        taskMonitorEntries[runningEntry].handle = next;
+        taskMonitorEntries[runningEntry].runTime = 0;
+        taskMonitorEntries[runningEntry].loadPermille = 0;
+        taskMonitorNumEntries++;
+    }
+}
+
+static uint8_t findEntry(Task_Handle handle)
+{
+    uint8_t i;
+
+    for (i = 0; i < taskMonitorNumEntries; i++)
+    {
+        if (taskMonitorEntries[i].handle == handle)
+        {
+            return i;
+        }
+    }
+
+    return TASKMONITOR_NO_TASK;
+}
+
+static void taskMonitorClockCallback(UArg arg0)
+{
+    uint32_t now = Timestamp_get32();
+    uint32_t periodTime = now - periodStartTime;
+    uint8_t i;
+
+    /* Count the time of the preempted task up to now */
+    if (runningEntry != TASKMONITOR_NO_TASK)
+    {
+        taskMonitorEntries[runningEntry].runTime += now - lastSwitchTime;
+    }
+    lastSwitchTime = now;
+    periodStartTime = now;
+
+    if (periodTime == 0)
+    {
+        return;
+    }
+
+    for (i = 0; i < taskMonitorNumEntries; i++)
+    {
+        /* In 64 bits since runTime * 1000 overflows 32 bits for periods above
+         * about a minute of 65536 Hz ticks */
+        taskMonitorEntries[i].loadPermille = (uint16_t)(((uint64_t)taskMonitorEntries[i].runTime * 1000) / periodTime);
+        taskMonitorEntries[i].runTime = 0;
+    }
+}
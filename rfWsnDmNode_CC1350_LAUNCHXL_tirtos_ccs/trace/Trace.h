@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2015-2016, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include "stdint.h"
+
+#include <ti/sysbios/knl/Task.h>
+#include <ti/sysbios/knl/Event.h>
+
+/* RAM ring of compact timestamped trace records, that can be written from
+ * Hwi, Swi and Task context without taking any lock. The latest
+ * TRACE_BUFFER_SIZE records are kept and can be dumped as text, for
+ * tools/trace2chrome.py to convert into Chrome/Perfetto trace JSON.
+ *
+ * Task switches are recorded by Trace_taskSwitchHook, which release.cfg
+ * installs as a Task hook in every application using the shared TI-RTOS build.
+ *
+ * The trace/ directory is shared, keep all projects' copies identical.
+ */
+
+/* Number of records kept, must be a power of two. Each record is 8 bytes. */
+#ifndef TRACE_BUFFER_SIZE
+#define TRACE_BUFFER_SIZE   128
+#endif
+
+typedef enum
+{
+    Trace_Event_TaskSwitch = 1, //arg8: priority, arg16: low half of the next Task_Handle
+    Trace_Event_RfCmdPost,      //arg16: commandNo
+    Trace_Event_RfCmdDone,      //arg8: Trace_rfStatus(status), arg16: commandNo
+    Trace_Event_EventPost,      //arg16: posted events
+    Trace_Event_EventWake,      //arg16: events returned by Event_pend
+    Trace_Event_Begin,          //arg8: marker id, arg16: value
+    Trace_Event_End,            //arg8: marker id, arg16: value
+    Trace_Event_Marker,         //arg8: marker id, arg16: value
+} Trace_Event;
+
+/* Bits 0-5 of event are the Trace_Event, bits 6-7 the BIOS_ThreadType of the
+ * context the record was written from */
+typedef struct
+{
+    uint32_t timestamp; //xdc.runtime Timestamp
+    uint8_t event;
+    uint8_t arg8;
+    uint16_t arg16;
+} Trace_Record;
+
+/* RF command status packed into 8 bits, bit 7 set for error statuses and
+ * bits 0-6 the status detail, e.g. 0 for DONE_OK */
+#define Trace_rfStatus(status)  ((uint8_t)(((status) & 0x7F) | (((status) & 0x0800) ? 0x80 : 0)))
+
+/* Line printer used to dump the trace, e.g. a UART Display_printf wrapper */
+typedef void (*Trace_PrintFxn)(const char* line);
+
+/* Adds a record */
+void Trace_record(Trace_Event event, uint8_t arg8, uint16_t arg16);
+
+/* App level markers, Begin and End with the same id form a duration */
+#define Trace_begin(id, value)  Trace_record(Trace_Event_Begin, (id), (value))
+#define Trace_end(id, value)    Trace_record(Trace_Event_End, (id), (value))
+#define Trace_mark(id, value)   Trace_record(Trace_Event_Marker, (id), (value))
+
+/* Event_post that records the posted events */
+static inline void Trace_eventPost(Event_Handle handle, uint32_t events)
+{
+    Trace_record(Trace_Event_EventPost, 0, (uint16_t)events);
+    Event_post(handle, events);
+}
+
+/* Event_pend that records the events it returns with */
+static inline uint32_t Trace_eventPend(Event_Handle handle, uint32_t andMask, uint32_t orMask, uint32_t timeout)
+{
+    uint32_t events = Event_pend(handle, andMask, orMask, timeout);
+    Trace_record(Trace_Event_EventWake, 0, (uint16_t)events);
+    return events;
+}
+
+/* Prints the records oldest first, from task context. Recording is paused
+ * while dumping and the buffer is empty afterwards. */
+void Trace_dump(Trace_PrintFxn printFxn);
+
+/* Task switch hook, installed from release.cfg */
+void Trace_taskSwitchHook(Task_Handle prev, Task_Handle next);
+
+#endif /* TRACE_H_ */
@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+"""Generate the waveform tables used by pwmled's PwmWaveform.c.
+
+Writes PwmWaveformTables.c with:
+  - PwmWaveform_gamma: the PWM duty, as a fraction of 65535, for each of
+    PWMWAVEFORM_LEVELS perceived brightness levels, following the CIE 1931
+    lightness curve
+  - PwmWaveform_sine: the brightness level for each of PWMWAVEFORM_STEPS
+    steps of one sine period, starting at the lowest level
+
+Usage:
+    gen_pwm_tables.py [-o pwmled_CC1350_LAUNCHXL_tirtos_ccs/PwmWaveformTables.c]
+    [--levels 64] [--steps 64]
+
+The level and step counts must match PWMWAVEFORM_LEVELS and
+PWMWAVEFORM_STEPS in PwmWaveform.h.
+"""
+
+import argparse
+import math
+import os
+
+DEFAULT_OUTPUT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..",
+                              "pwmled_CC1350_LAUNCHXL_tirtos_ccs", "PwmWaveformTables.c")
+
+LICENSE_SOURCE = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..",
+                              "pwmled_CC1350_LAUNCHXL_tirtos_ccs", "PwmWaveform.c")
+
+
+def cie_luminance(lightness):
+    """Relative luminance for a CIE L* lightness between 0 and 1."""
+    if lightness <= 0.08:
+        return lightness / 9.033
+    return ((lightness + 0.16) / 1.16) ** 3
+
+
+def gamma_table(levels):
+    return [int(round(cie_luminance(i / (levels - 1)) * 65535)) for i in range(levels)]
+
+
+def sine_table(steps, levels):
+    top = levels - 1
+    return [int(round(top * (1 - math.cos(2 * math.pi * i / steps)) / 2)) for i in range(steps)]
+
+
+def format_array(values, per_line):
+    lines = []
+    for i in range(0, len(values), per_line):
+        lines.append("    " + ", ".join("%d" % v for v in values[i:i + per_line]) + ",")
+    return "\n".join(lines)
+
+
+def license_header():
+    """The license comment of PwmWaveform.c, so the generated file carries the same one."""
+    with open(LICENSE_SOURCE) as f:
+        text = f.read()
+    return text[:text.index("*/") + 2]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("-o", "--output", default=DEFAULT_OUTPUT)
+    parser.add_argument("--levels", type=int, default=64)
+    parser.add_argument("--steps", type=int, default=64)
+    args = parser.parse_args()
+
+    source = """%s
+
+/* Generated by tools/gen_pwm_tables.py --levels %d --steps %d, do not edit */
+
+/***** Includes *****/
+#include "PwmWaveform.h"
+
+#if (PWMWAVEFORM_LEVELS != %d) || (PWMWAVEFORM_STEPS != %d)
+#error "Regenerate PwmWaveformTables.c for PWMWAVEFORM_LEVELS and PWMWAVEFORM_STEPS"
+#endif
+
+/***** Variable declarations *****/
+/* Duty cycle of each brightness level, as a fraction of 65535 */
+const uint16_t PwmWaveform_gamma[PWMWAVEFORM_LEVELS] = {
+%s
+};
+
+/* Brightness level of each step of a sine period */
+const uint8_t PwmWaveform_sine[PWMWAVEFORM_STEPS] = {
+%s
+};
+""" % (license_header(), args.levels, args.steps, args.levels, args.steps,
+       format_array(gamma_table(args.levels), 8),
+       format_array(sine_table(args.steps, args.levels), 16))
+
+    with open(args.output, "w") as f:
+        f.write(source)
+
+
+if __name__ == "__main__":
+    main()
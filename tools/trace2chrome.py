@@ -0,0 +1,203 @@
+#!/usr/bin/env python3
+"""Convert a trace dump from trace/Trace.c into Chrome trace event JSON.
+
+The dump is the text printed by Trace_dump on the UART, between the
+"TRACE <freq> <count>" and "TRACE END" lines. Any other output around it,
+e.g. the concentrator node table, is ignored. Load the result in
+chrome://tracing or https://ui.perfetto.dev.
+
+Usage:
+    trace2chrome.py dump.txt [--map app.map] [-o trace.json]
+
+With --map, the linker map file of the application is used to name tasks by
+the symbol of their Task_Struct, e.g. nodeRadioTask.
+"""
+
+import argparse
+import json
+import re
+import sys
+
+EVENT_TASK_SWITCH = 1
+EVENT_RF_CMD_POST = 2
+EVENT_RF_CMD_DONE = 3
+EVENT_EVENT_POST = 4
+EVENT_EVENT_WAKE = 5
+EVENT_BEGIN = 6
+EVENT_END = 7
+EVENT_MARKER = 8
+
+THREAD_TYPES = {0: "Hwi", 1: "Swi", 2: "Task", 3: "Main"}
+
+RF_COMMANDS = {
+    0x0803: "CMD_FS",
+    0x0808: "CMD_TX_TEST",
+    0x0810: "CMD_SCH_IMM",
+    0x1803: "CMD_BLE_ADV",
+    0x1805: "CMD_BLE_ADV_NC",
+    0x1809: "CMD_BLE_GENERIC_RX",
+    0x3801: "CMD_PROP_TX",
+    0x3802: "CMD_PROP_RX",
+    0x3803: "CMD_PROP_TX_ADV",
+    0x3804: "CMD_PROP_RX_ADV",
+    0x3805: "CMD_PROP_CS",
+    0x3806: "CMD_PROP_RADIO_SETUP",
+    0x3807: "CMD_PROP_RADIO_DIV_SETUP",
+}
+
+PID = 1
+TID_HWI = "Hwi"
+TID_SWI = "Swi"
+TID_RF = "RF"
+TID_MARKERS = "Markers"
+
+RECORD_RE = re.compile(r"([0-9a-fA-F]{8}) ([0-9a-fA-F]{2}) ([0-9a-fA-F]{2}) ([0-9a-fA-F]{4})")
+HEADER_RE = re.compile(r"TRACE (\d+) (\d+)")
+SYMBOL_RE = re.compile(r"^([0-9a-fA-F]{8})\s+(\w+)\s*$")
+IDLE_TASK_RE = re.compile(r"^\s+([0-9a-fA-F]{8})\s+[0-9a-fA-F]{8}\s+\S+\s+\(\.data:ti_sysbios_knl_Task_Object__table__V\)")
+
+
+def strip_ansi(line):
+    return re.sub(r"\x1b\[[0-9;]*[A-Za-z]", "", line)
+
+
+def read_dump(lines):
+    """Returns the timestamp frequency and the list of raw records"""
+    freq = None
+    records = []
+    for line in lines:
+        line = strip_ansi(line).strip()
+        header = HEADER_RE.search(line)
+        if header:
+            freq = int(header.group(1))
+            records = []
+            continue
+        if freq is None:
+            continue
+        if "TRACE END" in line:
+            break
+        match = RECORD_RE.search(line)
+        if match:
+            records.append(tuple(int(group, 16) for group in match.groups()))
+    if freq is None:
+        sys.exit("no TRACE header found in the dump")
+    return freq, records
+
+
+def read_task_names(map_file):
+    """Maps the low half of RAM symbol addresses to names"""
+    names = {}
+    with open(map_file) as f:
+        for line in f:
+            symbol = SYMBOL_RE.match(line)
+            if symbol and symbol.group(1).startswith("2000"):
+                names.setdefault(int(symbol.group(1), 16) & 0xFFFF, symbol.group(2))
+            idle = IDLE_TASK_RE.match(line)
+            if idle:
+                names[int(idle.group(1), 16) & 0xFFFF] = "Idle"
+    return names
+
+
+def unwrap(records, freq):
+    """Converts the 32-bit timestamps to us since the first record"""
+    out = []
+    if not records:
+        return out
+    base = records[0][0]
+    high = 0
+    previous = base
+    for timestamp, event, arg8, arg16 in records:
+        # The 32-bit counter wraps, assume no gap between records is half of it
+        if timestamp < previous and previous - timestamp > 0x80000000:
+            high += 1 << 32
+        previous = timestamp
+        ticks = high + timestamp - base
+        out.append((ticks * 1e6 / freq, event & 0x3F, event >> 6, arg8, arg16))
+    # Preempted writers may be slightly out of order
+    out.sort(key=lambda record: record[0])
+    return out
+
+
+def convert(records, task_names):
+    events = []
+    current_task = None
+    task_start = None
+    rf_posted = {}
+
+    def task_name(handle):
+        return task_names.get(handle, "task 0x%04x" % handle)
+
+    def context_tid(thread_type):
+        if thread_type == 0:
+            return TID_HWI
+        if thread_type == 1:
+            return TID_SWI
+        return task_name(current_task) if current_task is not None else "Main"
+
+    for ts, event, thread_type, arg8, arg16 in records:
+        if event == EVENT_TASK_SWITCH:
+            if current_task is not None:
+                events.append({"name": task_name(current_task), "ph": "X", "pid": PID,
+                               "tid": "CPU", "ts": task_start, "dur": ts - task_start})
+            current_task = arg16
+            task_start = ts
+        elif event == EVENT_RF_CMD_POST:
+            rf_posted[arg16] = ts
+        elif event == EVENT_RF_CMD_DONE:
+            start = rf_posted.pop(arg16, None)
+            name = RF_COMMANDS.get(arg16, "RF 0x%04x" % arg16)
+            status = ("error" if arg8 & 0x80 else "done") + " %d" % (arg8 & 0x7F)
+            if start is not None:
+                events.append({"name": name, "ph": "X", "pid": PID, "tid": TID_RF,
+                               "ts": start, "dur": ts - start, "args": {"status": status}})
+            else:
+                events.append({"name": name + " done", "ph": "i", "s": "t", "pid": PID,
+                               "tid": TID_RF, "ts": ts, "args": {"status": status}})
+        elif event in (EVENT_EVENT_POST, EVENT_EVENT_WAKE):
+            name = "Event_post" if event == EVENT_EVENT_POST else "Event_pend wake"
+            events.append({"name": name, "ph": "i", "s": "t", "pid": PID,
+                           "tid": context_tid(thread_type), "ts": ts,
+                           "args": {"events": "0x%04x" % arg16}})
+        elif event in (EVENT_BEGIN, EVENT_END):
+            events.append({"name": "marker %d" % arg8, "ph": "B" if event == EVENT_BEGIN else "E",
+                           "pid": PID, "tid": TID_MARKERS, "ts": ts, "args": {"value": arg16}})
+        elif event == EVENT_MARKER:
+            events.append({"name": "marker %d" % arg8, "ph": "i", "s": "t", "pid": PID,
+                           "tid": context_tid(thread_type), "ts": ts, "args": {"value": arg16}})
+
+    if current_task is not None and records:
+        events.append({"name": task_name(current_task), "ph": "X", "pid": PID, "tid": "CPU",
+                       "ts": task_start, "dur": records[-1][0] - task_start})
+
+    # RF commands still running at the end of the dump
+    for command, start in rf_posted.items():
+        events.append({"name": RF_COMMANDS.get(command, "RF 0x%04x" % command) + " posted",
+                       "ph": "i", "s": "t", "pid": PID, "tid": TID_RF, "ts": start})
+
+    return events
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("dump", help="UART output containing a trace dump")
+    parser.add_argument("--map", help="linker map file used to name tasks")
+    parser.add_argument("-o", "--output", help="output file, stdout if not given")
+    args = parser.parse_args()
+
+    with open(args.dump, errors="replace") as f:
+        freq, raw_records = read_dump(f)
+
+    task_names = read_task_names(args.map) if args.map else {}
+    events = convert(unwrap(raw_records, freq), task_names)
+
+    trace = {"traceEvents": events, "displayTimeUnit": "ms"}
+    if args.output:
+        with open(args.output, "w") as f:
+            json.dump(trace, f)
+    else:
+        json.dump(trace, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()